@@ -0,0 +1,650 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Storage footprint and scan cost of each genotype encoding.  The same
+ *   VCF is encoded as its sample columns, as the gt load files of each
+ *   vcf2scidb mode, run as they would be for a load, and as the array
+ *   layouts of the gt8 plugin.  For each one the bytes per genotype on
+ *   disk and in memory, the compression ratio under deflate and BGZF, and
+ *   the single and all core throughput of an alternate allele count over
+ *   every genotype are reported as JSON.
+ *
+ *   Every scan must find the same number of alternate alleles, or the run
+ *   fails.  Load files leave out empty calls, which count nothing.
+ *
+ */
+
+// Standard includes
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+
+// System
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// Boost
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+
+#include <zlib.h>
+
+#include "gt8.h"
+#include "bgzf.hpp"
+#include "thread-pool.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace boost::program_options;
+using namespace boost::algorithm;
+
+// Fields of a record of a SciDB binary load file
+enum EField {
+    eFieldInt64,
+    eFieldGt8,
+    eFieldString
+};
+
+struct field {
+    EField type;
+    bool nullable;
+};
+
+typedef vector<field> layout;
+
+typedef uint64_t (*scan_fn)(char const* begin, char const* end, layout const& fields);
+
+struct encoding {
+    string name;
+    string kind;            // vcf, load or array
+    bool lossless;          // keeps everything in the sample columns
+    string data;            // the bytes as written
+    uint64_t memory;        // bytes held in memory by the array, or data.size()
+    size_t scanned;         // the scan reads data[0, scanned), the gt8 column of an array
+    vector<size_t> blocks;  // offsets a scan can start from, then scanned
+    layout fields;
+    scan_fn scan;
+};
+
+struct codec_result {
+    string name;
+    uint64_t bytes;
+    double seconds;
+};
+
+struct encoding_result {
+    uint64_t alt_alleles;
+    double single_seconds;
+    double all_seconds;
+    vector<codec_result> codecs;
+};
+
+// Alternate alleles of each gt8, a missing allele counts as none
+static uint8_t _alt_alleles[256];
+
+void init_alt_alleles()
+{
+    for (unsigned g = 0; g < 256; ++g) {
+        uint8_t d = gt8_dosage((gt8_t)g);
+        _alt_alleles[g] = (d == GT8_DOSAGE_MISSING) ? 0 : d;
+    }
+}
+
+/*
+ * Allele count kernels, one for each way of storing the calls
+ */
+
+uint64_t scan_gt8(char const* begin, char const* end, layout const&)
+{
+    uint64_t total = 0;
+    for (uint8_t const* p = (uint8_t const*)begin; p < (uint8_t const*)end; ++p) total += _alt_alleles[*p];
+    return total;
+}
+
+// Two bit planes a row, the calls with any alternate allele, then those with two
+uint64_t scan_bitplanes(char const* begin, char const* end, layout const&)
+{
+    uint64_t total = 0;
+    for (uint64_t const* p = (uint64_t const*)begin; p < (uint64_t const*)end; ++p) total += __builtin_popcountll(*p);
+    return total;
+}
+
+uint64_t parse_alt_alleles(char const* s, size_t len)
+{
+    gt8_t g;
+    return gt8_parse(s, len, g) ? _alt_alleles[g] : 0;
+}
+
+// Tab separated sample columns, one row a line, GT first
+uint64_t scan_vcf(char const* begin, char const* end, layout const&)
+{
+    uint64_t total = 0;
+    char const* p = begin;
+    while (p < end) {
+        char const* gt = p;
+        while ((p < end) && (*p != ':') && (*p != '\t') && (*p != '\n')) ++p;
+        total += parse_alt_alleles(gt, p - gt);
+        while ((p < end) && (*p != '\t') && (*p != '\n')) ++p;
+        ++p;
+    }
+    return total;
+}
+
+// Text load tuples, ("chrom",pos,var,sampleid,"gt","unparsed")
+uint64_t scan_text(char const* begin, char const* end, layout const&)
+{
+    uint64_t total = 0;
+    char const* p = begin;
+    while (p < end) {
+        char const* eol = (char const*)memchr(p, '\n', end - p);
+        if (eol == NULL) eol = end;
+        if (*p == '(') {
+            int commas = 0;
+            while ((p < eol) && (commas < 4)) commas += (*p++ == ',');
+            if ((p < eol) && (*p == '"')) {
+                char const* gt = ++p;
+                while ((p < eol) && (*p != '"')) ++p;
+                total += parse_alt_alleles(gt, p - gt);
+            }
+        }
+        p = eol + 1;
+    }
+    return total;
+}
+
+// Step over one binary record, setting gt to its gt8, or -1 if it is null.
+// A nullable field has a null byte first, then its value either way.
+char const* next_record(char const* p, layout const& fields, int& gt)
+{
+    gt = -1;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        bool null = fields[i].nullable && (*(int8_t const*)p++ != -1);
+        switch (fields[i].type) {
+        case eFieldInt64:
+            p += 8;
+            break;
+        case eFieldGt8:
+            if (!null) gt = *(uint8_t const*)p;
+            ++p;
+            break;
+        case eFieldString:
+            uint32_t size;
+            memcpy(&size, p, sizeof(size));
+            p += sizeof(size) + size;
+            break;
+        }
+    }
+    return p;
+}
+
+uint64_t scan_binary(char const* begin, char const* end, layout const& fields)
+{
+    uint64_t total = 0;
+    int gt;
+    for (char const* p = begin; p < end; ) {
+        p = next_record(p, fields, gt);
+        if (gt >= 0) total += _alt_alleles[gt];
+    }
+    return total;
+}
+
+// The types of an input() format such as "(int64,gt8 null,string null)"
+layout parse_layout(string const& types)
+{
+    layout fields;
+    vector<string> names;
+    string inner = trim_copy_if(types, is_any_of("()"));
+    split(names, inner, is_any_of(","));
+    for (size_t i = 0; i < names.size(); ++i) {
+        string name = trim_copy(names[i]);
+        field f;
+        f.nullable = ends_with(name, " null");
+        if (f.nullable) name = trim_copy(name.substr(0, name.size() - 5));
+        if (name == "int64") f.type = eFieldInt64;
+        else if (name == "gt8") f.type = eFieldGt8;
+        else f.type = eFieldString;     // string and the other variable size types
+        fields.push_back(f);
+    }
+    return fields;
+}
+
+/*
+ * Building the encodings
+ */
+
+string read_file(string const& filename)
+{
+    ifstream ifs(filename.c_str(), ios::binary);
+    return string((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+}
+
+// Block offsets at every nth line
+void line_blocks(encoding& e, size_t lines)
+{
+    e.blocks.clear();
+    size_t n = 0;
+    for (size_t p = 0; p < e.scanned; ++p) {
+        if ((n++ % lines) == 0) e.blocks.push_back(p);
+        p = e.data.find('\n', p);
+        if (p == string::npos) break;
+    }
+    e.blocks.push_back(e.scanned);
+}
+
+// The sample columns, and the gt8 and the rest of each call
+void encode_vcf(string const& filename, size_t block_genotypes, encoding& vcf, encoding& gt8,
+                encoding& unparsed, encoding& bitplanes, uint64_t& rows, uint64_t& samples)
+{
+    ifstream ifs(filename.c_str());
+    if (!ifs) {
+        cerr << "Failed to open input file: " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    string line;
+    string strings;
+    uint64_t string_bytes = 0;
+    vector<uint64_t> planes;
+    rows = samples = 0;
+    while (getline(ifs, line)) {
+        if (line.empty() || (line[0] == '#')) continue;
+        size_t p = 0;
+        for (int tabs = 0; (tabs < 9) && (p != string::npos); ++tabs) {
+            p = line.find('\t', p);
+            if (p != string::npos) ++p;
+        }
+        if (p == string::npos) continue;
+        vcf.data.append(line, p, string::npos);
+        vcf.data.push_back('\n');
+
+        size_t words = 0;
+        size_t column = 0;
+        while (p <= line.size()) {
+            size_t tab = line.find('\t', p);
+            if (tab == string::npos) tab = line.size();
+            size_t colon = line.find(':', p);
+            if ((colon == string::npos) || (colon > tab)) colon = tab;
+            gt8_t g = 0;
+            gt8_parse(line.data() + p, colon - p, g);
+            gt8.data.push_back((char)g);
+            // Variable size values are kept with their NUL and an offset
+            if (colon < tab) strings.append(line, colon + 1, tab - colon - 1);
+            strings.push_back('\0');
+            string_bytes += 4;
+
+            if ((column % 64) == 0) {
+                planes.resize(planes.size() + 2, 0);
+                ++words;
+            }
+            uint8_t d = _alt_alleles[g];
+            if (d > 0) planes[planes.size() - 2] |= 1ULL << (column % 64);
+            if (d > 1) planes[planes.size() - 1] |= 1ULL << (column % 64);
+            ++column;
+            p = tab + 1;
+        }
+        // Lay out the row as all the first plane words, then the second
+        vector<uint64_t> row(planes.end() - 2 * words, planes.end());
+        for (size_t w = 0; w < words; ++w) {
+            planes[planes.size() - 2 * words + w] = row[2 * w];
+            planes[planes.size() - words + w] = row[2 * w + 1];
+        }
+        if (column > samples) samples = column;
+        ++rows;
+    }
+
+    size_t rows_per_block = std::max((size_t)1, block_genotypes / std::max((uint64_t)1, samples));
+    vcf.memory = vcf.scanned = vcf.data.size();
+    line_blocks(vcf, rows_per_block);
+
+    gt8.memory = gt8.scanned = gt8.data.size();
+    for (size_t p = 0; p < gt8.scanned; p += block_genotypes) gt8.blocks.push_back(p);
+    gt8.blocks.push_back(gt8.scanned);
+
+    unparsed.data = gt8.data + strings;
+    unparsed.memory = unparsed.data.size() + string_bytes;
+    unparsed.scanned = gt8.scanned;
+    unparsed.blocks = gt8.blocks;
+
+    bitplanes.data.assign((char const*)&planes[0], planes.size() * sizeof(uint64_t));
+    bitplanes.memory = bitplanes.scanned = bitplanes.data.size();
+    size_t row_bytes = rows ? bitplanes.data.size() / rows : 0;
+    for (size_t p = 0; p < bitplanes.scanned; p += rows_per_block * row_bytes) bitplanes.blocks.push_back(p);
+    bitplanes.blocks.push_back(bitplanes.scanned);
+}
+
+// Run vcf2scidb on the input, keeping the gt file it writes
+bool run_loader(vector<string> args, string const& input, string const& gtout, bool verbose)
+{
+    vector<char*> argv;
+    for (size_t i = 0; i < args.size(); ++i) argv.push_back(const_cast<char*>(args[i].c_str()));
+    argv.push_back(NULL);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int in = open(input.c_str(), O_RDONLY);
+        int devnull = open("/dev/null", O_WRONLY);
+        if ((in < 0) || (devnull < 0)) _exit(127);
+        dup2(in, 0);
+        dup2(devnull, 1);
+        if (!verbose) dup2(devnull, 2);
+        execv(argv[0], &argv[0]);
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && (WEXITSTATUS(status) == 0) && (access(gtout.c_str(), R_OK) == 0);
+}
+
+bool encode_load(encoding& e, string const& vcf2scidb, vector<string> const& options, string const& types,
+                 string const& input, string const& descriptions, string const& tmpdir,
+                 size_t block_genotypes, bool verbose)
+{
+    string gtout = tmpdir + "/gt";
+    string chroms = tmpdir + "/chroms";
+    vector<string> args;
+    args.push_back(vcf2scidb);
+    args.insert(args.end(), options.begin(), options.end());
+    if (!descriptions.empty()) {
+        args.push_back("-d");
+        args.push_back(descriptions);
+    }
+    args.push_back("--chroms");
+    args.push_back(chroms);
+    args.push_back("-v");
+    args.push_back("/dev/null");
+    args.push_back("-g");
+    args.push_back(gtout);
+
+    bool ok = run_loader(args, input, gtout, verbose);
+    if (ok) e.data = read_file(gtout);
+    unlink(gtout.c_str());
+    unlink(chroms.c_str());
+    if (!ok) return false;
+
+    e.memory = e.scanned = e.data.size();
+    if (types.empty()) {
+        line_blocks(e, block_genotypes);
+        return true;
+    }
+    e.fields = parse_layout(types);
+    int gt;
+    size_t n = 0;
+    for (char const* p = e.data.data(); p < e.data.data() + e.scanned; p = next_record(p, e.fields, gt)) {
+        if ((n++ % block_genotypes) == 0) e.blocks.push_back(p - e.data.data());
+    }
+    e.blocks.push_back(e.scanned);
+    return true;
+}
+
+/*
+ * Measurements
+ */
+
+uint64_t deflated_size(string const& data, int level)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    deflateInit(&zs, level);
+    vector<Bytef> out(1 << 20);
+    uint64_t total = 0;
+    size_t done = 0;
+    int flush;
+    do {
+        size_t len = std::min(data.size() - done, (size_t)(1 << 20));
+        zs.next_in = (Bytef*)data.data() + done;
+        zs.avail_in = len;
+        done += len;
+        flush = (done == data.size()) ? Z_FINISH : Z_NO_FLUSH;
+        do {
+            zs.next_out = &out[0];
+            zs.avail_out = out.size();
+            deflate(&zs, flush);
+            total += out.size() - zs.avail_out;
+        } while (zs.avail_out == 0);
+    } while (flush != Z_FINISH);
+    deflateEnd(&zs);
+    return total;
+}
+
+uint64_t bgzf_size(string const& data, int level)
+{
+    uint64_t total = 0;
+    string out;
+    for (size_t done = 0; done < data.size(); done += BGZF_BLOCK_INPUT) {
+        out.clear();
+        bgzf_compress_block(data.data() + done, std::min(data.size() - done, (size_t)BGZF_BLOCK_INPUT), level, out);
+        total += out.size();
+    }
+    out.clear();
+    bgzf_eof(out);
+    return total + out.size();
+}
+
+codec_result measure_codec(string const& name, string const& data, int level, bool bgzf)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint64_t bytes = bgzf ? bgzf_size(data, level) : deflated_size(data, level);
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+    codec_result r = { name, bytes, chrono::duration<double>(stop - start).count() };
+    return r;
+}
+
+// Best of repeat scans of all the blocks, on this thread or across the pool
+double time_scan(encoding const& e, thread_pool* pool, int repeat, uint64_t& alt_alleles)
+{
+    size_t n = e.blocks.size() - 1;
+    vector<uint64_t> partial(n, 0);
+    std::function<void(size_t)> fn = [&](size_t i) {
+        partial[i] = e.scan(e.data.data() + e.blocks[i], e.data.data() + e.blocks[i + 1], e.fields);
+    };
+    double best = 0;
+    for (int r = 0; r < repeat; ++r) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if (pool) pool->run(n, fn);
+        else for (size_t i = 0; i < n; ++i) fn(i);
+        chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+        double secs = chrono::duration<double>(stop - start).count();
+        if ((r == 0) || (secs < best)) best = secs;
+    }
+    alt_alleles = 0;
+    for (size_t i = 0; i < n; ++i) alt_alleles += partial[i];
+    return best;
+}
+
+void write_json(ostream& os, string const& label, string const& input, uint64_t rows, uint64_t samples,
+                size_t threads, vector<encoding> const& encodings, vector<encoding_result> const& results)
+{
+    uint64_t genotypes = rows * samples;
+    double per = genotypes ? 1.0 / genotypes : 0;
+    os << "{\n";
+    os << "  \"label\": \"" << label << "\",\n";
+    os << "  \"input\": {\"file\": \"" << input << "\", \"rows\": " << rows << ", \"samples\": " << samples
+       << ", \"genotypes\": " << genotypes << "},\n";
+    os << "  \"threads\": " << threads << ",\n";
+    os << "  \"encodings\": [";
+    for (size_t i = 0; i < encodings.size(); ++i) {
+        encoding const& e = encodings[i];
+        encoding_result const& r = results[i];
+        os << (i ? ",\n" : "\n");
+        os << "    {\"name\": \"" << e.name << "\", \"kind\": \"" << e.kind << "\""
+           << ", \"lossless\": " << (e.lossless ? "true" : "false")
+           << ", \"bytes\": " << e.data.size()
+           << ", \"bytes_per_genotype\": " << e.data.size() * per
+           << ", \"memory_bytes_per_genotype\": " << e.memory * per
+           << ", \"compression\": {";
+        for (size_t c = 0; c < r.codecs.size(); ++c) {
+            codec_result const& cr = r.codecs[c];
+            os << (c ? ", " : "") << "\"" << cr.name << "\": {\"bytes_per_genotype\": " << cr.bytes * per
+               << ", \"ratio\": " << (cr.bytes ? (double)e.data.size() / cr.bytes : 0)
+               << ", \"mb_per_s\": " << e.data.size() / (1024.0 * 1024.0) / std::max(cr.seconds, 1e-9) << "}";
+        }
+        os << "}"
+           << ", \"alt_alleles\": " << r.alt_alleles
+           << ", \"scan_single_genotypes_per_s\": " << genotypes / std::max(r.single_seconds, 1e-9)
+           << ", \"scan_all_genotypes_per_s\": " << genotypes / std::max(r.all_seconds, 1e-9)
+           << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+    options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "view help message, then exit")
+        ("input,i", value<string>(), "uncompressed VCF input file (required)")
+        ("descriptions,d", value<string>(), "CSV file listing info about the samples, passed to vcf2scidb")
+        ("vcf2scidb", value<string>()->default_value("./vcf2scidb"), "path to vcf2scidb, no load files if it fails")
+        ("threads,t", value<size_t>()->default_value(std::thread::hardware_concurrency()), "threads of the all core scan")
+        ("block,b", value<size_t>()->default_value(1 << 20), "genotypes a scan task, about a chunk")
+        ("repeat,r", value<int>()->default_value(3), "scans of each encoding, the best is kept")
+        ("label,l", value<string>()->default_value(""), "label for this set of runs, e.g. a commit id")
+        ("output,o", value<string>(), "JSON output file (default: stdout)")
+        ("verbose", "let the loaders write to stderr")
+    ;
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+    notify(vm);
+
+    if (vm.count("help") || !vm.count("input")) {
+        cout << desc << "\n";
+        return 1;
+    }
+
+    string input = vm["input"].as<string>();
+    string descriptions = vm.count("descriptions") ? vm["descriptions"].as<string>() : "";
+    size_t block = std::max((size_t)1, vm["block"].as<size_t>());
+    size_t threads = std::max((size_t)1, vm["threads"].as<size_t>());
+    int repeat = std::max(1, vm["repeat"].as<int>());
+    bool verbose = vm.count("verbose") > 0;
+    init_alt_alleles();
+
+    vector<encoding> encodings(4);
+    encoding& vcf = encodings[0];
+    encoding& gt8 = encodings[1];
+    encoding& unparsed = encodings[2];
+    encoding& bitplanes = encodings[3];
+    vcf.name = "vcf";
+    vcf.kind = "vcf";
+    vcf.lossless = true;
+    vcf.scan = scan_vcf;
+    gt8.name = "gt8";
+    gt8.kind = "array";
+    gt8.lossless = false;
+    gt8.scan = scan_gt8;
+    unparsed.name = "gt8+unparsed";
+    unparsed.kind = "array";
+    unparsed.lossless = true;
+    unparsed.scan = scan_gt8;
+    bitplanes.name = "bitplanes";
+    bitplanes.kind = "array";
+    bitplanes.lossless = false;
+    bitplanes.scan = scan_bitplanes;
+    uint64_t rows, samples;
+    encode_vcf(input, block, vcf, gt8, unparsed, bitplanes, rows, samples);
+    cerr << "input: " << rows << " rows, " << samples << " samples" << endl;
+
+    // The gt file of each load mode, with the layout of its records
+    struct load_mode {
+        char const* name;
+        char const* options;
+        char const* types;
+    };
+    static load_mode const modes[] = {
+        { "load-text", "-t", "" },
+        { "load-binary", "-b", "(string,int64,int64,int64,gt8,string null)" },
+        { "load-native", "-n", "(int64,int64,int64,int64,gt8 null,string null)" },
+        { "load-native-gl", "-n|--gt-schema|<gt:gt8 null,gl:gl null,unparsed:string null>"
+          "[chromid=0:*,1,0,pos=1:*,200000,0,var=1:*,20,0,sampleid=0:*,1000,0]",
+          "(int64,int64,int64,int64,gt8 null,gl null,string null)" }
+    };
+    char tmpl[] = "/tmp/encbench.XXXXXX";
+    if (mkdtemp(tmpl) == NULL) {
+        cerr << "Failed to create temporary directory" << endl;
+        return EXIT_FAILURE;
+    }
+    string tmpdir(tmpl);
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+        encoding e;
+        e.name = modes[m].name;
+        e.kind = "load";
+        e.lossless = true;
+        e.scan = *modes[m].types ? scan_binary : scan_text;
+        vector<string> options;
+        string optstr(modes[m].options);
+        split(options, optstr, is_any_of("|"));
+        if (encode_load(e, vm["vcf2scidb"].as<string>(), options, modes[m].types, input, descriptions,
+                        tmpdir, block, verbose)) {
+            encodings.push_back(e);
+        } else {
+            cerr << e.name << ": vcf2scidb failed, skipped" << endl;
+        }
+    }
+    rmdir(tmpdir.c_str());
+
+    thread_pool pool(threads);
+    vector<encoding_result> results;
+    bool failed = false;
+    for (size_t i = 0; i < encodings.size(); ++i) {
+        encoding const& e = encodings[i];
+        encoding_result r;
+        uint64_t alt;
+        r.single_seconds = time_scan(e, NULL, repeat, r.alt_alleles);
+        r.all_seconds = time_scan(e, &pool, repeat, alt);
+        r.codecs.push_back(measure_codec("deflate-1", e.data, 1, false));
+        r.codecs.push_back(measure_codec("deflate-6", e.data, 6, false));
+        r.codecs.push_back(measure_codec("bgzf", e.data, Z_DEFAULT_COMPRESSION, true));
+        cerr << e.name << ": " << e.data.size() << " bytes, " << r.alt_alleles << " alt alleles, scan "
+             << r.single_seconds << " s, " << r.all_seconds << " s on " << threads << " threads" << endl;
+        uint64_t expected = results.empty() ? r.alt_alleles : results[0].alt_alleles;
+        if ((r.alt_alleles != expected) || (alt != r.alt_alleles)) {
+            cerr << "FAILED: " << e.name << " counts " << r.alt_alleles << " alt alleles" << endl;
+            failed = true;
+        }
+        results.push_back(r);
+    }
+
+    if (vm.count("output")) {
+        ofstream ofs(vm["output"].as<string>().c_str());
+        write_json(ofs, vm["label"].as<string>(), input, rows, samples, threads, encodings, results);
+    } else {
+        write_json(cout, vm["label"].as<string>(), input, rows, samples, threads, encodings, results);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,733 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Correctness checks and microbenchmarks for the gt8 plugin functions,
+ *   run outside of SciDB through the scidb::Value stub.  Every gt8 value
+ *   (and every pair for the comparison operators) is checked against a
+ *   straightforward reference, then each registered function is timed over
+ *   a large array of generated values.  Exits non-zero if a check fails.
+ *
+ */
+
+// Standard includes
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdint.h>
+
+// Boost
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+
+#include "scidb-value-stub.h"
+
+using namespace std;
+using namespace boost;
+using namespace boost::program_options;
+using namespace boost::algorithm;
+using scidb::Value;
+
+#include "gt8-udf.h"
+#include "gt-filter.h"
+
+typedef void (*udf_t)(const Value**, Value*, void*);
+
+static size_t _failures = 0;
+
+#define CHECK(cond, what)                                               \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            if (++_failures <= 20) cerr << "FAILED: " << what << endl;  \
+        }                                                               \
+    } while (0)
+
+/*
+ * Reference implementations, decoding the bits directly
+ */
+
+struct ref_gt {
+    bool diploid;
+    bool phased;
+    int a;      // allele + 1, 0 if missing
+    int b;
+    int hap;    // haploid allele + 1
+};
+
+ref_gt ref_decode(uint8_t g)
+{
+    ref_gt r;
+    r.diploid = (g >> 7) & 1;
+    r.phased = (g >> 6) & 1;
+    r.a = (g >> 3) & 7;
+    r.b = g & 7;
+    r.hap = g;
+    return r;
+}
+
+string ref_text(uint8_t g)
+{
+    ref_gt r = ref_decode(g);
+    char buf[32];
+    if (!r.diploid) {
+        if (r.hap == 0) return ".";
+        snprintf(buf, sizeof(buf), "%d", r.hap - 1);
+        return buf;
+    }
+    string s;
+    s += (r.a == 0) ? string(".") : to_string(r.a - 1);
+    s += r.phased ? '|' : '/';
+    s += (r.b == 0) ? string(".") : to_string(r.b - 1);
+    return s;
+}
+
+unsigned ref_load(uint8_t g)
+{
+    ref_gt r = ref_decode(g);
+    return r.diploid ? (unsigned)(r.a + r.b) : g;
+}
+
+bool ref_less(uint8_t l, uint8_t r)
+{
+    unsigned ll = ref_load(l), lr = ref_load(r);
+    if (ll != lr) return ll < lr;
+    if ((l & 0x40) != (r & 0x40)) return (l & 0x40) < (r & 0x40);
+    return (l & 0x80) < (r & 0x80);
+}
+
+// The original split based implementations of the string functions
+bool ref_extract_value2(string const& key, string const& keyValStr, string& out)
+{
+    vector<string> keyValues;
+    split(keyValues, keyValStr, is_any_of(";"));
+    for (size_t i = 0; i < keyValues.size(); ++i) {
+        string const& entry = keyValues[i];
+        if ((entry.size() >= key.size()) && (entry.substr(0, key.size()) == key)) {
+            vector<string> kv_pair;
+            split(kv_pair, entry, is_any_of("="));
+            if (kv_pair.size() < 2) return false;
+            out = kv_pair[1];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ref_extract_value3(string const& key, string const& fmtStr, string const& valStr, string& out)
+{
+    vector<string> keys;
+    split(keys, fmtStr, is_any_of(":"));
+    vector<string>::iterator it = find(keys.begin(), keys.end(), key);
+    if (it == keys.end()) return false;
+    size_t pos = it - keys.begin();
+    vector<string> values;
+    split(values, valStr, is_any_of(":"));
+    if (values.size() <= pos) return false;
+    out = values[pos];
+    return true;
+}
+
+/*
+ * Calling helpers
+ */
+
+Value gt8_value(uint8_t g)
+{
+    Value v(sizeof(gt8_t));
+    *static_cast<gt8_t*>(v.data()) = g;
+    return v;
+}
+
+Value int64_value(int64_t i)
+{
+    Value v;
+    v.setInt64(i);
+    return v;
+}
+
+Value string_value(string const& s)
+{
+    Value v;
+    v.setString(s.c_str());
+    return v;
+}
+
+Value call(udf_t fn, Value const& a0)
+{
+    const Value* args[1] = { &a0 };
+    Value res(sizeof(uint64_t));
+    fn(args, &res, NULL);
+    return res;
+}
+
+Value call(udf_t fn, Value const& a0, Value const& a1)
+{
+    const Value* args[2] = { &a0, &a1 };
+    Value res(sizeof(uint64_t));
+    fn(args, &res, NULL);
+    return res;
+}
+
+Value call(udf_t fn, Value const& a0, Value const& a1, Value const& a2)
+{
+    const Value* args[3] = { &a0, &a1, &a2 };
+    Value res(sizeof(uint64_t));
+    fn(args, &res, NULL);
+    return res;
+}
+
+// Encode the nullable bool result as 0, 1 or 2 for null
+int tristate(Value const& v) { return v.isNull() ? 2 : (v.getBool() ? 1 : 0); }
+
+/*
+ * Exhaustive checks
+ */
+
+void check_gt8()
+{
+    for (int i = 0; i < 256; ++i) {
+        uint8_t g = (uint8_t)i;
+        ref_gt r = ref_decode(g);
+        Value v = gt8_value(g);
+        string tag = "gt8=" + to_string(i) + " ";
+
+        CHECK(call(gt8_hemizygous, v).getBool() == !r.diploid, tag + "hemizygous");
+
+        int hom = r.diploid ? ((r.a && r.b) ? (r.a == r.b) : 2) : 0;
+        CHECK(tristate(call(gt8_homozygous, v)) == hom, tag + "homozygous");
+
+        int het = r.diploid ? ((r.a && r.b) ? (r.a != r.b) : 2) : 0;
+        CHECK(tristate(call(gt8_heterozygous, v)) == het, tag + "heterozygous");
+
+        bool empty = r.diploid ? ((r.a == 0) && (r.b == 0)) : (g == 0);
+        CHECK(call(gt8_empty, v).getBool() == empty, tag + "empty_gt");
+
+        bool missing = r.diploid ? ((r.a == 0) || (r.b == 0)) : (g == 0);
+        CHECK(call(gt8_alleleMissing, v).getBool() == missing, tag + "allele_missing");
+
+        for (int64_t ai = 1; ai <= 3; ++ai) {
+            Value res = call(gt8_alleleValue, v, int64_value(ai));
+            int expect;
+            if (!r.diploid) expect = ((g == 0) || (ai > 1)) ? -1 : g - 1;
+            else expect = ((ai == 1) ? r.a : r.b) - 1;
+            if (expect < 0) CHECK(res.isNull(), tag + "allele_value null");
+            else CHECK(!res.isNull() && (res.getUint64() == (uint64_t)expect), tag + "allele_value");
+        }
+
+        for (int64_t ai = -1; ai <= 7; ++ai) {
+            uint64_t expect = 0;
+            if (!r.diploid) {
+                expect = ((g != 0) && (g - 1 == ai)) ? 1 : 0;
+            } else {
+                expect += ((r.a != 0) && (r.a - 1 == ai)) ? 1 : 0;
+                expect += ((r.b != 0) && (r.b - 1 == ai)) ? 1 : 0;
+            }
+            CHECK(call(gt8_alleleCount, v, int64_value(ai)).getUint64() == expect,
+                  tag + "allele_count " + to_string(ai));
+        }
+
+        Value dosage = call(gt8_alleleDosage, v);
+        if (missing) CHECK(dosage.isNull(), tag + "dosage null");
+        else CHECK(!dosage.isNull() && (dosage.getUint8() == (r.diploid ? (r.a > 1) + (r.b > 1) : (g > 1))),
+                   tag + "dosage");
+
+        CHECK(call(gt8_ploidy, v).getUint8() == (r.diploid ? 2 : 1), tag + "ploidy");
+        CHECK(call(gt8_phase, v).getBool() == r.phased, tag + "phase");
+
+        uint8_t norm = g;
+        if (r.diploid && ((r.a > r.b) || r.phased)) norm = 0x80 | (r.b << 3) | r.a;
+        CHECK(*static_cast<gt8_t*>(call(gt8_normalize, v).data()) == norm, tag + "norm");
+
+        // Converters, every value survives the round trip
+        string text = call(gt8_toString, v).getString();
+        CHECK(text == ref_text(g), tag + "string(gt8) " + text);
+        Value back;
+        try {
+            back = call(gt8_fromString, string_value(text));
+            CHECK(*static_cast<gt8_t*>(back.data()) == g, tag + "gt8(string(gt8))");
+        } catch (scidb::UserException const&) {
+            CHECK(false, tag + "gt8(string) threw on " + text);
+        }
+
+        for (int j = 0; j < 256; ++j) {
+            uint8_t h = (uint8_t)j;
+            Value w = gt8_value(h);
+            string pair = "gt8=" + to_string(i) + "," + to_string(j) + " ";
+            CHECK(call(gt8_lessThan, v, w).getBool() == ref_less(g, h), pair + "<");
+            CHECK(call(gt8_lessEqualThan, v, w).getBool() == (ref_load(g) <= ref_load(h)), pair + "<=");
+            CHECK(call(gt8_equal, v, w).getBool() == (g == h), pair + "=");
+        }
+    }
+
+    // Malformed text is refused
+    char const* bad[] = { "", "x", "0/", "/1", "a|b", "|" };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        bool threw = false;
+        try {
+            call(gt8_fromString, string_value(bad[i]));
+        } catch (scidb::UserException const&) {
+            threw = true;
+        }
+        CHECK(threw, string("gt8('") + bad[i] + "') should throw");
+    }
+}
+
+void check_strings()
+{
+    char const* info[] = { "AC=1;AF=0.5;AN=2", "DP=10", "AA", "AC=1=2;AF", "", ";;AF=0.1;",
+                           "AFR_AF=0.2;AF=0.3", "AF" };
+    char const* keys[] = { "AF", "AC", "AN", "DP", "A", "AFR", "", "X" };
+    for (size_t i = 0; i < sizeof(info) / sizeof(info[0]); ++i) {
+        for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); ++k) {
+            string expect;
+            bool found = ref_extract_value2(keys[k], info[i], expect);
+            Value res = call(extract_value2, string_value(keys[k]), string_value(info[i]));
+            string tag = string("extract_value('") + keys[k] + "','" + info[i] + "')";
+            if (found) CHECK((res.size() > 0) && (expect == res.getString()), tag);
+            else CHECK(res.size() == sizeof(uint64_t), tag + " should not set a result");
+        }
+    }
+
+    char const* fmts[] = { "GQ:DP:AD:PL", "GQ", "", "DP:DP" };
+    char const* vals[] = { "99:10:5,5:0,30,300", "99", "", "1:2:3", ":::" };
+    for (size_t f = 0; f < sizeof(fmts) / sizeof(fmts[0]); ++f) {
+        for (size_t v = 0; v < sizeof(vals) / sizeof(vals[0]); ++v) {
+            for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); ++k) {
+                char const* key = (k % 2) ? "PL" : "DP";
+                if (k >= 4) key = (k % 2) ? "GQ" : "AD";
+                string expect;
+                bool found = ref_extract_value3(key, fmts[f], vals[v], expect);
+                Value res = call(extract_value3, string_value(key), string_value(fmts[f]),
+                                 string_value(vals[v]));
+                string tag = string("extract_value('") + key + "','" + fmts[f] + "','" + vals[v] + "')";
+                if (found) CHECK((res.size() > 0) && (expect == res.getString()), tag);
+                else CHECK(res.size() == sizeof(uint64_t), tag + " should not set a result");
+            }
+        }
+    }
+
+    char const* csv[] = { "", "A", "A,C", ",,", "AC,GT,T" };
+    uint32_t csv_count[] = { 0, 1, 2, 3, 3 };
+    for (size_t i = 0; i < sizeof(csv) / sizeof(csv[0]); ++i) {
+        CHECK(call(num_csv, string_value(csv[i])).getUint32() == csv_count[i],
+              string("num_csv('") + csv[i] + "')");
+    }
+}
+
+// The functions on unsigned integers of T narrower than 64 bits
+template <typename T>
+void check_bits(uint64_t lhs, uint64_t rhs, udf_t and_fn, udf_t or_fn, udf_t xor_fn, udf_t not_fn)
+{
+    T l = (T)lhs, r = (T)rhs;
+    string bits = to_string(sizeof(T) * 8);
+    Value a(sizeof(T)), b(sizeof(T));
+    *static_cast<T*>(a.data()) = l;
+    *static_cast<T*>(b.data()) = r;
+    CHECK(*static_cast<T*>(call(and_fn, a, b).data()) == (T)(l & r), "bitand" + bits);
+    CHECK(*static_cast<T*>(call(or_fn, a, b).data()) == (T)(l | r), "bitor" + bits);
+    CHECK(*static_cast<T*>(call(xor_fn, a, b).data()) == (T)(l ^ r), "bitxor" + bits);
+    CHECK(*static_cast<T*>(call(not_fn, a).data()) == (T)~l, "bitnot" + bits);
+}
+
+void check_bitwise()
+{
+    uint64_t samples[] = { 0, 1, 0x5A, 0xFF, 0x1234, 0xFFFFFFFFULL, 0x0123456789ABCDEFULL, ~0ULL };
+    size_t n = sizeof(samples) / sizeof(samples[0]);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            Value l, r;
+            l.setUint64(samples[i]);
+            r.setUint64(samples[j]);
+            CHECK(call(bitwise_and64, l, r).getUint64() == (samples[i] & samples[j]), "bitand");
+            CHECK(call(bitwise_or64, l, r).getUint64() == (samples[i] | samples[j]), "bitor");
+            CHECK(call(bitwise_xor64, l, r).getUint64() == (samples[i] ^ samples[j]), "bitxor");
+            check_bits<uint8_t>(samples[i], samples[j], bitwise_and8, bitwise_or8, bitwise_xor8, bitwise_not8);
+            check_bits<uint16_t>(samples[i], samples[j], bitwise_and16, bitwise_or16, bitwise_xor16, bitwise_not16);
+            check_bits<uint32_t>(samples[i], samples[j], bitwise_and32, bitwise_or32, bitwise_xor32, bitwise_not32);
+        }
+        Value l;
+        l.setUint64(samples[i]);
+        CHECK(call(bitwise_not64, l).getUint64() == ~samples[i], "bitnot");
+    }
+}
+
+// Every class of gt_filter against the reference, and the selection of a
+// mixed filter against a scalar pass over every value and its neighbours
+bool ref_class(string const& c, uint8_t g)
+{
+    ref_gt r = ref_decode(g);
+    bool called = r.diploid ? (r.a && r.b) : (g != 0);
+    if (c == "het") return r.diploid && called && (r.a != r.b);
+    if (c == "hom") return r.diploid && called && (r.a == r.b);
+    if (c == "homref") return r.diploid && called && (r.a == 1) && (r.b == 1);
+    if (c == "homalt") return r.diploid && called && (r.a == r.b) && (r.a > 1);
+    if (c == "carrier") return r.diploid ? ((r.a > 1) || (r.b > 1)) : (g > 1);
+    if (c == "allele:2") return r.diploid ? ((r.a == 3) || (r.b == 3)) : (g == 3);
+    if (c == "missing") return !called;
+    if (c == "empty") return r.diploid ? (!r.a && !r.b) : (g == 0);
+    if (c == "called") return called;
+    if (c == "phased") return r.diploid && r.phased;
+    if (c == "haploid") return !r.diploid;
+    return r.diploid;
+}
+
+void check_gt_filter()
+{
+    char const* classes[] = { "het", "hom", "homref", "homalt", "carrier", "allele:2", "missing",
+                              "empty", "called", "phased", "haploid", "diploid" };
+    vector<uint8_t> all(256 + 15);
+    for (size_t i = 0; i < all.size(); ++i) all[i] = (uint8_t)i;
+    vector<uint32_t> hits(all.size());
+    for (size_t c = 0; c < sizeof(classes) / sizeof(classes[0]); ++c) {
+        gt_filter_mask mask;
+        CHECK(gt_filter_compile(classes[c], mask), string("gt_filter('") + classes[c] + "')");
+        size_t n = gt_filter_select(mask, &all[0], all.size(), &hits[0]);
+        size_t k = 0;
+        for (size_t i = 0; i < all.size(); ++i) {
+            if (!ref_class(classes[c], all[i])) continue;
+            CHECK((k < n) && (hits[k] == i), string("gt_filter ") + classes[c] + " gt8=" + to_string(all[i]));
+            ++k;
+        }
+        CHECK(k == n, string("gt_filter ") + classes[c] + " count");
+    }
+
+    gt_filter_mask mask;
+    CHECK(gt_filter_compile("het+!phased, homalt,!diploid+allele:0", mask), "gt_filter mixed");
+    for (int i = 0; i < 256; ++i) {
+        uint8_t g = (uint8_t)i;
+        bool expect = (ref_class("het", g) && !ref_class("phased", g)) || ref_class("homalt", g) ||
+                      (!ref_class("diploid", g) && (g == 1));
+        CHECK(mask.test(g) == expect, "gt_filter mixed gt8=" + to_string(i));
+    }
+
+    char const* bad[] = { "", "het,", "+het", "hets", "allele:", "allele:x", "!" };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i)
+        CHECK(!gt_filter_compile(bad[i], mask), string("gt_filter('") + bad[i] + "') should fail");
+}
+
+/*
+ * Benchmarks
+ */
+
+struct bench_result {
+    string name;
+    string signature;
+    uint64_t calls;
+    double seconds;
+};
+
+// Genotypes drawn the way they appear in real data: mostly 0/0, some
+// hets and hom-alts, a few missing, haploid and multi-allelic calls
+vector<uint8_t> generate_gt8(size_t n, uint64_t seed)
+{
+    vector<uint8_t> v(n);
+    uint64_t x = seed * 0x9E3779B97F4A7C15ULL + 1;
+    for (size_t i = 0; i < n; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        unsigned r = (unsigned)(x & 1023);
+        uint8_t g;
+        if (r < 700) g = 0x80 | (1 << 3) | 1;                         // 0/0
+        else if (r < 850) g = 0x80 | (1 << 3) | 2;                    // 0/1
+        else if (r < 920) g = 0x80 | (2 << 3) | 2;                    // 1/1
+        else if (r < 950) g = 0xC0 | (((x >> 10) & 1) ? (2 << 3) | 1 : (1 << 3) | 2); // phased het
+        else if (r < 980) g = 0x80 | (((x >> 12) % 8) << 3) | ((x >> 16) % 8);
+        else if (r < 1000) g = 0x80;                                  // ./.
+        else g = (uint8_t)((x >> 20) % 4);                            // haploid
+        v[i] = g;
+    }
+    return v;
+}
+
+bench_result bench_unary(string const& name, udf_t fn, vector<uint8_t> const& gts, uint64_t calls,
+                         uint64_t& sink)
+{
+    Value arg(sizeof(gt8_t));
+    Value res(sizeof(uint64_t));
+    const Value* args[1] = { &arg };
+    gt8_t* in = static_cast<gt8_t*>(arg.data());
+    size_t n = gts.size();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint64_t i = 0, j = 0; i < calls; ++i) {
+        *in = gts[j];
+        if (++j == n) j = 0;
+        fn(args, &res, NULL);
+        sink += *static_cast<uint8_t*>(res.data()) + res.isNull();
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+    bench_result r = { name, "(gt8)", calls, chrono::duration<double>(stop - start).count() };
+    return r;
+}
+
+bench_result bench_allele(string const& name, udf_t fn, vector<uint8_t> const& gts, uint64_t calls,
+                          uint64_t& sink)
+{
+    Value arg(sizeof(gt8_t));
+    Value ai;
+    Value res(sizeof(uint64_t));
+    const Value* args[2] = { &arg, &ai };
+    gt8_t* in = static_cast<gt8_t*>(arg.data());
+    size_t n = gts.size();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint64_t i = 0, j = 0; i < calls; ++i) {
+        *in = gts[j];
+        ai.setInt64((int64_t)(i & 1) + 1);
+        if (++j == n) j = 0;
+        fn(args, &res, NULL);
+        sink += *static_cast<uint8_t*>(res.data()) + res.isNull();
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+    bench_result r = { name, "(gt8,int64)", calls, chrono::duration<double>(stop - start).count() };
+    return r;
+}
+
+bench_result bench_binary(string const& name, udf_t fn, vector<uint8_t> const& gts, uint64_t calls,
+                          uint64_t& sink)
+{
+    Value lhs(sizeof(gt8_t)), rhs(sizeof(gt8_t));
+    Value res(sizeof(uint64_t));
+    const Value* args[2] = { &lhs, &rhs };
+    gt8_t* l = static_cast<gt8_t*>(lhs.data());
+    gt8_t* r = static_cast<gt8_t*>(rhs.data());
+    size_t n = gts.size();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint64_t i = 0, j = 0; i < calls; ++i) {
+        *l = gts[j];
+        *r = gts[n - 1 - j];
+        if (++j == n) j = 0;
+        fn(args, &res, NULL);
+        sink += *static_cast<uint8_t*>(res.data());
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+    bench_result br = { name, "(gt8,gt8)", calls, chrono::duration<double>(stop - start).count() };
+    return br;
+}
+
+bench_result bench_strings(string const& name, string const& signature, udf_t fn,
+                           vector<vector<Value> > const& inputs, uint64_t calls, uint64_t& sink)
+{
+    Value res(sizeof(uint64_t));
+    const Value* args[3];
+    size_t n = inputs.size();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint64_t i = 0, j = 0; i < calls; ++i) {
+        for (size_t a = 0; a < inputs[j].size(); ++a) args[a] = &inputs[j][a];
+        if (++j == n) j = 0;
+        fn(args, &res, NULL);
+        sink += res.size();
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+    bench_result r = { name, signature, calls, chrono::duration<double>(stop - start).count() };
+    return r;
+}
+
+// gt_filter over whole chunks of calls, counted per call
+bench_result bench_filter(string const& name, string const& classes, vector<uint8_t> const& gts,
+                          uint64_t calls, uint64_t& sink)
+{
+    gt_filter_mask mask;
+    gt_filter_compile(classes, mask);
+    size_t n = gts.size();
+    vector<uint32_t> hits(n);
+    uint64_t rounds = (calls + n - 1) / n;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < rounds; ++i) {
+        sink += gt_filter_select(mask, &gts[0], n, &hits[0]);
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+    bench_result r = { name, "('" + classes + "')", rounds * n, chrono::duration<double>(stop - start).count() };
+    return r;
+}
+
+// A bitwise function of one or two unsigned integers of T
+template <typename T>
+bench_result bench_bits(string const& name, udf_t fn, int arity, uint64_t calls, uint64_t& sink)
+{
+    Value lhs(sizeof(T)), rhs(sizeof(T)), res(sizeof(T));
+    const Value* args[2] = { &lhs, &rhs };
+    T* in = static_cast<T*>(lhs.data());
+    *static_cast<T*>(rhs.data()) = (T)0x00FF00FF00FF00FFULL;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < calls; ++i) {
+        *in = (T)i;
+        fn(args, &res, NULL);
+        sink += *static_cast<T*>(res.data());
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+    string type = "uint" + to_string(sizeof(T) * 8);
+    string signature = (arity == 1) ? "(" + type + ")" : "(" + type + "," + type + ")";
+    bench_result r = { name, signature, calls, chrono::duration<double>(stop - start).count() };
+    return r;
+}
+
+void write_results(ostream& os, vector<bench_result> const& results, bool json)
+{
+    if (json) {
+        os << "{\n  \"failures\": " << _failures << ",\n  \"functions\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            bench_result const& r = results[i];
+            os << (i ? ",\n" : "\n");
+            os << "    {\"name\": \"" << r.name << "\", \"signature\": \"" << r.signature << "\""
+               << ", \"calls\": " << r.calls << ", \"seconds\": " << r.seconds
+               << ", \"ns_per_call\": " << r.seconds * 1e9 / r.calls
+               << ", \"mcalls_per_s\": " << r.calls / r.seconds / 1e6 << "}";
+        }
+        os << "\n  ]\n}\n";
+        return;
+    }
+    char line[128];
+    for (size_t i = 0; i < results.size(); ++i) {
+        bench_result const& r = results[i];
+        snprintf(line, sizeof(line), "%-16s %-24s %12llu calls %8.2f ns/call %9.1f Mcalls/s\n",
+                 r.name.c_str(), r.signature.c_str(), (unsigned long long)r.calls,
+                 r.seconds * 1e9 / r.calls, r.calls / r.seconds / 1e6);
+        os << line;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "view help message, then exit")
+        ("count,n", value<uint64_t>()->default_value(200000000), "calls per gt8 function")
+        ("string-count", value<uint64_t>()->default_value(10000000), "calls per string function")
+        ("seed,s", value<uint64_t>()->default_value(1), "seed for the generated values")
+        ("check-only", "run the correctness checks but no benchmarks")
+        ("json,j", "write the results as JSON")
+        ("output,o", value<string>(), "output file (default: stdout)")
+    ;
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cout << desc << "\n";
+        return 1;
+    }
+
+    check_gt8();
+    check_strings();
+    check_bitwise();
+    check_gt_filter();
+    cerr << "correctness checks: " << _failures << " failures" << endl;
+    if (vm.count("check-only")) return _failures ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    uint64_t calls = vm["count"].as<uint64_t>();
+    uint64_t scalls = vm["string-count"].as<uint64_t>();
+    vector<uint8_t> gts = generate_gt8(1 << 20, vm["seed"].as<uint64_t>());
+
+    vector<vector<Value> > conv_in, info_in, fmt_in, csv_in;
+    for (size_t i = 0; i < 1024; ++i) {
+        char fmt[64];
+        conv_in.push_back(vector<Value>(1, string_value(ref_text(gts[i]))));
+        snprintf(fmt, sizeof(fmt), "AC=%u;AN=5008;AF=0.%04u;NS=2504;DP=%u", (unsigned)i, (unsigned)(i * 7), (unsigned)(i * 13));
+        vector<Value> iv;
+        iv.push_back(string_value((i % 2) ? "AF" : "DP"));
+        iv.push_back(string_value(fmt));
+        info_in.push_back(iv);
+        vector<Value> fv;
+        fv.push_back(string_value((i % 2) ? "PL" : "GQ"));
+        fv.push_back(string_value("GQ:DP:AD:PL"));
+        snprintf(fmt, sizeof(fmt), "%u:%u:%u,%u:0,%u,%u", (unsigned)(i % 99), (unsigned)(i % 40),
+                 (unsigned)(i % 20), (unsigned)(i % 17), (unsigned)(i % 300), (unsigned)(i % 900));
+        fv.push_back(string_value(fmt));
+        fmt_in.push_back(fv);
+        csv_in.push_back(vector<Value>(1, string_value((i % 3) ? "A" : "AC,G,T")));
+    }
+    vector<vector<Value> > gt8_in;
+    for (size_t i = 0; i < 1024; ++i) gt8_in.push_back(vector<Value>(1, gt8_value(gts[i])));
+
+    uint64_t sink = 0;
+    vector<bench_result> results;
+    results.push_back(bench_unary("hemizygous", gt8_hemizygous, gts, calls, sink));
+    results.push_back(bench_unary("homozygous", gt8_homozygous, gts, calls, sink));
+    results.push_back(bench_unary("heterozygous", gt8_heterozygous, gts, calls, sink));
+    results.push_back(bench_unary("empty_gt", gt8_empty, gts, calls, sink));
+    results.push_back(bench_unary("allele_missing", gt8_alleleMissing, gts, calls, sink));
+    results.push_back(bench_allele("allele_value", gt8_alleleValue, gts, calls, sink));
+    results.push_back(bench_allele("allele_count", gt8_alleleCount, gts, calls, sink));
+    results.push_back(bench_unary("dosage", gt8_alleleDosage, gts, calls, sink));
+    results.push_back(bench_unary("ploidy", gt8_ploidy, gts, calls, sink));
+    results.push_back(bench_unary("phase", gt8_phase, gts, calls, sink));
+    results.push_back(bench_binary("<=", gt8_lessEqualThan, gts, calls, sink));
+    results.push_back(bench_binary("<", gt8_lessThan, gts, calls, sink));
+    results.push_back(bench_binary("=", gt8_equal, gts, calls, sink));
+    results.push_back(bench_unary("norm", gt8_normalize, gts, calls, sink));
+    results.push_back(bench_unary("gt8", construct_gt8, gts, calls, sink));
+    results.push_back(bench_filter("gt_filter", "het", gts, calls, sink));
+    results.push_back(bench_filter("gt_filter", "het+!phased,homalt", gts, calls, sink));
+    results.push_back(bench_bits<uint8_t>("bitnot", bitwise_not8, 1, calls, sink));
+    results.push_back(bench_bits<uint16_t>("bitnot", bitwise_not16, 1, calls, sink));
+    results.push_back(bench_bits<uint32_t>("bitnot", bitwise_not32, 1, calls, sink));
+    results.push_back(bench_bits<uint64_t>("bitnot", bitwise_not64, 1, calls, sink));
+    results.push_back(bench_bits<uint8_t>("bitand", bitwise_and8, 2, calls, sink));
+    results.push_back(bench_bits<uint16_t>("bitand", bitwise_and16, 2, calls, sink));
+    results.push_back(bench_bits<uint32_t>("bitand", bitwise_and32, 2, calls, sink));
+    results.push_back(bench_bits<uint64_t>("bitand", bitwise_and64, 2, calls, sink));
+    results.push_back(bench_bits<uint8_t>("bitor", bitwise_or8, 2, calls, sink));
+    results.push_back(bench_bits<uint16_t>("bitor", bitwise_or16, 2, calls, sink));
+    results.push_back(bench_bits<uint32_t>("bitor", bitwise_or32, 2, calls, sink));
+    results.push_back(bench_bits<uint64_t>("bitor", bitwise_or64, 2, calls, sink));
+    results.push_back(bench_bits<uint8_t>("bitxor", bitwise_xor8, 2, calls, sink));
+    results.push_back(bench_bits<uint16_t>("bitxor", bitwise_xor16, 2, calls, sink));
+    results.push_back(bench_bits<uint32_t>("bitxor", bitwise_xor32, 2, calls, sink));
+    results.push_back(bench_bits<uint64_t>("bitxor", bitwise_xor64, 2, calls, sink));
+    results.push_back(bench_strings("string(gt8)", "(gt8)", gt8_toString, gt8_in, scalls, sink));
+    results.push_back(bench_strings("gt8(string)", "(string)", gt8_fromString, conv_in, scalls, sink));
+    results.push_back(bench_strings("extract_value", "(string,string)", extract_value2, info_in, scalls, sink));
+    results.push_back(bench_strings("extract_value", "(string,string,string)", extract_value3, fmt_in, scalls, sink));
+    results.push_back(bench_strings("num_csv", "(string)", num_csv, csv_in, scalls, sink));
+    cerr << "checksum: " << sink << endl;
+
+    if (vm.count("output")) {
+        ofstream ofs(vm["output"].as<string>().c_str());
+        write_results(ofs, results, vm.count("json") > 0);
+    } else {
+        write_results(cout, results, vm.count("json") > 0);
+    }
+    return _failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
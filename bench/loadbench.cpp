@@ -0,0 +1,389 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Benchmark harness for the VCF loaders.  Runs vcf2csv and vcf2scidb
+ *   (text and binary) over the same input, writing either to /dev/null or
+ *   to FIFOs drained by this process the way loadcsv.py would, and reports
+ *   the throughput and resource usage of each run as JSON.
+ *
+ *   Syscall counts are the read and write calls accounted in /proc/PID/io,
+ *   collected while the finished child is still a zombie.
+ *
+ */
+
+// Standard includes
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+
+// System
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// Boost
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+
+using namespace std;
+using namespace boost;
+using namespace boost::program_options;
+using namespace boost::algorithm;
+
+struct input_stats {
+    uint64_t bytes;
+    uint64_t rows;
+    uint64_t samples;
+};
+
+struct run_result {
+    string mode;
+    string sink;
+    int repeat;
+    int status;
+    double seconds;
+    double user_seconds;
+    double sys_seconds;
+    long peak_rss_kb;
+    long vol_ctx_switches;
+    long invol_ctx_switches;
+    uint64_t read_syscalls;
+    uint64_t write_syscalls;
+    uint64_t bytes_written;
+    uint64_t var_bytes;
+    uint64_t gt_bytes;
+};
+
+// Single pass over the input to learn its shape
+input_stats scan_input(string const& filename)
+{
+    input_stats st = { 0, 0, 0 };
+    FILE* f = fopen(filename.c_str(), "r");
+    if (f == NULL) {
+        cerr << "Failed to open input file: " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    vector<char> buf(1 << 20);
+    size_t col = 0;         // offset of the current character within its line
+    bool comment = false;
+    bool header = false;
+    size_t n;
+    while ((n = fread(&buf[0], 1, buf.size(), f)) > 0) {
+        st.bytes += n;
+        for (size_t i = 0; i < n; ++i) {
+            char c = buf[i];
+            if (col == 0) {
+                comment = (c == '#');
+                header = false;
+                if (!comment && (c != '\n')) ++st.rows;
+            } else if ((col == 1) && comment) {
+                header = (c == 'C');
+            }
+            if (header && (c == '\t')) ++st.samples;
+            col = (c == '\n') ? 0 : col + 1;
+        }
+    }
+    fclose(f);
+    // The header has eight tabs before the first sample
+    st.samples = (st.samples > 8) ? st.samples - 8 : 0;
+    return st;
+}
+
+// Read everything from a FIFO, the way the SciDB loader would, then set done
+void drain(string path, uint64_t* total, atomic<bool>* done)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        vector<char> buf(1 << 20);
+        ssize_t n;
+        while ((n = read(fd, &buf[0], buf.size())) > 0) *total += n;
+        close(fd);
+    }
+    *done = true;
+}
+
+/*
+ * Unblock a drainer still waiting in open() because the writer never
+ * came.  The open fails with ENXIO until the drainer is in its open(),
+ * so it is retried until it succeeds or the drainer is done.
+ */
+void release_fifo(string const& path, atomic<bool> const& done)
+{
+    while (!done) {
+        int fd = open(path.c_str(), O_WRONLY | O_NONBLOCK);
+        if (fd >= 0) {
+            close(fd);
+            return;
+        }
+        if (errno != ENXIO) return;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+uint64_t proc_io_field(string const& io, string const& key)
+{
+    size_t loc = io.find(key + ":");
+    if (loc == string::npos) return 0;
+    return strtoull(io.c_str() + loc + key.size() + 1, NULL, 10);
+}
+
+vector<string> loader_args(string const& mode, string const& vcf2csv, string const& vcf2scidb,
+                           string const& input, string const& descriptions,
+                           string const& varout, string const& gtout)
+{
+    vector<string> args;
+    if (mode == "vcf2csv") {
+        args.push_back(vcf2csv);
+        args.push_back("-s");
+        args.push_back(descriptions);
+        args.push_back("-i");
+        args.push_back(input);
+        args.push_back(varout);
+        args.push_back(gtout);
+    } else {
+        args.push_back(vcf2scidb);
+        args.push_back(mode == "vcf2scidb-binary" ? "-b" : "-t");
+        args.push_back("-d");
+        args.push_back(descriptions);
+        args.push_back("-v");
+        args.push_back(varout);
+        args.push_back("-g");
+        args.push_back(gtout);
+    }
+    return args;
+}
+
+run_result run_once(string const& mode, string const& sink, int repeat,
+                    string const& vcf2csv, string const& vcf2scidb,
+                    string const& input, string const& descriptions,
+                    string const& tmpdir, bool verbose)
+{
+    run_result r;
+    r.mode = mode;
+    r.sink = sink;
+    r.repeat = repeat;
+    r.var_bytes = 0;
+    r.gt_bytes = 0;
+
+    string varout("/dev/null");
+    string gtout("/dev/null");
+    vector<thread> drainers;
+    atomic<bool> var_done(false), gt_done(false);
+    if (sink == "fifo") {
+        varout = tmpdir + "/var_pipe";
+        gtout = tmpdir + "/gt_pipe";
+        unlink(varout.c_str());
+        unlink(gtout.c_str());
+        if ((mkfifo(varout.c_str(), 0600) != 0) || (mkfifo(gtout.c_str(), 0600) != 0)) {
+            cerr << "Failed to create FIFOs in " << tmpdir << endl;
+            exit(EXIT_FAILURE);
+        }
+        drainers.push_back(thread(drain, varout, &r.var_bytes, &var_done));
+        drainers.push_back(thread(drain, gtout, &r.gt_bytes, &gt_done));
+    }
+
+    vector<string> args = loader_args(mode, vcf2csv, vcf2scidb, input, descriptions, varout, gtout);
+    vector<char*> argv;
+    for (size_t i = 0; i < args.size(); ++i) argv.push_back(const_cast<char*>(args[i].c_str()));
+    argv.push_back(NULL);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int in = open(input.c_str(), O_RDONLY);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(in, 0);
+        dup2(devnull, 1);
+        if (!verbose) dup2(devnull, 2);
+        execv(argv[0], &argv[0]);
+        _exit(127);
+    }
+
+    // Leave the child as a zombie long enough to read its io accounting
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    waitid(P_PID, pid, &info, WEXITED | WNOWAIT);
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+    ostringstream iopath;
+    iopath << "/proc/" << pid << "/io";
+    ifstream ifs(iopath.str().c_str());
+    string io((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+    r.read_syscalls = proc_io_field(io, "syscr");
+    r.write_syscalls = proc_io_field(io, "syscw");
+    r.bytes_written = proc_io_field(io, "wchar");
+
+    int status = 0;
+    struct rusage ru;
+    wait4(pid, &status, 0, &ru);
+    r.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    r.seconds = chrono::duration<double>(stop - start).count();
+    r.user_seconds = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6;
+    r.sys_seconds = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+    r.peak_rss_kb = ru.ru_maxrss;
+    r.vol_ctx_switches = ru.ru_nvcsw;
+    r.invol_ctx_switches = ru.ru_nivcsw;
+
+    if (sink == "fifo") {
+        release_fifo(varout, var_done);
+        release_fifo(gtout, gt_done);
+        for (size_t i = 0; i < drainers.size(); ++i) drainers[i].join();
+        unlink(varout.c_str());
+        unlink(gtout.c_str());
+    }
+    return r;
+}
+
+string json_escape(string const& s)
+{
+    string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if ((s[i] == '"') || (s[i] == '\\')) out.push_back('\\');
+        out.push_back(s[i]);
+    }
+    return out;
+}
+
+void write_json(ostream& os, string const& label, string const& input,
+                input_stats const& in, vector<run_result> const& results)
+{
+    double mb = in.bytes / (1024.0 * 1024.0);
+    uint64_t genotypes = in.rows * in.samples;
+
+    os << "{\n";
+    os << "  \"label\": \"" << json_escape(label) << "\",\n";
+    os << "  \"input\": {\"file\": \"" << json_escape(input) << "\", \"bytes\": " << in.bytes
+       << ", \"rows\": " << in.rows << ", \"samples\": " << in.samples
+       << ", \"genotypes\": " << genotypes << "},\n";
+    os << "  \"runs\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        run_result const& r = results[i];
+        double secs = (r.seconds > 0) ? r.seconds : 1e-9;
+        os << (i ? ",\n" : "\n");
+        os << "    {\"mode\": \"" << r.mode << "\", \"sink\": \"" << r.sink << "\""
+           << ", \"repeat\": " << r.repeat
+           << ", \"status\": " << r.status
+           << ", \"seconds\": " << r.seconds
+           << ", \"mb_per_s\": " << mb / secs
+           << ", \"rows_per_s\": " << in.rows / secs
+           << ", \"genotypes_per_s\": " << genotypes / secs
+           << ", \"user_seconds\": " << r.user_seconds
+           << ", \"sys_seconds\": " << r.sys_seconds
+           << ", \"peak_rss_kb\": " << r.peak_rss_kb
+           << ", \"read_syscalls\": " << r.read_syscalls
+           << ", \"write_syscalls\": " << r.write_syscalls
+           << ", \"bytes_written\": " << r.bytes_written
+           << ", \"var_bytes\": " << r.var_bytes
+           << ", \"gt_bytes\": " << r.gt_bytes
+           << ", \"voluntary_ctx_switches\": " << r.vol_ctx_switches
+           << ", \"involuntary_ctx_switches\": " << r.invol_ctx_switches
+           << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+    options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "view help message, then exit")
+        ("input,i", value<string>(), "uncompressed VCF input file (required)")
+        ("descriptions,d", value<string>(), "CSV file listing info about the samples (required)")
+        ("vcf2csv", value<string>()->default_value("./vcf2csv"), "path to vcf2csv")
+        ("vcf2scidb", value<string>()->default_value("./vcf2scidb"), "path to vcf2scidb")
+        ("modes,m", value<string>()->default_value("vcf2csv,vcf2scidb-text,vcf2scidb-binary"),
+         "comma separated loader modes to run")
+        ("sinks,s", value<string>()->default_value("null,fifo"), "comma separated output sinks: null, fifo")
+        ("repeat,r", value<int>()->default_value(3), "number of runs of each mode and sink")
+        ("label,l", value<string>()->default_value(""), "label for this set of runs, e.g. a commit id")
+        ("output,o", value<string>(), "JSON output file (default: stdout)")
+        ("verbose", "let the loaders write to stderr")
+    ;
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+    notify(vm);
+
+    if (vm.count("help") || !vm.count("input") || !vm.count("descriptions")) {
+        cout << desc << "\n";
+        return 1;
+    }
+
+    string input = vm["input"].as<string>();
+    string descriptions = vm["descriptions"].as<string>();
+    string modestr = vm["modes"].as<string>();
+    string sinkstr = vm["sinks"].as<string>();
+    vector<string> modes, sinks;
+    split(modes, modestr, is_any_of(","));
+    split(sinks, sinkstr, is_any_of(","));
+
+    char tmpl[] = "/tmp/loadbench.XXXXXX";
+    if (mkdtemp(tmpl) == NULL) {
+        cerr << "Failed to create temporary directory" << endl;
+        return EXIT_FAILURE;
+    }
+    string tmpdir(tmpl);
+
+    input_stats in = scan_input(input);
+    vector<run_result> results;
+    for (vector<string>::iterator m = modes.begin(); m != modes.end(); ++m) {
+        for (vector<string>::iterator s = sinks.begin(); s != sinks.end(); ++s) {
+            for (int rep = 0; rep < vm["repeat"].as<int>(); ++rep) {
+                run_result r = run_once(*m, *s, rep,
+                                        vm["vcf2csv"].as<string>(), vm["vcf2scidb"].as<string>(),
+                                        input, descriptions, tmpdir, vm.count("verbose") > 0);
+                cerr << r.mode << " " << r.sink << " " << r.repeat << ": "
+                     << r.seconds << " s, status " << r.status << endl;
+                results.push_back(r);
+            }
+        }
+    }
+    rmdir(tmpdir.c_str());
+
+    if (vm.count("output")) {
+        ofstream ofs(vm["output"].as<string>().c_str());
+        write_json(ofs, vm["label"].as<string>(), input, in, results);
+    } else {
+        write_json(cout, vm["label"].as<string>(), input, in, results);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Just enough of scidb::Value and the plugin error machinery to compile
+ *   and run the user defined functions of the plugins outside of SciDB.
+ *   Like the real Value, small values live inline and larger ones on the
+ *   heap, and strings are stored with their terminating NUL.
+ *
+ */
+
+#ifndef SCIDB_VALUE_STUB_HPP
+#define SCIDB_VALUE_STUB_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <stdint.h>
+
+#define SCIDB_USER_ERROR_CODE_START 100000
+
+namespace scidb {
+
+enum { SCIDB_SE_UDO = 1 };
+
+class Value {
+public:
+    Value() : _size(0), _null(false), _heap(NULL) { memset(_inline, 0, sizeof(_inline)); }
+    explicit Value(size_t size) : _size(0), _null(false), _heap(NULL)
+    {
+        memset(_inline, 0, sizeof(_inline));
+        resize(size);
+    }
+    Value(Value const& other) : _size(0), _null(false), _heap(NULL)
+    {
+        memset(_inline, 0, sizeof(_inline));
+        setData(other.data(), other.size());
+        _null = other._null;
+    }
+    ~Value() { free(_heap); }
+
+    Value& operator=(Value const& other)
+    {
+        if (this != &other) {
+            setData(other.data(), other.size());
+            _null = other._null;
+        }
+        return *this;
+    }
+
+    void* data() const { return _heap ? _heap : const_cast<char*>(_inline); }
+    size_t size() const { return _size; }
+    bool isNull() const { return _null; }
+    void setNull() { _null = true; }
+
+    void setData(void const* data, size_t size)
+    {
+        resize(size);
+        if (size) memmove(this->data(), data, size);
+    }
+
+    const char* getString() const { return (_size == 0) ? "" : static_cast<const char*>(data()); }
+    void setString(const char* str) { setData(str, strlen(str) + 1); }
+
+    bool getBool() const { return get<bool>(); }
+    uint8_t getUint8() const { return get<uint8_t>(); }
+    uint32_t getUint32() const { return get<uint32_t>(); }
+    uint64_t getUint64() const { return get<uint64_t>(); }
+    int64_t getInt64() const { return get<int64_t>(); }
+    double getDouble() const { return get<double>(); }
+
+    void setBool(bool v) { set(v); }
+    void setUint8(uint8_t v) { set(v); }
+    void setUint32(uint32_t v) { set(v); }
+    void setUint64(uint64_t v) { set(v); }
+    void setInt64(int64_t v) { set(v); }
+    void setDouble(double v) { set(v); }
+
+private:
+    template <typename T> T get() const { return *static_cast<T const*>(data()); }
+    template <typename T> void set(T v)
+    {
+        resize(sizeof(T));
+        *static_cast<T*>(data()) = v;
+    }
+
+    void resize(size_t size)
+    {
+        _null = false;
+        if (size > sizeof(_inline)) {
+            if (size > _size || _heap == NULL) {
+                free(_heap);
+                _heap = static_cast<char*>(malloc(size));
+            }
+        } else if (_heap) {
+            free(_heap);
+            _heap = NULL;
+        }
+        _size = size;
+    }
+
+    size_t _size;
+    bool _null;
+    char* _heap;
+    char _inline[16];
+};
+
+// Thrown where the plugins would throw a SciDB user exception
+class UserException : public std::runtime_error {
+public:
+    UserException(const char* library, int code)
+        : std::runtime_error(library), _code(code) {}
+    ~UserException() throw() {}
+
+    template <typename T> UserException& operator<<(T const& arg)
+    {
+        std::ostringstream oss;
+        oss << arg;
+        _args.push_back(' ');
+        _args.append(oss.str());
+        return *this;
+    }
+
+    int code() const { return _code; }
+    std::string const& args() const { return _args; }
+
+private:
+    int _code;
+    std::string _args;
+};
+
+} // namespace scidb
+
+#define PLUGIN_USER_EXCEPTION(lib, category, code) scidb::UserException(lib, code)
+
+#endif // ! SCIDB_VALUE_STUB_HPP
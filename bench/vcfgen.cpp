@@ -0,0 +1,429 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Seeded generator of synthetic VCF files for benchmarking the loaders.
+ *   The random number generator and all the distributions are implemented
+ *   here, so the same seed produces the same file on every platform and
+ *   with every standard library.
+ *
+ */
+
+// Standard includes
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Boost
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+
+using namespace std;
+using namespace boost;
+using namespace boost::program_options;
+using namespace boost::algorithm;
+
+// xorshift128+ seeded through splitmix64
+class prng {
+public:
+    explicit prng(uint64_t seed)
+    {
+        _s[0] = splitmix(seed);
+        _s[1] = splitmix(seed);
+    }
+
+    uint64_t next()
+    {
+        uint64_t s1 = _s[0];
+        uint64_t const s0 = _s[1];
+        _s[0] = s0;
+        s1 ^= s1 << 23;
+        _s[1] = s1 ^ s0 ^ (s1 >> 18) ^ (s0 >> 5);
+        return _s[1] + s0;
+    }
+
+    // Uniform in [0,1)
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Uniform in [0,n)
+    uint32_t below(uint32_t n) { return (uint32_t)(((next() >> 32) * n) >> 32); }
+
+    bool chance(double p) { return uniform() < p; }
+
+private:
+    static uint64_t splitmix(uint64_t& x)
+    {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t _s[2];
+};
+
+// Output buffer with cheap integer formatting, flushed with fwrite
+class out_buffer {
+public:
+    out_buffer(FILE* out) : _out(out) { _buf.reserve(BUF_SIZE + 4096); }
+    ~out_buffer() { flush(); }
+
+    void put(char c) { _buf.push_back(c); }
+    void put(char const* s) { _buf.insert(_buf.end(), s, s + strlen(s)); }
+    void put(string const& s) { _buf.insert(_buf.end(), s.begin(), s.end()); }
+    void put_uint(uint64_t v)
+    {
+        char tmp[24];
+        char* p = tmp + sizeof(tmp);
+        do {
+            *--p = '0' + (v % 10);
+            v /= 10;
+        } while (v != 0);
+        _buf.insert(_buf.end(), p, tmp + sizeof(tmp));
+    }
+    // One decimal place
+    void put_fixed1(double v)
+    {
+        uint64_t t = (uint64_t)(v * 10.0 + 0.5);
+        put_uint(t / 10);
+        put('.');
+        put('0' + (char)(t % 10));
+    }
+    void endline()
+    {
+        _buf.push_back('\n');
+        if (_buf.size() >= BUF_SIZE) flush();
+    }
+    void flush()
+    {
+        if (!_buf.empty()) fwrite(&_buf[0], 1, _buf.size(), _out);
+        _buf.clear();
+    }
+
+private:
+    static const size_t BUF_SIZE = 1 << 20;
+    FILE* _out;
+    vector<char> _buf;
+};
+
+struct gen_params {
+    uint32_t samples;
+    uint64_t variants;
+    uint32_t chroms;
+    uint32_t populations;
+    double multiallelic;
+    double indel;
+    double missing;
+    double phased;
+    double duppos;
+    size_t info_size;
+    vector<string> format;
+};
+
+static char const BASES[] = "ACGT";
+static char const* FILTERS[] = { "PASS", "PASS", "PASS", "PASS", "q10", "s50", "LowQual" };
+static char const* POPULATIONS[] = { "ASW", "CEU", "CHB", "JPT", "LWK", "MXL", "TSI", "YRI" };
+
+string random_bases(prng& rng, size_t len)
+{
+    string s(len, 'A');
+    for (size_t i = 0; i < len; ++i) s[i] = BASES[rng.below(4)];
+    return s;
+}
+
+// Number of genotypes for a diploid call over n alleles
+inline uint32_t diploid_genotypes(uint32_t n) { return n * (n + 1) / 2; }
+
+void put_allele(out_buffer& out, int a)
+{
+    if (a < 0) out.put('.');
+    else out.put_uint(a);
+}
+
+void write_header(out_buffer& out, gen_params const& p)
+{
+    out.put("##fileformat=VCFv4.1");
+    out.endline();
+    out.put("##source=vcfgen");
+    out.endline();
+    for (uint32_t c = 1; c <= p.chroms; ++c) {
+        out.put("##contig=<ID=");
+        out.put_uint(c);
+        out.put('>');
+        out.endline();
+    }
+    out.put("#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT");
+    char name[32];
+    for (uint32_t s = 0; s < p.samples; ++s) {
+        snprintf(name, sizeof(name), "\tS%07u", s + 1);
+        out.put(name);
+    }
+    out.endline();
+}
+
+void write_descriptions(string const& filename, gen_params const& p)
+{
+    FILE* f = fopen(filename.c_str(), "w");
+    if (f == NULL) {
+        cerr << "Failed to open descriptions file: " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    fprintf(f, "#col,sample,population,founder,sex\n");
+    // Contiguous population blocks, as recommended for the samples file
+    uint32_t per_pop = (p.samples + p.populations - 1) / p.populations;
+    for (uint32_t s = 0; s < p.samples; ++s) {
+        fprintf(f, "%u,S%07u,%s,%s,%c\n", s + 1, s + 1,
+                POPULATIONS[(s / per_pop) % p.populations],
+                (s % 10 == 9) ? "false" : "true",
+                (s % 2) ? 'M' : 'F');
+    }
+    fclose(f);
+}
+
+void generate(out_buffer& out, gen_params const& p, prng& rng)
+{
+    uint64_t per_chrom = (p.variants + p.chroms - 1) / p.chroms;
+    uint64_t pos = 0;
+    vector<double> freqs;
+    string ref, info;
+    vector<string> alts;
+
+    for (uint64_t v = 0; v < p.variants; ++v) {
+        uint32_t chrom = (uint32_t)(v / per_chrom) + 1;
+        if ((v % per_chrom) == 0) pos = 0;
+        if ((pos == 0) || !rng.chance(p.duppos)) pos += 1 + rng.below(200);
+
+        // Alleles
+        bool indel = rng.chance(p.indel);
+        uint32_t nalt = 1;
+        if (rng.chance(p.multiallelic)) nalt = 2 + rng.below(2);
+        ref = random_bases(rng, indel ? 1 + rng.below(6) : 1);
+        alts.clear();
+        for (uint32_t a = 0; a < nalt; ++a) {
+            string alt;
+            do {
+                alt = random_bases(rng, indel ? 1 + rng.below(6) : 1);
+            } while ((alt == ref) || (find(alts.begin(), alts.end(), alt) != alts.end()));
+            alts.push_back(alt);
+        }
+
+        // Alternate allele frequencies, skewed towards rare variants
+        freqs.assign(nalt, 0.0);
+        double total = 0.0;
+        for (uint32_t a = 0; a < nalt; ++a) {
+            double u = rng.uniform();
+            freqs[a] = u * u * u * 0.5;
+            total += freqs[a];
+        }
+        if (total > 0.95) for (uint32_t a = 0; a < nalt; ++a) freqs[a] *= 0.95 / total;
+
+        out.put_uint(chrom);
+        out.put('\t');
+        out.put_uint(pos);
+        out.put('\t');
+        if (rng.chance(0.5)) {
+            out.put("rs");
+            out.put_uint(1000 + v);
+        } else {
+            out.put('.');
+        }
+        out.put('\t');
+        out.put(ref);
+        out.put('\t');
+        for (uint32_t a = 0; a < nalt; ++a) {
+            if (a) out.put(',');
+            out.put(alts[a]);
+        }
+        out.put('\t');
+        if (rng.chance(0.1)) out.put('.');
+        else out.put_fixed1(rng.uniform() * 1000.0);
+        out.put('\t');
+        out.put(FILTERS[rng.below(sizeof(FILTERS) / sizeof(FILTERS[0]))]);
+        out.put('\t');
+
+        // INFO: the usual counts, padded up to the requested size
+        info = "AN=" + to_string(2 * p.samples) + ";AF=";
+        for (uint32_t a = 0; a < nalt; ++a) {
+            char af[16];
+            snprintf(af, sizeof(af), "%.4f", freqs[a]);
+            if (a) info.push_back(',');
+            info.append(af);
+        }
+        info.append(";DP=" + to_string(rng.below(100000)));
+        if (info.size() + 4 < p.info_size) {
+            info.append(";XX=");
+            while (info.size() < p.info_size) info.push_back("abcdefghij"[rng.below(10)]);
+        }
+        out.put(info);
+        out.put('\t');
+
+        for (size_t f = 0; f < p.format.size(); ++f) {
+            if (f) out.put(':');
+            out.put(p.format[f]);
+        }
+
+        bool phased = rng.chance(p.phased);
+        uint32_t nalleles = nalt + 1;
+        for (uint32_t s = 0; s < p.samples; ++s) {
+            out.put('\t');
+            bool miss = rng.chance(p.missing);
+            int a = -1, b = -1;
+            if (!miss) {
+                int ab[2];
+                for (int h = 0; h < 2; ++h) {
+                    double u = rng.uniform();
+                    ab[h] = 0;
+                    for (uint32_t k = 0; k < nalt; ++k) {
+                        if (u < freqs[k]) {
+                            ab[h] = k + 1;
+                            break;
+                        }
+                        u -= freqs[k];
+                    }
+                }
+                a = ab[0];
+                b = ab[1];
+            }
+            for (size_t f = 0; f < p.format.size(); ++f) {
+                if (f) out.put(':');
+                string const& key = p.format[f];
+                if (key == "GT") {
+                    put_allele(out, a);
+                    out.put(phased ? '|' : '/');
+                    put_allele(out, b);
+                } else if (miss) {
+                    out.put('.');
+                } else if (key == "GQ") {
+                    out.put_uint(rng.below(100));
+                } else if (key == "DP") {
+                    out.put_uint(rng.below(120));
+                } else if (key == "AD") {
+                    for (uint32_t k = 0; k < nalleles; ++k) {
+                        if (k) out.put(',');
+                        out.put_uint(rng.below(60));
+                    }
+                } else if (key == "PL") {
+                    uint32_t ng = diploid_genotypes(nalleles);
+                    for (uint32_t k = 0; k < ng; ++k) {
+                        if (k) out.put(',');
+                        out.put_uint(rng.below(1000));
+                    }
+                } else if (key == "GL") {
+                    uint32_t ng = diploid_genotypes(nalleles);
+                    for (uint32_t k = 0; k < ng; ++k) {
+                        if (k) out.put(',');
+                        out.put('-');
+                        out.put_fixed1(rng.uniform() * 50.0);
+                    }
+                } else {
+                    out.put('.');
+                }
+            }
+        }
+        out.endline();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "view help message, then exit")
+        ("samples,n", value<uint32_t>()->default_value(100), "number of sample columns")
+        ("variants,v", value<uint64_t>()->default_value(10000), "number of variant rows")
+        ("seed,s", value<uint64_t>()->default_value(1), "random seed")
+        ("chroms", value<uint32_t>()->default_value(1), "number of chromosomes")
+        ("populations", value<uint32_t>()->default_value(5), "number of populations in the descriptions file")
+        ("multiallelic", value<double>()->default_value(0.05), "fraction of multi-allelic sites")
+        ("indel", value<double>()->default_value(0.1), "fraction of indel sites")
+        ("missing", value<double>()->default_value(0.01), "fraction of missing genotypes")
+        ("phased", value<double>()->default_value(0.0), "fraction of phased rows")
+        ("duppos", value<double>()->default_value(0.01), "fraction of rows repeating the previous position")
+        ("info-size", value<size_t>()->default_value(64), "approximate size of the INFO column in bytes")
+        ("format,f", value<string>()->default_value("GT:GQ:DP:AD:PL"), "FORMAT fields, GT is always first")
+        ("descriptions,d", value<string>(), "also write a CSV file describing the samples")
+        ("output,o", value<string>(), "output file (default: stdout)")
+    ;
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cout << desc << "\n";
+        return 1;
+    }
+
+    gen_params p;
+    p.samples = vm["samples"].as<uint32_t>();
+    p.variants = vm["variants"].as<uint64_t>();
+    p.chroms = max<uint32_t>(1, vm["chroms"].as<uint32_t>());
+    p.populations = min<uint32_t>(max<uint32_t>(1, vm["populations"].as<uint32_t>()),
+                                  sizeof(POPULATIONS) / sizeof(POPULATIONS[0]));
+    p.multiallelic = vm["multiallelic"].as<double>();
+    p.indel = vm["indel"].as<double>();
+    p.missing = vm["missing"].as<double>();
+    p.phased = vm["phased"].as<double>();
+    p.duppos = vm["duppos"].as<double>();
+    p.info_size = vm["info-size"].as<size_t>();
+
+    vector<string> fields;
+    string fmt = vm["format"].as<string>();
+    split(fields, fmt, is_any_of(":"));
+    p.format.push_back("GT");
+    for (vector<string>::iterator i = fields.begin(); i != fields.end(); ++i) {
+        if (!i->empty() && (*i != "GT")) p.format.push_back(*i);
+    }
+
+    if (vm.count("descriptions")) {
+        write_descriptions(vm["descriptions"].as<string>(), p);
+    }
+
+    FILE* f = stdout;
+    if (vm.count("output")) {
+        f = fopen(vm["output"].as<string>().c_str(), "w");
+        if (f == NULL) {
+            cerr << "Failed to open output file: " << vm["output"].as<string>() << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    prng rng(vm["seed"].as<uint64_t>());
+    {
+        out_buffer out(f);
+        write_header(out, p);
+        generate(out, p, rng);
+    }
+    if (f != stdout) fclose(f);
+    return 0;
+}
@@ -0,0 +1,251 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Output to a file descriptor through a bounded queue of blocks which
+ *   a thread of its own writes out, so a reader that stalls for a while
+ *   (a loadcsv.py committing a chunk, say) does not stop the parser.
+ *   The parser only waits once the blocks queued reach the memory cap.
+ *
+ */
+
+#ifndef ASYNC_WRITER_HPP
+#define ASYNC_WRITER_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstdio>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "load-metrics.hpp"
+
+// Default memory cap of each output queue
+#define ASYNC_WRITER_QUEUE_MB 64
+
+class async_writer {
+public:
+    /*
+     * At most max(2, max_bytes / block_size) blocks exist at once, counting
+     * the ones being filled and written.  The writes are charged to metrics,
+     * as are the time spent waiting for a free block and the queue depth.
+     */
+    async_writer(int fd, size_t block_size, size_t max_bytes, stream_metrics* metrics)
+        : _fd(fd), _block_size(block_size), _max_blocks(std::max(max_bytes / block_size, (size_t)2)),
+          _allocated(0), _queued(0), _metrics(metrics), _closed(false), _failed(false),
+          _current(NULL), _used(0)
+    {
+        if (_metrics) _metrics->set_async();
+        _thread = std::thread(&async_writer::run, this);
+    }
+
+    ~async_writer() { close(); }
+
+    size_t block_size() const { return _block_size; }
+
+    // An empty block to fill, waits while the cap is reached
+    char* get_block()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_free.empty() && (_allocated == _max_blocks)) {
+            uint64_t start = _metrics ? metrics_now_ns() : 0;
+            _freed.wait(lock, [this] { return !_free.empty(); });
+            if (_metrics) _metrics->add_stall(metrics_now_ns() - start);
+        }
+        if (!_free.empty()) {
+            char* block = _free.back();
+            _free.pop_back();
+            return block;
+        }
+        ++_allocated;
+        return static_cast<char*>(malloc(_block_size));
+    }
+
+    // Queue the first size bytes of a block from get_block to be written
+    void put_block(char* block, size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (size == 0) {
+                _free.push_back(block);
+                return;
+            }
+            _queue.push_back(std::make_pair(block, size));
+            _queued += size;
+            if (_metrics) _metrics->set_queued(_queued);
+        }
+        _ready.notify_one();
+    }
+
+    // Copy data into blocks, queueing each one as it fills
+    void write(void const* data, size_t size)
+    {
+        char const* p = static_cast<char const*>(data);
+        while (size > 0) {
+            if (_current == NULL) {
+                _current = get_block();
+                _used = 0;
+            }
+            size_t n = std::min(size, _block_size - _used);
+            memcpy(_current + _used, p, n);
+            _used += n;
+            p += n;
+            size -= n;
+            if (_used == _block_size) flush();
+        }
+    }
+
+    // Queue the block partly filled by write
+    void flush()
+    {
+        if (_current == NULL) return;
+        put_block(_current, _used);
+        _current = NULL;
+    }
+
+    // Write out everything queued and stop the thread, the fd stays open
+    void close()
+    {
+        if (!_thread.joinable()) return;
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _ready.notify_one();
+        _thread.join();
+        for (size_t i = 0; i < _free.size(); ++i) free(_free[i]);
+        _free.clear();
+    }
+
+    // True once a write has failed, later blocks are then dropped
+    bool failed() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _failed;
+    }
+
+private:
+    async_writer(async_writer const&);
+    async_writer& operator=(async_writer const&);
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _ready.wait(lock, [this] { return _closed || !_queue.empty(); });
+            if (_queue.empty()) return;
+            std::pair<char*, size_t> block = _queue.front();
+            _queue.pop_front();
+            bool failed = _failed;
+            lock.unlock();
+            if (!failed && (timed_write(_fd, block.first, block.second, _metrics) < 0))
+                failed = true;
+            lock.lock();
+            _failed = failed;
+            _queued -= block.second;
+            if (_metrics) _metrics->set_queued(_queued);
+            _free.push_back(block.first);
+            _freed.notify_one();
+        }
+    }
+
+    int _fd;
+    size_t _block_size;
+    size_t _max_blocks;
+    size_t _allocated;
+    size_t _queued;
+    stream_metrics* _metrics;
+    bool _closed;
+    bool _failed;
+    mutable std::mutex _mutex;
+    std::condition_variable _ready;
+    std::condition_variable _freed;
+    std::deque<std::pair<char*, size_t> > _queue;
+    std::vector<char*> _free;
+    std::thread _thread;
+    // Block being filled by write
+    char* _current;
+    size_t _used;
+};
+
+#ifdef __GLIBC__
+/*
+ * A stdio stream whose buffers are copied into an async_writer, for
+ * the loaders which print their output.  fclose writes out the queue
+ * and closes fd.
+ */
+struct async_cookie {
+    int fd;
+    async_writer* writer;
+};
+
+inline ssize_t async_cookie_write(void* c, char const* buf, size_t size)
+{
+    async_cookie* ac = static_cast<async_cookie*>(c);
+    if (ac->writer->failed()) return 0;
+    ac->writer->write(buf, size);
+    return size;
+}
+
+inline int async_cookie_close(void* c)
+{
+    async_cookie* ac = static_cast<async_cookie*>(c);
+    ac->writer->close();
+    bool failed = ac->writer->failed();
+    delete ac->writer;
+    int rc = ::close(ac->fd);
+    delete ac;
+    return failed ? -1 : rc;
+}
+
+inline FILE* async_fdopen(int fd, size_t max_bytes, stream_metrics* m)
+{
+    async_cookie* ac = new async_cookie;
+    ac->fd = fd;
+    ac->writer = new async_writer(fd, 1 << 18, max_bytes, m);
+    cookie_io_functions_t io;
+    io.read = NULL;
+    io.write = async_cookie_write;
+    io.seek = NULL;
+    io.close = async_cookie_close;
+    FILE* f = fopencookie(ac, "w", io);
+    if (f == NULL) {
+        delete ac->writer;
+        delete ac;
+    }
+    return f;
+}
+#endif
+
+#endif // ! ASYNC_WRITER_HPP
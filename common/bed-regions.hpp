@@ -0,0 +1,113 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Regions read from a BED file, merged per chromosome, for filtering
+ *   VCF rows by position.
+ *
+ */
+
+#ifndef BED_REGIONS_HPP
+#define BED_REGIONS_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+class bed_regions {
+public:
+    // Half open, 0-based intervals as in the BED file
+    typedef std::vector<std::pair<int64_t, int64_t> > interval_list;
+    typedef std::map<std::string, interval_list> region_map;
+
+    bed_regions() : _last(NULL) {}
+
+    bool load(std::string const& filename)
+    {
+        std::ifstream ifs(filename.c_str());
+        if (!ifs) return false;
+        std::string line;
+        while (getline(ifs, line)) {
+            if (line.empty() || (line[0] == '#') ||
+                (line.compare(0, 5, "track") == 0) || (line.compare(0, 7, "browser") == 0)) continue;
+            std::istringstream iss(line);
+            std::string chrom;
+            int64_t beg, end;
+            if (!(iss >> chrom >> beg >> end)) return false;
+            if (end > beg) _regions[chrom].push_back(std::make_pair(beg, end));
+        }
+        for (region_map::iterator i = _regions.begin(); i != _regions.end(); ++i) merge(i->second);
+        _last = NULL;
+        return true;
+    }
+
+    bool empty() const { return _regions.empty(); }
+    region_map const& regions() const { return _regions; }
+
+    // True if the 1-based pos on chrom falls within a region
+    bool contains(char const* chrom, size_t len, int64_t pos)
+    {
+        if ((_last == NULL) || (_last_chrom.compare(0, std::string::npos, chrom, len) != 0)) {
+            _last_chrom.assign(chrom, len);
+            region_map::const_iterator i = _regions.find(_last_chrom);
+            _last = (i == _regions.end()) ? &_none : &i->second;
+        }
+        int64_t p = pos - 1;
+        interval_list::const_iterator i =
+            std::upper_bound(_last->begin(), _last->end(), std::make_pair(p, std::numeric_limits<int64_t>::max()));
+        if (i == _last->begin()) return false;
+        --i;
+        return p < i->second;
+    }
+
+private:
+    static void merge(interval_list& list)
+    {
+        std::sort(list.begin(), list.end());
+        size_t n = 0;
+        for (size_t i = 0; i < list.size(); ++i) {
+            if ((n > 0) && (list[i].first <= list[n-1].second)) {
+                list[n-1].second = std::max(list[n-1].second, list[i].second);
+            } else {
+                list[n++] = list[i];
+            }
+        }
+        list.resize(n);
+    }
+
+    region_map _regions;
+    interval_list _none;
+    std::string _last_chrom;
+    interval_list const* _last;
+};
+
+#endif // ! BED_REGIONS_HPP
@@ -0,0 +1,382 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Random access to BGZF compressed VCF files through their tabix (.tbi)
+ *   index, so that only the blocks overlapping a set of regions are read
+ *   and decompressed, and the compression of BGZF blocks for writing
+ *   them, each block on its own so they can be compressed in parallel.
+ *   Needs zlib.
+ *
+ */
+
+#ifndef BGZF_HPP
+#define BGZF_HPP
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "bed-regions.hpp"
+
+// Maximum uncompressed size of a BGZF block
+#define BGZF_MAX_BLOCK 65536
+
+/*
+ * Reader of BGZF blocks.  Positions are virtual offsets, the file offset
+ * of a block shifted left 16 bits plus the offset within the block.
+ */
+class bgzf_reader {
+public:
+    bgzf_reader() : _fd(-1), _block(0), _next(0), _pos(0), _len(0), _data(new char[BGZF_MAX_BLOCK]) {}
+    ~bgzf_reader()
+    {
+        if (_fd != -1) close(_fd);
+        delete[] _data;
+    }
+
+    bool open(std::string const& filename)
+    {
+        _fd = ::open(filename.c_str(), O_RDONLY);
+        return (_fd != -1) && seek(0);
+    }
+
+    bool seek(uint64_t voffset)
+    {
+        if (!load(voffset >> 16)) return false;
+        _pos = voffset & 0xFFFF;
+        return _pos <= _len;
+    }
+
+    uint64_t tell() const { return (_block << 16) | _pos; }
+
+    // Read up to size bytes, stopping at the virtual offset end, 0 at the end
+    ssize_t read(char* buf, size_t size, uint64_t end = UINT64_MAX)
+    {
+        size_t done = 0;
+        while ((done < size) && (tell() < end)) {
+            if (_pos == _len) {
+                if (!load(_next)) return -1;
+                if (_len == 0 && _next == _block) break;   // end of file
+                continue;
+            }
+            size_t n = std::min(size - done, _len - _pos);
+            if ((end >> 16) == _block) n = std::min(n, (size_t)((end & 0xFFFF) - _pos));
+            memcpy(buf + done, _data + _pos, n);
+            _pos += n;
+            done += n;
+        }
+        return done;
+    }
+
+private:
+    bool load(uint64_t offset)
+    {
+        unsigned char header[18];
+        ssize_t n = pread(_fd, header, sizeof(header), offset);
+        if (n == 0) {
+            // Past the last block
+            _block = _next = offset;
+            _pos = _len = 0;
+            return true;
+        }
+        if ((n != sizeof(header)) || (header[0] != 31) || (header[1] != 139) || !(header[3] & 4) ||
+            (header[12] != 'B') || (header[13] != 'C')) return false;
+        size_t bsize = (header[16] | (header[17] << 8)) + 1;
+        _compressed.resize(bsize);
+        if (pread(_fd, &_compressed[0], bsize, offset) != (ssize_t)bsize) return false;
+        size_t xlen = header[10] | (header[11] << 8);
+
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, -15) != Z_OK) return false;
+        zs.next_in = reinterpret_cast<Bytef*>(&_compressed[12 + xlen]);
+        zs.avail_in = bsize - 12 - xlen - 8;
+        zs.next_out = reinterpret_cast<Bytef*>(_data);
+        zs.avail_out = BGZF_MAX_BLOCK;
+        int rc = inflate(&zs, Z_FINISH);
+        inflateEnd(&zs);
+        if (rc != Z_STREAM_END) return false;
+
+        _block = offset;
+        _next = offset + bsize;
+        _pos = 0;
+        _len = BGZF_MAX_BLOCK - zs.avail_out;
+        return true;
+    }
+
+    bgzf_reader(bgzf_reader const&);
+    bgzf_reader& operator=(bgzf_reader const&);
+
+    int _fd;
+    uint64_t _block;
+    uint64_t _next;
+    size_t _pos;
+    size_t _len;
+    char* _data;
+    std::vector<char> _compressed;
+};
+
+// Largest input of a block, so its compressed form always fits in 64KB
+#define BGZF_BLOCK_INPUT 0xff00
+
+// Compress len bytes, at most BGZF_BLOCK_INPUT, as one block appended to out
+inline bool bgzf_compress_block(char const* data, size_t len, int level, std::string& out)
+{
+    static unsigned char const header[18] = {
+        31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 0, 0
+    };
+    size_t start = out.size();
+    out.resize(start + BGZF_MAX_BLOCK);
+    unsigned char* block = reinterpret_cast<unsigned char*>(&out[start]);
+    memcpy(block, header, sizeof(header));
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = len;
+    zs.next_out = block + sizeof(header);
+    zs.avail_out = BGZF_MAX_BLOCK - sizeof(header) - 8;
+    int rc = deflate(&zs, Z_FINISH);
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END) return false;
+
+    size_t bsize = sizeof(header) + zs.total_out + 8;
+    uint32_t crc = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<Bytef const*>(data), len);
+    unsigned char* tail = block + sizeof(header) + zs.total_out;
+    for (int i = 0; i < 4; ++i) {
+        tail[i] = (crc >> (8 * i)) & 0xFF;
+        tail[4 + i] = ((uint32_t)len >> (8 * i)) & 0xFF;
+    }
+    block[16] = (bsize - 1) & 0xFF;
+    block[17] = (bsize - 1) >> 8;
+    out.resize(start + bsize);
+    return true;
+}
+
+// Compress len bytes as as many blocks as needed, appended to out
+inline bool bgzf_compress(char const* data, size_t len, int level, std::string& out)
+{
+    for (size_t done = 0; done < len; done += BGZF_BLOCK_INPUT) {
+        if (!bgzf_compress_block(data + done, std::min(len - done, (size_t)BGZF_BLOCK_INPUT), level, out))
+            return false;
+    }
+    return true;
+}
+
+// The empty block which ends a BGZF file
+inline void bgzf_eof(std::string& out)
+{
+    static unsigned char const eof[28] = {
+        31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+    out.append(reinterpret_cast<char const*>(eof), sizeof(eof));
+}
+
+struct bgzf_chunk {
+    uint64_t beg;
+    uint64_t end;
+    bool operator<(bgzf_chunk const& other) const { return beg < other.beg; }
+};
+
+// The binning and linear index of a tabix file
+class tabix_index {
+public:
+    bool load(std::string const& filename)
+    {
+        bgzf_reader bgzf;
+        if (!bgzf.open(filename)) return false;
+        char magic[4];
+        int32_t header[8];
+        if (!get(bgzf, magic, 4) || (memcmp(magic, "TBI\1", 4) != 0)) return false;
+        if (!get(bgzf, header, sizeof(header))) return false;
+        int32_t n_ref = header[0];
+        std::vector<char> names(header[7]);
+        if (!get(bgzf, names.data(), names.size())) return false;
+        for (size_t i = 0, start = 0; i < names.size(); ++i) {
+            if (names[i] == '\0') {
+                _names.push_back(std::string(&names[start], i - start));
+                start = i + 1;
+            }
+        }
+        _refs.resize(n_ref);
+        for (int32_t r = 0; r < n_ref; ++r) {
+            int32_t n_bin;
+            if (!get(bgzf, &n_bin, sizeof(n_bin))) return false;
+            for (int32_t b = 0; b < n_bin; ++b) {
+                uint32_t bin;
+                int32_t n_chunk;
+                if (!get(bgzf, &bin, sizeof(bin)) || !get(bgzf, &n_chunk, sizeof(n_chunk))) return false;
+                std::vector<bgzf_chunk>& chunks = _refs[r].bins[bin];
+                chunks.resize(n_chunk);
+                if (!get(bgzf, chunks.data(), n_chunk * sizeof(bgzf_chunk))) return false;
+            }
+            int32_t n_intv;
+            if (!get(bgzf, &n_intv, sizeof(n_intv))) return false;
+            _refs[r].linear.resize(n_intv);
+            if (!get(bgzf, _refs[r].linear.data(), n_intv * sizeof(uint64_t))) return false;
+        }
+        return true;
+    }
+
+    // Chunks which may hold records in [beg, end) of chrom, 0-based
+    void query(std::string const& chrom, int64_t beg, int64_t end, std::vector<bgzf_chunk>& chunks) const
+    {
+        std::vector<std::string>::const_iterator name = std::find(_names.begin(), _names.end(), chrom);
+        if ((name == _names.end()) || (end <= beg)) return;
+        reference const& ref = _refs[name - _names.begin()];
+
+        uint64_t min_off = 0;
+        if (!ref.linear.empty()) {
+            size_t w = beg >> 14;
+            min_off = ref.linear[std::min(w, ref.linear.size() - 1)];
+        }
+        std::vector<uint32_t> bins;
+        reg2bins(beg, end, bins);
+        for (size_t i = 0; i < bins.size(); ++i) {
+            std::map<uint32_t, std::vector<bgzf_chunk> >::const_iterator b = ref.bins.find(bins[i]);
+            if (b == ref.bins.end()) continue;
+            for (size_t c = 0; c < b->second.size(); ++c) {
+                if (b->second[c].end > min_off) chunks.push_back(b->second[c]);
+            }
+        }
+    }
+
+    // Chunks for all the regions, sorted and with overlaps merged
+    void query(bed_regions const& regions, std::vector<bgzf_chunk>& chunks) const
+    {
+        chunks.clear();
+        bed_regions::region_map const& rm = regions.regions();
+        for (bed_regions::region_map::const_iterator i = rm.begin(); i != rm.end(); ++i) {
+            for (size_t r = 0; r < i->second.size(); ++r) {
+                query(i->first, i->second[r].first, i->second[r].second, chunks);
+            }
+        }
+        std::sort(chunks.begin(), chunks.end());
+        size_t n = 0;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            if ((n > 0) && (chunks[i].beg <= chunks[n-1].end)) {
+                chunks[n-1].end = std::max(chunks[n-1].end, chunks[i].end);
+            } else {
+                chunks[n++] = chunks[i];
+            }
+        }
+        chunks.resize(n);
+    }
+
+private:
+    struct reference {
+        std::map<uint32_t, std::vector<bgzf_chunk> > bins;
+        std::vector<uint64_t> linear;
+    };
+
+    static bool get(bgzf_reader& bgzf, void* buf, size_t size)
+    {
+        return bgzf.read(static_cast<char*>(buf), size) == (ssize_t)size;
+    }
+
+    // Bins of the UCSC binning scheme overlapping [beg, end)
+    static void reg2bins(int64_t beg, int64_t end, std::vector<uint32_t>& bins)
+    {
+        --end;
+        bins.push_back(0);
+        for (int64_t k = 1 + (beg >> 26); k <= 1 + (end >> 26); ++k) bins.push_back(k);
+        for (int64_t k = 9 + (beg >> 23); k <= 9 + (end >> 23); ++k) bins.push_back(k);
+        for (int64_t k = 73 + (beg >> 20); k <= 73 + (end >> 20); ++k) bins.push_back(k);
+        for (int64_t k = 585 + (beg >> 17); k <= 585 + (end >> 17); ++k) bins.push_back(k);
+        for (int64_t k = 4681 + (beg >> 14); k <= 4681 + (end >> 14); ++k) bins.push_back(k);
+    }
+
+    std::vector<std::string> _names;
+    std::vector<reference> _refs;
+};
+
+/*
+ * The header lines of an indexed VCF, then the records of the chunks
+ * overlapping the regions.  Blocks outside the chunks are never read.
+ */
+class bgzf_region_reader {
+public:
+    bgzf_region_reader() : _chunk(0), _in_header(true), _line_start(true) {}
+
+    bool open(std::string const& filename, std::string const& index, bed_regions const& regions)
+    {
+        tabix_index tbi;
+        if (!tbi.load(index) || !_bgzf.open(filename)) return false;
+        tbi.query(regions, _chunks);
+        return true;
+    }
+
+    size_t chunks() const { return _chunks.size(); }
+
+    ssize_t read(char* buf, size_t size)
+    {
+        if (_in_header) {
+            ssize_t n = read_header(buf, size);
+            if (n != 0) return n;
+            _in_header = false;
+            if (!_chunks.empty() && !_bgzf.seek(_chunks[0].beg)) return -1;
+        }
+        while (_chunk < _chunks.size()) {
+            ssize_t n = _bgzf.read(buf, size, _chunks[_chunk].end);
+            if (n != 0) return n;
+            if ((++_chunk < _chunks.size()) && !_bgzf.seek(_chunks[_chunk].beg)) return -1;
+        }
+        return 0;
+    }
+
+private:
+    // Lines starting with '#' from the start of the file, 0 after the last
+    ssize_t read_header(char* buf, size_t size)
+    {
+        uint64_t start = _bgzf.tell();
+        ssize_t n = _bgzf.read(buf, size);
+        if (n <= 0) return n;
+        for (ssize_t i = 0; i < n; ++i) {
+            if (_line_start && (buf[i] != '#')) {
+                _bgzf.seek(start);
+                _bgzf.read(buf, i);
+                return i;
+            }
+            _line_start = (buf[i] == '\n');
+        }
+        return n;
+    }
+
+    bgzf_reader _bgzf;
+    std::vector<bgzf_chunk> _chunks;
+    size_t _chunk;
+    bool _in_header;
+    bool _line_start;
+};
+
+#endif // ! BGZF_HPP
@@ -0,0 +1,173 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Side index of the variant IDs, kept while the ID column is scanned
+ *   and written at the end of the load, sorted by key, as a tab separated
+ *   file for an _ids array dimensioned on the key.  An rsID is keyed by
+ *   its number, any other ID by a 61 bit hash, as a negative key, so a
+ *   batch of IDs can be joined to the index instead of scanning _var.
+ *
+ */
+
+#ifndef ID_INDEX_HPP
+#define ID_INDEX_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+#include "text-format.hpp"
+
+// Number of a canonical rsID, "rs" then up to 18 digits without a leading zero, else -1
+inline int64_t id_rs_number(char const* s, size_t len)
+{
+    if ((len < 3) || (len > 20) || (s[0] != 'r') || (s[1] != 's') || (s[2] == '0')) return -1;
+    int64_t n = 0;
+    for (size_t i = 2; i < len; ++i) {
+        if ((s[i] < '0') || (s[i] > '9')) return -1;
+        n = n * 10 + (s[i] - '0');
+    }
+    return n;
+}
+
+/*
+ * Key of a variant ID: the number of an rsID, otherwise the 64 bit FNV-1a
+ * hash of the ID cut to 61 bits, negated, so the two never meet and both
+ * are within the coordinates of a SciDB dimension.  Hashes can collide,
+ * so a lookup also compares the ID.  ids_lookup.py has the same function.
+ */
+inline int64_t id_key(char const* s, size_t len)
+{
+    int64_t rs = id_rs_number(s, len);
+    if (rs >= 0) return rs;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t)s[i];
+        h *= 1099511628211ULL;
+    }
+    return -(int64_t)(h >> 3) - 1;
+}
+
+class id_index {
+public:
+    id_index() : _chrom(0) {}
+
+    // IDs separated by ';' are each indexed, "." or an empty ID is not
+    void add(char const* chrom, size_t chrom_len, int64_t pos, int64_t var, char const* id, size_t id_len)
+    {
+        if ((id_len == 0) || ((id_len == 1) && (id[0] == '.'))) return;
+        if (_chroms.empty() || (_chroms[_chrom].compare(0, std::string::npos, chrom, chrom_len) != 0)) {
+            _chrom = std::find(_chroms.begin(), _chroms.end(), std::string(chrom, chrom_len)) - _chroms.begin();
+            if (_chrom == _chroms.size()) _chroms.push_back(std::string(chrom, chrom_len));
+        }
+        char const* end = id + id_len;
+        while (id < end) {
+            char const* semi = static_cast<char const*>(memchr(id, ';', end - id));
+            if (semi == NULL) semi = end;
+            if (semi > id) {
+                entry e;
+                e.key = id_key(id, semi - id);
+                e.pos = pos;
+                e.chrom = _chrom;
+                e.var = var;
+                e.name = NO_NAME;
+                if (e.key < 0) {
+                    e.name = _names.size();
+                    _names.push_back(std::string(id, semi - id));
+                }
+                _entries.push_back(e);
+            }
+            id = semi + 1;
+        }
+    }
+
+    size_t size() const { return _entries.size(); }
+
+    // key, chrom, pos, var and id of each entry, sorted by key then place
+    bool write(std::string const& filename)
+    {
+        FILE* f = fopen(filename.c_str(), "w");
+        if (f == NULL) return false;
+        std::sort(_entries.begin(), _entries.end());
+        char line[4 * FORMAT_INT64_MAX + 8];
+        for (size_t i = 0; i < _entries.size(); ++i) {
+            entry const& e = _entries[i];
+            size_t n = format_int64(e.key, line);
+            line[n++] = '\t';
+            fwrite(line, 1, n, f);
+            fwrite(_chroms[e.chrom].data(), 1, _chroms[e.chrom].size(), f);
+            n = 0;
+            line[n++] = '\t';
+            n += format_int64(e.pos, line + n);
+            line[n++] = '\t';
+            n += format_int64(e.var, line + n);
+            line[n++] = '\t';
+            if (e.name == NO_NAME) {
+                line[n++] = 'r';
+                line[n++] = 's';
+                n += format_int64(e.key, line + n);
+                line[n++] = '\n';
+                fwrite(line, 1, n, f);
+            } else {
+                fwrite(line, 1, n, f);
+                fwrite(_names[e.name].data(), 1, _names[e.name].size(), f);
+                fputc('\n', f);
+            }
+        }
+        return (fclose(f) == 0);
+    }
+
+private:
+    static const uint32_t NO_NAME = 0xFFFFFFFF;
+
+    // An rsID is spelled from its key, other IDs are kept in _names
+    struct entry {
+        int64_t key;
+        int64_t pos;
+        uint32_t chrom;
+        uint32_t var;
+        uint32_t name;
+
+        bool operator<(entry const& rhs) const
+        {
+            if (key != rhs.key) return key < rhs.key;
+            if (chrom != rhs.chrom) return chrom < rhs.chrom;
+            if (pos != rhs.pos) return pos < rhs.pos;
+            return var < rhs.var;
+        }
+    };
+
+    std::vector<entry> _entries;
+    std::vector<std::string> _chroms;
+    size_t _chrom;
+    std::vector<std::string> _names;
+};
+
+#endif // ! ID_INDEX_HPP
@@ -0,0 +1,346 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Throughput and backpressure counters shared by the loaders.  Each
+ *   stream (the input and every output) counts bytes, rows, calls and the
+ *   time spent blocked in read() or write(); whatever is left of the wall
+ *   clock is time spent parsing.  An output written by its own thread
+ *   through a queue also counts the queue depth and the time the parser
+ *   stalled on a full queue, which replaces the write time in the parse
+ *   figure.  A reporter thread prints a progress line
+ *   every few seconds, and a JSON summary can be written at the end.
+ *
+ */
+
+#ifndef LOAD_METRICS_HPP
+#define LOAD_METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+inline uint64_t metrics_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+inline long metrics_peak_rss_kb()
+{
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+    return ru.ru_maxrss;
+}
+
+/*
+ * Counters for one stream.  Every counter has a single writing thread,
+ * or is only written under the lock of an output queue, so a relaxed
+ * load and store is enough, and the reporter thread only ever reads them.
+ */
+class stream_metrics {
+public:
+    stream_metrics(std::string const& name)
+        : _name(name), _bytes(0), _rows(0), _calls(0), _wait_ns(0),
+          _stall_ns(0), _queued(0), _peak_queued(0), _async(false) {}
+
+    std::string const& name() const { return _name; }
+
+    void add_io(size_t bytes, uint64_t ns)
+    {
+        bump(_bytes, bytes);
+        bump(_calls, 1);
+        bump(_wait_ns, ns);
+    }
+    void add_rows(uint64_t rows) { bump(_rows, rows); }
+
+    // Set before the stream is written when a queue decouples its writes
+    void set_async() { _async.store(true, std::memory_order_relaxed); }
+    void add_stall(uint64_t ns) { bump(_stall_ns, ns); }
+    void set_queued(uint64_t bytes)
+    {
+        _queued.store(bytes, std::memory_order_relaxed);
+        if (bytes > _peak_queued.load(std::memory_order_relaxed))
+            _peak_queued.store(bytes, std::memory_order_relaxed);
+    }
+
+    uint64_t bytes() const { return _bytes.load(std::memory_order_relaxed); }
+    uint64_t rows() const { return _rows.load(std::memory_order_relaxed); }
+    uint64_t calls() const { return _calls.load(std::memory_order_relaxed); }
+    uint64_t wait_ns() const { return _wait_ns.load(std::memory_order_relaxed); }
+    bool async() const { return _async.load(std::memory_order_relaxed); }
+    uint64_t stall_ns() const { return _stall_ns.load(std::memory_order_relaxed); }
+    uint64_t queued() const { return _queued.load(std::memory_order_relaxed); }
+    uint64_t peak_queued() const { return _peak_queued.load(std::memory_order_relaxed); }
+    // Time the parser could not go on because of this stream
+    uint64_t blocked_ns() const { return async() ? stall_ns() : wait_ns(); }
+
+private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::string _name;
+    std::atomic<uint64_t> _bytes;
+    std::atomic<uint64_t> _rows;
+    std::atomic<uint64_t> _calls;
+    std::atomic<uint64_t> _wait_ns;
+    std::atomic<uint64_t> _stall_ns;
+    std::atomic<uint64_t> _queued;
+    std::atomic<uint64_t> _peak_queued;
+    std::atomic<bool> _async;
+};
+
+// read() which charges the bytes and the time blocked to m, if not NULL
+inline ssize_t timed_read(int fd, void* buf, size_t size, stream_metrics* m)
+{
+    uint64_t start = m ? metrics_now_ns() : 0;
+    ssize_t rc;
+    do {
+        rc = read(fd, buf, size);
+    } while ((rc < 0) && (errno == EINTR));
+    if (m) m->add_io(rc > 0 ? rc : 0, metrics_now_ns() - start);
+    return rc;
+}
+
+// write() of the whole buffer, charging the bytes and time blocked to m
+inline ssize_t timed_write(int fd, void const* buf, size_t size, stream_metrics* m)
+{
+    uint64_t start = m ? metrics_now_ns() : 0;
+    char const* p = static_cast<char const*>(buf);
+    size_t left = size;
+    while (left > 0) {
+        ssize_t rc = write(fd, p, left);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            if (m) m->add_io(size - left, metrics_now_ns() - start);
+            return -1;
+        }
+        p += rc;
+        left -= rc;
+    }
+    if (m) m->add_io(size, metrics_now_ns() - start);
+    return size;
+}
+
+#ifdef __GLIBC__
+/*
+ * Stdio streams over a file descriptor whose reads or writes are timed,
+ * so the cost is one clock read per buffer rather than per fprintf.
+ */
+struct timed_cookie {
+    int fd;
+    stream_metrics* metrics;
+};
+
+inline ssize_t timed_cookie_read(void* c, char* buf, size_t size)
+{
+    timed_cookie* tc = static_cast<timed_cookie*>(c);
+    return timed_read(tc->fd, buf, size, tc->metrics);
+}
+
+inline ssize_t timed_cookie_write(void* c, char const* buf, size_t size)
+{
+    timed_cookie* tc = static_cast<timed_cookie*>(c);
+    ssize_t rc = timed_write(tc->fd, buf, size, tc->metrics);
+    return (rc < 0) ? 0 : rc;
+}
+
+inline int timed_cookie_close(void* c)
+{
+    timed_cookie* tc = static_cast<timed_cookie*>(c);
+    int rc = close(tc->fd);
+    delete tc;
+    return rc;
+}
+
+inline FILE* timed_fdopen(int fd, char const* mode, stream_metrics* m)
+{
+    timed_cookie* tc = new timed_cookie;
+    tc->fd = fd;
+    tc->metrics = m;
+    cookie_io_functions_t io;
+    io.read = timed_cookie_read;
+    io.write = timed_cookie_write;
+    io.seek = NULL;
+    io.close = timed_cookie_close;
+    FILE* f = fopencookie(tc, mode, io);
+    if (f == NULL) delete tc;
+    return f;
+}
+#endif
+
+class load_metrics {
+public:
+    load_metrics(std::string const& tool)
+        : _tool(tool), _start(metrics_now_ns()), _input("input"), _stop(false) {}
+    ~load_metrics() { stop(); }
+
+    stream_metrics& input() { return _input; }
+
+    // Register an output stream, the reference stays valid
+    stream_metrics& add_output(std::string const& name)
+    {
+        _outputs.emplace_back(name);
+        return _outputs.back();
+    }
+
+    // Print a progress line to stderr every interval seconds, 0 disables
+    void start(unsigned interval)
+    {
+        if (interval == 0 || _reporter.joinable()) return;
+        _stop = false;
+        _reporter = std::thread(&load_metrics::run, this, interval);
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        if (_reporter.joinable()) _reporter.join();
+    }
+
+    // Wall clock not spent blocked on the input or an output, up to now
+    double parse_seconds(uint64_t now) const
+    {
+        uint64_t wall = now - _start;
+        uint64_t wait = _input.wait_ns();
+        for (std::deque<stream_metrics>::const_iterator i = _outputs.begin(); i != _outputs.end(); ++i)
+            wait += i->blocked_ns();
+        return (wall > wait) ? (wall - wait) / 1e9 : 0.0;
+    }
+
+    void report(FILE* f) const
+    {
+        uint64_t now = metrics_now_ns();
+        double secs = (now - _start) / 1e9;
+        double rate = secs > 0 ? 1.0 / secs : 0.0;
+        char line[1024];
+        int n = snprintf(line, sizeof(line), "%s: %.0fs in %.1f MB %.1f MB/s %llu rows %.0f rows/s read-wait %.0f%%",
+                         _tool.c_str(), secs, _input.bytes() / 1e6, _input.bytes() / 1e6 * rate,
+                         (unsigned long long)_input.rows(), _input.rows() * rate,
+                         percent(_input.wait_ns(), secs));
+        for (std::deque<stream_metrics>::const_iterator i = _outputs.begin(); i != _outputs.end(); ++i) {
+            if (n >= (int)sizeof(line)) break;
+            n += snprintf(line + n, sizeof(line) - n, " | %s %.1f MB %llu rows write-wait %.0f%%",
+                          i->name().c_str(), i->bytes() / 1e6, (unsigned long long)i->rows(),
+                          percent(i->wait_ns(), secs));
+            if (i->async() && (n < (int)sizeof(line))) {
+                n += snprintf(line + n, sizeof(line) - n, " stall %.0f%% queue %.1f MB",
+                              percent(i->stall_ns(), secs), i->queued() / 1e6);
+            }
+        }
+        if (n < (int)sizeof(line)) {
+            snprintf(line + n, sizeof(line) - n, " | parse %.0f%% | rss %ld MB",
+                     secs > 0 ? 100.0 * parse_seconds(now) / secs : 0.0, metrics_peak_rss_kb() / 1024);
+        }
+        fprintf(f, "%s\n", line);
+        fflush(f);
+    }
+
+    void write_json(std::ostream& os) const
+    {
+        uint64_t now = metrics_now_ns();
+        double secs = (now - _start) / 1e9;
+        os << "{\n  \"tool\": \"" << _tool << "\",\n"
+           << "  \"elapsed_s\": " << secs << ",\n"
+           << "  \"parse_s\": " << parse_seconds(now) << ",\n"
+           << "  \"peak_rss_kb\": " << metrics_peak_rss_kb() << ",\n"
+           << "  \"streams\": [\n";
+        write_stream(os, _input, secs);
+        for (std::deque<stream_metrics>::const_iterator i = _outputs.begin(); i != _outputs.end(); ++i) {
+            os << ",\n";
+            write_stream(os, *i, secs);
+        }
+        os << "\n  ]\n}\n";
+    }
+
+    // Stop the reporter, print the last line and write the summary to filename
+    bool finish(std::string const& filename, bool quiet = false)
+    {
+        stop();
+        if (!quiet) report(stderr);
+        if (filename.empty()) return true;
+        std::ofstream ofs(filename.c_str());
+        write_json(ofs);
+        return ofs.good();
+    }
+
+private:
+    static double percent(uint64_t ns, double secs) { return secs > 0 ? ns / 1e7 / secs : 0.0; }
+
+    static void write_stream(std::ostream& os, stream_metrics const& s, double secs)
+    {
+        os << "    {\"name\": \"" << s.name() << "\""
+           << ", \"bytes\": " << s.bytes()
+           << ", \"rows\": " << s.rows()
+           << ", \"calls\": " << s.calls()
+           << ", \"wait_s\": " << s.wait_ns() / 1e9;
+        if (s.async()) {
+            os << ", \"stall_s\": " << s.stall_ns() / 1e9
+               << ", \"queue_peak_bytes\": " << s.peak_queued();
+        }
+        os << ", \"mb_per_s\": " << (secs > 0 ? s.bytes() / 1e6 / secs : 0.0)
+           << ", \"rows_per_s\": " << (secs > 0 ? s.rows() / secs : 0.0) << "}";
+    }
+
+    void run(unsigned interval)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (!_stop) {
+            if (_cv.wait_for(lock, std::chrono::seconds(interval)) == std::cv_status::timeout && !_stop)
+                report(stderr);
+        }
+    }
+
+    std::string _tool;
+    uint64_t _start;
+    stream_metrics _input;
+    std::deque<stream_metrics> _outputs;
+    std::thread _reporter;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _stop;
+};
+
+#endif // ! LOAD_METRICS_HPP
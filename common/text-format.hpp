@@ -0,0 +1,110 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Integer to text and text to integer conversions for the loaders,
+ *   without locales, streams or heap allocation.
+ *
+ */
+
+#ifndef TEXT_FORMAT_HPP
+#define TEXT_FORMAT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// Longest output of format_int64, including the sign
+#define FORMAT_INT64_MAX 20
+
+// Write the decimal digits of v to out, returns the number of chars
+inline size_t format_uint64(uint64_t v, char* out)
+{
+    static char const digits[201] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char tmp[FORMAT_INT64_MAX];
+    char* p = tmp + sizeof(tmp);
+    while (v >= 100) {
+        unsigned i = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--p = digits[i + 1];
+        *--p = digits[i];
+    }
+    if (v >= 10) {
+        unsigned i = (unsigned)v * 2;
+        *--p = digits[i + 1];
+        *--p = digits[i];
+    } else {
+        *--p = (char)('0' + v);
+    }
+    size_t n = tmp + sizeof(tmp) - p;
+    memcpy(out, p, n);
+    return n;
+}
+
+inline size_t format_int64(int64_t v, char* out)
+{
+    if (v < 0) {
+        *out = '-';
+        return 1 + format_uint64(0 - (uint64_t)v, out + 1);
+    }
+    return format_uint64((uint64_t)v, out);
+}
+
+// Leading integer of s as atol would read it, 0 if there is none
+inline int64_t parse_int64(char const* s, size_t len)
+{
+    char const* end = s + len;
+    while ((s < end) && ((*s == ' ') || (*s == '\t'))) ++s;
+    bool neg = false;
+    if ((s < end) && ((*s == '-') || (*s == '+'))) neg = (*s++ == '-');
+    uint64_t v = 0;
+    while ((s < end) && (*s >= '0') && (*s <= '9')) v = v * 10 + (*s++ - '0');
+    return neg ? (int64_t)(0 - v) : (int64_t)v;
+}
+
+/*
+ * Offsets of the tab separated columns of s.  starts gets the start of
+ * each column, then one past the end of s as if it ended with a tab, so
+ * column i is [starts[i], starts[i+1]-1).  The scan stops once max_cols
+ * columns are found, leaving the rest of s untouched.
+ */
+inline void find_columns(char const* s, size_t len, std::vector<size_t>& starts,
+                         size_t max_cols = (size_t)-1)
+{
+    starts.clear();
+    starts.push_back(0);
+    char const* end = s + len;
+    for (char const* p = s; (starts.size() <= max_cols) &&
+             ((p = static_cast<char const*>(memchr(p, '\t', end - p))) != NULL); ++p)
+        starts.push_back(p - s + 1);
+    if (starts.size() <= max_cols) starts.push_back(len + 1);
+}
+
+#endif // ! TEXT_FORMAT_HPP
@@ -0,0 +1,128 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   A fixed set of threads which run the tasks of one batch at a time,
+ *   with the calling thread taking part.  Used to encode the sample
+ *   columns of a single wide VCF row in parallel.
+ *
+ */
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+public:
+    // threads includes the caller, so threads-1 workers are started
+    explicit thread_pool(size_t threads)
+        : _fn(NULL), _generation(0), _tasks(0), _next(0), _busy(0), _stop(false)
+    {
+        for (size_t i = 1; i < threads; ++i)
+            _workers.push_back(std::thread(&thread_pool::work, this));
+    }
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start.notify_all();
+        for (size_t i = 0; i < _workers.size(); ++i) _workers[i].join();
+    }
+
+    size_t size() const { return _workers.size() + 1; }
+
+    // Run fn(0) .. fn(n-1) across the pool, returns when all are done
+    void run(size_t n, std::function<void(size_t)> const& fn)
+    {
+        if (_workers.empty() || (n < 2)) {
+            for (size_t i = 0; i < n; ++i) fn(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _fn = &fn;
+            _tasks = n;
+            _next.store(0);
+            _busy = _workers.size();
+            ++_generation;
+        }
+        _start.notify_all();
+        take(fn, n);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this] { return _busy == 0; });
+        _fn = NULL;
+    }
+
+private:
+    void take(std::function<void(size_t)> const& fn, size_t n)
+    {
+        for (size_t i = _next.fetch_add(1); i < n; i = _next.fetch_add(1)) fn(i);
+    }
+
+    void work()
+    {
+        size_t seen = 0;
+        while (true) {
+            std::function<void(size_t)> const* fn;
+            size_t n;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start.wait(lock, [&] { return _stop || (_generation != seen); });
+                if (_stop) return;
+                seen = _generation;
+                fn = _fn;
+                n = _tasks;
+            }
+            take(*fn, n);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (--_busy == 0) _done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _done;
+    std::function<void(size_t)> const* _fn;
+    size_t _generation;
+    size_t _tasks;
+    std::atomic<size_t> _next;
+    size_t _busy;
+    bool _stop;
+};
+
+#endif // ! THREAD_POOL_HPP
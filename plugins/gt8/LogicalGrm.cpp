@@ -0,0 +1,127 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file LogicalGrm.cpp
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief grm(gt_array) and pca(gt_array, k)
+ *
+ * grm returns the genetic relationship matrix of the samples of a
+ * genotype array [chromid, pos, var, sampleid] with a gt8 first
+ * attribute, over all its polymorphic variants, see grm.h:
+ *
+ *   <grm:double> [sampleid, sampleid2]
+ *
+ * pca returns the top k eigenvectors of that matrix, the principal
+ * components of the samples, and their eigenvalues:
+ *
+ *   <loading:double, eigenvalue:double> [sampleid, pc=0:k-1]
+ *
+ * Every instance adds up the variants of its own chunks and the sums are
+ * gathered on one instance, so sampleid must be bounded and one chunk,
+ * e.g. repart(foobar_gt, <...>[..., sampleid=0:2503,2504,0]).
+ */
+
+#include <algorithm>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "query/Operator.h"
+#include "system/Exceptions.h"
+
+#include "genotype-input.h"
+
+namespace scidb
+{
+
+// Chunk interval of each side of the grm output
+#define GRM_CHUNK 1024
+
+class LogicalGrm : public LogicalOperator
+{
+public:
+    LogicalGrm(const std::string& logicalName, const std::string& alias)
+        : LogicalOperator(logicalName, alias)
+    {
+        ADD_PARAM_INPUT();
+    }
+
+    ArrayDesc inferSchema(std::vector<ArrayDesc> schemas, boost::shared_ptr<Query> query)
+    {
+        DimensionDesc const& samples = gt_sample_dimension(schemas[0], "grm");
+        int64_t chunk = std::min<int64_t>(samples.getEndMax() - samples.getStartMin() + 1, GRM_CHUNK);
+
+        Attributes attrs;
+        attrs.push_back(AttributeDesc(0, "grm", TID_DOUBLE, 0, 0));
+        attrs = addEmptyTagAttribute(attrs);
+
+        Dimensions dims;
+        dims.push_back(DimensionDesc(samples.getBaseName(), samples.getStartMin(), samples.getEndMax(), chunk, 0));
+        dims.push_back(DimensionDesc(samples.getBaseName() + "2", samples.getStartMin(), samples.getEndMax(), chunk, 0));
+        return ArrayDesc(schemas[0].getName() + "_grm", attrs, dims);
+    }
+};
+
+class LogicalPca : public LogicalOperator
+{
+public:
+    LogicalPca(const std::string& logicalName, const std::string& alias)
+        : LogicalOperator(logicalName, alias)
+    {
+        ADD_PARAM_INPUT();
+        ADD_PARAM_CONSTANT("int64");
+    }
+
+    ArrayDesc inferSchema(std::vector<ArrayDesc> schemas, boost::shared_ptr<Query> query)
+    {
+        DimensionDesc const& samples = gt_sample_dimension(schemas[0], "pca");
+        int64_t nsamples = samples.getEndMax() - samples.getStartMin() + 1;
+        int64_t k = evaluate(((boost::shared_ptr<OperatorParamLogicalExpression>&)_parameters[0])->getExpression(),
+                             query, TID_INT64).getInt64();
+        if ((k < 1) || (k > nsamples))
+            throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "pca needs between 1 and the number of samples components";
+
+        Attributes attrs;
+        attrs.push_back(AttributeDesc(0, "loading", TID_DOUBLE, 0, 0));
+        attrs.push_back(AttributeDesc(1, "eigenvalue", TID_DOUBLE, 0, 0));
+        attrs = addEmptyTagAttribute(attrs);
+
+        Dimensions dims;
+        dims.push_back(DimensionDesc(samples.getBaseName(), samples.getStartMin(), samples.getEndMax(), nsamples, 0));
+        dims.push_back(DimensionDesc("pc", 0, k - 1, k, 0));
+        return ArrayDesc(schemas[0].getName() + "_pca", attrs, dims);
+    }
+};
+
+DECLARE_LOGICAL_OPERATOR_FACTORY(LogicalGrm, "grm");
+DECLARE_LOGICAL_OPERATOR_FACTORY(LogicalPca, "pca");
+
+} // namespace scidb
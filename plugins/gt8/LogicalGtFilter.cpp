@@ -0,0 +1,97 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file LogicalGtFilter.cpp
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief gt_filter(gt_array, classes)
+ *
+ * The cells of an array with a gt8 first attribute whose genotype is in
+ * classes, with all their attributes, e.g.
+ *
+ *   gt_filter(foobar_gt, 'het+!phased,homalt')
+ *
+ * does what filter(foobar_gt, (heterozygous(gt) and not phase(gt)) or
+ * ...) would, see gt-filter.h for the classes.  Null genotypes are left
+ * out.  The result has the dimensions of the input without overlap.
+ */
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "query/Operator.h"
+#include "system/Exceptions.h"
+
+#include "gt-filter.h"
+
+namespace scidb
+{
+
+class LogicalGtFilter : public LogicalOperator
+{
+public:
+    LogicalGtFilter(const std::string& logicalName, const std::string& alias)
+        : LogicalOperator(logicalName, alias)
+    {
+        ADD_PARAM_INPUT();
+        ADD_PARAM_CONSTANT("string");
+    }
+
+    ArrayDesc inferSchema(std::vector<ArrayDesc> schemas, boost::shared_ptr<Query> query)
+    {
+        ArrayDesc const& input = schemas[0];
+        Attributes const& in = input.getAttributes(true);
+        if (in[0].getType() != "gt8")
+            throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "gt_filter needs a gt8 first attribute";
+
+        std::string classes = evaluate(((boost::shared_ptr<OperatorParamLogicalExpression>&)_parameters[0])->getExpression(),
+                                       query, TID_STRING).getString();
+        gt_filter_mask mask;
+        if (!gt_filter_compile(classes, mask))
+            throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "gt_filter cannot parse the classes '" << classes << "'";
+
+        Attributes attrs(in.begin(), in.end());
+        attrs = addEmptyTagAttribute(attrs);
+
+        Dimensions const& dims = input.getDimensions();
+        Dimensions out;
+        for (size_t d = 0; d < dims.size(); ++d) {
+            out.push_back(DimensionDesc(dims[d].getBaseName(), dims[d].getStartMin(), dims[d].getEndMax(),
+                                        dims[d].getChunkInterval(), 0));
+        }
+        return ArrayDesc(input.getName(), attrs, out);
+    }
+};
+
+DECLARE_LOGICAL_OPERATOR_FACTORY(LogicalGtFilter, "gt_filter");
+
+} // namespace scidb
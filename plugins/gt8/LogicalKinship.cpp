@@ -0,0 +1,98 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file LogicalKinship.cpp
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief kinship(gt_array, tile)
+ *
+ * Identity by state and the KING robust kinship coefficient of every
+ * pair of samples of a genotype array [chromid, pos, var, sampleid] with
+ * a gt8 first attribute, see kinship.h.  Only sampleid < sampleid2 is
+ * set:
+ *
+ *   <n:uint32, ibs0:uint32, ibs1:uint32, ibs2:uint32, kinship:double null>
+ *   [sampleid, sampleid2]
+ *
+ * Both sampleid dimensions of the result are chunked by tile, usually
+ * the sample_chunksize of the _gt array, and each tile of pairs is one
+ * output chunk.  Every instance counts the variants of its own chunks,
+ * then the counts of each tile are added on the instance writing it.
+ * The input must hold all samples of a variant in one chunk.
+ */
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "query/Operator.h"
+#include "system/Exceptions.h"
+
+#include "genotype-input.h"
+
+namespace scidb
+{
+
+class LogicalKinship : public LogicalOperator
+{
+public:
+    LogicalKinship(const std::string& logicalName, const std::string& alias)
+        : LogicalOperator(logicalName, alias)
+    {
+        ADD_PARAM_INPUT();
+        ADD_PARAM_CONSTANT("int64");
+    }
+
+    ArrayDesc inferSchema(std::vector<ArrayDesc> schemas, boost::shared_ptr<Query> query)
+    {
+        DimensionDesc const& samples = gt_sample_dimension(schemas[0], "kinship");
+        int64_t tile = evaluate(((boost::shared_ptr<OperatorParamLogicalExpression>&)_parameters[0])->getExpression(),
+                                query, TID_INT64).getInt64();
+        if (tile < 1)
+            throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "kinship needs a tile of at least 1 sample";
+
+        Attributes attrs;
+        attrs.push_back(AttributeDesc(0, "n", TID_UINT32, 0, 0));
+        attrs.push_back(AttributeDesc(1, "ibs0", TID_UINT32, 0, 0));
+        attrs.push_back(AttributeDesc(2, "ibs1", TID_UINT32, 0, 0));
+        attrs.push_back(AttributeDesc(3, "ibs2", TID_UINT32, 0, 0));
+        attrs.push_back(AttributeDesc(4, "kinship", TID_DOUBLE, AttributeDesc::IS_NULLABLE, 0));
+        attrs = addEmptyTagAttribute(attrs);
+
+        Dimensions dims;
+        dims.push_back(DimensionDesc(samples.getBaseName(), samples.getStartMin(), samples.getEndMax(), tile, 0));
+        dims.push_back(DimensionDesc(samples.getBaseName() + "2", samples.getStartMin(), samples.getEndMax(), tile, 0));
+        return ArrayDesc(schemas[0].getName() + "_kinship", attrs, dims);
+    }
+};
+
+DECLARE_LOGICAL_OPERATOR_FACTORY(LogicalKinship, "kinship");
+
+} // namespace scidb
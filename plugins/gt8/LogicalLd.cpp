@@ -0,0 +1,141 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file LogicalLd.cpp
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief ld(gt_array, window [, min_r2 [, populations]])
+ *
+ * Pairwise linkage disequilibrium of the variants of a genotype array
+ * [chromid, pos, var, sampleid] with a gt8 first attribute, for every
+ * pair of variants at most window bases apart.  Pairs with r2 below
+ * min_r2 (default 0) are left out, so the result is sparse:
+ *
+ *   <r2:double, dprime:double, n:uint32> [chromid, pos, var, pos2, var2, popid]
+ *
+ * populations is a comma separated list of the first sampleid of each
+ * population, so the samples must be numbered by population as
+ * samples_load.sh does; by default all samples are one population.
+ *
+ * Each instance works on the pos chunks it holds.  The pairs which cross
+ * into the next chunk are found in the chunk overlap, so the pos overlap
+ * of the input must be at least window, and var and sampleid must each
+ * be a single chunk, e.g. repart(foobar_gt, <...>[chromid=0:*,1,0,
+ * pos=1:*,200000,100000, var=1:20,20,0, sampleid=0:2503,2504,0]).
+ */
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "query/Operator.h"
+#include "system/Exceptions.h"
+
+#include "ld.h"
+
+namespace scidb
+{
+
+class LogicalLd : public LogicalOperator
+{
+public:
+    LogicalLd(const std::string& logicalName, const std::string& alias)
+        : LogicalOperator(logicalName, alias)
+    {
+        ADD_PARAM_INPUT();
+        ADD_PARAM_CONSTANT("int64");
+        ADD_PARAM_VARIES();
+    }
+
+    std::vector<boost::shared_ptr<OperatorParamPlaceholder> > nextVaryParamPlaceholder(const std::vector<ArrayDesc>& schemas)
+    {
+        std::vector<boost::shared_ptr<OperatorParamPlaceholder> > res;
+        res.push_back(END_OF_VARIES_PARAMS());
+        if (_parameters.size() == 1) res.push_back(PARAM_CONSTANT("double"));
+        else if (_parameters.size() == 2) res.push_back(PARAM_CONSTANT("string"));
+        return res;
+    }
+
+    ArrayDesc inferSchema(std::vector<ArrayDesc> schemas, boost::shared_ptr<Query> query)
+    {
+        ArrayDesc const& input = schemas[0];
+        Dimensions const& dims = input.getDimensions();
+        if (dims.size() != 4)
+            throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "ld needs an array of [chromid, pos, var, sampleid]";
+        if (input.getAttributes(true)[0].getType() != "gt8")
+            throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "ld needs a gt8 first attribute";
+
+        int64_t window = evaluate(((boost::shared_ptr<OperatorParamLogicalExpression>&)_parameters[0])->getExpression(),
+                                  query, TID_INT64).getInt64();
+        if ((window < 0) || (window > dims[1].getChunkOverlap()))
+            throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "ld needs a window within the pos chunk overlap";
+        for (size_t d = 2; d < 4; ++d) {
+            if ((dims[d].getEndMax() == MAX_COORDINATE) ||
+                (dims[d].getChunkInterval() < dims[d].getEndMax() - dims[d].getStartMin() + 1))
+                throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                    << "ld needs var and sampleid bounded and in a single chunk";
+        }
+
+        std::vector<int64_t> starts(1, dims[3].getStartMin());
+        if (_parameters.size() > 2) {
+            std::string pops = evaluate(((boost::shared_ptr<OperatorParamLogicalExpression>&)_parameters[2])->getExpression(),
+                                        query, TID_STRING).getString();
+            if (!ld_parse_populations(pops, starts))
+                throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                    << "ld populations must be ascending sampleids";
+        }
+
+        Attributes attrs;
+        attrs.push_back(AttributeDesc(0, "r2", TID_DOUBLE, 0, 0));
+        attrs.push_back(AttributeDesc(1, "dprime", TID_DOUBLE, 0, 0));
+        attrs.push_back(AttributeDesc(2, "n", TID_UINT32, 0, 0));
+        attrs = addEmptyTagAttribute(attrs);
+
+        Dimensions out;
+        out.push_back(DimensionDesc(dims[0].getBaseName(), dims[0].getStartMin(), dims[0].getEndMax(),
+                                    dims[0].getChunkInterval(), 0));
+        out.push_back(DimensionDesc(dims[1].getBaseName(), dims[1].getStartMin(), dims[1].getEndMax(),
+                                    dims[1].getChunkInterval(), 0));
+        out.push_back(DimensionDesc(dims[2].getBaseName(), dims[2].getStartMin(), dims[2].getEndMax(),
+                                    dims[2].getChunkInterval(), 0));
+        out.push_back(DimensionDesc(dims[1].getBaseName() + "2", dims[1].getStartMin(), dims[1].getEndMax(),
+                                    dims[1].getChunkInterval(), 0));
+        out.push_back(DimensionDesc(dims[2].getBaseName() + "2", dims[2].getStartMin(), dims[2].getEndMax(),
+                                    dims[2].getChunkInterval(), 0));
+        out.push_back(DimensionDesc("popid", 0, starts.size() - 1, starts.size(), 0));
+        return ArrayDesc(input.getName() + "_ld", attrs, out);
+    }
+};
+
+DECLARE_LOGICAL_OPERATOR_FACTORY(LogicalLd, "ld");
+
+} // namespace scidb
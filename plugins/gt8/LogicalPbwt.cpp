@@ -0,0 +1,200 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file LogicalPbwt.cpp
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief pbwt_decode(pbwt_array [, chromid, start, end]) and
+ * pbwt_match(pbwt_array, haplotype, min_sites [, interval])
+ *
+ * Both read the PBWT of the phased genotypes written by vcf2scidb --pbwt,
+ * see pbwt.h, stored as
+ *
+ *   <code:uint8, length:uint32> [chromid, pos, var, run=-S:2S-1]
+ *
+ * for S sampleids.  Runs 0 and up are the runs of allele codes of a
+ * variant, and the negative runs its calls which are not phased diploid,
+ * the gt8 as code and the sampleid as length, so run must be a single
+ * chunk.  The PBWT order starts over at the first variant of each pos
+ * chunk of the load.
+ *
+ * pbwt_decode gives back the genotypes, as the _gt array
+ *
+ *   <gt:gt8 null> [chromid, pos, var, sampleid=0:S-1]
+ *
+ * by default for every variant.  Given a chromid and a pos range only
+ * the pos chunks overlapping it are read.  The input must be chunked by
+ * pos as it was loaded, each chunk is decoded from its first variant.
+ *
+ * pbwt_match finds the set-maximal matches of haplotype (2 sampleid for
+ * the first allele, 2 sampleid + 1 for the second) with every other,
+ * of at least min_sites variants:
+ *
+ *   <end:int64, sites:uint64> [chromid, pos, haplotype=0:2S-1]
+ *
+ * pos and end are the first and last variant of a match.  Matches run
+ * across the chunks of the load, interval (default 200000) being their
+ * pos chunk interval, so pos must be a single chunk of the input, e.g.
+ * repart(foobar_pbwt, <...>[chromid=0:*,1,0, pos=1:249000000,249000000,0,
+ * var=1:20,20,0, run=-2504:5007,7512,0]), and each instance matches the
+ * chromosomes it holds.
+ */
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "query/Operator.h"
+#include "system/Exceptions.h"
+
+#include "pbwt.h"
+
+namespace scidb
+{
+
+// Number of samples of the PBWT array input of the operator op
+static int64_t pbwt_samples(ArrayDesc const& input, std::string const& op)
+{
+    Dimensions const& dims = input.getDimensions();
+    Attributes const& attrs = input.getAttributes(true);
+    if ((dims.size() != 4) || (attrs.size() < 2) || (attrs[0].getType() != TID_UINT8) ||
+        (attrs[1].getType() != TID_UINT32))
+        throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+            << (op + " needs an array of <code:uint8, length:uint32> [chromid, pos, var, run]");
+    DimensionDesc const& runs = dims[3];
+    if ((runs.getStartMin() >= 0) || (runs.getEndMax() == MAX_COORDINATE) ||
+        (runs.getChunkInterval() < runs.getEndMax() - runs.getStartMin() + 1))
+        throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+            << (op + " needs run from -samples, bounded and in a single chunk");
+    return -runs.getStartMin();
+}
+
+class LogicalPbwtDecode : public LogicalOperator
+{
+public:
+    LogicalPbwtDecode(const std::string& logicalName, const std::string& alias)
+        : LogicalOperator(logicalName, alias)
+    {
+        ADD_PARAM_INPUT();
+        ADD_PARAM_VARIES();
+    }
+
+    std::vector<boost::shared_ptr<OperatorParamPlaceholder> > nextVaryParamPlaceholder(const std::vector<ArrayDesc>& schemas)
+    {
+        std::vector<boost::shared_ptr<OperatorParamPlaceholder> > res;
+        if ((_parameters.size() == 0) || (_parameters.size() == 3)) res.push_back(END_OF_VARIES_PARAMS());
+        if (_parameters.size() < 3) res.push_back(PARAM_CONSTANT("int64"));
+        return res;
+    }
+
+    ArrayDesc inferSchema(std::vector<ArrayDesc> schemas, boost::shared_ptr<Query> query)
+    {
+        int64_t samples = pbwt_samples(schemas[0], "pbwt_decode");
+        Dimensions const& dims = schemas[0].getDimensions();
+
+        Attributes attrs;
+        attrs.push_back(AttributeDesc(0, "gt", "gt8", AttributeDesc::IS_NULLABLE, 0));
+        attrs = addEmptyTagAttribute(attrs);
+
+        Dimensions out;
+        for (size_t d = 0; d < 3; ++d) {
+            out.push_back(DimensionDesc(dims[d].getBaseName(), dims[d].getStartMin(), dims[d].getEndMax(),
+                                        dims[d].getChunkInterval(), 0));
+        }
+        out.push_back(DimensionDesc("sampleid", 0, samples - 1, samples, 0));
+        return ArrayDesc(schemas[0].getName() + "_gt", attrs, out);
+    }
+};
+
+class LogicalPbwtMatch : public LogicalOperator
+{
+public:
+    LogicalPbwtMatch(const std::string& logicalName, const std::string& alias)
+        : LogicalOperator(logicalName, alias)
+    {
+        ADD_PARAM_INPUT();
+        ADD_PARAM_CONSTANT("int64");
+        ADD_PARAM_CONSTANT("int64");
+        ADD_PARAM_VARIES();
+    }
+
+    std::vector<boost::shared_ptr<OperatorParamPlaceholder> > nextVaryParamPlaceholder(const std::vector<ArrayDesc>& schemas)
+    {
+        std::vector<boost::shared_ptr<OperatorParamPlaceholder> > res;
+        res.push_back(END_OF_VARIES_PARAMS());
+        if (_parameters.size() == 2) res.push_back(PARAM_CONSTANT("int64"));
+        return res;
+    }
+
+    ArrayDesc inferSchema(std::vector<ArrayDesc> schemas, boost::shared_ptr<Query> query)
+    {
+        int64_t samples = pbwt_samples(schemas[0], "pbwt_match");
+        Dimensions const& dims = schemas[0].getDimensions();
+        if ((dims[1].getEndMax() == MAX_COORDINATE) ||
+            (dims[1].getChunkInterval() < dims[1].getEndMax() - dims[1].getStartMin() + 1))
+            throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "pbwt_match needs pos bounded and in a single chunk";
+
+        int64_t haplotype = evaluate(((boost::shared_ptr<OperatorParamLogicalExpression>&)_parameters[0])->getExpression(),
+                                     query, TID_INT64).getInt64();
+        if ((haplotype < 0) || (haplotype >= 2 * samples))
+            throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "pbwt_match needs a haplotype between 0 and twice the number of samples";
+        int64_t min_sites = evaluate(((boost::shared_ptr<OperatorParamLogicalExpression>&)_parameters[1])->getExpression(),
+                                     query, TID_INT64).getInt64();
+        if (min_sites < 1)
+            throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "pbwt_match needs min_sites of at least 1";
+        if (_parameters.size() > 2) {
+            int64_t interval = evaluate(((boost::shared_ptr<OperatorParamLogicalExpression>&)_parameters[2])->getExpression(),
+                                        query, TID_INT64).getInt64();
+            if (interval < 1)
+                throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                    << "pbwt_match needs an interval of at least 1";
+        }
+
+        Attributes attrs;
+        attrs.push_back(AttributeDesc(0, "end", TID_INT64, 0, 0));
+        attrs.push_back(AttributeDesc(1, "sites", TID_UINT64, 0, 0));
+        attrs = addEmptyTagAttribute(attrs);
+
+        Dimensions out;
+        out.push_back(DimensionDesc(dims[0].getBaseName(), dims[0].getStartMin(), dims[0].getEndMax(),
+                                    dims[0].getChunkInterval(), 0));
+        out.push_back(DimensionDesc(dims[1].getBaseName(), dims[1].getStartMin(), dims[1].getEndMax(),
+                                    dims[1].getChunkInterval(), 0));
+        out.push_back(DimensionDesc("haplotype", 0, 2 * samples - 1, 2 * samples, 0));
+        return ArrayDesc(schemas[0].getName() + "_match", attrs, out);
+    }
+};
+
+DECLARE_LOGICAL_OPERATOR_FACTORY(LogicalPbwtDecode, "pbwt_decode");
+DECLARE_LOGICAL_OPERATOR_FACTORY(LogicalPbwtMatch, "pbwt_match");
+
+} // namespace scidb
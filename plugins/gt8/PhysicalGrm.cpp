@@ -0,0 +1,217 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file PhysicalGrm.cpp
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Physical implementation of grm and pca, see LogicalGrm.cpp.
+ * Each instance streams the variants of its local chunks through a
+ * grm_accumulator, then sends its partial sums to the first instance,
+ * which adds them up and writes the whole result.
+ */
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "query/Operator.h"
+#include "array/MemArray.h"
+#include "network/Network.h"
+
+#include "grm.h"
+
+namespace scidb
+{
+
+class PhysicalGrmBase : public PhysicalOperator
+{
+public:
+    PhysicalGrmBase(const std::string& logicalName, const std::string& physicalName,
+                    const Parameters& parameters, const ArrayDesc& schema)
+        : PhysicalOperator(logicalName, physicalName, parameters, schema)
+    {
+    }
+
+    virtual bool changesDistribution(const std::vector<ArrayDesc>& inputSchemas) const
+    {
+        return true;
+    }
+
+    virtual ArrayDistribution getOutputDistribution(const std::vector<ArrayDistribution>& inputDistributions,
+                                                    const std::vector<ArrayDesc>& inputSchemas) const
+    {
+        return ArrayDistribution(psUndefined);
+    }
+
+protected:
+    /*
+     * The relationship matrix of the samples over the variants of every
+     * instance, true on the first instance, which then holds it in grm
+     */
+    bool gather(boost::shared_ptr<Array>& input, boost::shared_ptr<Query>& query, std::vector<double>& grm)
+    {
+        DimensionDesc const& samples = input->getArrayDesc().getDimensions()[3];
+        Coordinate first = samples.getStartMin();
+        size_t nsamples = samples.getEndMax() - first + 1;
+        grm_accumulator acc(nsamples);
+
+        boost::shared_ptr<ConstArrayIterator> chunks = input->getConstIterator(0);
+        for (; !chunks->end(); ++(*chunks)) {
+            boost::shared_ptr<ConstChunkIterator> cells = chunks->getChunk().getConstIterator(
+                ConstChunkIterator::IGNORE_OVERLAPS | ConstChunkIterator::IGNORE_EMPTY_CELLS);
+            Coordinate pos = 0, var = 0;
+            int8_t* dosage = NULL;
+            for (; !cells->end(); ++(*cells)) {
+                Coordinates const& at = cells->getPosition();
+                if (!dosage || (at[1] != pos) || (at[2] != var)) {
+                    dosage = acc.next_variant();
+                    pos = at[1];
+                    var = at[2];
+                }
+                Value const& v = cells->getItem();
+                if (v.isNull()) continue;
+                uint8_t d = gt8_dosage(*static_cast<gt8_t const*>(v.data()));
+                if (d != GT8_DOSAGE_MISSING) dosage[at[3] - first] = d;
+            }
+        }
+        acc.flush();
+
+        // The sums, then the variant count, as doubles
+        std::vector<double> const& sums = acc.sums();
+        size_t bytes = (sums.size() + 1) * sizeof(double);
+        if (query->getInstanceID() != 0) {
+            std::vector<double> buf(sums);
+            buf.push_back(acc.variants());
+            BufSend(0, boost::shared_ptr<SharedBuffer>(new MemoryBuffer(&buf[0], bytes)), query);
+            return false;
+        }
+        for (InstanceID i = 1; i < query->getInstancesCount(); ++i) {
+            boost::shared_ptr<SharedBuffer> buf = BufReceive(i, query);
+            double const* data = static_cast<double const*>(buf->getData());
+            acc.merge(data, (uint64_t)data[sums.size()]);
+        }
+        acc.finish(grm);
+        return true;
+    }
+};
+
+class PhysicalGrm : public PhysicalGrmBase
+{
+public:
+    PhysicalGrm(const std::string& logicalName, const std::string& physicalName,
+                const Parameters& parameters, const ArrayDesc& schema)
+        : PhysicalGrmBase(logicalName, physicalName, parameters, schema)
+    {
+    }
+
+    boost::shared_ptr<Array> execute(std::vector<boost::shared_ptr<Array> >& inputArrays, boost::shared_ptr<Query> query)
+    {
+        boost::shared_ptr<MemArray> output(new MemArray(_schema, query));
+        std::vector<double> grm;
+        if (!gather(inputArrays[0], query, grm)) return output;
+
+        DimensionDesc const& rows = _schema.getDimensions()[0];
+        Coordinate first = rows.getStartMin();
+        Coordinate last = rows.getEndMax();
+        int64_t chunk = rows.getChunkInterval();
+        size_t n = last - first + 1;
+        boost::shared_ptr<ArrayIterator> chunks = output->getIterator(0);
+        Coordinates at(2);
+        Value value;
+        for (Coordinate r0 = first; r0 <= last; r0 += chunk) {
+            for (Coordinate c0 = first; c0 <= last; c0 += chunk) {
+                at[0] = r0;
+                at[1] = c0;
+                boost::shared_ptr<ChunkIterator> cells =
+                    chunks->newChunk(at).getIterator(query, ChunkIterator::SEQUENTIAL_WRITE);
+                for (at[0] = r0; at[0] <= std::min(r0 + chunk - 1, last); ++at[0]) {
+                    for (at[1] = c0; at[1] <= std::min(c0 + chunk - 1, last); ++at[1]) {
+                        cells->setPosition(at);
+                        value.setDouble(grm[(at[0] - first) * n + (at[1] - first)]);
+                        cells->writeItem(value);
+                    }
+                }
+                cells->flush();
+            }
+        }
+        return output;
+    }
+};
+
+class PhysicalPca : public PhysicalGrmBase
+{
+public:
+    PhysicalPca(const std::string& logicalName, const std::string& physicalName,
+                const Parameters& parameters, const ArrayDesc& schema)
+        : PhysicalGrmBase(logicalName, physicalName, parameters, schema)
+    {
+    }
+
+    boost::shared_ptr<Array> execute(std::vector<boost::shared_ptr<Array> >& inputArrays, boost::shared_ptr<Query> query)
+    {
+        boost::shared_ptr<MemArray> output(new MemArray(_schema, query));
+        std::vector<double> grm;
+        if (!gather(inputArrays[0], query, grm)) return output;
+
+        DimensionDesc const& rows = _schema.getDimensions()[0];
+        Coordinate first = rows.getStartMin();
+        size_t n = rows.getEndMax() - first + 1;
+        size_t k = ((boost::shared_ptr<OperatorParamPhysicalExpression>&)_parameters[0])->getExpression()->evaluate().getInt64();
+        std::vector<double> vals, vecs;
+        grm_top_eigen(grm, n, k, vals, vecs);
+
+        Coordinates at(2);
+        at[0] = first;
+        at[1] = 0;
+        Value value;
+        for (AttributeID a = 0; a < 2; ++a) {
+            int flags = ChunkIterator::SEQUENTIAL_WRITE;
+            if (a > 0) flags |= ChunkIterator::NO_EMPTY_CHECK;
+            boost::shared_ptr<ArrayIterator> chunks = output->getIterator(a);
+            boost::shared_ptr<ChunkIterator> cells = chunks->newChunk(at).getIterator(query, flags);
+            Coordinates cell(2);
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t c = 0; c < k; ++c) {
+                    cell[0] = first + i;
+                    cell[1] = c;
+                    cells->setPosition(cell);
+                    value.setDouble((a == 0) ? vecs[i * k + c] : vals[c]);
+                    cells->writeItem(value);
+                }
+            }
+            cells->flush();
+        }
+        return output;
+    }
+};
+
+DECLARE_PHYSICAL_OPERATOR_FACTORY(PhysicalGrm, "grm", "PhysicalGrm");
+DECLARE_PHYSICAL_OPERATOR_FACTORY(PhysicalPca, "pca", "PhysicalPca");
+
+} // namespace scidb
@@ -0,0 +1,142 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file PhysicalGtFilter.cpp
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Physical implementation of gt_filter, see LogicalGtFilter.cpp.
+ * The genotypes of each local chunk are gathered into a flat buffer and
+ * matched against the class mask in one pass, then the cells which
+ * matched are copied from every attribute into a sparse chunk at the
+ * same position, so the distribution of the input is kept.
+ */
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "query/Operator.h"
+#include "array/MemArray.h"
+
+#include "gt-filter.h"
+
+namespace scidb
+{
+
+class PhysicalGtFilter : public PhysicalOperator
+{
+public:
+    PhysicalGtFilter(const std::string& logicalName, const std::string& physicalName,
+                     const Parameters& parameters, const ArrayDesc& schema)
+        : PhysicalOperator(logicalName, physicalName, parameters, schema)
+    {
+    }
+
+    boost::shared_ptr<Array> execute(std::vector<boost::shared_ptr<Array> >& inputArrays, boost::shared_ptr<Query> query)
+    {
+        std::string classes = ((boost::shared_ptr<OperatorParamPhysicalExpression>&)_parameters[0])->getExpression()->evaluate().getString();
+        gt_filter_compile(classes, _mask);
+
+        boost::shared_ptr<MemArray> output(new MemArray(_schema, query));
+        size_t nattrs = _schema.getAttributes(true).size();
+        std::vector<boost::shared_ptr<ConstArrayIterator> > chunks(nattrs);
+        for (AttributeID a = 0; a < nattrs; ++a) chunks[a] = inputArrays[0]->getConstIterator(a);
+
+        for (; !chunks[0]->end(); ) {
+            if (select(chunks[0]->getChunk()) > 0) {
+                Coordinates const& at = chunks[0]->getChunk().getFirstPosition(false);
+                for (AttributeID a = 0; a < nattrs; ++a) {
+                    boost::shared_ptr<ArrayIterator> out = output->getIterator(a);
+                    copy_cells(chunks[a]->getChunk(), out->newChunk(at), a, query);
+                }
+            }
+            for (AttributeID a = 0; a < nattrs; ++a) ++(*chunks[a]);
+        }
+        return output;
+    }
+
+private:
+    // Offsets in the chunk of the cells which are in the mask
+    size_t select(ConstChunk const& chunk)
+    {
+        _gts.clear();
+        _nulls.clear();
+        boost::shared_ptr<ConstChunkIterator> cells = chunk.getConstIterator(
+                ConstChunkIterator::IGNORE_OVERLAPS | ConstChunkIterator::IGNORE_EMPTY_CELLS);
+        for (; !cells->end(); ++(*cells)) {
+            Value const& v = cells->getItem();
+            if (v.isNull()) {
+                _nulls.push_back(_gts.size());
+                _gts.push_back(0);
+            } else {
+                _gts.push_back(*static_cast<gt8_t const*>(v.data()));
+            }
+        }
+        _hits.resize(_gts.size());
+        if (_gts.empty()) return 0;
+        _hits.resize(gt_filter_select(_mask, &_gts[0], _gts.size(), &_hits[0]));
+
+        // Null genotypes are read as 0, the empty haploid, take them back out
+        if (!_nulls.empty() && !_hits.empty()) {
+            size_t k = 0;
+            for (size_t i = 0, n = 0; i < _hits.size(); ++i) {
+                while ((n < _nulls.size()) && (_nulls[n] < _hits[i])) ++n;
+                if ((n < _nulls.size()) && (_nulls[n] == _hits[i])) continue;
+                _hits[k++] = _hits[i];
+            }
+            _hits.resize(k);
+        }
+        return _hits.size();
+    }
+
+    void copy_cells(ConstChunk const& chunk, Chunk& out, AttributeID a, boost::shared_ptr<Query>& query)
+    {
+        int flags = ChunkIterator::SEQUENTIAL_WRITE;
+        if (a > 0) flags |= ChunkIterator::NO_EMPTY_CHECK;
+        boost::shared_ptr<ChunkIterator> dst = out.getIterator(query, flags);
+        boost::shared_ptr<ConstChunkIterator> src = chunk.getConstIterator(
+                ConstChunkIterator::IGNORE_OVERLAPS | ConstChunkIterator::IGNORE_EMPTY_CELLS);
+        uint32_t offset = 0;
+        for (size_t i = 0; i < _hits.size(); ++i) {
+            for (; offset < _hits[i]; ++offset) ++(*src);
+            dst->setPosition(src->getPosition());
+            dst->writeItem(src->getItem());
+        }
+        dst->flush();
+    }
+
+    gt_filter_mask _mask;
+    std::vector<gt8_t> _gts;
+    std::vector<uint32_t> _nulls;
+    std::vector<uint32_t> _hits;
+};
+
+DECLARE_PHYSICAL_OPERATOR_FACTORY(PhysicalGtFilter, "gt_filter", "PhysicalGtFilter");
+
+} // namespace scidb
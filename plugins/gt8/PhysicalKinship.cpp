@@ -0,0 +1,214 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file PhysicalKinship.cpp
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Physical implementation of kinship, see LogicalKinship.cpp.
+ * The tiles of sample pairs, sampleid tile <= sampleid2 tile, are dealt
+ * out to the instances in turn.  Each instance sends its counts of the
+ * tiles of every other instance to it, adds up the counts it receives
+ * for its own, and writes those.
+ */
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "query/Operator.h"
+#include "array/MemArray.h"
+#include "network/Network.h"
+
+#include "kinship.h"
+
+namespace scidb
+{
+
+class PhysicalKinship : public PhysicalOperator
+{
+public:
+    PhysicalKinship(const std::string& logicalName, const std::string& physicalName,
+                    const Parameters& parameters, const ArrayDesc& schema)
+        : PhysicalOperator(logicalName, physicalName, parameters, schema)
+    {
+    }
+
+    virtual bool changesDistribution(const std::vector<ArrayDesc>& inputSchemas) const
+    {
+        return true;
+    }
+
+    virtual ArrayDistribution getOutputDistribution(const std::vector<ArrayDistribution>& inputDistributions,
+                                                    const std::vector<ArrayDesc>& inputSchemas) const
+    {
+        return ArrayDistribution(psUndefined);
+    }
+
+    boost::shared_ptr<Array> execute(std::vector<boost::shared_ptr<Array> >& inputArrays, boost::shared_ptr<Query> query)
+    {
+        DimensionDesc const& samples = _schema.getDimensions()[0];
+        _first = samples.getStartMin();
+        _samples = samples.getEndMax() - _first + 1;
+        _tile = samples.getChunkInterval();
+        kinship_accumulator acc(_samples, _tile);
+
+        boost::shared_ptr<ConstArrayIterator> chunks = inputArrays[0]->getConstIterator(0);
+        for (; !chunks->end(); ++(*chunks)) {
+            boost::shared_ptr<ConstChunkIterator> cells = chunks->getChunk().getConstIterator(
+                ConstChunkIterator::IGNORE_OVERLAPS | ConstChunkIterator::IGNORE_EMPTY_CELLS);
+            Coordinate pos = 0, var = 0;
+            bool started = false;
+            for (; !cells->end(); ++(*cells)) {
+                Coordinates const& at = cells->getPosition();
+                if (!started || (at[1] != pos) || (at[2] != var)) {
+                    acc.next_variant();
+                    started = true;
+                    pos = at[1];
+                    var = at[2];
+                }
+                Value const& v = cells->getItem();
+                if (!v.isNull()) acc.set(at[3] - _first, *static_cast<gt8_t const*>(v.data()));
+            }
+        }
+        acc.flush();
+
+        InstanceID self = query->getInstanceID();
+        size_t ninstances = query->getInstancesCount();
+        for (InstanceID peer = 0; peer < ninstances; ++peer) {
+            if (peer == self) continue;
+            std::vector<ibs_counts> buf;
+            pack(acc, peer, ninstances, buf);
+            size_t bytes = buf.size() * sizeof(ibs_counts);
+            BufSend(peer, boost::shared_ptr<SharedBuffer>(new MemoryBuffer(buf.empty() ? NULL : &buf[0], bytes)), query);
+        }
+        for (InstanceID peer = 0; peer < ninstances; ++peer) {
+            if (peer == self) continue;
+            boost::shared_ptr<SharedBuffer> buf = BufReceive(peer, query);
+            unpack(acc, self, ninstances, static_cast<ibs_counts const*>(buf->getData()));
+        }
+
+        boost::shared_ptr<MemArray> output(new MemArray(_schema, query));
+        size_t ntiles = (_samples + _tile - 1) / _tile;
+        size_t id = 0;
+        for (size_t ti = 0; ti < ntiles; ++ti) {
+            for (size_t tj = ti; tj < ntiles; ++tj, ++id) {
+                if (id % ninstances == self) write_tile(acc, ti, tj, output, query);
+            }
+        }
+        return output;
+    }
+
+private:
+    // Visit the pairs of the tiles dealt to instance owner, in the same order everywhere
+    template <typename Visit>
+    void for_pairs(size_t owner, size_t ninstances, Visit visit)
+    {
+        size_t ntiles = (_samples + _tile - 1) / _tile;
+        size_t id = 0;
+        for (size_t ti = 0; ti < ntiles; ++ti) {
+            for (size_t tj = ti; tj < ntiles; ++tj, ++id) {
+                if (id % ninstances != owner) continue;
+                for (size_t i = ti * _tile; i < std::min((ti + 1) * _tile, _samples); ++i) {
+                    for (size_t j = std::max(tj * _tile, i + 1); j < std::min((tj + 1) * _tile, _samples); ++j)
+                        visit(i, j);
+                }
+            }
+        }
+    }
+
+    struct pack_visit {
+        kinship_accumulator& acc;
+        std::vector<ibs_counts>& buf;
+        void operator()(size_t i, size_t j) { buf.push_back(acc.counts(i, j)); }
+    };
+
+    struct unpack_visit {
+        kinship_accumulator& acc;
+        ibs_counts const* data;
+        void operator()(size_t i, size_t j) { acc.counts(i, j).add(*data++); }
+    };
+
+    void pack(kinship_accumulator& acc, size_t owner, size_t ninstances, std::vector<ibs_counts>& buf)
+    {
+        pack_visit visit = { acc, buf };
+        for_pairs(owner, ninstances, visit);
+    }
+
+    void unpack(kinship_accumulator& acc, size_t owner, size_t ninstances, ibs_counts const* data)
+    {
+        unpack_visit visit = { acc, data };
+        for_pairs(owner, ninstances, visit);
+    }
+
+    void write_tile(kinship_accumulator& acc, size_t ti, size_t tj,
+                    boost::shared_ptr<MemArray>& output, boost::shared_ptr<Query>& query)
+    {
+        size_t i1 = std::min((ti + 1) * _tile, _samples);
+        size_t j1 = std::min((tj + 1) * _tile, _samples);
+        if (j1 <= ti * _tile + 1) return;   // only the diagonal of a 1 sample tile
+        Coordinates chunk(2), at(2);
+        chunk[0] = _first + ti * _tile;
+        chunk[1] = _first + tj * _tile;
+        Value value;
+        for (AttributeID a = 0; a < 5; ++a) {
+            int flags = ChunkIterator::SEQUENTIAL_WRITE;
+            if (a > 0) flags |= ChunkIterator::NO_EMPTY_CHECK;
+            boost::shared_ptr<ArrayIterator> chunks = output->getIterator(a);
+            boost::shared_ptr<ChunkIterator> cells = chunks->newChunk(chunk).getIterator(query, flags);
+            for (size_t i = ti * _tile; i < i1; ++i) {
+                for (size_t j = std::max(tj * _tile, i + 1); j < j1; ++j) {
+                    ibs_counts const& c = acc.counts(i, j);
+                    at[0] = _first + i;
+                    at[1] = _first + j;
+                    cells->setPosition(at);
+                    switch (a) {
+                    case 0: value.setUint32(c.n); break;
+                    case 1: value.setUint32(c.ibs0); break;
+                    case 2: value.setUint32(c.ibs1()); break;
+                    case 3: value.setUint32(c.ibs2); break;
+                    default:
+                        if (c.het1 + c.het2 == 0) value.setNull();
+                        else value.setDouble(c.kinship());
+                        break;
+                    }
+                    cells->writeItem(value);
+                }
+            }
+            cells->flush();
+        }
+    }
+
+    Coordinate _first;
+    size_t _samples;
+    size_t _tile;
+};
+
+DECLARE_PHYSICAL_OPERATOR_FACTORY(PhysicalKinship, "kinship", "PhysicalKinship");
+
+} // namespace scidb
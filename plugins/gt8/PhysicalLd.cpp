@@ -0,0 +1,209 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file PhysicalLd.cpp
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Physical implementation of ld, see LogicalLd.cpp.  Every local
+ * chunk of the input, with its overlap, is packed into the ld_bits of
+ * each variant and population, and each variant in the chunk proper is
+ * paired with those after it within the window.  The output is written
+ * on the instance which holds the chunk of the first variant.
+ */
+
+#include <algorithm>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "query/Operator.h"
+#include "array/MemArray.h"
+
+#include "ld.h"
+
+namespace scidb
+{
+
+class PhysicalLd : public PhysicalOperator
+{
+public:
+    PhysicalLd(const std::string& logicalName, const std::string& physicalName,
+               const Parameters& parameters, const ArrayDesc& schema)
+        : PhysicalOperator(logicalName, physicalName, parameters, schema)
+    {
+    }
+
+    virtual bool changesDistribution(const std::vector<ArrayDesc>& inputSchemas) const
+    {
+        return true;
+    }
+
+    virtual ArrayDistribution getOutputDistribution(const std::vector<ArrayDistribution>& inputDistributions,
+                                                    const std::vector<ArrayDesc>& inputSchemas) const
+    {
+        return ArrayDistribution(psUndefined);
+    }
+
+    boost::shared_ptr<Array> execute(std::vector<boost::shared_ptr<Array> >& inputArrays, boost::shared_ptr<Query> query)
+    {
+        _window = ((boost::shared_ptr<OperatorParamPhysicalExpression>&)_parameters[0])->getExpression()->evaluate().getInt64();
+        _min_r2 = 0;
+        if (_parameters.size() > 1)
+            _min_r2 = ((boost::shared_ptr<OperatorParamPhysicalExpression>&)_parameters[1])->getExpression()->evaluate().getDouble();
+        Dimensions const& dims = inputArrays[0]->getArrayDesc().getDimensions();
+        _starts.assign(1, dims[3].getStartMin());
+        if (_parameters.size() > 2) {
+            std::string pops = ((boost::shared_ptr<OperatorParamPhysicalExpression>&)_parameters[2])->getExpression()->evaluate().getString();
+            ld_parse_populations(pops, _starts);
+        }
+
+        boost::shared_ptr<MemArray> output(new MemArray(_schema, query));
+        boost::shared_ptr<ConstArrayIterator> chunks = inputArrays[0]->getConstIterator(0);
+        for (; !chunks->end(); ++(*chunks)) {
+            ConstChunk const& chunk = chunks->getChunk();
+            load_sites(chunk);
+            pair_sites(chunk.getFirstPosition(false)[1], chunk.getLastPosition(false)[1]);
+            write_cells(output, query);
+        }
+        return output;
+    }
+
+private:
+    // A variant, its calls in each population
+    struct ld_site {
+        Coordinate chromid;
+        Coordinate pos;
+        Coordinate var;
+        std::vector<ld_bits> pops;
+    };
+
+    struct ld_cell {
+        Coordinates coords;
+        ld_result ld;
+    };
+
+    void load_sites(ConstChunk const& chunk)
+    {
+        Coordinate last_sampleid = chunk.getLastPosition(true)[3];
+        _sites.clear();
+        boost::shared_ptr<ConstChunkIterator> cells = chunk.getConstIterator(ConstChunkIterator::IGNORE_EMPTY_CELLS);
+        for (; !cells->end(); ++(*cells)) {
+            Coordinates const& at = cells->getPosition();
+            if (_sites.empty() || (_sites.back().pos != at[1]) || (_sites.back().var != at[2])) {
+                _sites.push_back(ld_site());
+                ld_site& site = _sites.back();
+                site.chromid = at[0];
+                site.pos = at[1];
+                site.var = at[2];
+                site.pops.resize(_starts.size());
+                for (size_t p = 0; p < _starts.size(); ++p) {
+                    Coordinate end = (p + 1 < _starts.size()) ? _starts[p + 1] : last_sampleid + 1;
+                    site.pops[p].reset(std::max<Coordinate>(end - _starts[p], 0));
+                }
+            }
+            Value const& v = cells->getItem();
+            if (v.isNull() || (at[3] < _starts[0])) continue;
+            size_t p = std::upper_bound(_starts.begin(), _starts.end(), at[3]) - _starts.begin() - 1;
+            _sites.back().pops[p].set(at[3] - _starts[p], *static_cast<gt8_t const*>(v.data()));
+        }
+    }
+
+    // Pairs of a variant in [first, last] of pos, and one after it within the window
+    void pair_sites(Coordinate first, Coordinate last)
+    {
+        _cells.clear();
+        ld_cell cell;
+        cell.coords.resize(6);
+        for (size_t i = 0; i < _sites.size(); ++i) {
+            ld_site const& x = _sites[i];
+            if ((x.pos < first) || (x.pos > last)) continue;
+            for (size_t j = i + 1; (j < _sites.size()) && (_sites[j].pos - x.pos <= _window); ++j) {
+                ld_site const& y = _sites[j];
+                for (size_t p = 0; p < _starts.size(); ++p) {
+                    if (!ld_pair(x.pops[p], y.pops[p], cell.ld) || (cell.ld.r2 < _min_r2)) continue;
+                    cell.coords[0] = x.chromid;
+                    cell.coords[1] = x.pos;
+                    cell.coords[2] = x.var;
+                    cell.coords[3] = y.pos;
+                    cell.coords[4] = y.var;
+                    cell.coords[5] = p;
+                    _cells.push_back(cell);
+                }
+            }
+        }
+    }
+
+    // The cells are in row-major order within each output chunk
+    void write_cells(boost::shared_ptr<MemArray>& output, boost::shared_ptr<Query>& query)
+    {
+        if (_cells.empty()) return;
+        ArrayDesc const& desc = output->getArrayDesc();
+        std::vector<std::pair<Coordinates, size_t> > order(_cells.size());
+        for (size_t i = 0; i < _cells.size(); ++i) {
+            order[i].first = _cells[i].coords;
+            desc.getChunkPositionFor(order[i].first);
+            order[i].second = i;
+        }
+        std::sort(order.begin(), order.end());
+
+        size_t nattrs = desc.getAttributes(true).size();
+        for (size_t begin = 0; begin < order.size(); ) {
+            size_t end = begin;
+            while ((end < order.size()) && (order[end].first == order[begin].first)) ++end;
+            for (AttributeID a = 0; a < nattrs; ++a) {
+                boost::shared_ptr<ArrayIterator> chunks = output->getIterator(a);
+                Chunk& chunk = chunks->newChunk(order[begin].first);
+                int flags = ChunkIterator::SEQUENTIAL_WRITE;
+                if (a > 0) flags |= ChunkIterator::NO_EMPTY_CHECK;
+                boost::shared_ptr<ChunkIterator> cells = chunk.getIterator(query, flags);
+                Value value;
+                for (size_t k = begin; k < end; ++k) {
+                    ld_cell const& cell = _cells[order[k].second];
+                    cells->setPosition(cell.coords);
+                    if (a == 0) value.setDouble(cell.ld.r2);
+                    else if (a == 1) value.setDouble(cell.ld.dprime);
+                    else value.setUint32(cell.ld.n);
+                    cells->writeItem(value);
+                }
+                cells->flush();
+            }
+            begin = end;
+        }
+    }
+
+    int64_t _window;
+    double _min_r2;
+    std::vector<int64_t> _starts;
+    std::vector<ld_site> _sites;
+    std::vector<ld_cell> _cells;
+};
+
+DECLARE_PHYSICAL_OPERATOR_FACTORY(PhysicalLd, "ld", "PhysicalLd");
+
+} // namespace scidb
@@ -0,0 +1,372 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file PhysicalPbwt.cpp
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Physical implementations of pbwt_decode and pbwt_match, see
+ * LogicalPbwt.cpp.  Each instance decodes the chunks it holds, variant by
+ * variant, and writes its results.
+ */
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "query/Operator.h"
+#include "array/MemArray.h"
+#include "system/Exceptions.h"
+
+#include "pbwt.h"
+
+namespace scidb
+{
+
+/*
+ * Decodes the variants of the chunks of a PBWT array in order, giving
+ * the allele code of each haplotype and the calls which are not phased
+ * diploid, by sampleid.
+ */
+class PbwtChunkDecoder
+{
+public:
+    PbwtChunkDecoder(int64_t interval) : _interval(interval), _started(false) {}
+
+    struct variant {
+        Coordinate chromid;
+        Coordinate pos;
+        Coordinate var;
+        std::vector<uint8_t> codes;                         // by haplotype
+        std::vector<std::pair<Coordinate, gt8_t> > calls;   // ascending sampleid
+    };
+
+    // Call visit(variant) for each variant of a chunk of codes and the matching chunk of lengths
+    template <typename Visit>
+    void decode(ConstChunk const& codes, ConstChunk const& lengths, Visit& visit)
+    {
+        int flags = ConstChunkIterator::IGNORE_EMPTY_CELLS | ConstChunkIterator::IGNORE_OVERLAPS;
+        boost::shared_ptr<ConstChunkIterator> c = codes.getConstIterator(flags);
+        boost::shared_ptr<ConstChunkIterator> l = lengths.getConstIterator(flags);
+        bool open = false;
+        for (; !c->end(); ++(*c), ++(*l)) {
+            Coordinates const& at = c->getPosition();
+            if (!open || (at[0] != _variant.chromid) || (at[1] != _variant.pos) || (at[2] != _variant.var)) {
+                if (open) finish(visit);
+                open = true;
+                _variant.chromid = at[0];
+                _variant.pos = at[1];
+                _variant.var = at[2];
+                _variant.calls.clear();
+                _runs.clear();
+            }
+            uint8_t code = c->getItem().getUint8();
+            uint32_t length = l->getItem().getUint32();
+            if (at[3] < 0) {
+                _variant.calls.push_back(std::make_pair((Coordinate)length, (gt8_t)code));
+            } else {
+                pbwt_run r = { code, length };
+                _runs.push_back(r);
+            }
+        }
+        if (open) finish(visit);
+    }
+
+private:
+    template <typename Visit>
+    void finish(Visit& visit)
+    {
+        size_t haplotypes = 0;
+        for (size_t r = 0; r < _runs.size(); ++r) haplotypes += _runs[r].length;
+        int64_t chunk = (_variant.pos > 0) ? (_variant.pos - 1) / _interval : 0;
+        if (!_started || (_variant.chromid != _chromid) || (chunk != _chunk)) {
+            _order.reset(haplotypes);
+            _started = true;
+            _chromid = _variant.chromid;
+            _chunk = chunk;
+        }
+        _variant.codes.resize(haplotypes);
+        if (_runs.empty() || !_order.decode(&_runs[0], _runs.size(), &_variant.codes[0]))
+            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_ILLEGAL_OPERATION)
+                << "the PBWT runs of a variant do not cover its haplotypes, is the input chunked as loaded?";
+        // The negative runs are in descending sampleid
+        std::reverse(_variant.calls.begin(), _variant.calls.end());
+        visit(_variant);
+    }
+
+    int64_t _interval;
+    bool _started;
+    Coordinate _chromid;
+    int64_t _chunk;
+    variant _variant;
+    std::vector<pbwt_run> _runs;
+    pbwt_order _order;
+};
+
+class PhysicalPbwtDecode : public PhysicalOperator
+{
+public:
+    PhysicalPbwtDecode(const std::string& logicalName, const std::string& physicalName,
+                       const Parameters& parameters, const ArrayDesc& schema)
+        : PhysicalOperator(logicalName, physicalName, parameters, schema)
+    {
+    }
+
+    virtual bool changesDistribution(const std::vector<ArrayDesc>& inputSchemas) const
+    {
+        return true;
+    }
+
+    virtual ArrayDistribution getOutputDistribution(const std::vector<ArrayDistribution>& inputDistributions,
+                                                    const std::vector<ArrayDesc>& inputSchemas) const
+    {
+        return ArrayDistribution(psUndefined);
+    }
+
+    boost::shared_ptr<Array> execute(std::vector<boost::shared_ptr<Array> >& inputArrays, boost::shared_ptr<Query> query)
+    {
+        _region = _parameters.size() == 3;
+        if (_region) {
+            _chromid = param(0);
+            _start = param(1);
+            _end = param(2);
+        }
+        _samples = _schema.getDimensions()[3].getEndMax() + 1;
+        PbwtChunkDecoder decoder(inputArrays[0]->getArrayDesc().getDimensions()[1].getChunkInterval());
+
+        _output.reset(new MemArray(_schema, query));
+        _query = query;
+        boost::shared_ptr<ConstArrayIterator> codes = inputArrays[0]->getConstIterator(0);
+        boost::shared_ptr<ConstArrayIterator> lengths = inputArrays[0]->getConstIterator(1);
+        for (; !codes->end(); ++(*codes), ++(*lengths)) {
+            ConstChunk const& chunk = codes->getChunk();
+            if (_region) {
+                // Only the chunks overlapping the region are decoded
+                Coordinates const& first = chunk.getFirstPosition(false);
+                Coordinates const& last = chunk.getLastPosition(false);
+                if ((_chromid < first[0]) || (_chromid > last[0]) || (_end < first[1]) || (_start > last[1])) continue;
+            }
+            decoder.decode(chunk, lengths->getChunk(), *this);
+            if (_cells) {
+                _cells->flush();
+                _cells.reset();
+            }
+        }
+        _query.reset();
+        return _output;
+    }
+
+    // Write the calls of a variant into the output chunk of its input chunk
+    void operator()(PbwtChunkDecoder::variant const& v)
+    {
+        if (_region && ((v.chromid != _chromid) || (v.pos < _start) || (v.pos > _end))) return;
+        Coordinates at(4);
+        at[0] = v.chromid;
+        at[1] = v.pos;
+        at[2] = v.var;
+        size_t samples = std::min<size_t>(v.codes.size() / 2, _samples);
+        size_t k = 0;
+        Value value;
+        for (size_t s = 0; s < samples; ++s) {
+            while ((k < v.calls.size()) && (v.calls[k].first < (Coordinate)s)) ++k;
+            gt8_t g;
+            if ((k < v.calls.size()) && (v.calls[k].first == (Coordinate)s)) g = v.calls[k].second;
+            else if ((v.codes[2 * s] != 0) || (v.codes[2 * s + 1] != 0)) g = pbwt_call(v.codes[2 * s], v.codes[2 * s + 1]);
+            else continue;
+            at[3] = s;
+            if (!_cells) {
+                Coordinates chunk = at;
+                _schema.getChunkPositionFor(chunk);
+                boost::shared_ptr<ArrayIterator> chunks = _output->getIterator(0);
+                _cells = chunks->newChunk(chunk).getIterator(_query, ChunkIterator::SEQUENTIAL_WRITE);
+            }
+            _cells->setPosition(at);
+            value.setData(&g, sizeof(g));
+            _cells->writeItem(value);
+        }
+    }
+
+private:
+    int64_t param(size_t i)
+    {
+        return ((boost::shared_ptr<OperatorParamPhysicalExpression>&)_parameters[i])->getExpression()->evaluate().getInt64();
+    }
+
+    bool _region;
+    Coordinate _chromid;
+    Coordinate _start;
+    Coordinate _end;
+    size_t _samples;
+    boost::shared_ptr<MemArray> _output;
+    boost::shared_ptr<Query> _query;
+    boost::shared_ptr<ChunkIterator> _cells;
+};
+
+class PhysicalPbwtMatch : public PhysicalOperator
+{
+public:
+    PhysicalPbwtMatch(const std::string& logicalName, const std::string& physicalName,
+                      const Parameters& parameters, const ArrayDesc& schema)
+        : PhysicalOperator(logicalName, physicalName, parameters, schema)
+    {
+    }
+
+    virtual bool changesDistribution(const std::vector<ArrayDesc>& inputSchemas) const
+    {
+        return true;
+    }
+
+    virtual ArrayDistribution getOutputDistribution(const std::vector<ArrayDistribution>& inputDistributions,
+                                                    const std::vector<ArrayDesc>& inputSchemas) const
+    {
+        return ArrayDistribution(psUndefined);
+    }
+
+    boost::shared_ptr<Array> execute(std::vector<boost::shared_ptr<Array> >& inputArrays, boost::shared_ptr<Query> query)
+    {
+        _haplotype = param(0);
+        _min_sites = param(1);
+        PbwtChunkDecoder decoder((_parameters.size() > 2) ? param(2) : PBWT_CHUNK);
+
+        boost::shared_ptr<MemArray> output(new MemArray(_schema, query));
+        boost::shared_ptr<ConstArrayIterator> codes = inputArrays[0]->getConstIterator(0);
+        boost::shared_ptr<ConstArrayIterator> lengths = inputArrays[0]->getConstIterator(1);
+        for (; !codes->end(); ++(*codes), ++(*lengths)) {
+            decoder.decode(codes->getChunk(), lengths->getChunk(), *this);
+            finish();
+            write_cells(output, query);
+        }
+        return output;
+    }
+
+    // Add a variant to the matches of its chromosome
+    void operator()(PbwtChunkDecoder::variant const& v)
+    {
+        if (_matcher && (v.chromid != _chromid)) finish();
+        if (!_matcher) {
+            if ((size_t)_haplotype >= v.codes.size())
+                throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_ILLEGAL_OPERATION)
+                    << "pbwt_match haplotype is not in the PBWT";
+            _matcher.reset(new pbwt_matcher(v.codes.size(), _haplotype, _min_sites));
+            _chromid = v.chromid;
+            _haplotypes = v.codes.size();
+            _sites.clear();
+        }
+        if (v.codes.size() != _haplotypes)
+            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_ILLEGAL_OPERATION)
+                << "pbwt_match needs the same haplotypes at every variant of a chromosome";
+        _sites.push_back(v.pos);
+        _matcher->next_site(&v.codes[0], _matches);
+    }
+
+private:
+    struct match_cell {
+        Coordinates coords;
+        Coordinate end;
+        uint64_t sites;
+    };
+
+    int64_t param(size_t i)
+    {
+        return ((boost::shared_ptr<OperatorParamPhysicalExpression>&)_parameters[i])->getExpression()->evaluate().getInt64();
+    }
+
+    // The matches of the current chromosome, as cells
+    void finish()
+    {
+        if (!_matcher) return;
+        _matcher->finish(_matches);
+        match_cell cell;
+        cell.coords.resize(3);
+        for (size_t i = 0; i < _matches.size(); ++i) {
+            pbwt_match const& m = _matches[i];
+            cell.coords[0] = _chromid;
+            cell.coords[1] = _sites[m.first];
+            cell.coords[2] = m.haplotype;
+            cell.end = _sites[m.last];
+            cell.sites = m.last - m.first + 1;
+            _cells.push_back(cell);
+        }
+        _matches.clear();
+        _matcher.reset();
+    }
+
+    // The matches are found by their end, so they are sorted by chunk, then cell
+    void write_cells(boost::shared_ptr<MemArray>& output, boost::shared_ptr<Query>& query)
+    {
+        if (_cells.empty()) return;
+        ArrayDesc const& desc = output->getArrayDesc();
+        std::vector<std::pair<std::pair<Coordinates, Coordinates>, size_t> > order(_cells.size());
+        for (size_t i = 0; i < _cells.size(); ++i) {
+            order[i].first.first = _cells[i].coords;
+            desc.getChunkPositionFor(order[i].first.first);
+            order[i].first.second = _cells[i].coords;
+            order[i].second = i;
+        }
+        std::sort(order.begin(), order.end());
+
+        for (size_t begin = 0; begin < order.size(); ) {
+            size_t end = begin;
+            while ((end < order.size()) && (order[end].first.first == order[begin].first.first)) ++end;
+            for (AttributeID a = 0; a < 2; ++a) {
+                boost::shared_ptr<ArrayIterator> chunks = output->getIterator(a);
+                Chunk& chunk = chunks->newChunk(order[begin].first.first);
+                int flags = ChunkIterator::SEQUENTIAL_WRITE;
+                if (a > 0) flags |= ChunkIterator::NO_EMPTY_CHECK;
+                boost::shared_ptr<ChunkIterator> cells = chunk.getIterator(query, flags);
+                Value value;
+                for (size_t k = begin; k < end; ++k) {
+                    match_cell const& cell = _cells[order[k].second];
+                    cells->setPosition(cell.coords);
+                    if (a == 0) value.setInt64(cell.end);
+                    else value.setUint64(cell.sites);
+                    cells->writeItem(value);
+                }
+                cells->flush();
+            }
+            begin = end;
+        }
+        _cells.clear();
+    }
+
+    int64_t _haplotype;
+    int64_t _min_sites;
+    Coordinate _chromid;
+    size_t _haplotypes;
+    boost::shared_ptr<pbwt_matcher> _matcher;
+    std::vector<Coordinate> _sites;     // pos of each site of the chromosome
+    std::vector<pbwt_match> _matches;
+    std::vector<match_cell> _cells;
+};
+
+DECLARE_PHYSICAL_OPERATOR_FACTORY(PhysicalPbwtDecode, "pbwt_decode", "PhysicalPbwtDecode");
+DECLARE_PHYSICAL_OPERATOR_FACTORY(PhysicalPbwtMatch, "pbwt_match", "PhysicalPbwtMatch");
+
+} // namespace scidb
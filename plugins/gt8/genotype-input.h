@@ -0,0 +1,68 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file genotype-input.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Schema checks shared by the operators which read a genotype
+ * array, [chromid, pos, var, sampleid] with a gt8 first attribute, and
+ * need all the samples of a variant in one chunk.  Include after the
+ * SciDB headers.
+ */
+
+#ifndef GENOTYPE_INPUT_H
+#define GENOTYPE_INPUT_H
+
+#include <string>
+
+namespace scidb
+{
+
+// The sampleid dimension of the genotype array input of the operator op
+inline DimensionDesc const& gt_sample_dimension(ArrayDesc const& input, std::string const& op)
+{
+    Dimensions const& dims = input.getDimensions();
+    if (dims.size() != 4)
+        throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+            << (op + " needs an array of [chromid, pos, var, sampleid]");
+    if (input.getAttributes(true)[0].getType() != "gt8")
+        throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+            << (op + " needs a gt8 first attribute");
+    DimensionDesc const& samples = dims[3];
+    if ((samples.getEndMax() == MAX_COORDINATE) ||
+        (samples.getChunkInterval() < samples.getEndMax() - samples.getStartMin() + 1))
+        throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+            << (op + " needs sampleid bounded and in a single chunk");
+    return samples;
+}
+
+} // namespace scidb
+
+#endif // ! GENOTYPE_INPUT_H
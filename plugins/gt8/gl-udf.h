@@ -0,0 +1,138 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file gl-udf.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief User defined functions of the gl type, written against the
+ * scidb::Value calling convention.  Include it exactly once per binary,
+ * after gt8-udf.h.  A gl value which does not match its header, such as
+ * the empty value written for a call without likelihoods, gives null.
+ *
+ */
+
+#ifndef GL_UDF_H
+#define GL_UDF_H
+
+#include <string>
+#include "gl.h"
+
+enum {
+  GT8_E_CANT_CONVERT_TO_GL = SCIDB_USER_ERROR_CODE_START + 1
+};
+
+inline uint8_t const* gl_data(const scidb::Value* v) { return static_cast<uint8_t const*>(v->data()); }
+
+inline bool gl_valid(const scidb::Value* v) { return gl_valid(gl_data(v), v->size()); }
+
+void gl_fromString(const scidb::Value** args, scidb::Value* res, void*)
+{
+    const char* s = args[0]->getString();
+    size_t len = strlen(s);
+    std::string buf(gl_encoded_size(s, len), '\0');
+    size_t size = gl_parse(s, len, reinterpret_cast<uint8_t*>(&buf[0]));
+    if (size == 0)
+        throw PLUGIN_USER_EXCEPTION("libgt8", scidb::SCIDB_SE_UDO,
+                                    GT8_E_CANT_CONVERT_TO_GL) << s;
+    res->setData(buf.data(), size);
+}
+
+void gl_toString(const scidb::Value** args, scidb::Value* res, void*)
+{
+    std::string s;
+    gl_format(gl_data(args[0]), args[0]->size(), s);
+    res->setString(s.c_str());
+}
+
+// Likelihood of genotype i, in the order of PL
+void gl_pl(const scidb::Value** args, scidb::Value* res, void*)
+{
+    int64_t i = args[1]->getInt64();
+    if (!gl_valid(args[0]) || (i < 0) || ((size_t)i + 1 >= args[0]->size()))
+        res->setNull();
+    else
+        res->setUint8(gl_data(args[0])[i + 1]);
+}
+
+// Phred scaled confidence in the most likely genotype, as GQ
+void gl_genotypeQuality(const scidb::Value** args, scidb::Value* res, void*)
+{
+    if (gl_valid(args[0]))
+        res->setUint8(gl_gq(gl_data(args[0]), args[0]->size()));
+    else
+        res->setNull();
+}
+
+// Most likely genotype, null if its alleles do not fit in a gt8
+void gl_bestGt(const scidb::Value** args, scidb::Value* res, void*)
+{
+    gt8_t g;
+    if (gl_best_gt8(gl_data(args[0]), args[0]->size(), g))
+        res->setData(&g, sizeof(g));
+    else
+        res->setNull();
+}
+
+// Posterior dosage with a flat prior
+void gl_dosageFlat(const scidb::Value** args, scidb::Value* res, void*)
+{
+    if (gl_valid(args[0]))
+        res->setDouble(gl_dosage(gl_data(args[0]), args[0]->size(), -1));
+    else
+        res->setNull();
+}
+
+// Posterior dosage with a Hardy-Weinberg prior of alternate frequency af
+void gl_dosagePrior(const scidb::Value** args, scidb::Value* res, void*)
+{
+    double af = args[1]->getDouble();
+    if (gl_valid(args[0]) && (af >= 0) && (af <= 1))
+        res->setDouble(gl_dosage(gl_data(args[0]), args[0]->size(), af));
+    else
+        res->setNull();
+}
+
+void gl_ploidyOf(const scidb::Value** args, scidb::Value* res, void*)
+{
+    if (gl_valid(args[0]))
+        res->setUint8(gl_ploidy(gl_data(args[0])));
+    else
+        res->setNull();
+}
+
+void gl_numAlleles(const scidb::Value** args, scidb::Value* res, void*)
+{
+    if (gl_valid(args[0]))
+        res->setUint32(gl_alleles(gl_data(args[0])));
+    else
+        res->setNull();
+}
+
+#endif // ! GL_UDF_H
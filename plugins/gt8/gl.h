@@ -0,0 +1,306 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file gl.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Codec and kernels for the gl type, the genotype likelihoods of
+ * a call as in the PL FORMAT field.  Has no SciDB dependencies, so it is
+ * shared by the plugin and the loaders.
+ *
+ * Layout of a gl value:
+ *   header byte: 0x80 set if diploid, the low 7 bits are alleles - 1
+ *   then one byte for each genotype, its phred scaled likelihood capped
+ *   at 255, in the order of PL: for diploid a/b (a <= b) at b(b+1)/2 + a
+ *
+ * So a biallelic diploid call takes 4 bytes.  GL (log10) likelihoods are
+ * scaled by -10 and shifted so the most likely genotype is 0, like PL.
+ */
+
+#ifndef GL_H
+#define GL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "gt8.h"
+
+#define GL_DIPLOID 0x80
+#define GL_MAX_ALLELES 128
+#define GL_MAX_PL 255
+// GQ is capped as the callers cap it
+#define GL_MAX_GQ 99
+
+inline size_t gl_genotypes(unsigned ploidy, unsigned alleles)
+{
+    return (ploidy == 1) ? alleles : alleles * (alleles + 1) / 2;
+}
+
+inline unsigned gl_ploidy(uint8_t const* d) { return (d[0] & GL_DIPLOID) ? 2 : 1; }
+
+inline unsigned gl_alleles(uint8_t const* d) { return (d[0] & 0x7F) + 1; }
+
+// True iff size matches the header, anything else is taken as missing
+inline bool gl_valid(uint8_t const* d, size_t size)
+{
+    return (size > 0) && (size == 1 + gl_genotypes(gl_ploidy(d), gl_alleles(d)));
+}
+
+// Index of the diploid genotype a/b
+inline size_t gl_index(unsigned a, unsigned b)
+{
+    if (a > b) std::swap(a, b);
+    return b * (b + 1) / 2 + a;
+}
+
+// The ploidy and alleles of n likelihoods, given the alleles of the
+// variant if known (else 0) and the ploidy of the call if known (else 0)
+inline bool gl_shape(size_t n, unsigned alleles, unsigned ploidy_hint, unsigned& ploidy, unsigned& nalleles)
+{
+    if (alleles == 0) {
+        // Any triangular number of likelihoods is taken as diploid
+        unsigned k = 1;
+        while (gl_genotypes(2, k) < n) ++k;
+        bool dip = (gl_genotypes(2, k) == n);
+        ploidy = (dip && (ploidy_hint != 1)) ? 2 : 1;
+        nalleles = (ploidy == 2) ? k : n;
+    } else {
+        bool hap = (n == alleles);
+        bool dip = (n == gl_genotypes(2, alleles));
+        if (hap && dip) ploidy = (ploidy_hint == 1) ? 1 : 2;
+        else if (hap) ploidy = 1;
+        else if (dip) ploidy = 2;
+        else return false;
+        nalleles = alleles;
+    }
+    return (nalleles > 0) && (nalleles <= GL_MAX_ALLELES);
+}
+
+// One number of a comma separated list at p, PL as an integer or GL as
+// a decimal, "." for missing; returns the end, or NULL if malformed
+inline char const* gl_parse_number(char const* p, char const* end, double& v, bool& missing)
+{
+    missing = false;
+    if ((p < end) && (*p == '.') && ((p + 1 == end) || (p[1] == ','))) {
+        missing = true;
+        return p + 1;
+    }
+    bool neg = (p < end) && (*p == '-');
+    if (neg || ((p < end) && (*p == '+'))) ++p;
+    size_t digits = 0;
+    v = 0;
+    for (; (p < end) && (*p >= '0') && (*p <= '9'); ++p, ++digits) v = v * 10 + (*p - '0');
+    if ((p < end) && (*p == '.')) {
+        double scale = 0.1;
+        for (++p; (p < end) && (*p >= '0') && (*p <= '9'); ++p, ++digits, scale /= 10) v += (*p - '0') * scale;
+    }
+    if (digits == 0) return NULL;
+    if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+        ++p;
+        bool eneg = (p < end) && (*p == '-');
+        if (eneg || ((p < end) && (*p == '+'))) ++p;
+        int e = 0;
+        char const* edigits = p;
+        for (; (p < end) && (*p >= '0') && (*p <= '9'); ++p) e = e * 10 + (*p - '0');
+        if (p == edigits) return NULL;
+        v *= pow(10.0, eneg ? -e : e);
+    }
+    if (neg) v = -v;
+    if ((p < end) && (*p != ',')) return NULL;
+    return p;
+}
+
+// Encoded size of the likelihoods in s at most
+inline size_t gl_encoded_size(char const* s, size_t len)
+{
+    return 1 + gt8_num_csv(s, len);
+}
+
+// Encode the PL (or GL if log10) values in s, out holds gl_encoded_size
+// bytes; returns the size, 0 if s is missing, malformed or does not fit
+// the number of alleles and ploidy, which may be 0 if not known
+inline size_t gl_encode(char const* s, size_t len, bool log10, unsigned alleles, unsigned ploidy_hint,
+                        uint8_t* out)
+{
+    if ((len == 0) || ((len == 1) && (s[0] == '.'))) return 0;
+    char const* end = s + len;
+    // PL are written as they are, GL shifted by their maximum
+    double top = -HUGE_VAL;
+    size_t n = 0;
+    for (char const* p = s; ; ++p) {
+        double v = 0;
+        bool missing;
+        p = gl_parse_number(p, end, v, missing);
+        if (p == NULL) return 0;
+        if (!missing && log10 && (v > top)) top = v;
+        ++n;
+        if (p == end) break;
+    }
+    unsigned ploidy, nalleles;
+    if (!gl_shape(n, alleles, ploidy_hint, ploidy, nalleles)) return 0;
+    out[0] = ((ploidy == 2) ? GL_DIPLOID : 0) | (nalleles - 1);
+    size_t i = 1;
+    for (char const* p = s; ; ++p) {
+        double v = 0;
+        bool missing;
+        p = gl_parse_number(p, end, v, missing);
+        if (log10) v = -10 * (v - top);
+        if (missing || (v >= GL_MAX_PL)) out[i++] = GL_MAX_PL;
+        else out[i++] = (v <= 0) ? 0 : (uint8_t)(v + 0.5);
+        if (p == end) break;
+    }
+    return i;
+}
+
+// Text form, the PL values separated by commas, "1:" first if haploid
+inline void gl_format(uint8_t const* d, size_t size, std::string& out)
+{
+    out.clear();
+    if (!gl_valid(d, size)) return;
+    if (gl_ploidy(d) == 1) out.append("1:");
+    char num[8];
+    for (size_t i = 1; i < size; ++i) {
+        if (i > 1) out.push_back(',');
+        out.append(num, gt8_format_uint(d[i], num));
+    }
+}
+
+// Parse the text form, "1:" or "2:" first to set the ploidy, else
+// diploid if the number of values allows it
+inline size_t gl_parse(char const* s, size_t len, uint8_t* out)
+{
+    unsigned ploidy = 0;
+    if ((len >= 2) && ((s[0] == '1') || (s[0] == '2')) && (s[1] == ':')) {
+        ploidy = s[0] - '0';
+        s += 2;
+        len -= 2;
+    }
+    size_t size = gl_encode(s, len, false, 0, ploidy, out);
+    if ((size > 0) && (ploidy == 2) && (gl_ploidy(out) != 2)) return 0;
+    return size;
+}
+
+// The genotype with the lowest likelihood, the first of any ties
+inline size_t gl_best(uint8_t const* d, size_t size)
+{
+    size_t best = 1;
+    for (size_t i = 2; i < size; ++i) {
+        if (d[i] < d[best]) best = i;
+    }
+    return best - 1;
+}
+
+// Alleles of genotype i of a diploid gl
+inline void gl_diploid_alleles(size_t i, unsigned& a, unsigned& b)
+{
+    b = 0;
+    while ((b + 1) * (b + 2) / 2 <= i) ++b;
+    a = i - b * (b + 1) / 2;
+}
+
+// Most likely genotype as an unphased gt8, false if it does not fit
+inline bool gl_best_gt8(uint8_t const* d, size_t size, gt8_t& g)
+{
+    if (!gl_valid(d, size)) return false;
+    size_t best = gl_best(d, size);
+    if (gl_ploidy(d) == 1) {
+        if (best + 1 >= GT8_DIPLOID) return false;
+        g = best + 1;
+        return true;
+    }
+    unsigned a, b;
+    gl_diploid_alleles(best, a, b);
+    if (b + 1 > 7) return false;
+    g = GT8_DIPLOID | ((a + 1) << 3) | (b + 1);
+    return true;
+}
+
+// Phred scaled confidence in the most likely genotype: the difference
+// to the next most likely, capped at GL_MAX_GQ
+inline uint8_t gl_gq(uint8_t const* d, size_t size)
+{
+    unsigned first = GL_MAX_PL + 1, second = GL_MAX_PL + 1;
+    for (size_t i = 1; i < size; ++i) {
+        if (d[i] < first) {
+            second = first;
+            first = d[i];
+        } else if (d[i] < second) {
+            second = d[i];
+        }
+    }
+    if (second > GL_MAX_PL) return GL_MAX_GQ;
+    return (second - first < GL_MAX_GQ) ? second - first : GL_MAX_GQ;
+}
+
+// Likelihood of a phred scaled value
+inline double gl_probability(uint8_t pl)
+{
+    static struct table {
+        double p[GL_MAX_PL + 1];
+        table() { for (int i = 0; i <= GL_MAX_PL; ++i) p[i] = pow(10.0, -i / 10.0); }
+    } const t;
+    return t.p[pl];
+}
+
+// Expected number of alternate alleles, of any alt, over the posterior
+// of the genotypes.  With af < 0 the prior is flat, else it is Hardy-
+// Weinberg with af the frequency of all the alternates, shared evenly.
+inline double gl_dosage(uint8_t const* d, size_t size, double af)
+{
+    unsigned alleles = gl_alleles(d);
+    bool flat = (af < 0) || (alleles < 2);
+    double p_ref = flat ? 1 : 1 - af;
+    double p_alt = flat ? 1 : af / (alleles - 1);
+    double total = 0, alt = 0;
+    if (gl_ploidy(d) == 1) {
+        for (unsigned a = 0; a < alleles; ++a) {
+            double w = gl_probability(d[1 + a]) * (a ? p_alt : p_ref);
+            total += w;
+            if (a) alt += w;
+        }
+    } else {
+        size_t i = 1;
+        for (unsigned b = 0; b < alleles; ++b) {
+            for (unsigned a = 0; a <= b; ++a, ++i) {
+                double w = gl_probability(d[i]);
+                if (!flat) w *= (a ? p_alt : p_ref) * (b ? p_alt : p_ref) * ((a == b) ? 1 : 2);
+                total += w;
+                alt += w * ((a > 0) + (b > 0));
+            }
+        }
+    }
+    return (total > 0) ? alt / total : NAN;
+}
+
+#endif // ! GL_H
@@ -0,0 +1,292 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file grm.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Kernels of the grm and pca operators.  Has no SciDB
+ * dependencies.
+ *
+ * The genetic relationship matrix is A = Z'Z / M over M variants, where
+ * Z holds the dosage of each sample standardized by the allele frequency
+ * p of the variant, (x - 2p) / sqrt(2p(1 - p)), and 0 when missing.
+ * Variants are added a block at a time; a block is standardized into a
+ * samples x variants buffer and its product accumulated one tile of
+ * sample pairs at a time, so the rows of both tiles stay in cache.  Only
+ * the upper triangle is accumulated.
+ *
+ * The top eigenvectors come from a randomized range finder (Halko,
+ * Martinsson and Tropp) with a few power iterations, and the Jacobi
+ * method on the small projected matrix.
+ */
+
+#ifndef GRM_H
+#define GRM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "gt8.h"
+
+// Sample pairs of a tile, and variants standardized at once
+#define GRM_TILE 64
+#define GRM_BLOCK 256
+
+class grm_accumulator {
+public:
+    explicit grm_accumulator(size_t samples)
+        : _samples(samples), _variants(0), _sums(samples * (samples + 1) / 2, 0.0),
+          _z(samples * GRM_BLOCK), _block(0), _dosage(samples * GRM_BLOCK, -1) {}
+
+    size_t samples() const { return _samples; }
+    uint64_t variants() const { return _variants; }
+
+    // Upper triangle of Z'Z with its diagonal, packed row by row
+    std::vector<double> const& sums() const { return _sums; }
+
+    // Add the sums of the same samples over other variants
+    void merge(double const* sums, uint64_t variants)
+    {
+        for (size_t i = 0; i < _sums.size(); ++i) _sums[i] += sums[i];
+        _variants += variants;
+    }
+
+    // Dosage of sample s at the variant being filled, -1 when missing
+    int8_t* next_variant()
+    {
+        if (_block == GRM_BLOCK) flush();
+        int8_t* row = &_dosage[_block * _samples];
+        std::fill(row, row + _samples, -1);
+        ++_block;
+        return row;
+    }
+
+    // Accumulate the variants filled so far
+    void flush()
+    {
+        size_t nv = 0;
+        for (size_t v = 0; v < _block; ++v) {
+            if (standardize(&_dosage[v * _samples], nv)) ++nv;
+        }
+        _block = 0;
+        if (nv == 0) return;
+        _variants += nv;
+        for (size_t i0 = 0; i0 < _samples; i0 += GRM_TILE) {
+            size_t i1 = std::min(i0 + GRM_TILE, _samples);
+            for (size_t j0 = i0; j0 < _samples; j0 += GRM_TILE) {
+                size_t j1 = std::min(j0 + GRM_TILE, _samples);
+                for (size_t i = i0; i < i1; ++i) {
+                    double const* zi = &_z[i * GRM_BLOCK];
+                    double* out = &_sums[index(i, i)];
+                    for (size_t j = std::max(i, j0); j < j1; ++j) {
+                        double const* zj = &_z[j * GRM_BLOCK];
+                        double dot = 0;
+                        for (size_t v = 0; v < nv; ++v) dot += zi[v] * zj[v];
+                        out[j - i] += dot;
+                    }
+                }
+            }
+        }
+    }
+
+    // The matrix, both triangles, divided by the variant count
+    void finish(std::vector<double>& grm)
+    {
+        flush();
+        grm.assign(_samples * _samples, 0.0);
+        if (_variants == 0) return;
+        for (size_t i = 0; i < _samples; ++i) {
+            for (size_t j = i; j < _samples; ++j) {
+                grm[i * _samples + j] = grm[j * _samples + i] = _sums[index(i, j)] / _variants;
+            }
+        }
+    }
+
+private:
+    // Offset of the pair i <= j in the packed triangle
+    size_t index(size_t i, size_t j) const { return i * (2 * _samples - i + 1) / 2 + j - i; }
+
+    // Column v of the samples x variants buffer, false if monomorphic
+    bool standardize(int8_t const* dosage, size_t v)
+    {
+        uint64_t sum = 0, called = 0;
+        for (size_t s = 0; s < _samples; ++s) {
+            if (dosage[s] < 0) continue;
+            sum += dosage[s];
+            ++called;
+        }
+        if (called == 0) return false;
+        double p = (double)sum / (2 * called);
+        if ((p <= 0) || (p >= 1)) return false;
+        double scale = 1 / std::sqrt(2 * p * (1 - p));
+        for (size_t s = 0; s < _samples; ++s)
+            _z[s * GRM_BLOCK + v] = (dosage[s] < 0) ? 0 : (dosage[s] - 2 * p) * scale;
+        return true;
+    }
+
+    size_t _samples;
+    uint64_t _variants;
+    std::vector<double> _sums;
+    std::vector<double> _z;         // samples x GRM_BLOCK
+    size_t _block;
+    std::vector<int8_t> _dosage;    // GRM_BLOCK x samples
+};
+
+// y = A x for the n x n row major A and the n x l row major x
+inline void grm_multiply(std::vector<double> const& a, size_t n, std::vector<double> const& x, size_t l,
+                         std::vector<double>& y)
+{
+    y.assign(n * l, 0.0);
+    for (size_t i = 0; i < n; ++i) {
+        double* yi = &y[i * l];
+        for (size_t k = 0; k < n; ++k) {
+            double aik = a[i * n + k];
+            double const* xk = &x[k * l];
+            for (size_t c = 0; c < l; ++c) yi[c] += aik * xk[c];
+        }
+    }
+}
+
+// Orthonormalize the l columns of the n x l row major q, modified Gram-Schmidt
+inline void grm_orthonormalize(std::vector<double>& q, size_t n, size_t l)
+{
+    for (size_t c = 0; c < l; ++c) {
+        for (size_t prev = 0; prev < c; ++prev) {
+            double dot = 0;
+            for (size_t i = 0; i < n; ++i) dot += q[i * l + c] * q[i * l + prev];
+            for (size_t i = 0; i < n; ++i) q[i * l + c] -= dot * q[i * l + prev];
+        }
+        double norm = 0;
+        for (size_t i = 0; i < n; ++i) norm += q[i * l + c] * q[i * l + c];
+        norm = std::sqrt(norm);
+        for (size_t i = 0; i < n; ++i) q[i * l + c] = (norm > 0) ? q[i * l + c] / norm : 0;
+    }
+}
+
+// Eigenvalues and vectors (columns of v) of the symmetric l x l b, cyclic Jacobi
+inline void grm_jacobi(std::vector<double>& b, size_t l, std::vector<double>& v)
+{
+    v.assign(l * l, 0.0);
+    for (size_t i = 0; i < l; ++i) v[i * l + i] = 1;
+    for (int sweep = 0; sweep < 100; ++sweep) {
+        double off = 0;
+        for (size_t p = 0; p < l; ++p)
+            for (size_t q = p + 1; q < l; ++q) off += b[p * l + q] * b[p * l + q];
+        if (off < 1e-22) break;
+        for (size_t p = 0; p < l; ++p) {
+            for (size_t q = p + 1; q < l; ++q) {
+                double bpq = b[p * l + q];
+                if (std::fabs(bpq) < 1e-300) continue;
+                double theta = (b[q * l + q] - b[p * l + p]) / (2 * bpq);
+                double t = ((theta >= 0) ? 1 : -1) / (std::fabs(theta) + std::sqrt(theta * theta + 1));
+                double c = 1 / std::sqrt(t * t + 1), s = t * c;
+                for (size_t k = 0; k < l; ++k) {
+                    double bkp = b[k * l + p], bkq = b[k * l + q];
+                    b[k * l + p] = c * bkp - s * bkq;
+                    b[k * l + q] = s * bkp + c * bkq;
+                }
+                for (size_t k = 0; k < l; ++k) {
+                    double bpk = b[p * l + k], bqk = b[q * l + k];
+                    b[p * l + k] = c * bpk - s * bqk;
+                    b[q * l + k] = s * bpk + c * bqk;
+                }
+                for (size_t k = 0; k < l; ++k) {
+                    double vkp = v[k * l + p], vkq = v[k * l + q];
+                    v[k * l + p] = c * vkp - s * vkq;
+                    v[k * l + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Top k eigenvalues and eigenvectors of the symmetric n x n a, as the
+ * columns of the n x k row major vecs.  oversample extra directions and
+ * power iterations sharpen the estimate of the slowly decaying spectra
+ * of population structure.
+ */
+inline void grm_top_eigen(std::vector<double> const& a, size_t n, size_t k, std::vector<double>& vals,
+                          std::vector<double>& vecs, size_t oversample = 10, int power = 4, uint64_t seed = 1)
+{
+    size_t l = std::min(n, k + oversample);
+    k = std::min(k, l);
+    // Gaussian test matrix, Box-Muller over a 64 bit LCG
+    std::vector<double> omega(n * l);
+    uint64_t state = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    for (size_t i = 0; i < omega.size(); ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double u1 = ((state >> 11) + 1.0) / 9007199254740993.0;
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double u2 = (state >> 11) / 9007199254740992.0;
+        omega[i] = std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+    }
+    std::vector<double> q;
+    grm_multiply(a, n, omega, l, q);
+    grm_orthonormalize(q, n, l);
+    for (int it = 0; it < power; ++it) {
+        grm_multiply(a, n, q, l, omega);
+        q.swap(omega);
+        grm_orthonormalize(q, n, l);
+    }
+
+    // b = q' a q
+    std::vector<double> aq;
+    grm_multiply(a, n, q, l, aq);
+    std::vector<double> b(l * l, 0.0);
+    for (size_t i = 0; i < n; ++i)
+        for (size_t r = 0; r < l; ++r)
+            for (size_t c = 0; c < l; ++c) b[r * l + c] += q[i * l + r] * aq[i * l + c];
+    for (size_t r = 0; r < l; ++r)
+        for (size_t c = r + 1; c < l; ++c) b[r * l + c] = b[c * l + r] = (b[r * l + c] + b[c * l + r]) / 2;
+    std::vector<double> u;
+    grm_jacobi(b, l, u);
+
+    std::vector<std::pair<double, size_t> > order(l);
+    for (size_t i = 0; i < l; ++i) order[i] = std::make_pair(-b[i * l + i], i);
+    std::sort(order.begin(), order.end());
+    vals.resize(k);
+    vecs.assign(n * k, 0.0);
+    for (size_t c = 0; c < k; ++c) {
+        size_t e = order[c].second;
+        vals[c] = b[e * l + e];
+        for (size_t i = 0; i < n; ++i) {
+            double x = 0;
+            for (size_t r = 0; r < l; ++r) x += q[i * l + r] * u[r * l + e];
+            vecs[i * k + c] = x;
+        }
+    }
+}
+
+#endif // ! GRM_H
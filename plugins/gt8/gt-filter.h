@@ -0,0 +1,221 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file gt-filter.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Genotype class masks of the gt_filter operator.  A filter such
+ * as 'het+!missing,homalt' is compiled into the set of the 256 gt8
+ * values it accepts, so a chunk of calls is filtered with one table
+ * lookup per call, 16 calls at a time with SSSE3 shuffles where the
+ * compiler allows it.  Has no SciDB dependencies.
+ *
+ * A filter is a ',' separated list of alternatives, each a '+' separated
+ * list of classes which must all hold, each optionally negated by '!':
+ *
+ *   het       diploid, both alleles called and different
+ *   hom       diploid, both alleles called and the same
+ *   homref    hom of the reference allele
+ *   homalt    hom of an alternate allele
+ *   carrier   some called allele is an alternate
+ *   allele:K  some called allele is K, 0 = ref, as in allele_count
+ *   missing   some allele is missing, as in allele_missing
+ *   empty     no allele is called, as in empty_gt
+ *   called    no allele is missing
+ *   phased    diploid and phased
+ *   haploid, diploid
+ */
+
+#ifndef GT_FILTER_H
+#define GT_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cstdlib>
+#include <string>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "gt8.h"
+
+// A set of gt8 values, bit g of the 256
+struct gt_filter_mask {
+    uint64_t bits[4];
+
+    void clear() { bits[0] = bits[1] = bits[2] = bits[3] = 0; }
+    void set(gt8_t g) { bits[g >> 6] |= 1ULL << (g & 63); }
+    bool test(gt8_t g) const { return (bits[g >> 6] >> (g & 63)) & 1; }
+};
+
+// True iff g is in the class named by [name, end)
+inline bool gt_filter_class(char const* name, char const* end, gt8_t g, bool& known)
+{
+    std::string c(name, end);
+    known = true;
+    bool diploid = gt8_is_diploid(g);
+    if (c == "het") return gt8_is_heterozygous(g) == eGt8True;
+    if (c == "hom") return gt8_is_homozygous(g) == eGt8True;
+    if (c == "homref") return (gt8_is_homozygous(g) == eGt8True) && (gt8_a(g) == 1);
+    if (c == "homalt") return (gt8_is_homozygous(g) == eGt8True) && (gt8_a(g) > 1);
+    if (c == "carrier") return diploid ? ((gt8_a(g) > 1) || (gt8_b(g) > 1)) : (g > 1);
+    if (c == "missing") return gt8_allele_missing(g);
+    if (c == "empty") return gt8_is_empty(g);
+    if (c == "called") return !gt8_allele_missing(g);
+    if (c == "phased") return diploid && gt8_is_phased(g);
+    if (c == "haploid") return !diploid;
+    if (c == "diploid") return diploid;
+    if (c.compare(0, 7, "allele:") == 0) {
+        char* last;
+        long k = strtol(c.c_str() + 7, &last, 10);
+        if ((last != c.c_str() + c.size()) || (last == c.c_str() + 7) || (k < 0)) {
+            known = false;
+            return false;
+        }
+        return gt8_allele_count(g, k) > 0;
+    }
+    known = false;
+    return false;
+}
+
+// Compile a filter into its mask, false if it does not parse
+inline bool gt_filter_compile(std::string const& text, gt_filter_mask& mask)
+{
+    mask.clear();
+    for (unsigned v = 0; v < 256; ++v) {
+        gt8_t g = (gt8_t)v;
+        bool any = false;
+        char const* p = text.c_str();
+        for (;;) {
+            bool all = true;
+            for (;;) {
+                while (*p == ' ') ++p;
+                bool negate = (*p == '!');
+                if (negate) ++p;
+                char const* name = p;
+                while (*p && (*p != ',') && (*p != '+') && (*p != ' ')) ++p;
+                bool known;
+                bool in = gt_filter_class(name, p, g, known);
+                if (!known) return false;
+                all = all && (in != negate);
+                while (*p == ' ') ++p;
+                if (*p != '+') break;
+                ++p;
+            }
+            any = any || all;
+            if (!*p) break;
+            if (*p != ',') return false;
+            ++p;
+        }
+        if (any) mask.set(g);
+    }
+    return true;
+}
+
+// Offsets of the calls in gt[0, n) which are in the mask, returns their number
+inline size_t gt_filter_select_scalar(gt_filter_mask const& mask, gt8_t const* gt, size_t n, uint32_t* out)
+{
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i) {
+        out[k] = (uint32_t)i;
+        k += mask.test(gt[i]);
+    }
+    return k;
+}
+
+#ifdef __SSSE3__
+
+// The mask as two shuffle tables on the low nibble of a call: row[lo] has
+// bit h set iff (h << 4 | lo) is in the mask, lo8 for h < 8, hi8 for h >= 8
+struct gt_filter_tables {
+    __m128i lo8;
+    __m128i hi8;
+
+    explicit gt_filter_tables(gt_filter_mask const& mask)
+    {
+        uint8_t lo[16], hi[16];
+        for (unsigned l = 0; l < 16; ++l) {
+            lo[l] = hi[l] = 0;
+            for (unsigned h = 0; h < 8; ++h) {
+                if (mask.test((gt8_t)((h << 4) | l))) lo[l] |= 1 << h;
+                if (mask.test((gt8_t)(((h + 8) << 4) | l))) hi[l] |= 1 << h;
+            }
+        }
+        lo8 = _mm_loadu_si128((__m128i const*)lo);
+        hi8 = _mm_loadu_si128((__m128i const*)hi);
+    }
+};
+
+// 16 calls, bit i set iff gt[i] is in the mask
+inline unsigned gt_filter_match16(gt_filter_tables const& t, __m128i x)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i seven = _mm_set1_epi8(0x07);
+    const __m128i pow2 = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128,
+                                       1, 2, 4, 8, 16, 32, 64, (char)128);
+    __m128i lo = _mm_and_si128(x, nibble);
+    __m128i h = _mm_and_si128(_mm_srli_epi16(x, 4), seven);
+    __m128i upper = _mm_cmplt_epi8(x, _mm_setzero_si128());
+    __m128i row = _mm_or_si128(_mm_and_si128(upper, _mm_shuffle_epi8(t.hi8, lo)),
+                               _mm_andnot_si128(upper, _mm_shuffle_epi8(t.lo8, lo)));
+    __m128i hit = _mm_and_si128(row, _mm_shuffle_epi8(pow2, h));
+    return ~_mm_movemask_epi8(_mm_cmpeq_epi8(hit, _mm_setzero_si128())) & 0xFFFF;
+}
+
+inline size_t gt_filter_select(gt_filter_mask const& mask, gt8_t const* gt, size_t n, uint32_t* out)
+{
+    gt_filter_tables t(mask);
+    size_t k = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        unsigned m = gt_filter_match16(t, _mm_loadu_si128((__m128i const*)(gt + i)));
+        while (m) {
+            out[k++] = (uint32_t)(i + __builtin_ctz(m));
+            m &= m - 1;
+        }
+    }
+    for (; i < n; ++i) {
+        out[k] = (uint32_t)i;
+        k += mask.test(gt[i]);
+    }
+    return k;
+}
+
+#else
+
+inline size_t gt_filter_select(gt_filter_mask const& mask, gt8_t const* gt, size_t n, uint32_t* out)
+{
+    return gt_filter_select_scalar(mask, gt, n, out);
+}
+
+#endif
+
+#endif // ! GT_FILTER_H
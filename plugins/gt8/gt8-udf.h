@@ -0,0 +1,360 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file gt8-udf.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief User defined functions of the gt8 library, written against the
+ * scidb::Value calling convention.  Include it exactly once per binary,
+ * after either the SciDB headers (gt8.cpp) or bench/scidb-value-stub.h.
+ *
+ */
+
+#ifndef GT8_UDF_H
+#define GT8_UDF_H
+
+#include <string>
+#include "gt8.h"
+
+enum {
+  GT8_E_CANT_CONVERT_TO_GT8 = SCIDB_USER_ERROR_CODE_START
+};
+
+inline void gt8_setTristate(scidb::Value* res, EGt8Tristate t)
+{
+    if (t == eGt8Null)
+        res->setNull();
+    else
+        res->setBool(t == eGt8True);
+}
+
+void extract_value2(const scidb::Value** args, scidb::Value* res, void*)
+{
+    const char* key = args[0]->getString();
+    const char* keyValStr = args[1]->getString();
+
+    const char* value;
+    size_t len;
+    if (!gt8_extract_info(key, strlen(key), keyValStr, strlen(keyValStr), value, len)) return;
+
+    res->setString(std::string(value, len).c_str());
+}
+
+void extract_value3(const scidb::Value** args, scidb::Value* res, void*)
+{
+    const char* key = args[0]->getString();
+    const char* fmtStr = args[1]->getString();
+    const char* valStr = args[2]->getString();
+
+    const char* value;
+    size_t len;
+    if (!gt8_extract_format(key, strlen(key), fmtStr, strlen(fmtStr),
+                            valStr, strlen(valStr), value, len)) return;
+
+    res->setString(std::string(value, len).c_str());
+}
+
+void num_csv(const scidb::Value** args, scidb::Value* res, void*)
+{
+    const char* cell = args[0]->getString();
+    res->setUint32(gt8_num_csv(cell, strlen(cell)));
+}
+
+// True iff gt8 is haploid and not empty
+void gt8_hemizygous(const scidb::Value** args, scidb::Value* res, void* misc)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    res->setBool(gt8_is_hemizygous(*g));
+}
+
+// True iff gt8 is diploid, not missing values, and both alleles are the same
+void gt8_homozygous(const scidb::Value** args, scidb::Value* res, void* misc)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    gt8_setTristate(res, gt8_is_homozygous(*g));
+}
+
+// True iff gt8 is diploid, not missing values, and both alleles are different
+void gt8_heterozygous(const scidb::Value** args, scidb::Value* res, void* misc)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    gt8_setTristate(res, gt8_is_heterozygous(*g));
+}
+
+// True iff there is no data for any allele
+void gt8_empty(const scidb::Value** args, scidb::Value* res, void* misc)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    res->setBool(gt8_is_empty(*g));
+}
+
+// True iff any allele is missing
+void gt8_alleleMissing(const scidb::Value** args, scidb::Value* res, void* misc)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    res->setBool(gt8_allele_missing(*g));
+}
+
+// Extract a specified allele value
+void gt8_alleleValue(const scidb::Value** args, scidb::Value* res, void* misc)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    int64_t ai = args[1]->getInt64(); // allele, 1=a, 2=b
+
+    uint64_t value;
+    if (gt8_allele_value(*g, ai, value))
+        res->setUint64(value);
+    else
+        res->setNull();
+}
+
+// Count the number of alleles values, 0=ref, 1=1st alt, 2=2nd alt, etc
+void gt8_alleleCount(const scidb::Value** args, scidb::Value* res, void* misc)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    int64_t ai = args[1]->getInt64();
+    res->setUint64(gt8_allele_count(*g, ai));
+}
+
+// Number of alternate alleles, null if an allele is missing
+void gt8_alleleDosage(const scidb::Value** args, scidb::Value* res, void* misc)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    uint8_t dosage = gt8_dosage(*g);
+    if (dosage == GT8_DOSAGE_MISSING)
+        res->setNull();
+    else
+        res->setUint8(dosage);
+}
+
+void gt8_ploidy(const scidb::Value** args, scidb::Value* res, void* misc)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    res->setUint8(gt8_get_ploidy(*g));
+}
+
+void gt8_phase(const scidb::Value** args, scidb::Value* res, void* misc)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    res->setBool(gt8_is_phased(*g));
+}
+
+void gt8_lessEqualThan(const scidb::Value** args, scidb::Value* res, void*)
+{
+    gt8_t& lhs = *(gt8_t*)args[0]->data();
+    gt8_t& rhs = *(gt8_t*)args[1]->data();
+    res->setBool(gt8_less_equal(lhs, rhs));
+}
+
+void gt8_lessThan(const scidb::Value** args, scidb::Value* res, void*)
+{
+    gt8_t& lhs = *(gt8_t*)args[0]->data();
+    gt8_t& rhs = *(gt8_t*)args[1]->data();
+    res->setBool(gt8_less(lhs, rhs));
+}
+
+void gt8_equal(const scidb::Value** args, scidb::Value* res, void*)
+{
+    gt8_t& lhs = *(gt8_t*)args[0]->data();
+    gt8_t& rhs = *(gt8_t*)args[1]->data();
+    res->setBool(lhs == rhs);
+}
+
+void gt8_fromString(const scidb::Value** args, scidb::Value* res, void*)
+{
+    const char* gstr = args[0]->getString();
+    gt8_t* g = static_cast<gt8_t*>( res->data() );
+    if (!gt8_parse(gstr, *g))
+        throw PLUGIN_USER_EXCEPTION("libgt8", scidb::SCIDB_SE_UDO,
+                                    GT8_E_CANT_CONVERT_TO_GT8) << gstr;
+}
+
+void gt8_toString(const scidb::Value** args, scidb::Value* res, void*)
+{
+    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
+    char buf[16];
+    size_t n = gt8_format(*g, buf);
+    buf[n] = '\0';
+    res->setString(buf);
+}
+
+void construct_gt8(const scidb::Value** args, scidb::Value* res, void*)
+{
+    *(gt8_t*)res->data() = 0;
+}
+
+void gt8_normalize(const scidb::Value** args, scidb::Value* res, void*)
+{
+    gt8_t* gtIn = static_cast<gt8_t*>( args[0]->data() );
+    gt8_t* gtOut = static_cast<gt8_t*>( res->data() );
+    *gtOut = gt8_norm(*gtIn);
+}
+
+void bitwise_not8(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint8_t* left = static_cast<uint8_t*>( args[0]->data() );
+    uint8_t* result = static_cast<uint8_t*>( res->data() );
+
+    *result = ~(*left);
+}
+
+void bitwise_not16(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint16_t* left = static_cast<uint16_t*>( args[0]->data() );
+    uint16_t* result = static_cast<uint16_t*>( res->data() );
+
+    *result = ~(*left);
+}
+
+void bitwise_not32(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint32_t* left = static_cast<uint32_t*>( args[0]->data() );
+    uint32_t* result = static_cast<uint32_t*>( res->data() );
+
+    *result = ~(*left);
+}
+
+void bitwise_not64(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint64_t* left = static_cast<uint64_t*>( args[0]->data() );
+    uint64_t* result = static_cast<uint64_t*>( res->data() );
+
+    *result = ~(*left);
+}
+
+void bitwise_and8(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint8_t* left = static_cast<uint8_t*>( args[0]->data() );
+    uint8_t* right = static_cast<uint8_t*>( args[1]->data() );
+    uint8_t* result = static_cast<uint8_t*>( res->data() );
+
+    *result = *left & *right;
+}
+
+void bitwise_and16(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint16_t* left = static_cast<uint16_t*>( args[0]->data() );
+    uint16_t* right = static_cast<uint16_t*>( args[1]->data() );
+    uint16_t* result = static_cast<uint16_t*>( res->data() );
+
+    *result = *left & *right;
+}
+
+void bitwise_and32(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint32_t* left = static_cast<uint32_t*>( args[0]->data() );
+    uint32_t* right = static_cast<uint32_t*>( args[1]->data() );
+    uint32_t* result = static_cast<uint32_t*>( res->data() );
+
+    *result = *left & *right;
+}
+
+void bitwise_and64(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint64_t* left = static_cast<uint64_t*>( args[0]->data() );
+    uint64_t* right = static_cast<uint64_t*>( args[1]->data() );
+    uint64_t* result = static_cast<uint64_t*>( res->data() );
+
+    *result = *left & *right;
+}
+
+void bitwise_or8(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint8_t* left = static_cast<uint8_t*>( args[0]->data() );
+    uint8_t* right = static_cast<uint8_t*>( args[1]->data() );
+    uint8_t* result = static_cast<uint8_t*>( res->data() );
+
+    *result = *left | *right;
+}
+
+void bitwise_or16(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint16_t* left = static_cast<uint16_t*>( args[0]->data() );
+    uint16_t* right = static_cast<uint16_t*>( args[1]->data() );
+    uint16_t* result = static_cast<uint16_t*>( res->data() );
+
+    *result = *left | *right;
+}
+
+void bitwise_or32(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint32_t* left = static_cast<uint32_t*>( args[0]->data() );
+    uint32_t* right = static_cast<uint32_t*>( args[1]->data() );
+    uint32_t* result = static_cast<uint32_t*>( res->data() );
+
+    *result = *left | *right;
+}
+
+void bitwise_or64(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint64_t* left = static_cast<uint64_t*>( args[0]->data() );
+    uint64_t* right = static_cast<uint64_t*>( args[1]->data() );
+    uint64_t* result = static_cast<uint64_t*>( res->data() );
+
+    *result = *left | *right;
+}
+
+void bitwise_xor8(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint8_t* left = static_cast<uint8_t*>( args[0]->data() );
+    uint8_t* right = static_cast<uint8_t*>( args[1]->data() );
+    uint8_t* result = static_cast<uint8_t*>( res->data() );
+
+    *result = *left ^ *right;
+}
+
+void bitwise_xor16(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint16_t* left = static_cast<uint16_t*>( args[0]->data() );
+    uint16_t* right = static_cast<uint16_t*>( args[1]->data() );
+    uint16_t* result = static_cast<uint16_t*>( res->data() );
+
+    *result = *left ^ *right;
+}
+
+void bitwise_xor32(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint32_t* left = static_cast<uint32_t*>( args[0]->data() );
+    uint32_t* right = static_cast<uint32_t*>( args[1]->data() );
+    uint32_t* result = static_cast<uint32_t*>( res->data() );
+
+    *result = *left ^ *right;
+}
+
+void bitwise_xor64(const scidb::Value** args, scidb::Value* res, void*)
+{
+    uint64_t* left = static_cast<uint64_t*>( args[0]->data() );
+    uint64_t* right = static_cast<uint64_t*>( args[1]->data() );
+    uint64_t* result = static_cast<uint64_t*>( res->data() );
+
+    *result = *left ^ *right;
+}
+
+#endif // ! GT8_UDF_H
@@ -38,8 +38,6 @@
 #include <vector>
 #include <algorithm>
 #include <boost/assign.hpp>
-#include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/classification.hpp>
 
 #include "query/Operator.h"
 #include "query/FunctionLibrary.h"
@@ -51,11 +49,9 @@ using namespace std;
 using namespace scidb;
 using namespace boost::assign;
 
-typedef uint8_t gt8_t;
-
-enum {
-  GT8_E_CANT_CONVERT_TO_GT8 = SCIDB_USER_ERROR_CODE_START
-};
+#include "gt8-udf.h"
+#include "nuc-udf.h"
+#include "gl-udf.h"
 
 EXPORTED_FUNCTION void GetPluginVersion(uint32_t& major, uint32_t& minor, 
                                         uint32_t& patch, uint32_t& build)
@@ -68,597 +64,11 @@ EXPORTED_FUNCTION void GetPluginVersion(uint32_t& major, uint32_t& minor,
     build = scidb::SCIDB_VERSION_BUILD();
 }
 
-struct StartsWithPred
-{
-    string key;
-    bool operator()(string const& entry)
-    {
-        if (entry.size() < key.size()) return false;
-        return ( key == entry.substr(0,key.size()) );
-    }
-};
-
-void extract_value2(const scidb::Value** args, scidb::Value* res, void*)
-{
-    string const& key = args[0]->getString();
-    string const& keyValStr = args[1]->getString();
-
-    vector<string> keyValues;
-    split(keyValues, keyValStr, is_any_of(";"));
-
-    StartsWithPred pred;
-    pred.key = key;
-
-    vector<string>::iterator it = find_if(keyValues.begin(),
-                                       keyValues.end(),
-                                       pred);
-    if (it == keyValues.end()) return;
-
-    vector<string> kv_pair;
-    split(kv_pair, *it, is_any_of("="));
-
-    if (kv_pair.size() < 2) return;
-    
-    res->setString(kv_pair[1].c_str());
-}
-
-void extract_value3(const scidb::Value** args, scidb::Value* res, void*)
-{
-    string const& key = args[0]->getString();
-    string const& fmtStr = args[1]->getString();
-    string const& valStr = args[2]->getString();
-
-    vector<string> keys;
-    split(keys, fmtStr, is_any_of(":"));
-
-    vector<string>::iterator it = find(keys.begin(),
-                                       keys.end(),
-                                       key);
-    if (it == keys.end()) return;
-    
-    size_t pos = it - keys.begin();
-    vector<string> values;
-    split(values, valStr, is_any_of(":"));
-
-    if (values.size() <= pos) return;
-    
-    res->setString(values[pos].c_str());
-}
-
-void num_csv(const scidb::Value** args, scidb::Value* res, void*)
-{
-    string const& cell = args[0]->getString();
-
-    uint32_t count = 0;
-
-    if (!cell.empty()) {
-        count = 1 + std::count(cell.begin(), cell.end(), ',');
-    }
-
-    res->setUint32(count);
-}
-
-// True iff gt8 is haploid and not empty
-void gt8_hemizygous(const scidb::Value** args, scidb::Value* res, void* misc)
-{
-    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
-    
-    uint8_t ploidy = *g & 0x80;    
-    if (ploidy == 0) {
-        res->setBool(true);
-    } else {
-        res->setBool(false);
-    }
-}
-
-// True iff gt8 is diploid, not missing values, and both alleles are the same 
-void gt8_homozygous(const scidb::Value** args, scidb::Value* res, void* misc)
-{
-    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
-    
-    uint8_t ploidy = *g & 0x80;    
-    if (ploidy == 0) {
-        res->setBool(false);
-    } else {
-        uint8_t a = *g & 0x38;
-        a >>= 3;
-
-        uint8_t b = *g & 0x07;
-
-        if ((a > 0) && (b > 0))
-            res->setBool(a == b);
-        else
-            res->setNull();
-    }
-}
-
-// True iff gt8 is diploid, not missing values, and both alleles are different
-void gt8_heterozygous(const scidb::Value** args, scidb::Value* res, void* misc)
-{
-    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
-
-    uint8_t ploidy = *g & 0x80;    
-    if (ploidy == 0) {
-        res->setBool(false);
-    } else {
-        uint8_t a = *g & 0x38;
-        a >>= 3;
-
-        uint8_t b = *g & 0x07;
-
-        if ((a > 0) && (b > 0))
-            res->setBool(a != b);
-        else {
-            res->setNull();
-        }
-    }
-}
-
-// True iff there is no data for any allele
-void gt8_empty(const scidb::Value** args, scidb::Value* res, void* misc)
-{
-    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
-
-    uint8_t ploidy = *g & 0x80;    
-    if (ploidy == 0) {
-        if (*g == 0) {
-            res->setBool(true);
-            return;
-        }
-    } else {
-        uint8_t v = *g & 0x3F;
-        if (v==0) {
-            res->setBool(true);
-            return;
-        }
-    }
-    res->setBool(false);
-}
-
-// True iff any allele is missing
-void gt8_alleleMissing(const scidb::Value** args, scidb::Value* res, void* misc)
-{
-    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
-
-    uint8_t ploidy = *g & 0x80;    
-    if (ploidy == 0) {
-        if (*g == 0) {
-            res->setBool(true);
-            return;
-        }
-    } else {
-        uint8_t a = *g & 0x38;
-        a >>= 3;
-        uint8_t b = *g & 0x07;
-        if ((a==0) || (b==0)) {
-            res->setBool(true);
-            return;
-        } 
-    }
-    res->setBool(false);
-}
-
-// Extract a specified allele value
-void gt8_alleleValue(const scidb::Value** args, scidb::Value* res, void* misc)
-{
-    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
-    int64_t ai = args[1]->getInt64(); // allele, 1=a, 2=b
-
-    uint8_t ploidy = *g & 0x80;    
-    if (ploidy == 0) {
-        if ((*g == 0) || (ai > 1)) 
-            res->setNull();
-        else
-            res->setUint64(*g-1);
-    } else {
-        if (ai == 1) {
-            uint8_t a = *g & 0x38;
-            a >>= 3;
-            if (a == 0)
-                res->setNull();
-            else
-                res->setUint64(a-1);
-        } else {
-            uint8_t b = *g & 0x07;
-            if (b == 0)
-                res->setNull();
-            else
-                res->setUint64(b-1);
-        }
-    }
-}
-
-// Count the number of alleles values, 0=ref, 1=1st alt, 2=2nd alt, etc
-void gt8_alleleCount(const scidb::Value** args, scidb::Value* res, void* misc)
-{
-    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
-    int64_t ai = args[1]->getInt64();
-
-    uint32_t ac = 0;
-
-    uint8_t ploidy = *g & 0x80;
-    
-    if (ploidy == 0) {
-        if (*g != 0) 
-            if ((*g-1) == ai)
-                ac++;
-    } else {
-        uint8_t a = *g & 0x38;
-        a >>= 3;
-
-        uint8_t b = *g & 0x07;
-
-        if (a > 0) 
-            if((int64_t)(a-1) == ai)
-                ac++;
-        if (b > 0) 
-            if((int64_t)(b-1) == ai)
-                ac++;
-    }
-    
-    res->setUint64(ac);
-}
-
-void gt8_ploidy(const scidb::Value** args, scidb::Value* res, void* misc)
-{
-    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
-    uint8_t pl = *g & 0x80;
-    if (pl == 0)
-        pl = 1;
-    else
-        pl = 2;
-    res->setUint8(pl);
-}
-
-void gt8_phase(const scidb::Value** args, scidb::Value* res, void* misc)
-{
-    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
-    uint8_t p = *g & 0x40;
-    res->setBool(p!=0);
-}
-
-void gt8_lessEqualThan(const Value** args, Value* res, void*)
-{
-    gt8_t& lhs = *(gt8_t*)args[0]->data();
-    gt8_t& rhs = *(gt8_t*)args[1]->data();
-    bool result = false;
-
-    unsigned loadLhs = lhs;
-    unsigned loadRhs = rhs;
-    if(lhs & 0x80)
-    {
-        uint8_t a1 = lhs & 0x38;
-        a1 >>= 3;
-        uint8_t b1 = lhs & 0x07;
-        loadLhs = a1 + b1;
-    }
-    if (rhs & 0x80)
-    {
-        uint8_t a2 = rhs & 0x38;
-        a2 >>= 3;
-        uint8_t b2 = rhs & 0x07;
-        loadRhs = a2 + b2;
-    }
-    // REF < ALT
-    if (loadLhs <= loadRhs)
-        result = true;
-    else if (loadLhs == loadRhs) 
-    {
-        if ((lhs & 0x40) != (rhs & 0x40))
-            // unphased < phased
-            result = ((lhs & 0x40) <= (rhs & 0x40));
-        else // finaly haploid < diploid
-            result = ((lhs & 0x80) <= (rhs & 0x80));
-    }
-    res->setBool(result);
-}
-
-void gt8_lessThan(const Value** args, Value* res, void*)
-{
-    gt8_t& lhs = *(gt8_t*)args[0]->data();
-    gt8_t& rhs = *(gt8_t*)args[1]->data();
-    bool result = false;
-
-    unsigned loadLhs = lhs;
-    unsigned loadRhs = rhs;
-    if(lhs & 0x80)
-    {
-        uint8_t a1 = lhs & 0x38;
-        a1 >>= 3;
-        uint8_t b1 = lhs & 0x07;
-        loadLhs = a1 + b1;
-    }
-    if (rhs & 0x80)
-    {
-        uint8_t a2 = rhs & 0x38;
-        a2 >>= 3;
-        uint8_t b2 = rhs & 0x07;
-        loadRhs = a2 + b2;
-    }
-    // REF < ALT
-    if (loadLhs < loadRhs)
-        result = true;
-    else if (loadLhs == loadRhs) 
-    {
-        if ((lhs & 0x40) != (rhs & 0x40))
-            // unphased < phased
-            result = ((lhs & 0x40) < (rhs & 0x40));
-        else // finaly haploid < diploid
-            result = ((lhs & 0x80) < (rhs & 0x80));
-    }
-    res->setBool(result);
-}
-
-void gt8_equal(const Value** args, Value* res, void*)
-{
-    gt8_t& lhs = *(gt8_t*)args[0]->data();
-    gt8_t& rhs = *(gt8_t*)args[1]->data();
-    bool result = (lhs == rhs);
-    res->setBool(result);
-}
-
-void gt8_fromString(const scidb::Value** args, scidb::Value* res, void*)
-{
-    string const& gstr = args[0]->getString();
-    size_t phase_loc = gstr.find_first_of("/|");
-    bool isDiploid;
-    unsigned short int a, b;
-    char phase('/');
-    if (phase_loc != string::npos) {
-        isDiploid = true;
-        phase = gstr[phase_loc];
-        string strA = gstr.substr(0, phase_loc);
-        string strB = gstr.substr(phase_loc+1);
-        if (strA[0] == '.') {
-            a=0;
-        } else {
-            if (sscanf(strA.c_str(), "%hu", &a) < 1)
-                throw PLUGIN_USER_EXCEPTION("libgt8", scidb::SCIDB_SE_UDO, 
-                                             GT8_E_CANT_CONVERT_TO_GT8) << gstr;
-            a++;
-        }
-        if (strB[0] == '.') {
-            b=0;
-        } else {
-            if (sscanf(strB.c_str(), "%hu", &b) < 1)
-                throw PLUGIN_USER_EXCEPTION("libgt8", scidb::SCIDB_SE_UDO, 
-                                             GT8_E_CANT_CONVERT_TO_GT8) << gstr;
-            b++;
-        }
-    } else {
-        isDiploid = false;
-        if (gstr[0] == '.') {
-            a=0;
-        } else {
-            if (sscanf(gstr.c_str(), "%hu", &a) < 1)
-                throw PLUGIN_USER_EXCEPTION("libgt8", scidb::SCIDB_SE_UDO, 
-                                             GT8_E_CANT_CONVERT_TO_GT8) << gstr;
-            a++;
-        }
-    }
-    
-    gt8_t* g = static_cast<gt8_t*>( res->data() );
-    *g = a;
-    if (isDiploid) {
-        *g <<= 3;
-        *g |= b;
-        if (phase == '|') {
-            *g |= 0xC0;  // 0x80 & 0x40
-        } else {
-            *g |= 0x80;
-        }
-    }
-}
-
-void gt8_toString(const scidb::Value** args, scidb::Value* res, void*)
-{
-    gt8_t* g = static_cast<gt8_t*>( args[0]->data() );
-
-    stringstream ss;
-
-    uint8_t ploidy = *g & 0x80;
-    
-    if (ploidy == 0) {
-        if (*g == 0) 
-            ss << ".";
-        else
-            ss << (*g-1);
-    } else {
-        uint8_t a = *g & 0x38;
-        a >>= 3;
-
-        uint8_t b = *g & 0x07;
-
-        uint8_t p = *g & 0x40;
-        char phase = (p==0) ? '/' : '|';
-
-        if (a == 0) ss << ".";
-        else ss << (static_cast<int>(a)-1);
-
-        ss << phase ;
-    
-        if (b == 0) ss << ".";
-        else ss << (static_cast<int>(b)-1);
-    }
-    
-    res->setString(ss.str().c_str());
-}
-
-void construct_gt8(const scidb::Value** args, scidb::Value* res, void*)
-{
-    *(gt8_t*)res->data() = 0;
-}
-
-void gt8_normalize(const scidb::Value** args, scidb::Value* res, void*)
-{
-    gt8_t* gtIn = static_cast<gt8_t*>( args[0]->data() );
-    gt8_t* gtOut = static_cast<gt8_t*>( res->data() );
-    
-    uint8_t ploidy = *gtIn & 0x80;
-    
-    if (ploidy == 0) {
-        *gtOut = *gtIn;
-        return;
-    } else {
-        uint8_t a = *gtIn & 0x38;
-        a >>= 3;
-        uint8_t b = *gtIn & 0x07;
-
-        uint8_t p = *gtIn & 0x40;
-
-        if ((a <= b) && (p == 0)) {
-            *gtOut = *gtIn;
-            return;
-        }
-        
-        *gtOut = b;
-        *gtOut <<= 3;
-        *gtOut |= a;
-        *gtOut |= 0x80;
-    }
-}
-
-void bitwise_not8(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint8_t* left = static_cast<uint8_t*>( args[0]->data() );
-    uint8_t* result = static_cast<uint8_t*>( res->data() );
-
-    *result = ~(*left);
-}
-
-void bitwise_not16(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint16_t* left = static_cast<uint16_t*>( args[0]->data() );
-    uint16_t* result = static_cast<uint16_t*>( res->data() );
-
-    *result = ~(*left);
-}
-
-void bitwise_not32(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint32_t* left = static_cast<uint32_t*>( args[0]->data() );
-    uint32_t* result = static_cast<uint32_t*>( res->data() );
-
-    *result = ~(*left);
-}
-
-void bitwise_not64(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint64_t* left = static_cast<uint64_t*>( args[0]->data() );
-    uint64_t* result = static_cast<uint64_t*>( res->data() );
-
-    *result = ~(*left);
-}
-
-void bitwise_and8(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint8_t* left = static_cast<uint8_t*>( args[0]->data() );
-    uint8_t* right = static_cast<uint8_t*>( args[1]->data() );
-    uint8_t* result = static_cast<uint8_t*>( res->data() );
-
-    *result = *left & *right;
-}
-
-void bitwise_and16(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint16_t* left = static_cast<uint16_t*>( args[0]->data() );
-    uint16_t* right = static_cast<uint16_t*>( args[1]->data() );
-    uint16_t* result = static_cast<uint16_t*>( res->data() );
-
-    *result = *left & *right;
-}
-
-void bitwise_and32(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint32_t* left = static_cast<uint32_t*>( args[0]->data() );
-    uint32_t* right = static_cast<uint32_t*>( args[1]->data() );
-    uint32_t* result = static_cast<uint32_t*>( res->data() );
-
-    *result = *left & *right;
-}
-
-void bitwise_and64(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint64_t* left = static_cast<uint64_t*>( args[0]->data() );
-    uint64_t* right = static_cast<uint64_t*>( args[1]->data() );
-    uint64_t* result = static_cast<uint64_t*>( res->data() );
-
-    *result = *left & *right;
-}
-
-void bitwise_or8(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint8_t* left = static_cast<uint8_t*>( args[0]->data() );
-    uint8_t* right = static_cast<uint8_t*>( args[1]->data() );
-    uint8_t* result = static_cast<uint8_t*>( res->data() );
-
-    *result = *left | *right;
-}
-
-void bitwise_or16(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint16_t* left = static_cast<uint16_t*>( args[0]->data() );
-    uint16_t* right = static_cast<uint16_t*>( args[1]->data() );
-    uint16_t* result = static_cast<uint16_t*>( res->data() );
-
-    *result = *left | *right;
-}
-
-void bitwise_or32(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint32_t* left = static_cast<uint32_t*>( args[0]->data() );
-    uint32_t* right = static_cast<uint32_t*>( args[1]->data() );
-    uint32_t* result = static_cast<uint32_t*>( res->data() );
-
-    *result = *left | *right;
-}
-
-void bitwise_or64(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint64_t* left = static_cast<uint64_t*>( args[0]->data() );
-    uint64_t* right = static_cast<uint64_t*>( args[1]->data() );
-    uint64_t* result = static_cast<uint64_t*>( res->data() );
-
-    *result = *left | *right;
-}
-
-void bitwise_xor8(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint8_t* left = static_cast<uint8_t*>( args[0]->data() );
-    uint8_t* right = static_cast<uint8_t*>( args[1]->data() );
-    uint8_t* result = static_cast<uint8_t*>( res->data() );
-
-    *result = *left ^ *right;
-}
-
-void bitwise_xor16(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint16_t* left = static_cast<uint16_t*>( args[0]->data() );
-    uint16_t* right = static_cast<uint16_t*>( args[1]->data() );
-    uint16_t* result = static_cast<uint16_t*>( res->data() );
-
-    *result = *left ^ *right;
-}
-
-void bitwise_xor32(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint32_t* left = static_cast<uint32_t*>( args[0]->data() );
-    uint32_t* right = static_cast<uint32_t*>( args[1]->data() );
-    uint32_t* result = static_cast<uint32_t*>( res->data() );
-
-    *result = *left ^ *right;
-}
-
-void bitwise_xor64(const scidb::Value** args, scidb::Value* res, void*)
-{
-    uint64_t* left = static_cast<uint64_t*>( args[0]->data() );
-    uint64_t* right = static_cast<uint64_t*>( args[1]->data() );
-    uint64_t* result = static_cast<uint64_t*>( res->data() );
-
-    *result = *left ^ *right;
-}
-
 REGISTER_TYPE(gt8, sizeof(gt8_t));
+// Variable size, see nuc.h
+REGISTER_TYPE(nuc, 0);
+// Variable size, see gl.h
+REGISTER_TYPE(gl, 0);
 
 REGISTER_FUNCTION(extract_value, list_of(TID_STRING)(TID_STRING), TID_STRING, extract_value2);
 REGISTER_FUNCTION(extract_value, list_of(TID_STRING)(TID_STRING)(TID_STRING), TID_STRING, extract_value3);
@@ -670,6 +80,7 @@ REGISTER_FUNCTION(empty_gt, list_of("gt8"), "bool", gt8_empty);
 REGISTER_FUNCTION(allele_missing, list_of("gt8"), "bool", gt8_alleleMissing);
 REGISTER_FUNCTION(allele_value, list_of("gt8")("int64"), "uint64", gt8_alleleValue);
 REGISTER_FUNCTION(allele_count, list_of("gt8")("int64"), "uint64", gt8_alleleCount);
+REGISTER_FUNCTION(dosage, list_of("gt8"), "uint8", gt8_alleleDosage);
 REGISTER_FUNCTION(ploidy, list_of("gt8"), "uint8", gt8_ploidy);
 REGISTER_FUNCTION(phase, list_of("gt8"), "bool", gt8_phase);
 REGISTER_FUNCTION(<=, list_of("gt8")("gt8"), "bool", gt8_lessEqualThan);
@@ -702,6 +113,34 @@ REGISTER_FUNCTION(bitxor, list_of("uint64")("uint64"), "uint64", bitwise_xor64);
 REGISTER_CONVERTER(gt8, string, EXPLICIT_CONVERSION_COST, gt8_toString);
 REGISTER_CONVERTER(string, gt8, EXPLICIT_CONVERSION_COST, gt8_fromString);
 
+// Nucleotide alleles
+REGISTER_FUNCTION(is_snv, list_of("nuc")("nuc"), "bool", nuc_isSnv);
+REGISTER_FUNCTION(is_snv, list_of("nuc")("nuc")("int64"), "bool", nuc_isSnvAllele);
+REGISTER_FUNCTION(is_transition, list_of("nuc")("nuc"), "bool", nuc_isTransition);
+REGISTER_FUNCTION(is_transition, list_of("nuc")("nuc")("int64"), "bool", nuc_isTransitionAllele);
+REGISTER_FUNCTION(variant_class, list_of("nuc")("nuc"), TID_STRING, nuc_variantClass);
+REGISTER_FUNCTION(variant_class, list_of("nuc")("nuc")("int64"), TID_STRING, nuc_variantClassAllele);
+REGISTER_FUNCTION(alt_allele, list_of("nuc")("int64"), TID_STRING, nuc_altAllele);
+REGISTER_FUNCTION(length, list_of("nuc"), "uint32", nuc_length);
+REGISTER_FUNCTION(length, list_of("nuc")("int64"), "uint32", nuc_lengthAllele);
+REGISTER_FUNCTION(num_alleles, list_of("nuc"), "uint32", nuc_numAlleles);
+REGISTER_FUNCTION(=, list_of("nuc")("nuc"), "bool", nuc_equal);
+
+REGISTER_CONVERTER(nuc, string, EXPLICIT_CONVERSION_COST, nuc_toString);
+REGISTER_CONVERTER(string, nuc, EXPLICIT_CONVERSION_COST, nuc_fromString);
+
+// Genotype likelihoods
+REGISTER_FUNCTION(pl, list_of("gl")("int64"), "uint8", gl_pl);
+REGISTER_FUNCTION(gq, list_of("gl"), "uint8", gl_genotypeQuality);
+REGISTER_FUNCTION(best_gt, list_of("gl"), "gt8", gl_bestGt);
+REGISTER_FUNCTION(dosage, list_of("gl"), "double", gl_dosageFlat);
+REGISTER_FUNCTION(dosage, list_of("gl")("double"), "double", gl_dosagePrior);
+REGISTER_FUNCTION(ploidy, list_of("gl"), "uint8", gl_ploidyOf);
+REGISTER_FUNCTION(num_alleles, list_of("gl"), "uint32", gl_numAlleles);
+
+REGISTER_CONVERTER(gl, string, EXPLICIT_CONVERSION_COST, gl_toString);
+REGISTER_CONVERTER(string, gl, EXPLICIT_CONVERSION_COST, gl_fromString);
+
 /*
  * Class for registering/unregistering user defined objects
  */
@@ -712,8 +151,11 @@ public:
     Gt8Library()
     {
         Type("gt8", sizeof(gt8_t) * 8);
+        Type("nuc", 0);
+        Type("gl", 0);
 
         _errors[GT8_E_CANT_CONVERT_TO_GT8] = "Cannot convert '%1%' to gt8";
+        _errors[GT8_E_CANT_CONVERT_TO_GL] = "Cannot convert '%1%' to gl";
         scidb::ErrorsLibrary::getInstance()->registerErrors("gt8", &_errors);
     }
 
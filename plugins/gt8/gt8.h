@@ -0,0 +1,337 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file gt8.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Codec and kernels for genotypes encoded into 8bits.  Has no
+ * SciDB dependencies, so it is shared by the plugin, the loaders and the
+ * benchmarks.
+ *
+ * Layout of a gt8 value:
+ *   haploid: 0x80 clear, the whole byte is the allele + 1, 0 = missing
+ *   diploid: 0x80 set, 0x40 phased, bits 3-5 allele a + 1, bits 0-2 allele b + 1
+ */
+
+#ifndef GT8_H
+#define GT8_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t gt8_t;
+
+#define GT8_DIPLOID 0x80
+#define GT8_PHASED  0x40
+
+// Dosage of a gt8 with a missing allele
+#define GT8_DOSAGE_MISSING 3
+
+// Result of the predicates which are undefined for missing alleles
+enum EGt8Tristate {
+    eGt8False = 0,
+    eGt8True = 1,
+    eGt8Null = 2
+};
+
+inline bool gt8_is_diploid(gt8_t g) { return (g & GT8_DIPLOID) != 0; }
+
+// First allele + 1 of a diploid gt8, 0 if missing
+inline uint8_t gt8_a(gt8_t g) { return (g & 0x38) >> 3; }
+
+// Second allele + 1 of a diploid gt8, 0 if missing
+inline uint8_t gt8_b(gt8_t g) { return g & 0x07; }
+
+// True iff gt8 is haploid
+inline bool gt8_is_hemizygous(gt8_t g) { return !gt8_is_diploid(g); }
+
+// True iff gt8 is diploid, not missing values, and both alleles are the same
+inline EGt8Tristate gt8_is_homozygous(gt8_t g)
+{
+    if (!gt8_is_diploid(g)) return eGt8False;
+    uint8_t a = gt8_a(g);
+    uint8_t b = gt8_b(g);
+    if ((a == 0) || (b == 0)) return eGt8Null;
+    return (a == b) ? eGt8True : eGt8False;
+}
+
+// True iff gt8 is diploid, not missing values, and both alleles are different
+inline EGt8Tristate gt8_is_heterozygous(gt8_t g)
+{
+    if (!gt8_is_diploid(g)) return eGt8False;
+    uint8_t a = gt8_a(g);
+    uint8_t b = gt8_b(g);
+    if ((a == 0) || (b == 0)) return eGt8Null;
+    return (a != b) ? eGt8True : eGt8False;
+}
+
+// True iff there is no data for any allele
+inline bool gt8_is_empty(gt8_t g)
+{
+    if (!gt8_is_diploid(g)) return g == 0;
+    return (g & 0x3F) == 0;
+}
+
+// True iff any allele is missing
+inline bool gt8_allele_missing(gt8_t g)
+{
+    if (!gt8_is_diploid(g)) return g == 0;
+    return (gt8_a(g) == 0) || (gt8_b(g) == 0);
+}
+
+// Value of allele ai (1=a, 2=b), false if it is missing
+inline bool gt8_allele_value(gt8_t g, int64_t ai, uint64_t& value)
+{
+    if (!gt8_is_diploid(g)) {
+        if ((g == 0) || (ai > 1)) return false;
+        value = g - 1;
+        return true;
+    }
+    uint8_t v = (ai == 1) ? gt8_a(g) : gt8_b(g);
+    if (v == 0) return false;
+    value = v - 1;
+    return true;
+}
+
+// Count the number of alleles values, 0=ref, 1=1st alt, 2=2nd alt, etc
+inline uint32_t gt8_allele_count(gt8_t g, int64_t ai)
+{
+    uint32_t ac = 0;
+    if (!gt8_is_diploid(g)) {
+        if ((g != 0) && ((int64_t)(g - 1) == ai)) ac++;
+    } else {
+        uint8_t a = gt8_a(g);
+        uint8_t b = gt8_b(g);
+        if ((a > 0) && ((int64_t)(a - 1) == ai)) ac++;
+        if ((b > 0) && ((int64_t)(b - 1) == ai)) ac++;
+    }
+    return ac;
+}
+
+// Number of alternate alleles, of any alt, GT8_DOSAGE_MISSING if an allele is missing
+inline uint8_t gt8_dosage(gt8_t g)
+{
+    if (gt8_allele_missing(g)) return GT8_DOSAGE_MISSING;
+    if (!gt8_is_diploid(g)) return g > 1;
+    return (gt8_a(g) > 1) + (gt8_b(g) > 1);
+}
+
+inline uint8_t gt8_get_ploidy(gt8_t g) { return gt8_is_diploid(g) ? 2 : 1; }
+
+inline bool gt8_is_phased(gt8_t g) { return (g & GT8_PHASED) != 0; }
+
+// Sort load: haploid values sort by value, diploid by the sum of alleles
+inline unsigned gt8_load(gt8_t g)
+{
+    if (gt8_is_diploid(g)) return gt8_a(g) + gt8_b(g);
+    return g;
+}
+
+inline bool gt8_less_equal(gt8_t lhs, gt8_t rhs)
+{
+    unsigned loadLhs = gt8_load(lhs);
+    unsigned loadRhs = gt8_load(rhs);
+    // REF < ALT
+    if (loadLhs <= loadRhs) return true;
+    return false;
+}
+
+inline bool gt8_less(gt8_t lhs, gt8_t rhs)
+{
+    unsigned loadLhs = gt8_load(lhs);
+    unsigned loadRhs = gt8_load(rhs);
+    // REF < ALT
+    if (loadLhs < loadRhs) return true;
+    if (loadLhs == loadRhs) {
+        if ((lhs & GT8_PHASED) != (rhs & GT8_PHASED))
+            // unphased < phased
+            return (lhs & GT8_PHASED) < (rhs & GT8_PHASED);
+        // finaly haploid < diploid
+        return (lhs & GT8_DIPLOID) < (rhs & GT8_DIPLOID);
+    }
+    return false;
+}
+
+// Unphased diploid with the smaller allele first, haploid is unchanged
+inline gt8_t gt8_norm(gt8_t g)
+{
+    if (!gt8_is_diploid(g)) return g;
+    uint8_t a = gt8_a(g);
+    uint8_t b = gt8_b(g);
+    if ((a <= b) && ((g & GT8_PHASED) == 0)) return g;
+    return (gt8_t)(GT8_DIPLOID | (b << 3) | a);
+}
+
+// Parse one allele as sscanf("%hu") would, storing allele + 1 in a
+inline bool gt8_parse_allele(char const* s, char const* end, unsigned short& a)
+{
+    if ((s < end) && (*s == '.')) {
+        a = 0;
+        return true;
+    }
+    while ((s < end) && ((*s == ' ') || (*s == '\t'))) ++s;
+    if ((s < end) && (*s == '+')) ++s;
+    if ((s >= end) || (*s < '0') || (*s > '9')) return false;
+    unsigned short v = 0;
+    while ((s < end) && (*s >= '0') && (*s <= '9')) {
+        v = v * 10 + (*s - '0');
+        ++s;
+    }
+    a = v + 1;
+    return true;
+}
+
+// Convert text such as "0/1", "1|0", "./." or "1" into a gt8
+inline bool gt8_parse(char const* s, size_t len, gt8_t& g)
+{
+    char const* end = s + len;
+    char const* phase_loc = s;
+    while ((phase_loc < end) && (*phase_loc != '/') && (*phase_loc != '|')) ++phase_loc;
+
+    unsigned short a, b;
+    if (phase_loc == end) {
+        if (!gt8_parse_allele(s, end, a)) return false;
+        g = (gt8_t)a;
+        return true;
+    }
+    if (!gt8_parse_allele(s, phase_loc, a)) return false;
+    if (!gt8_parse_allele(phase_loc + 1, end, b)) return false;
+    g = (gt8_t)a;
+    g <<= 3;
+    g |= (gt8_t)b;
+    g |= (*phase_loc == '|') ? (GT8_DIPLOID | GT8_PHASED) : GT8_DIPLOID;
+    return true;
+}
+
+inline bool gt8_parse(char const* s, gt8_t& g) { return gt8_parse(s, strlen(s), g); }
+
+// Append the decimal digits of v to out, returns the number of chars
+inline size_t gt8_format_uint(unsigned v, char* out)
+{
+    char tmp[12];
+    size_t n = 0;
+    do {
+        tmp[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v != 0);
+    for (size_t i = 0; i < n; ++i) out[i] = tmp[n - 1 - i];
+    return n;
+}
+
+// Text form of a gt8, out must hold 8 chars, returns the number used
+inline size_t gt8_format(gt8_t g, char* out)
+{
+    size_t n = 0;
+    if (!gt8_is_diploid(g)) {
+        if (g == 0) out[n++] = '.';
+        else n += gt8_format_uint(g - 1, out);
+        return n;
+    }
+    uint8_t a = gt8_a(g);
+    uint8_t b = gt8_b(g);
+    if (a == 0) out[n++] = '.';
+    else n += gt8_format_uint(a - 1, out + n);
+    out[n++] = gt8_is_phased(g) ? '|' : '/';
+    if (b == 0) out[n++] = '.';
+    else n += gt8_format_uint(b - 1, out + n);
+    return n;
+}
+
+/*
+ * String kernels behind the extract_value and num_csv functions.  The
+ * results point into the input strings.
+ */
+
+// Value of the first ';' separated entry starting with key, in key=value form
+inline bool gt8_extract_info(char const* key, size_t keylen, char const* kv, size_t kvlen,
+                             char const*& value, size_t& valuelen)
+{
+    char const* end = kv + kvlen;
+    char const* entry = kv;
+    while (true) {
+        char const* entry_end = static_cast<char const*>(memchr(entry, ';', end - entry));
+        if (entry_end == NULL) entry_end = end;
+        if (((size_t)(entry_end - entry) >= keylen) && (memcmp(entry, key, keylen) == 0)) {
+            char const* eq = static_cast<char const*>(memchr(entry, '=', entry_end - entry));
+            if (eq == NULL) return false;
+            value = eq + 1;
+            char const* eq2 = static_cast<char const*>(memchr(value, '=', entry_end - value));
+            valuelen = ((eq2 == NULL) ? entry_end : eq2) - value;
+            return true;
+        }
+        if (entry_end == end) return false;
+        entry = entry_end + 1;
+    }
+}
+
+// Value in valStr at the position of key in the ':' separated fmtStr
+inline bool gt8_extract_format(char const* key, size_t keylen,
+                               char const* fmt, size_t fmtlen,
+                               char const* val, size_t vallen,
+                               char const*& value, size_t& valuelen)
+{
+    char const* end = fmt + fmtlen;
+    size_t pos = 0;
+    char const* field = fmt;
+    while (true) {
+        char const* field_end = static_cast<char const*>(memchr(field, ':', end - field));
+        if (field_end == NULL) field_end = end;
+        if (((size_t)(field_end - field) == keylen) && (memcmp(field, key, keylen) == 0)) break;
+        if (field_end == end) return false;
+        field = field_end + 1;
+        ++pos;
+    }
+
+    char const* vend = val + vallen;
+    char const* v = val;
+    for (size_t i = 0; i < pos; ++i) {
+        v = static_cast<char const*>(memchr(v, ':', vend - v));
+        if (v == NULL) return false;
+        ++v;
+    }
+    char const* v_end = static_cast<char const*>(memchr(v, ':', vend - v));
+    value = v;
+    valuelen = ((v_end == NULL) ? vend : v_end) - v;
+    return true;
+}
+
+// Number of entries in a comma separated list, 0 if empty
+inline uint32_t gt8_num_csv(char const* cell, size_t len)
+{
+    if (len == 0) return 0;
+    uint32_t count = 1;
+    for (size_t i = 0; i < len; ++i) {
+        if (cell[i] == ',') ++count;
+    }
+    return count;
+}
+
+#endif // ! GT8_H
@@ -0,0 +1,190 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file kinship.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Kernel of the kinship operator.  Has no SciDB dependencies.
+ *
+ * The calls of a block of variants are kept as three bit planes for
+ * each sample, called, het and hom-alt, 64 variants to a word.  The
+ * identity by state of a pair of samples over the block then comes from
+ * a few AND, OR and popcounts per word, accumulated one tile of sample
+ * pairs at a time so the planes of both tiles stay in cache.
+ *
+ * Over the variants called in both samples, IBS0 counts opposite
+ * homozygotes, IBS2 identical genotypes and IBS1 the rest.  The KING
+ * robust kinship coefficient is (N_het,het - 2 IBS0) / (N_het1 + N_het2),
+ * as in Manichaikul et al. 2010, with the hets of each sample counted
+ * over the same variants.  Any alternate allele counts as alt, and
+ * haploid calls are taken as missing.
+ */
+
+#ifndef KINSHIP_H
+#define KINSHIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gt8.h"
+
+// 64 bit words of each plane of a block of variants
+#define KINSHIP_BLOCK_WORDS 16
+
+// Counts of a pair of samples i < j
+struct ibs_counts {
+    uint32_t n;         // called in both
+    uint32_t ibs0;
+    uint32_t ibs2;
+    uint32_t hethet;
+    uint32_t het1;      // het in i, where both are called
+    uint32_t het2;      // het in j
+
+    uint32_t ibs1() const { return n - ibs0 - ibs2; }
+
+    // KING robust kinship, NAN without a het in either sample
+    double kinship() const
+    {
+        if (het1 + het2 == 0) return NAN;
+        return ((double)hethet - 2.0 * ibs0) / (het1 + het2);
+    }
+
+    void add(ibs_counts const& rhs)
+    {
+        n += rhs.n;
+        ibs0 += rhs.ibs0;
+        ibs2 += rhs.ibs2;
+        hethet += rhs.hethet;
+        het1 += rhs.het1;
+        het2 += rhs.het2;
+    }
+};
+
+class kinship_accumulator {
+public:
+    kinship_accumulator(size_t samples, size_t tile)
+        : _samples(samples), _tile(tile), _variant(0), _counts(samples * (samples - 1) / 2),
+          _called(samples * KINSHIP_BLOCK_WORDS, 0), _het(samples * KINSHIP_BLOCK_WORDS, 0),
+          _alt(samples * KINSHIP_BLOCK_WORDS, 0)
+    {
+        ibs_counts zero = { 0, 0, 0, 0, 0, 0 };
+        std::fill(_counts.begin(), _counts.end(), zero);
+    }
+
+    size_t samples() const { return _samples; }
+    size_t tile() const { return _tile; }
+
+    // Counts of the pair i < j
+    ibs_counts& counts(size_t i, size_t j) { return _counts[index(i, j)]; }
+
+    // Start a variant, its samples are missing until set
+    void next_variant()
+    {
+        if (_variant == 64 * KINSHIP_BLOCK_WORDS) flush();
+        ++_variant;
+    }
+
+    // The call of sample s at the current variant, after next_variant
+    void set(size_t s, gt8_t g)
+    {
+        if (!gt8_is_diploid(g) || gt8_allele_missing(g)) return;
+        size_t v = _variant - 1;
+        uint64_t bit = 1ULL << (v % 64);
+        size_t w = s * KINSHIP_BLOCK_WORDS + v / 64;
+        _called[w] |= bit;
+        bool alt_a = gt8_a(g) > 1;
+        bool alt_b = gt8_b(g) > 1;
+        if (alt_a != alt_b) _het[w] |= bit;
+        else if (alt_a) _alt[w] |= bit;
+    }
+
+    // Accumulate the variants of the current block
+    void flush()
+    {
+        if (_variant == 0) return;
+        size_t words = (_variant + 63) / 64;
+        for (size_t i0 = 0; i0 < _samples; i0 += _tile) {
+            for (size_t j0 = i0; j0 < _samples; j0 += _tile) {
+                size_t i1 = std::min(i0 + _tile, _samples);
+                size_t j1 = std::min(j0 + _tile, _samples);
+                for (size_t i = i0; i < i1; ++i) {
+                    for (size_t j = std::max(j0, i + 1); j < j1; ++j) pair(i, j, words);
+                }
+            }
+        }
+        std::fill(_called.begin(), _called.end(), 0);
+        std::fill(_het.begin(), _het.end(), 0);
+        std::fill(_alt.begin(), _alt.end(), 0);
+        _variant = 0;
+    }
+
+private:
+    static uint32_t popcount(uint64_t w) { return __builtin_popcountll(w); }
+
+    // Only the pairs i < j are kept, row by row
+    size_t index(size_t i, size_t j) const { return i * (2 * _samples - i - 1) / 2 + j - i - 1; }
+
+    void pair(size_t i, size_t j, size_t words)
+    {
+        uint64_t const* ci = &_called[i * KINSHIP_BLOCK_WORDS];
+        uint64_t const* cj = &_called[j * KINSHIP_BLOCK_WORDS];
+        uint64_t const* hi = &_het[i * KINSHIP_BLOCK_WORDS];
+        uint64_t const* hj = &_het[j * KINSHIP_BLOCK_WORDS];
+        uint64_t const* ai = &_alt[i * KINSHIP_BLOCK_WORDS];
+        uint64_t const* aj = &_alt[j * KINSHIP_BLOCK_WORDS];
+        ibs_counts& c = _counts[index(i, j)];
+        for (size_t w = 0; w < words; ++w) {
+            uint64_t both = ci[w] & cj[w];
+            if (both == 0) continue;
+            uint64_t het_i = hi[w] & both, het_j = hj[w] & both;
+            uint64_t alt_i = ai[w] & both, alt_j = aj[w] & both;
+            uint64_t ref_i = both & ~(het_i | alt_i), ref_j = both & ~(het_j | alt_j);
+            c.n += popcount(both);
+            c.ibs0 += popcount((alt_i & ref_j) | (ref_i & alt_j));
+            c.ibs2 += popcount((het_i & het_j) | (alt_i & alt_j) | (ref_i & ref_j));
+            c.hethet += popcount(het_i & het_j);
+            c.het1 += popcount(het_i);
+            c.het2 += popcount(het_j);
+        }
+    }
+
+    size_t _samples;
+    size_t _tile;
+    size_t _variant;                // in the current block
+    std::vector<ibs_counts> _counts;  // samples * (samples - 1) / 2 pairs
+    std::vector<uint64_t> _called;  // samples x KINSHIP_BLOCK_WORDS
+    std::vector<uint64_t> _het;
+    std::vector<uint64_t> _alt;
+};
+
+#endif // ! KINSHIP_H
@@ -0,0 +1,162 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file ld.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Linkage disequilibrium kernels of the ld operator.  The calls of
+ * a variant in a population are packed into bit vectors, 64 samples to a
+ * word, so the statistics of a pair of variants come from a few popcounts
+ * per word.  Has no SciDB dependencies.
+ *
+ * Alleles are counted as in gt8_dosage: any alternate is 1.  Only diploid
+ * calls without a missing allele are used, and a pair is measured over
+ * the samples called at both variants.  When every call of both variants
+ * is phased or homozygous D is taken from the haplotype counts, otherwise
+ * it is the composite estimate, half the covariance of the dosages, and
+ * r2 is the squared correlation of the dosages.
+ */
+
+#ifndef LD_H
+#define LD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "gt8.h"
+
+inline uint32_t ld_popcount(uint64_t w) { return __builtin_popcountll(w); }
+
+// The calls of one variant in one population
+struct ld_bits {
+    std::vector<uint64_t> a;        // first allele is an alternate
+    std::vector<uint64_t> b;        // second allele is an alternate
+    std::vector<uint64_t> valid;    // diploid with both alleles called
+    bool phased;                    // every het in valid is phased
+
+    void reset(size_t samples)
+    {
+        size_t words = (samples + 63) / 64;
+        a.assign(words, 0);
+        b.assign(words, 0);
+        valid.assign(words, 0);
+        phased = true;
+    }
+
+    void set(size_t i, gt8_t g)
+    {
+        if (!gt8_is_diploid(g) || gt8_allele_missing(g)) return;
+        uint64_t bit = 1ULL << (i % 64);
+        size_t w = i / 64;
+        valid[w] |= bit;
+        bool alt_a = gt8_a(g) > 1;
+        bool alt_b = gt8_b(g) > 1;
+        if (alt_a) a[w] |= bit;
+        if (alt_b) b[w] |= bit;
+        if ((alt_a != alt_b) && !gt8_is_phased(g)) phased = false;
+    }
+};
+
+struct ld_result {
+    double r2;
+    double dprime;      // |D'|
+    uint32_t n;         // samples called at both variants
+};
+
+// Dmax of D given the alternate allele frequencies p and q
+inline double ld_dmax(double d, double p, double q)
+{
+    if (d >= 0) return std::min(p * (1 - q), (1 - p) * q);
+    return std::min(p * q, (1 - p) * (1 - q));
+}
+
+// LD of x and y, false if either is monomorphic over their common samples
+inline bool ld_pair(ld_bits const& x, ld_bits const& y, ld_result& out)
+{
+    uint64_t n = 0, sx = 0, sy = 0, hx = 0, hy = 0, sxy = 0, hxy = 0;
+    size_t words = x.valid.size();
+    for (size_t w = 0; w < words; ++w) {
+        uint64_t v = x.valid[w] & y.valid[w];
+        uint64_t ax = x.a[w] & v, bx = x.b[w] & v;
+        uint64_t ay = y.a[w] & v, by = y.b[w] & v;
+        n += ld_popcount(v);
+        sx += ld_popcount(ax) + ld_popcount(bx);
+        sy += ld_popcount(ay) + ld_popcount(by);
+        hx += ld_popcount(ax & bx);
+        hy += ld_popcount(ay & by);
+        hxy += ld_popcount(ax & ay) + ld_popcount(bx & by);
+        sxy += ld_popcount(ax & by) + ld_popcount(bx & ay);
+    }
+    if (n == 0) return false;
+    sxy += hxy;
+    // Moments of the dosages, x^2 = x + 2 ab for a dosage of a + b
+    double mx = (double)sx / n, my = (double)sy / n;
+    double var_x = (double)(sx + 2 * hx) / n - mx * mx;
+    double var_y = (double)(sy + 2 * hy) / n - my * my;
+    if ((var_x <= 0) || (var_y <= 0)) return false;
+    double p = mx / 2, q = my / 2;
+    double d;
+    if (x.phased && y.phased) {
+        d = (double)hxy / (2 * n) - p * q;
+        out.r2 = d * d / (p * (1 - p) * q * (1 - q));
+    } else {
+        double cov = (double)sxy / n - mx * my;
+        d = cov / 2;
+        out.r2 = cov * cov / (var_x * var_y);
+    }
+    double dmax = ld_dmax(d, p, q);
+    out.dprime = (dmax > 0) ? std::min(std::fabs(d) / dmax, 1.0) : 0;
+    out.n = n;
+    return true;
+}
+
+// First sampleid of each population, from comma separated ascending numbers
+inline bool ld_parse_populations(std::string const& text, std::vector<int64_t>& starts)
+{
+    starts.clear();
+    char const* p = text.c_str();
+    while (*p) {
+        char* end;
+        long long v = strtoll(p, &end, 10);
+        if ((end == p) || (!starts.empty() && (v <= starts.back()))) return false;
+        starts.push_back(v);
+        p = end;
+        if (*p == ',') ++p;
+        else if (*p) return false;
+    }
+    return !starts.empty();
+}
+
+#endif // ! LD_H
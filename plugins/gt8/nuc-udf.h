@@ -0,0 +1,165 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file nuc-udf.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief User defined functions of the nuc type, written against the
+ * scidb::Value calling convention.  Include it exactly once per binary,
+ * after either the SciDB headers (gt8.cpp) or bench/scidb-value-stub.h.
+ * Alternate alleles are numbered from 1, as in the genotypes.
+ *
+ */
+
+#ifndef NUC_UDF_H
+#define NUC_UDF_H
+
+#include <string>
+#include "nuc.h"
+
+inline uint8_t const* nuc_data(const scidb::Value* v) { return static_cast<uint8_t const*>(v->data()); }
+
+void nuc_fromString(const scidb::Value** args, scidb::Value* res, void*)
+{
+    const char* s = args[0]->getString();
+    size_t len = strlen(s);
+    std::string buf(nuc_encoded_size(s, len), '\0');
+    nuc_encode(s, len, reinterpret_cast<uint8_t*>(&buf[0]));
+    res->setData(buf.data(), buf.size());
+}
+
+void nuc_toString(const scidb::Value** args, scidb::Value* res, void*)
+{
+    std::string s;
+    nuc_format(nuc_data(args[0]), args[0]->size(), s);
+    res->setString(s.c_str());
+}
+
+void nuc_equal(const scidb::Value** args, scidb::Value* res, void*)
+{
+    res->setBool((args[0]->size() == args[1]->size()) &&
+                 (memcmp(args[0]->data(), args[1]->data(), args[0]->size()) == 0));
+}
+
+// True iff every alternate is a single base substitution
+void nuc_isSnv(const scidb::Value** args, scidb::Value* res, void*)
+{
+    res->setBool(nuc_classify_all(nuc_data(args[0]), args[0]->size(),
+                                  nuc_data(args[1]), args[1]->size()) == eNucSnv);
+}
+
+// Class of the pair of alleles ref and alternate i, false if either is missing
+inline bool nuc_get_pair(const scidb::Value** args, int64_t i, nuc_allele& ref, nuc_allele& alt)
+{
+    return (i >= 1) && nuc_get(nuc_data(args[0]), args[0]->size(), 0, ref) &&
+        nuc_get(nuc_data(args[1]), args[1]->size(), i - 1, alt);
+}
+
+void nuc_isSnvAllele(const scidb::Value** args, scidb::Value* res, void*)
+{
+    nuc_allele ref, alt;
+    if (nuc_get_pair(args, args[2]->getInt64(), ref, alt))
+        res->setBool(nuc_classify(ref, alt) == eNucSnv);
+    else
+        res->setNull();
+}
+
+// True iff the only alternate is a transition
+void nuc_isTransition(const scidb::Value** args, scidb::Value* res, void*)
+{
+    nuc_allele ref, alt;
+    res->setBool((nuc_count(nuc_data(args[1]), args[1]->size()) == 1) &&
+                 nuc_get_pair(args, 1, ref, alt) && nuc_is_transition(ref, alt));
+}
+
+void nuc_isTransitionAllele(const scidb::Value** args, scidb::Value* res, void*)
+{
+    nuc_allele ref, alt;
+    if (nuc_get_pair(args, args[2]->getInt64(), ref, alt))
+        res->setBool(nuc_is_transition(ref, alt));
+    else
+        res->setNull();
+}
+
+// snv, mnv, insertion, deletion, indel, symbolic, ref, or mixed
+void nuc_variantClass(const scidb::Value** args, scidb::Value* res, void*)
+{
+    res->setString(nuc_class_name(nuc_classify_all(nuc_data(args[0]), args[0]->size(),
+                                                   nuc_data(args[1]), args[1]->size())));
+}
+
+void nuc_variantClassAllele(const scidb::Value** args, scidb::Value* res, void*)
+{
+    nuc_allele ref, alt;
+    if (nuc_get_pair(args, args[2]->getInt64(), ref, alt))
+        res->setString(nuc_class_name(nuc_classify(ref, alt)));
+    else
+        res->setNull();
+}
+
+void nuc_altAllele(const scidb::Value** args, scidb::Value* res, void*)
+{
+    int64_t i = args[1]->getInt64();
+    nuc_allele a;
+    if ((i < 1) || !nuc_get(nuc_data(args[0]), args[0]->size(), i - 1, a)) {
+        res->setNull();
+        return;
+    }
+    std::string s;
+    nuc_append(a, s);
+    res->setString(s.c_str());
+}
+
+// Length of the first allele, such as the REF
+void nuc_length(const scidb::Value** args, scidb::Value* res, void*)
+{
+    nuc_allele a;
+    if (nuc_get(nuc_data(args[0]), args[0]->size(), 0, a))
+        res->setUint32(a.length);
+    else
+        res->setNull();
+}
+
+void nuc_lengthAllele(const scidb::Value** args, scidb::Value* res, void*)
+{
+    int64_t i = args[1]->getInt64();
+    nuc_allele a;
+    if ((i >= 1) && nuc_get(nuc_data(args[0]), args[0]->size(), i - 1, a))
+        res->setUint32(a.length);
+    else
+        res->setNull();
+}
+
+void nuc_numAlleles(const scidb::Value** args, scidb::Value* res, void*)
+{
+    res->setUint32(nuc_count(nuc_data(args[0]), args[0]->size()));
+}
+
+#endif // ! NUC_UDF_H
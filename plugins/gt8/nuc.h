@@ -0,0 +1,302 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file nuc.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Codec and kernels for the nuc type, a compact form of the REF
+ * or ALT alleles of a variant.  Has no SciDB dependencies, so it is
+ * shared by the plugin and the loaders.
+ *
+ * Layout of a nuc value, one entry for each comma separated allele,
+ * each starting with a header byte h:
+ *   01bbbbbb, 10bbbbbb, 11bbbbbb:  1, 2 or 3 bases of ACGT, 2 bits each,
+ *                                  first base in the low bits
+ *   000nnnnn:  n + 4 bases, packed 4 to a byte in the bytes that follow
+ *   001nnnnn:  n bytes of text follow, for any other allele, and for
+ *              n = 31 a uint32 length, little endian, comes first
+ *
+ * So a SNV allele takes 1 byte, and "<DEL>", "*" or lower case bases are
+ * kept as they were written.
+ */
+
+#ifndef NUC_H
+#define NUC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#define NUC_INLINE_MAX 3
+#define NUC_PACKED_MAX (0x1F + 4)
+#define NUC_TEXT 0x20
+#define NUC_TEXT_MAX 0x1E
+#define NUC_LONG_TEXT 0x3F
+
+enum ENucClass {
+    eNucRef,        // the allele is the reference, or "."
+    eNucSnv,
+    eNucMnv,        // several bases replaced, same length
+    eNucInsertion,
+    eNucDeletion,
+    eNucIndel,      // replaced by a sequence of another length
+    eNucSymbolic,   // <ID>, breakends, "*" or bases other than ACGT
+    eNucMixed       // alleles of different classes
+};
+
+inline char const* nuc_class_name(ENucClass c)
+{
+    static char const* const names[] = {
+        "ref", "snv", "mnv", "insertion", "deletion", "indel", "symbolic", "mixed"
+    };
+    return names[c];
+}
+
+// 2 bit code of a base, -1 unless it is one of ACGT
+inline int nuc_code(char base)
+{
+    switch (base) {
+    case 'A': return 0;
+    case 'C': return 1;
+    case 'G': return 2;
+    case 'T': return 3;
+    default: return -1;
+    }
+}
+
+inline bool nuc_packable(char const* s, size_t len)
+{
+    if ((len == 0) || (len > NUC_PACKED_MAX)) return false;
+    for (size_t i = 0; i < len; ++i) {
+        if (nuc_code(s[i]) < 0) return false;
+    }
+    return true;
+}
+
+inline size_t nuc_allele_size(char const* s, size_t len)
+{
+    if (nuc_packable(s, len)) return (len <= NUC_INLINE_MAX) ? 1 : 1 + (len + 3) / 4;
+    return (len <= NUC_TEXT_MAX) ? 1 + len : 5 + len;
+}
+
+// Encoded size of the comma separated alleles in s
+inline size_t nuc_encoded_size(char const* s, size_t len)
+{
+    size_t size = 0;
+    char const* end = s + len;
+    for (char const* a = s; ; ) {
+        char const* comma = static_cast<char const*>(memchr(a, ',', end - a));
+        char const* a_end = comma ? comma : end;
+        size += nuc_allele_size(a, a_end - a);
+        if (!comma) break;
+        a = comma + 1;
+    }
+    return size;
+}
+
+inline size_t nuc_encode_allele(char const* s, size_t len, uint8_t* out)
+{
+    if (nuc_packable(s, len)) {
+        if (len <= NUC_INLINE_MAX) {
+            out[0] = len << 6;
+            for (size_t i = 0; i < len; ++i) out[0] |= nuc_code(s[i]) << (2 * i);
+            return 1;
+        }
+        out[0] = len - 4;
+        size_t nbytes = (len + 3) / 4;
+        memset(out + 1, 0, nbytes);
+        for (size_t i = 0; i < len; ++i) out[1 + i / 4] |= nuc_code(s[i]) << (2 * (i % 4));
+        return 1 + nbytes;
+    }
+    if (len <= NUC_TEXT_MAX) {
+        out[0] = NUC_TEXT + len;
+        memcpy(out + 1, s, len);
+        return 1 + len;
+    }
+    out[0] = NUC_LONG_TEXT;
+    uint32_t n = len;
+    for (int i = 0; i < 4; ++i) out[1 + i] = (n >> (8 * i)) & 0xFF;
+    memcpy(out + 5, s, len);
+    return 5 + len;
+}
+
+// Encode the comma separated alleles in s, out holds nuc_encoded_size bytes
+inline size_t nuc_encode(char const* s, size_t len, uint8_t* out)
+{
+    size_t size = 0;
+    char const* end = s + len;
+    for (char const* a = s; ; ) {
+        char const* comma = static_cast<char const*>(memchr(a, ',', end - a));
+        char const* a_end = comma ? comma : end;
+        size += nuc_encode_allele(a, a_end - a, out + size);
+        if (!comma) break;
+        a = comma + 1;
+    }
+    return size;
+}
+
+// One allele of a nuc value
+struct nuc_allele {
+    bool packed;
+    size_t length;      // in bases or chars
+    uint8_t const* data;
+
+    char base(size_t i) const
+    {
+        if (!packed) return data[i];
+        return "ACGT"[(data[i / 4] >> (2 * (i % 4))) & 3];
+    }
+};
+
+// Decode the allele at p, returns the next one, or NULL if it is cut short
+inline uint8_t const* nuc_next(uint8_t const* p, uint8_t const* end, nuc_allele& a)
+{
+    uint8_t h = *p;
+    size_t nbytes;
+    if (h >= 0x40) {
+        a.packed = true;
+        a.length = h >> 6;
+        a.data = p;
+        return p + 1;
+    }
+    ++p;
+    if (h < NUC_TEXT) {
+        a.packed = true;
+        a.length = h + 4;
+        nbytes = (a.length + 3) / 4;
+    } else if (h < NUC_LONG_TEXT) {
+        a.packed = false;
+        a.length = nbytes = h - NUC_TEXT;
+    } else {
+        if (end - p < 4) return NULL;
+        a.packed = false;
+        a.length = nbytes = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        p += 4;
+    }
+    if ((size_t)(end - p) < nbytes) return NULL;
+    a.data = p;
+    return p + nbytes;
+}
+
+// Allele i, counting from 0, false if there is no such allele
+inline bool nuc_get(uint8_t const* d, size_t size, size_t i, nuc_allele& a)
+{
+    uint8_t const* end = d + size;
+    for (uint8_t const* p = d; (p != NULL) && (p < end); --i) {
+        p = nuc_next(p, end, a);
+        if ((p != NULL) && (i == 0)) return true;
+    }
+    return false;
+}
+
+inline size_t nuc_count(uint8_t const* d, size_t size)
+{
+    size_t count = 0;
+    nuc_allele a;
+    uint8_t const* end = d + size;
+    for (uint8_t const* p = d; (p != NULL) && (p < end); ++count) p = nuc_next(p, end, a);
+    return count;
+}
+
+inline void nuc_append(nuc_allele const& a, std::string& out)
+{
+    if (!a.packed) {
+        out.append(reinterpret_cast<char const*>(a.data), a.length);
+        return;
+    }
+    for (size_t i = 0; i < a.length; ++i) out.push_back(a.base(i));
+}
+
+// Text form, the alleles separated by commas
+inline void nuc_format(uint8_t const* d, size_t size, std::string& out)
+{
+    out.clear();
+    nuc_allele a;
+    for (size_t i = 0; nuc_get(d, size, i, a); ++i) {
+        if (i > 0) out.push_back(',');
+        nuc_append(a, out);
+    }
+}
+
+inline bool nuc_equal(nuc_allele const& lhs, nuc_allele const& rhs)
+{
+    if ((lhs.packed == rhs.packed) && (lhs.length == rhs.length))
+        return memcmp(lhs.data, rhs.data, lhs.packed ? (lhs.length + 3) / 4 : lhs.length) == 0;
+    if (lhs.length != rhs.length) return false;
+    for (size_t i = 0; i < lhs.length; ++i) {
+        if (lhs.base(i) != rhs.base(i)) return false;
+    }
+    return true;
+}
+
+// Class of the change from ref to alt
+inline ENucClass nuc_classify(nuc_allele const& ref, nuc_allele const& alt)
+{
+    if (!alt.packed) {
+        if ((alt.length == 1) && (alt.data[0] == '.')) return eNucRef;
+        if (!ref.packed || (alt.length == 0) || (alt.data[0] == '<') || (alt.data[0] == '*') ||
+            memchr(alt.data, '[', alt.length) || memchr(alt.data, ']', alt.length)) return eNucSymbolic;
+    } else if (!ref.packed) {
+        return eNucSymbolic;
+    }
+    if (nuc_equal(ref, alt)) return eNucRef;
+    if (ref.length == alt.length) return (ref.length == 1) ? eNucSnv : eNucMnv;
+    // A shared leading base and nothing else changed is a plain insertion or deletion
+    size_t shorter = (ref.length < alt.length) ? ref.length : alt.length;
+    size_t same = 0;
+    while ((same < shorter) && (ref.base(same) == alt.base(same))) ++same;
+    if (same == shorter) return (ref.length < alt.length) ? eNucInsertion : eNucDeletion;
+    return eNucIndel;
+}
+
+// True iff ref and alt are single bases A<->G or C<->T
+inline bool nuc_is_transition(nuc_allele const& ref, nuc_allele const& alt)
+{
+    if (!ref.packed || !alt.packed || (ref.length != 1) || (alt.length != 1)) return false;
+    // With A=0, C=1, G=2 and T=3 the transitions differ in the high bit only
+    return ((ref.data[0] ^ alt.data[0]) & 3) == 2;
+}
+
+// Class of every alternate of a nuc value against the first allele of ref
+inline ENucClass nuc_classify_all(uint8_t const* ref, size_t ref_size, uint8_t const* alt, size_t alt_size)
+{
+    nuc_allele r, a;
+    if (!nuc_get(ref, ref_size, 0, r)) return eNucSymbolic;
+    ENucClass c = eNucRef;
+    for (size_t i = 0; nuc_get(alt, alt_size, i, a); ++i) {
+        ENucClass ci = nuc_classify(r, a);
+        if (i == 0) c = ci;
+        else if (ci != c) return eNucMixed;
+    }
+    return c;
+}
+
+#endif // ! NUC_H
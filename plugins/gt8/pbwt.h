@@ -0,0 +1,249 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Author:  Douglas Slotta
+ *
+ */
+
+/*
+ * @file pbwt.h
+ *
+ * @author slottad@ncbi.nlm.nih.gov
+ *
+ * @brief Positional Burrows-Wheeler transform (Durbin 2014) of phased
+ * gt8 calls, shared by the loader, which encodes it, and the pbwt_decode
+ * and pbwt_match operators.  Has no SciDB dependencies.
+ *
+ * Sample s has haplotypes 2s (allele a) and 2s + 1 (allele b).  At each
+ * variant the haplotypes are listed in the order of their reversed
+ * prefixes, the alleles before it, so haplotypes sharing a long history
+ * are next to each other and the column of allele codes, in that order,
+ * is a few long runs.  The order for the next variant is a stable sort of
+ * the current one by allele code.  A column is kept as its runs, and the
+ * order starts over as the identity at the first variant of each pos
+ * chunk, so every chunk can be decoded on its own.
+ *
+ * An allele code is 0 for a missing allele, else the allele + 1, as in
+ * a diploid gt8.  Only phased diploid calls are kept by the codes alone,
+ * any other call is also stored as is, an exception.
+ */
+
+#ifndef PBWT_H
+#define PBWT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "gt8.h"
+
+// Number of allele codes
+#define PBWT_CODES 8
+
+// Default pos chunk interval at which the order starts over, as the _gt array
+#define PBWT_CHUNK 200000
+
+// A run of haplotypes with the same allele code
+struct pbwt_run {
+    uint8_t code;
+    uint32_t length;
+};
+
+// True iff the codes of the haplotypes of g restore it exactly
+inline bool pbwt_is_plain(gt8_t g)
+{
+    return (g & (GT8_DIPLOID | GT8_PHASED)) == (GT8_DIPLOID | GT8_PHASED);
+}
+
+// Allele code of haplotype h (0 = a, 1 = b) of g, a haploid call is on a
+inline uint8_t pbwt_code(gt8_t g, int h)
+{
+    if (!gt8_is_diploid(g)) return (h == 0) ? std::min<uint8_t>(g, PBWT_CODES - 1) : 0;
+    return (h == 0) ? gt8_a(g) : gt8_b(g);
+}
+
+// Phased diploid gt8 of two allele codes
+inline gt8_t pbwt_call(uint8_t a, uint8_t b)
+{
+    return (gt8_t)(GT8_DIPLOID | GT8_PHASED | (a << 3) | b);
+}
+
+// The positional prefix order of the haplotypes at the current variant
+class pbwt_order {
+public:
+    pbwt_order() {}
+
+    // Start over with the haplotypes in order, before the first variant of a chunk
+    void reset(size_t haplotypes)
+    {
+        _order.resize(haplotypes);
+        for (size_t i = 0; i < haplotypes; ++i) _order[i] = i;
+        _codes.resize(haplotypes);
+    }
+
+    size_t haplotypes() const { return _order.size(); }
+
+    // Runs of the code of each haplotype in the current order, then move on to the next variant
+    void encode(uint8_t const* codes, std::vector<pbwt_run>& runs)
+    {
+        runs.clear();
+        for (size_t i = 0; i < _order.size(); ++i) {
+            uint8_t c = codes[_order[i]];
+            _codes[i] = c;
+            if (!runs.empty() && (runs.back().code == c)) {
+                ++runs.back().length;
+            } else {
+                pbwt_run r = { c, 1 };
+                runs.push_back(r);
+            }
+        }
+        advance();
+    }
+
+    /*
+     * The code of each haplotype from the runs of a variant, then move on
+     * to the next.  False if the runs do not cover the haplotypes.
+     */
+    bool decode(pbwt_run const* runs, size_t nruns, uint8_t* codes)
+    {
+        size_t i = 0;
+        for (size_t r = 0; r < nruns; ++r) {
+            if ((runs[r].code >= PBWT_CODES) || (runs[r].length > _order.size() - i)) return false;
+            for (uint32_t k = 0; k < runs[r].length; ++k, ++i) {
+                _codes[i] = runs[r].code;
+                codes[_order[i]] = runs[r].code;
+            }
+        }
+        if (i != _order.size()) return false;
+        advance();
+        return true;
+    }
+
+private:
+    // Stable counting sort of the order by the codes of the current variant
+    void advance()
+    {
+        size_t start[PBWT_CODES] = { 0 };
+        for (size_t i = 0; i < _codes.size(); ++i) ++start[_codes[i]];
+        size_t sum = 0;
+        for (int c = 0; c < PBWT_CODES; ++c) {
+            size_t n = start[c];
+            start[c] = sum;
+            sum += n;
+        }
+        _next.resize(_order.size());
+        for (size_t i = 0; i < _order.size(); ++i) _next[start[_codes[i]]++] = _order[i];
+        _order.swap(_next);
+    }
+
+    std::vector<uint32_t> _order;
+    std::vector<uint32_t> _next;
+    std::vector<uint8_t> _codes;    // in the current order
+};
+
+// A match of a haplotype with the query over sites first to last
+struct pbwt_match {
+    uint32_t haplotype;
+    uint64_t first;
+    uint64_t last;
+};
+
+/*
+ * Set-maximal matches of a query haplotype against the others: a match
+ * of the query with haplotype h over sites [first, last] which cannot be
+ * extended, and is not inside a longer match with another haplotype.
+ * Each haplotype keeps the first site of its current match, so when the
+ * matches of some haplotypes end at a site, those starting earliest are
+ * set-maximal unless a haplotype matching on past the site started no
+ * later.  Sites are numbered from 0 as they are given.  A site where the
+ * query allele is missing is passed over, and a missing allele of
+ * another haplotype ends its match.
+ */
+class pbwt_matcher {
+public:
+    pbwt_matcher(size_t haplotypes, uint32_t query, uint64_t min_sites)
+        : _query(query), _min_sites(min_sites), _site(0), _start(haplotypes, 0)
+    {
+    }
+
+    // Add the codes of the next site, by haplotype, appending the matches which end before it
+    void next_site(uint8_t const* codes, std::vector<pbwt_match>& matches)
+    {
+        uint8_t q = codes[_query];
+        if (q == 0) {
+            ++_site;
+            return;
+        }
+        uint64_t const none = std::numeric_limits<uint64_t>::max();
+        uint64_t on = none, ended = none;
+        for (size_t h = 0; h < _start.size(); ++h) {
+            if (h == _query) continue;
+            if (codes[h] == q) on = std::min(on, _start[h]);
+            else if (_start[h] < _site) ended = std::min(ended, _start[h]);
+        }
+        if (ended < on) report(ended, codes, q, matches);
+        for (size_t h = 0; h < _start.size(); ++h) {
+            if (codes[h] != q) _start[h] = _site + 1;
+        }
+        ++_site;
+    }
+
+    // Append the matches which run to the last site
+    void finish(std::vector<pbwt_match>& matches)
+    {
+        uint64_t first = std::numeric_limits<uint64_t>::max();
+        for (size_t h = 0; h < _start.size(); ++h) {
+            if ((h != _query) && (_start[h] < _site)) first = std::min(first, _start[h]);
+        }
+        if (first == std::numeric_limits<uint64_t>::max()) return;
+        for (size_t h = 0; h < _start.size(); ++h) {
+            if ((h != _query) && (_start[h] == first)) add(h, first, matches);
+        }
+    }
+
+private:
+    void report(uint64_t first, uint8_t const* codes, uint8_t q, std::vector<pbwt_match>& matches)
+    {
+        for (size_t h = 0; h < _start.size(); ++h) {
+            if ((h != _query) && (codes[h] != q) && (_start[h] == first)) add(h, first, matches);
+        }
+    }
+
+    // The match of h from first to the site before the current one
+    void add(size_t h, uint64_t first, std::vector<pbwt_match>& matches)
+    {
+        if (_site - first < _min_sites) return;
+        pbwt_match m = { (uint32_t)h, first, _site - 1 };
+        matches.push_back(m);
+    }
+
+    uint32_t _query;
+    uint64_t _min_sites;
+    uint64_t _site;
+    std::vector<uint64_t> _start;
+};
+
+#endif // ! PBWT_H
@@ -92,8 +92,15 @@ def get_column(db, query):
 def main():
     parser = argparse.ArgumentParser(description='Compute the allele counts for the given array.')
     parser.add_argument('array', help='The SciDB base array name')
+    parser.add_argument('--delta', type=int, metavar='SAMPLEID',
+                        help='Only count the samples from this sampleid on, and add them into the existing _counts')
     args = parser.parse_args()
 
+    counts = "%s_counts" % args.array
+    samples = "%s_samples" % args.array
+    if args.delta is not None:
+        samples = "filter(%s,row>=%s)" % (samples, args.delta)
+
     try: 
         db = scidb.connect("localhost", 1239)
     except Exception, inst: 
@@ -112,21 +119,40 @@ def main():
 
     idx_base = 0
     idx_max = count * len(populations) * (max_alleles+2) - 1
-    loading_array = "create array %s_counts_load<chrom:string,pos:int64,var:int64,alleles:uint64 null,samples:int64 null,population:string,allele:int64> [idx=0:*,1000000,0]" % args.array
-    do_query(db,loading_array)
 
-    sizes = get_column(db, "project(dimensions(%s),length)" % args.array)
-    chunks = get_column(db, "project(dimensions(%s),chunk_interval)" % args.array)
+    if args.delta is not None:
+        # The delta rows are added to the _counts_load of the last full run,
+        # and summed into _counts through its own chrom and population
+        # mappings, so they must fit the population and allele bounds
+        if not get_column(db, "filter(list('arrays'),name='%s_load')" % counts):
+            print >> sys.stderr, "No %s_load from a full run to add to" % counts
+            sys.exit(1)
+        old = set(get_column(db, "project(filter(%s_samples,row<%s),population)" % (args.array, args.delta)))
+        new = set(populations) - old - set(["global"])
+        if new:
+            print >> sys.stderr, "New populations need a full run:", ", ".join(sorted(new))
+            sys.exit(1)
+        allele_high = get_single_result(db, "project(filter(dimensions(%s),name='allele'),high)" % counts)
+        if max_alleles > allele_high:
+            print >> sys.stderr, "Alleles beyond", allele_high, "need a full run"
+            sys.exit(1)
+        idx_base = get_single_result(db, "aggregate(apply(%s_load,i,idx),max(i))" % counts) + 1
+    else:
+        loading_array = "create array %s_load<chrom:string,pos:int64,var:int64,alleles:uint64 null,samples:int64 null,population:string,allele:int64> [idx=0:*,1000000,0]" % counts
+        do_query(db,loading_array)
+
+        sizes = get_column(db, "project(dimensions(%s),length)" % args.array)
+        chunks = get_column(db, "project(dimensions(%s),chunk_interval)" % args.array)
 
-    final_array = "create array %s_counts<alleles:uint64 null, samples:int64 null> [chrom(string)=%s,1,0,pos=1:%s,%s,0,var=1:%s,%s,0,population(string)=%s,%s,0,allele=-1:%s,%s,0]" % (args.array, sizes[0], sizes[1], chunks[1], sizes[2], chunks[2], len(populations), len(populations), max_alleles, max_alleles+2)
-    #print final_array
-    do_query(db,final_array)
+        final_array = "create array %s<alleles:uint64 null, samples:int64 null> [chrom(string)=%s,1,0,pos=1:%s,%s,0,var=1:%s,%s,0,population(string)=%s,%s,0,allele=-1:%s,%s,0]" % (counts, sizes[0], sizes[1], chunks[1], sizes[2], chunks[2], len(populations), len(populations), max_alleles, max_alleles+2)
+        #print final_array
+        do_query(db,final_array)
 
     for population in populations:
         if population == "global":
-            pop_array = "cross_join(filter(project(%s_gt,gt),not(empty_gt(gt))),filter(%s_samples,founder),sampleid,row)" % (args.array, args.array)
+            pop_array = "cross_join(filter(project(%s_gt,gt),not(empty_gt(gt))),filter(%s,founder),sampleid,row)" % (args.array, samples)
         else:
-            pop_array = "cross_join(filter(project(%s_gt,gt),not(empty_gt(gt))),filter(%s_samples,population='%s' and founder),sampleid,row)" % (args.array, args.array, population)
+            pop_array = "cross_join(filter(project(%s_gt,gt),not(empty_gt(gt))),filter(%s,population='%s' and founder),sampleid,row)" % (args.array, samples, population)
 
         complete_alleles = []
         for allele in range(-1,max_alleles+1):
@@ -148,7 +174,7 @@ def main():
             redim_query = "redimension_store(%s_temp1,%s_temp2)" % (args.array, args.array)
             do_query(db,redim_query)
 
-            insert_query = "insert(%s_temp2,%s_counts_load)" % (args.array, args.array)
+            insert_query = "insert(%s_temp2,%s_load)" % (args.array, counts)
             do_query(db,insert_query)
 
             do_query(db,"remove(%s_temp1)" % args.array)
@@ -162,7 +188,15 @@ def main():
 
         print population, "\t", complete_alleles, " complete"
 
-    do_query(db, "redimension_store(%s_counts_load,%s_counts)" % (args.array, args.array))
+    if args.delta is None:
+        do_query(db, "redimension_store(%s_load,%s)" % (counts, counts))
+    else:
+        # The rows of a cell, from the full run and each delta, are summed.
+        # This rewrites all of _counts from a load array which grows with
+        # every delta, only the counting is limited to the new samples.
+        do_query(db, "redimension_store(%s_load,%s,sum(alleles) as alleles,sum(samples) as samples)" % (counts, counts))
+        print "added samples from", args.delta, "to", counts
+
     db.disconnect()     #Disconnect from the SciDB server.
 
     sys.exit(0) #success
@@ -0,0 +1,154 @@
+#!/opt/python-2.7/bin/python
+##!/usr/bin/python
+################################################################################
+#
+#                            PUBLIC DOMAIN NOTICE
+#               National Center for Biotechnology Information
+#
+#  This software/database is a "United States Government Work" under the
+#  terms of the United States Copyright Act.  It was written as part of
+#  the author's official duties as a United States Government employee and
+#  thus cannot be copyrighted.  This software/database is freely available
+#  to the public for use. The National Library of Medicine and the U.S.
+#  Government have not placed any restriction on its use or reproduction.
+#
+#  Although all reasonable efforts have been taken to ensure the accuracy
+#  and reliability of the software and data, the NLM and the U.S.
+#  Government do not and cannot warrant the performance or results that
+#  may be obtained by using this software or data. The NLM and the U.S.
+#  Government disclaim all warranties, express or implied, including
+#  warranties of performance, merchantability or fitness for any particular
+#  purpose.
+#
+#  Please cite the author in any work or product based on this material.
+#
+# ===========================================================================
+#
+# Author:  Douglas Slotta
+#
+################################################################################
+import os
+import sys
+import argparse
+import subprocess as sp
+from ScidbQuery import ScidbQuery
+import logging as log
+
+log.basicConfig(level='INFO', format='%(asctime)s %(message)s', datefmt='%Y-%m-%d %H:%M:%S')
+
+def dims(array):
+    """low, high and chunk_interval of each dimension of array, by name"""
+    records = query_obj.getRecords('project(dimensions(%s), name, low, high, chunk_interval)' % array)
+    return dict((r.name, (int(r.low), int(r.high), int(r.chunk_interval))) for r in records)
+
+def chunks_spanned(lo, hi, start, interval):
+    return (hi - start) // interval - (lo - start) // interval + 1
+
+def sample_runs(sampleids):
+    """Merge the sampleids into runs of consecutive ids"""
+    runs = []
+    for s in sorted(sampleids):
+        if runs and runs[-1][1] == s - 1:
+            runs[-1] = (runs[-1][0], s)
+        else:
+            runs.append((s, s))
+    return runs
+
+def pos_layout_chunks(d, nchroms, start, end, runs):
+    """Chunks of _gt read: every pos chunk of the region, for each sample chunk holding a sample"""
+    slo, shi, sc = d['sampleid']
+    sample_chunks = set()
+    for (a, b) in runs:
+        for c in range((a - slo) // sc, (b - slo) // sc + 1):
+            sample_chunks.add(c)
+    plo, phi, pc = d['pos']
+    return nchroms * chunks_spanned(start, end, plo, pc) * len(sample_chunks)
+
+def sample_layout_chunks(d, nchroms, start, end, runs):
+    """Chunks of _gt_bysample read: the pos chunks of the region, for each sample"""
+    plo, phi, pc = d['pos']
+    nsamples = sum(b - a + 1 for (a, b) in runs)
+    return nchroms * chunks_spanned(start, end, plo, pc) * nsamples
+
+def boxes(array, bysample, chromid, start, end, runs):
+    """Union of a between() box for each run of samples, on one or every chromosome"""
+    c = 'null' if chromid is None else str(chromid)
+    parts = []
+    for (a, b) in runs:
+        if bysample:
+            parts.append('between(%s,%d,%s,%d,null,%d,%s,%d,null)' % (array, a, c, start, b, c, end))
+        else:
+            parts.append('between(%s,%s,%d,null,%d,%s,%d,null,%d)' % (array, c, start, a, c, end, b))
+    query = parts[0]
+    for part in parts[1:]:
+        query = 'merge(%s,%s)' % (query, part)
+    return query
+
+def main():
+    parser = argparse.ArgumentParser(description='Read the genotypes of a few samples, from _gt or from the '
+                                     'sample-major _gt_bysample copy, whichever needs fewer chunks')
+    parser.add_argument('array', help='Base array name')
+    parser.add_argument('samples', help='comma separated sample names')
+    parser.add_argument('--chromid', help='only this chromosome', type=int)
+    parser.add_argument('--start', help='first pos of the region', type=int)
+    parser.add_argument('--end', help='last pos of the region', type=int)
+    parser.add_argument('-f', '--filter', help='filter on the genotypes, e.g. "dosage(gt) > 0"')
+    parser.add_argument('-l', '--layout', help='array to read (Default: auto)', choices=['auto', 'pos', 'sample'],
+                        default='auto')
+    parser.add_argument('-o', '--output', help='CSV output file (Default: stdout)')
+    parser.add_argument('--print', help='print the query instead of running it', action='store_true', dest='print_only')
+    parser.add_argument('-c', '--host', help='SciDB coordinator host (Default: localhost)', default='localhost')
+    parser.add_argument('-p', '--port', help='SciDB host port', default=1239, type=int)
+    parser.add_argument('--log_level', help='log output level', type=str, \
+        choices=['debug', 'info', 'warning', 'error', 'critical'], default='info')
+    args = parser.parse_args()
+
+    global query_obj; query_obj = ScidbQuery(server=args.host, port=args.port, log_level=args.log_level)
+
+    logger = log.getLogger()
+    logger.setLevel(args.log_level.upper())
+
+    names = [n.strip() for n in args.samples.split(',') if n.strip()]
+    terms = ' or '.join("sample = '%s'" % n for n in names)
+    records = query_obj.getRecords('filter(apply(%s_samples, sid, id), %s)' % (args.array, terms))
+    sampleids = [int(r.sid) for r in records]
+    if len(sampleids) < len(names):
+        log.warning('found %d of the %d samples' % (len(sampleids), len(names)))
+    if not sampleids:
+        log.error('no samples to read')
+        sys.exit(1)
+    runs = sample_runs(sampleids)
+
+    gt = dims('%s_gt' % args.array)
+    nchroms = 1 if args.chromid is not None else gt['chromid'][1] - gt['chromid'][0] + 1
+    start = args.start if args.start is not None else gt['pos'][0]
+    end = args.end if args.end is not None else gt['pos'][1]
+
+    pos_chunks = pos_layout_chunks(gt, nchroms, start, end, runs)
+    log.info('_gt: %d chunks' % pos_chunks)
+    bysample = False
+    if args.layout != 'pos' and len(query_obj.getRecords('show(%s_gt_bysample)' % args.array)) > 0:
+        sample_chunks = sample_layout_chunks(dims('%s_gt_bysample' % args.array), nchroms, start, end, runs)
+        log.info('_gt_bysample: %d chunks' % sample_chunks)
+        bysample = (args.layout == 'sample') or (sample_chunks < pos_chunks)
+    elif args.layout == 'sample':
+        log.error('there is no %s_gt_bysample array, see redimension.py --bysample' % args.array)
+        sys.exit(1)
+
+    array = '%s_gt_bysample' % args.array if bysample else 'project(%s_gt, gt)' % args.array
+    query = boxes(array, bysample, args.chromid, start, end, runs)
+    if args.filter:
+        query = 'filter(%s, %s)' % (query, args.filter)
+    log.info('reading %s' % ('_gt_bysample' if bysample else '_gt'))
+
+    if args.print_only:
+        print query
+        sys.exit(0)
+
+    iquery = '/opt/scidb/%s/bin/iquery' % os.environ['SCIDB_VER']
+    out = open(args.output, 'w') if args.output else sys.stdout
+    ret = sp.call([iquery, '-c', args.host, '-p', str(args.port), '-o', 'csv+', '-aq', query], stdout=out)
+    sys.exit(ret)
+
+if __name__ == "__main__":
+    main()
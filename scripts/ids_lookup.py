@@ -0,0 +1,127 @@
+#!/opt/python-2.7/bin/python
+##!/usr/bin/python
+################################################################################
+#
+#                            PUBLIC DOMAIN NOTICE
+#               National Center for Biotechnology Information
+#
+#  This software/database is a "United States Government Work" under the
+#  terms of the United States Copyright Act.  It was written as part of
+#  the author's official duties as a United States Government employee and
+#  thus cannot be copyrighted.  This software/database is freely available
+#  to the public for use. The National Library of Medicine and the U.S.
+#  Government have not placed any restriction on its use or reproduction.
+#
+#  Although all reasonable efforts have been taken to ensure the accuracy
+#  and reliability of the software and data, the NLM and the U.S.
+#  Government do not and cannot warrant the performance or results that
+#  may be obtained by using this software or data. The NLM and the U.S.
+#  Government disclaim all warranties, express or implied, including
+#  warranties of performance, merchantability or fitness for any particular
+#  purpose.
+#
+#  Please cite the author in any work or product based on this material.
+#
+# ===========================================================================
+#
+# Author:  Douglas Slotta
+#
+################################################################################
+import os
+import sys
+import argparse
+import tempfile
+import subprocess as sp
+from ScidbQuery import ScidbQuery
+import logging as log
+
+log.basicConfig(level='INFO', format='%(asctime)s %(message)s', datefmt='%Y-%m-%d %H:%M:%S')
+
+# Limits of the key dimension of the _ids array
+KEY_LOW = -2305843009213693952
+KEY_HIGH = 2305843009213693951
+
+def id_key(variant_id):
+    """Key of a variant ID, as id_key() in common/id-index.hpp: the number
+    of an rsID, otherwise a negative 61 bit FNV-1a hash"""
+    digits = variant_id[2:]
+    if variant_id.startswith('rs') and 0 < len(digits) <= 18 and digits.isdigit() and digits[0] != '0':
+        return int(digits)
+    h = 14695981039346656037
+    for c in variant_id:
+        h = ((h ^ ord(c)) * 1099511628211) & 0xFFFFFFFFFFFFFFFF
+    return -(h >> 3) - 1
+
+def read_ids(filename):
+    ids = set()
+    with open(filename) as f:
+        for line in f:
+            for variant_id in line.split():
+                ids.add(variant_id)
+    return sorted(ids)
+
+def main():
+    parser = argparse.ArgumentParser(description='Look up a batch of variant IDs through the _ids index')
+    parser.add_argument('array', help='Base array name')
+    parser.add_argument('ids', help='file of rsIDs or other variant IDs, separated by white space')
+    parser.add_argument('-o', '--output', help='CSV output file (Default: stdout)')
+    parser.add_argument('-c', '--host', help='SciDB coordinator host (Default: localhost)', default='localhost')
+    parser.add_argument('-p', '--port', help='SciDB host port', default=1239, type=int)
+    parser.add_argument('--log_level', help='log output level', type=str, \
+        choices=['debug', 'info', 'warning', 'error', 'critical'], default='info')
+    args = parser.parse_args()
+
+    global query_obj; query_obj = ScidbQuery(server=args.host, port=args.port, log_level=args.log_level)
+
+    logger = log.getLogger()
+    logger.setLevel(args.log_level.upper())
+
+    ids = read_ids(args.ids)
+    log.info('looking up %d ids' % len(ids))
+
+    # The IDs are loaded as a small array, then joined to the index by key
+    query_array = '%s_ids_query' % args.array
+    if len(query_obj.getRecords('show(%s)' % query_array)) > 0:
+        query_obj.serverActionOnly('remove(%s)' % query_array)
+
+    ver = os.environ['SCIDB_VER']
+    with tempfile.NamedTemporaryFile(suffix='.tsv', delete=False) as f:
+        for variant_id in ids:
+            f.write('%d\t%s\n' % (id_key(variant_id), variant_id))
+        loadfile = f.name
+    loadids = "/opt/scidb/%s/bin/loadcsv.py -p %d -x -q -d %s -D'\\t' -a %s -s '<key:int64,qid:string>[row=0:*,1000000,0]' -i %s" \
+        % (ver, args.port, args.host, query_array, loadfile)
+    log.debug('calling: %s' % loadids)
+    os.system(loadids)
+    os.unlink(loadfile)
+
+    # A _var from 'redimension.py --dictionary' has the id of its FILTER,
+    # named by <array>_filters
+    coded = query_obj.getRecords("filter(attributes(%s_var), name = 'filterid')" % args.array)
+    filter_attr = 'filterid' if len(coded) > 0 else 'filter'
+
+    lookup = """
+    project(
+        cross_join(
+            project(
+                filter(
+                    cross_join(
+                        {base}_ids as i,
+                        redimension({query}, <qid:string>[key={low}:{high},1000000,0]) as q,
+                        i.key, q.key),
+                    id = qid),
+                qid) as m,
+            {base}_var as v,
+            m.chromid, v.chromid, m.pos, v.pos, m.var, v.var),
+        qid, id, ref, alt, alleles, qual, {filter})
+    """.format(base = args.array, query = query_array, low = KEY_LOW, high = KEY_HIGH, filter = filter_attr)
+
+    iquery = '/opt/scidb/%s/bin/iquery' % ver
+    out = open(args.output, 'w') if args.output else sys.stdout
+    ret = sp.call([iquery, '-c', args.host, '-p', str(args.port), '-o', 'csv+', '-aq', ' '.join(lookup.split())], stdout=out)
+    query_obj.serverActionOnly('remove(%s)' % query_array)
+
+    sys.exit(ret)
+
+if __name__ == "__main__":
+    main()
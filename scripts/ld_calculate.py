@@ -0,0 +1,110 @@
+#!/opt/python-2.7/bin/python
+##!/usr/bin/python
+################################################################################
+#
+#                            PUBLIC DOMAIN NOTICE
+#               National Center for Biotechnology Information
+#
+#  This software/database is a "United States Government Work" under the
+#  terms of the United States Copyright Act.  It was written as part of
+#  the author's official duties as a United States Government employee and
+#  thus cannot be copyrighted.  This software/database is freely available
+#  to the public for use. The National Library of Medicine and the U.S.
+#  Government have not placed any restriction on its use or reproduction.
+#
+#  Although all reasonable efforts have been taken to ensure the accuracy
+#  and reliability of the software and data, the NLM and the U.S.
+#  Government do not and cannot warrant the performance or results that
+#  may be obtained by using this software or data. The NLM and the U.S.
+#  Government disclaim all warranties, express or implied, including
+#  warranties of performance, merchantability or fitness for any particular
+#  purpose.
+#
+#  Please cite the author in any work or product based on this material.
+#
+# ===========================================================================
+#
+# Author:  Douglas Slotta
+#
+################################################################################
+import os
+import sys
+import argparse
+from ScidbQuery import ScidbQuery
+import logging as log
+
+log.basicConfig(level='INFO', format='%(asctime)s %(message)s', datefmt='%Y-%m-%d %H:%M:%S')
+
+def population_starts(records):
+    """First sampleid of each run of samples of the same population"""
+    starts = []
+    for r in sorted(records, key=lambda r: int(r.sid)):
+        if not starts or starts[-1][1] != r.population:
+            starts.append((int(r.sid), r.population))
+    return starts
+
+def dim_high(array, dim):
+    return int(query_obj.getRecords("project(filter(dimensions(%s), name='%s'), high)" % (array, dim))[0].high)
+
+def main():
+    parser = argparse.ArgumentParser(description='Store the pairwise LD of the variants within a window, '
+                                     'for each population, with the ld operator of the gt8 plugin')
+    parser.add_argument('array', help='Base array name')
+    parser.add_argument('-w', '--window', help='largest distance in bases between the variants of a pair',
+                        default=100000, type=int)
+    parser.add_argument('-m', '--min-r2', help='leave out pairs with a lower r2', default=0.2, type=float)
+    parser.add_argument('--chunk', help='pos chunk interval of the _gt array', default=200000, type=int)
+    parser.add_argument('--chromid', help='only this chromosome', type=int)
+    parser.add_argument('--global', help='treat all samples as one population', action='store_true', dest='single')
+    parser.add_argument('--print', help='print the query instead of running it', action='store_true', dest='print_only')
+    parser.add_argument('-c', '--host', help='SciDB coordinator host (Default: localhost)', default='localhost')
+    parser.add_argument('-p', '--port', help='SciDB host port', default=1239, type=int)
+    parser.add_argument('--log_level', help='log output level', type=str, \
+        choices=['debug', 'info', 'warning', 'error', 'critical'], default='info')
+    args = parser.parse_args()
+
+    if args.window > args.chunk:
+        log.error('the window cannot be larger than the pos chunk')
+        sys.exit(1)
+
+    global query_obj; query_obj = ScidbQuery(server=args.host, port=args.port, log_level=args.log_level)
+
+    logger = log.getLogger()
+    logger.setLevel(args.log_level.upper())
+
+    gt = '%s_gt' % args.array
+    chrom_high = dim_high(gt, 'chromid')
+    pos_high = dim_high(gt, 'pos')
+    var_high = dim_high(gt, 'var')
+    sample_high = dim_high(gt, 'sampleid')
+
+    pops = ''
+    if not args.single:
+        records = query_obj.getRecords('apply(project(%s_samples, id, population), sid, id)' % args.array)
+        starts = population_starts(records)
+        for popid, (sampleid, population) in enumerate(starts):
+            log.info('popid %d: %s from sampleid %d' % (popid, population, sampleid))
+        if len(set(s[1] for s in starts)) != len(starts):
+            log.warning('the samples of a population are not numbered together, it has several popids')
+        pops = ", '%s'" % ','.join(str(s[0]) for s in starts)
+
+    source = 'project(%s, gt)' % gt
+    if args.chromid is not None:
+        source = 'between(%s, %d, null, null, null, %d, null, null, null)' % (source, args.chromid, args.chromid)
+    # The pos overlap carries the variants of the next chunk within the window
+    halo = """repart({source}, <gt:gt8 null>
+        [chromid=0:{chrom_high},1,0, pos=1:{pos_high},{chunk},{window},
+         var=1:{var_high},{var_high},0, sampleid=0:{sample_high},{samples},0])
+        """.format(source=source, chrom_high=chrom_high, pos_high=pos_high, chunk=args.chunk,
+                   window=args.window, var_high=var_high, sample_high=sample_high, samples=sample_high + 1)
+    query = 'store(ld(%s, %d, %s%s), %s_ld)' % (halo, args.window, repr(args.min_r2), pops, args.array)
+
+    if args.print_only:
+        print query
+        sys.exit(0)
+
+    log.info('computing LD into %s_ld' % args.array)
+    query_obj.serverActionOnly(query)
+
+if __name__ == "__main__":
+    main()
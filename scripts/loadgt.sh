@@ -14,6 +14,9 @@ OPTIONS:
    -d      SciDB coordinator system (default: localhost)
    -p      SciDB port
    -s      file containing the list of samples (required)
+   -M      write a JSON summary of loader throughput and wait times to this file
+   -Q      memory cap in MB of the queue in front of each loadcsv reader (default: 64)
+   -I      also load an index of the variant IDs into <dataset>_ids_load
 EOF
 }
 
@@ -22,6 +25,7 @@ cleanup()
     echo "Removing temporary files."
     rm $varloadpipe
     rm $gtloadpipe
+    rm -f $tmpdir/ids.tsv
     rmdir $tmpdir
 }
 
@@ -43,7 +47,10 @@ refsize=50
 dbsystem="localhost"
 samples=""
 port=1239
-while getopts "hc:d:s:p:?" flag
+metrics=""
+queue=""
+ids=""
+while getopts "hc:d:s:p:M:Q:I?" flag
 do
     case $flag in
         h)
@@ -68,6 +75,15 @@ do
         s)
             samples=$OPTARG
             ;;
+        M)
+            metrics=$OPTARG
+            ;;
+        Q)
+            queue=$OPTARG
+            ;;
+        I)
+            ids=1
+            ;;
         ?)
             usage
             exit 1
@@ -116,7 +132,18 @@ mkfifo $gtloadpipe
 chmod 666 $varloadpipe
 chmod 666 $gtloadpipe
 
-options="-s ${samples} ${varloadpipe} ${gtloadpipe}"
+options="-s ${samples}"
+if [[ $metrics ]]; then
+    options="${options} -m ${metrics}"
+fi
+if [[ $queue ]]; then
+    options="${options} -q ${queue}"
+fi
+if [[ $ids ]]; then
+    idsfile=$tmpdir/ids.tsv
+    options="${options} -x ${idsfile}"
+fi
+options="${options} ${varloadpipe} ${gtloadpipe}"
 case $2 in
     *.gz)
         decompress=zcat
@@ -128,7 +155,7 @@ esac
 
 
 # these loadcsv calls receive data from the fifo written to by vcf2csv
-var_load_array_def="<chrom: string, pos: int64, var: int64, id: string null, ref: string, alt: string, alleles: uint32, qual: float null, filter: string null, info: string null, format: string null >[row=0:*,${chunksize},0]"
+var_load_array_def="<chrom: string, pos: int64, var: int64, id: string null, ref: nuc, alt: nuc, alleles: uint32, qual: float null, filter: string null, info: string null, format: string null >[row=0:*,${chunksize},0]"
 echo "var_load fifo reader: $LOADCSV -x -q -d ${dbsystem} -p ${port} -D'\t' -a ${var_load_array} -s \"$var_load_array_def\" -i $varloadpipe"
 $LOADCSV -x -q -d ${dbsystem} -p ${port} -D'\t' -a ${var_load_array} -s "$var_load_array_def" -i $varloadpipe &
 
@@ -145,4 +172,14 @@ else
     result=(`pv ${files} | ${decompress} | ${VCF2CSV} ${options}`)
 fi
 
-exit $?
+status=$?
+
+# the ID index is written once the input is done, sorted by key
+if [[ $ids ]]; then
+    wait
+    ids_load_array_def="<key:int64,chrom:string,pos:int64,var:int64,id:string>[row=0:*,${chunksize},0]"
+    echo "ids_load: $LOADCSV -x -q -d ${dbsystem} -p ${port} -D'\t' -a ${array}_ids_load -s \"$ids_load_array_def\" -i $idsfile"
+    $LOADCSV -x -q -d ${dbsystem} -p ${port} -D'\t' -a ${array}_ids_load -s "$ids_load_array_def" -i $idsfile
+fi
+
+exit $status
@@ -0,0 +1,98 @@
+#!/opt/python-2.7/bin/python
+##!/usr/bin/python
+################################################################################
+#
+#                            PUBLIC DOMAIN NOTICE
+#               National Center for Biotechnology Information
+#
+#  This software/database is a "United States Government Work" under the
+#  terms of the United States Copyright Act.  It was written as part of
+#  the author's official duties as a United States Government employee and
+#  thus cannot be copyrighted.  This software/database is freely available
+#  to the public for use. The National Library of Medicine and the U.S.
+#  Government have not placed any restriction on its use or reproduction.
+#
+#  Although all reasonable efforts have been taken to ensure the accuracy
+#  and reliability of the software and data, the NLM and the U.S.
+#  Government do not and cannot warrant the performance or results that
+#  may be obtained by using this software or data. The NLM and the U.S.
+#  Government disclaim all warranties, express or implied, including
+#  warranties of performance, merchantability or fitness for any particular
+#  purpose.
+#
+#  Please cite the author in any work or product based on this material.
+#
+# ===========================================================================
+#
+# Author:  Douglas Slotta
+#
+################################################################################
+import os
+import sys
+import argparse
+from ScidbQuery import ScidbQuery
+import logging as log
+
+log.basicConfig(level='INFO', format='%(asctime)s %(message)s', datefmt='%Y-%m-%d %H:%M:%S')
+
+def dim_field(array, dim, field):
+    return int(getattr(query_obj.getRecords("project(filter(dimensions(%s), name='%s'), %s)" % (array, dim, field))[0], field))
+
+def main():
+    parser = argparse.ArgumentParser(description='Store the set-maximal matches of a haplotype with the others, '
+                                     'found in the PBWT of the phased genotypes by the pbwt_match operator of the gt8 plugin')
+    parser.add_argument('array', help='Base array name')
+    parser.add_argument('sample', help='name of the sample of the query haplotype')
+    parser.add_argument('-a', '--allele', help='query the first or second allele of the sample', choices=[1, 2],
+                        default=1, type=int)
+    parser.add_argument('-m', '--min-sites', help='shortest match in variants', default=100, type=int)
+    parser.add_argument('--chromid', help='only this chromosome', type=int)
+    parser.add_argument('-o', '--output', help='array to store the matches in (Default: <array>_match)')
+    parser.add_argument('--print', help='print the query instead of running it', action='store_true', dest='print_only')
+    parser.add_argument('-c', '--host', help='SciDB coordinator host (Default: localhost)', default='localhost')
+    parser.add_argument('-p', '--port', help='SciDB host port', default=1239, type=int)
+    parser.add_argument('--log_level', help='log output level', type=str, \
+        choices=['debug', 'info', 'warning', 'error', 'critical'], default='info')
+    args = parser.parse_args()
+
+    global query_obj; query_obj = ScidbQuery(server=args.host, port=args.port, log_level=args.log_level)
+
+    logger = log.getLogger()
+    logger.setLevel(args.log_level.upper())
+
+    records = query_obj.getRecords("filter(apply(%s_samples, sid, id), sample = '%s')" % (args.array, args.sample))
+    if len(records) == 0:
+        log.error('no sample %s in %s_samples' % (args.sample, args.array))
+        sys.exit(1)
+    haplotype = 2 * int(records[0].sid) + args.allele - 1
+    log.info('query haplotype: %d' % haplotype)
+
+    pbwt = '%s_pbwt' % args.array
+    chrom_high = dim_field(pbwt, 'chromid', 'high')
+    pos_high = dim_field(pbwt, 'pos', 'high')
+    interval = dim_field(pbwt, 'pos', 'chunk_interval')
+    var_high = dim_field(pbwt, 'var', 'high')
+    run_low = dim_field(pbwt, 'run', 'low')
+    run_high = dim_field(pbwt, 'run', 'high')
+
+    source = pbwt
+    if args.chromid is not None:
+        source = 'between(%s, %d, null, null, null, %d, null, null, null)' % (source, args.chromid, args.chromid)
+    # Each chromosome in one chunk, so its matches are found on one instance
+    source = """repart({source}, <code:uint8,length:uint32>
+        [chromid=0:{chrom_high},1,0, pos=1:{pos_high},{pos_high},0,
+         var=1:{var_high},{var_high},0, run={run_low}:{run_high},{runs},0])
+        """.format(source=source, chrom_high=chrom_high, pos_high=pos_high, var_high=var_high,
+                   run_low=run_low, run_high=run_high, runs=run_high - run_low + 1)
+    output = args.output if args.output else '%s_match' % args.array
+    query = 'store(pbwt_match(%s, %d, %d, %d), %s)' % (source, haplotype, args.min_sites, interval, output)
+
+    if args.print_only:
+        print query
+        sys.exit(0)
+
+    log.info('matching haplotype %d into %s' % (haplotype, output))
+    query_obj.serverActionOnly(query)
+
+if __name__ == "__main__":
+    main()
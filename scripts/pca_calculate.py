@@ -0,0 +1,89 @@
+#!/opt/python-2.7/bin/python
+##!/usr/bin/python
+################################################################################
+#
+#                            PUBLIC DOMAIN NOTICE
+#               National Center for Biotechnology Information
+#
+#  This software/database is a "United States Government Work" under the
+#  terms of the United States Copyright Act.  It was written as part of
+#  the author's official duties as a United States Government employee and
+#  thus cannot be copyrighted.  This software/database is freely available
+#  to the public for use. The National Library of Medicine and the U.S.
+#  Government have not placed any restriction on its use or reproduction.
+#
+#  Although all reasonable efforts have been taken to ensure the accuracy
+#  and reliability of the software and data, the NLM and the U.S.
+#  Government do not and cannot warrant the performance or results that
+#  may be obtained by using this software or data. The NLM and the U.S.
+#  Government disclaim all warranties, express or implied, including
+#  warranties of performance, merchantability or fitness for any particular
+#  purpose.
+#
+#  Please cite the author in any work or product based on this material.
+#
+# ===========================================================================
+#
+# Author:  Douglas Slotta
+#
+################################################################################
+import os
+import sys
+import argparse
+from ScidbQuery import ScidbQuery
+import logging as log
+
+log.basicConfig(level='INFO', format='%(asctime)s %(message)s', datefmt='%Y-%m-%d %H:%M:%S')
+
+def dim_high(array, dim):
+    return int(query_obj.getRecords("project(filter(dimensions(%s), name='%s'), high)" % (array, dim))[0].high)
+
+def main():
+    parser = argparse.ArgumentParser(description='Store the principal components of the samples, or their '
+                                     'genetic relationship matrix, with the pca and grm operators of the gt8 plugin')
+    parser.add_argument('array', help='Base array name')
+    parser.add_argument('-k', '--components', help='number of principal components', default=10, type=int)
+    parser.add_argument('--grm', help='store the relationship matrix in <array>_grm instead', action='store_true')
+    parser.add_argument('-f', '--filter', help='filter on the _var array selecting the variants, e.g. "alleles = 2"')
+    parser.add_argument('--print', help='print the query instead of running it', action='store_true', dest='print_only')
+    parser.add_argument('-c', '--host', help='SciDB coordinator host (Default: localhost)', default='localhost')
+    parser.add_argument('-p', '--port', help='SciDB host port', default=1239, type=int)
+    parser.add_argument('--log_level', help='log output level', type=str, \
+        choices=['debug', 'info', 'warning', 'error', 'critical'], default='info')
+    args = parser.parse_args()
+
+    global query_obj; query_obj = ScidbQuery(server=args.host, port=args.port, log_level=args.log_level)
+
+    logger = log.getLogger()
+    logger.setLevel(args.log_level.upper())
+
+    gt = '%s_gt' % args.array
+    chrom_high = dim_high(gt, 'chromid')
+    pos_high = dim_high(gt, 'pos')
+    var_high = dim_high(gt, 'var')
+    sample_high = dim_high(gt, 'sampleid')
+
+    source = 'project(%s, gt)' % gt
+    if args.filter:
+        source = 'project(cross_join(%s as G, filter(%s_var, %s) as V, G.chromid, V.chromid, G.pos, V.pos, G.var, V.var), gt)' % \
+                 (source, args.array, args.filter)
+    # Every variant with all of its samples in one chunk
+    source = """repart({source}, <gt:gt8 null>
+        [chromid=0:{chrom_high},1,0, pos=1:{pos_high},200000,0,
+         var=1:{var_high},{var_high},0, sampleid=0:{sample_high},{samples},0])
+        """.format(source=source, chrom_high=chrom_high, pos_high=pos_high, var_high=var_high,
+                   sample_high=sample_high, samples=sample_high + 1)
+    if args.grm:
+        query = 'store(grm(%s), %s_grm)' % (source, args.array)
+    else:
+        query = 'store(pca(%s, %d), %s_pca)' % (source, args.components, args.array)
+
+    if args.print_only:
+        print query
+        sys.exit(0)
+
+    log.info('computing %s' % ('the relationship matrix' if args.grm else 'the principal components'))
+    query_obj.serverActionOnly(query)
+
+if __name__ == "__main__":
+    main()
@@ -96,11 +96,55 @@ def redim_all_at_once():
     query_obj.serverActionOnly(gt_redim)
 
 
+def update_dictionary(attr):
+    """Add the values of attr in _var_load to <array>_<attr>s, numbered on
+    from its last id, creating it first if need be, with PASS as filter 0"""
+    dictionary = '%s_%ss' % (args.array, attr)
+    if len(query_obj.getRecords('show(%s)' % dictionary)) == 0:
+        query_obj.serverActionOnly('create array %s <%s:string>[%sid=0:*,1000000,0]' % (dictionary, attr, attr))
+        if attr == 'filter':
+            query_obj.serverActionOnly("store(build(<filter:string>[filterid=0:0,1000000,0], 'PASS'), %s)" % dictionary)
+
+    # Ids are line numbers, as in the --filters and --formats files, so new
+    # values go after the highest id, whatever gaps there are below it
+    high = query_obj.getRecords('aggregate(apply(%s, id, %sid), max(id))' % (dictionary, attr))[0].id_max
+    first = 0 if high in ('', 'null') else int(high) + 1
+    log.info('adding to the %s dictionary from id %s' % (attr, first))
+    add = """
+    insert(
+        redimension(
+            apply(
+                uniq(sort(project(
+                    filter(
+                        index_lookup(
+                            filter({base}_var_load, {attr} is not null),
+                            {dictionary},
+                            {base}_var_load.{attr},
+                            code),
+                        code is null),
+                    {attr}))),
+                {attr}id, i + {first}),
+            {dictionary}),
+        {dictionary})
+    """.format(base = args.array, attr = attr, dictionary = dictionary, first = first)
+
+    query_obj.serverActionOnly(add)
+
+
 def main():
     parser = gtUtils.argparser('host', 'port', 'log_level', description='Load a study to SciDB')
     parser.add_argument('array', help='Base array name')
     parser.add_argument('--nogt', help='skip redimension of the gt array', action='store_true')
     parser.add_argument('--novar', help='skip redimension of the var array', action='store_true')
+    parser.add_argument('--noids', help='skip redimension of the variant ID index', action='store_true')
+    parser.add_argument('--nosynopsis', help='skip redimension of the chunk synopsis', action='store_true')
+    parser.add_argument('--nopbwt', help='skip redimension of the haplotype PBWT', action='store_true')
+    parser.add_argument('--bysample', help='also store <array>_gt_bysample, chunked by sample', action='store_true')
+    parser.add_argument('--bysample-chunk', type=int, help='pos chunk interval of <array>_gt_bysample', default=50000000)
+    parser.add_argument('--carriers', help='only store the calls carrying an alternate allele in <array>_gt_bysample',
+                        action='store_true')
+    parser.add_argument('--dictionary', help='store filter and format in <array>_var as filterid and formatid, '
+                        'numbered by <array>_filters and <array>_formats', action='store_true')
     parser.add_argument('--redim_max', type=int, help='threshhold for redimensioning by parts', default=1000000000)
     global args; args = parser.parse_args()
 
@@ -137,11 +181,15 @@ def main():
     if len(exists) > 0:
         log.info('var array exists - will not recreate')
     else:
+        # With --dictionary the low cardinality strings are kept as their ids
+        coded = 'filterid:int64 null,info:string null,formatid:int64 null' if args.dictionary else \
+            'filter:string null,info:string null,format:string null'
         var_def = """
-        create array {base}_var<id:string null,ref:string,alt:string,alleles:uint32,
-        qual:float null,filter:string null,info:string null,format:string null> 
+        create array {base}_var<id:string null,ref:nuc,alt:nuc,alleles:uint32,
+        qual:float null,{coded}> 
         [chromid=0:{chrom_high},1,0, pos=1:{pos_high},200000,0, var=1:{var_high},{var_high},0]
-        """.format(base = args.array, chrom_high = chrom_high, pos_high = pos_high, var_high = var_high)
+        """.format(base = args.array, chrom_high = chrom_high, pos_high = pos_high, var_high = var_high,
+            coded = coded)
 
         query_obj.serverActionOnly(var_def) 
 
@@ -163,17 +211,32 @@ def main():
     # redimension _var_load
     if not args.novar:
         log.info('redimensioning var array')
+        var_load = '%s_var_load' % args.array
+        if args.dictionary:
+            update_dictionary('filter')
+            update_dictionary('format')
+            var_load = """
+                index_lookup(
+                    index_lookup(
+                        {base}_var_load,
+                        {base}_filters,
+                        {base}_var_load.filter,
+                        filterid),
+                    {base}_formats,
+                    {base}_var_load.format,
+                    formatid)
+            """.format(base = args.array)
         var_redim = """
         store(
             redimension(
                 index_lookup( 
-                    {base}_var_load, 
+                    {var_load}, 
                     project({base}_chroms, chrom), 
                     {base}_var_load.chrom, 
                     chromid),
                 {base}_var),
             {base}_var)
-        """.format(base = args.array)
+        """.format(base = args.array, var_load = var_load)
 
         tstart = datetime.datetime.now()
         query_obj.serverActionOnly(var_redim)
@@ -182,6 +245,108 @@ def main():
         log.info("finished variation array redimension - time: %s" % tdiff)
 
 
+    # redimension _ids_load, written by the loader with -I, into an array
+    # dimensioned on the rsID number or the hash of other IDs
+    if not args.noids and len(query_obj.getRecords('show(%s_ids_load)' % args.array)) > 0:
+        exists = query_obj.getRecords('show(%s_ids)' % args.array)
+        if len(exists) > 0:
+            log.info('ids array exists - will not recreate')
+        else:
+            ids_def = """
+            create array {base}_ids <id:string>
+            [key=-2305843009213693952:2305843009213693951,1000000,0,
+             chromid=0:{chrom_high},{chrom_chunk},0,
+             pos=1:{pos_high},{pos_high},0,
+             var=1:{var_high},{var_high},0]
+            """.format(base = args.array, chrom_high = chrom_high, chrom_chunk = int(chrom_high)+1,
+                pos_high = pos_high, var_high = var_high)
+
+            query_obj.serverActionOnly(ids_def)
+
+        log.info('redimensioning ids array')
+        ids_redim = """
+        store(
+            redimension(
+                index_lookup(
+                    {base}_ids_load,
+                    project({base}_chroms, chrom),
+                    {base}_ids_load.chrom,
+                    chromid),
+                {base}_ids),
+            {base}_ids)
+        """.format(base = args.array)
+
+        tstart = datetime.datetime.now()
+        query_obj.serverActionOnly(ids_redim)
+        tstop = datetime.datetime.now()
+        log.info("finished ids array redimension - time: %s" % (tstop - tstart))
+
+
+    # redimension _synopsis_load, the chunk summaries of vcf2scidb --synopsis
+    if not args.nosynopsis and len(query_obj.getRecords('show(%s_synopsis_load)' % args.array)) > 0:
+        exists = query_obj.getRecords('show(%s_synopsis)' % args.array)
+        if len(exists) > 0:
+            log.info('synopsis array exists - will not recreate')
+        else:
+            synopsis_def = """
+            create array {base}_synopsis <rows:uint64,min_pos:int64,max_pos:int64,
+            min_qual:double null,max_qual:double null,max_af:double,multiallelic:uint64,carriers:uint64>
+            [chromid=0:{chrom_high},1,0, chunk=0:*,10000,0]
+            """.format(base = args.array, chrom_high = chrom_high)
+
+            query_obj.serverActionOnly(synopsis_def)
+
+        log.info('redimensioning synopsis array')
+        synopsis_redim = """
+        store(
+            redimension(
+                index_lookup(
+                    {base}_synopsis_load,
+                    project({base}_chroms, chrom),
+                    {base}_synopsis_load.chrom,
+                    chromid),
+                {base}_synopsis),
+            {base}_synopsis)
+        """.format(base = args.array)
+
+        query_obj.serverActionOnly(synopsis_redim)
+
+
+    # redimension _pbwt_load, the PBWT runs of vcf2scidb --pbwt, whose
+    # order starts over at each pos chunk of the _gt array
+    if not args.nopbwt and len(query_obj.getRecords('show(%s_pbwt_load)' % args.array)) > 0:
+        exists = query_obj.getRecords('show(%s_pbwt)' % args.array)
+        if len(exists) > 0:
+            log.info('pbwt array exists - will not recreate')
+        else:
+            samples = int(sample_high) + 1
+            pbwt_def = """
+            create array {base}_pbwt <code:uint8,length:uint32>
+            [chromid=0:{chrom_high},1,0,
+             pos=1:{pos_high},200000,0,
+             var=1:{var_high},{var_high},0,
+             run=-{samples}:{run_high},{runs},0]
+            """.format(base = args.array, chrom_high = chrom_high, pos_high = pos_high, var_high = var_high,
+                samples = samples, run_high = 2 * samples - 1, runs = 3 * samples)
+
+            query_obj.serverActionOnly(pbwt_def)
+
+        log.info('redimensioning pbwt array')
+        pbwt_redim = """
+        store(
+            redimension(
+                index_lookup(
+                    {base}_pbwt_load,
+                    project({base}_chroms, chrom),
+                    {base}_pbwt_load.chrom,
+                    chromid),
+                {base}_pbwt),
+            {base}_pbwt)
+        """.format(base = args.array)
+
+        query_obj.serverActionOnly(pbwt_redim)
+
+
     # redimension _gt_load
     if not args.nogt:
         log.info('redimensioning genotype array')
@@ -199,6 +364,34 @@ def main():
         tdiff = tstop - tstart
         log.info("finished genotype array redimension - time: %s" % tdiff)
 
+    # A copy of _gt with one sample to a chunk, and a long pos extent, so
+    # the calls of an individual are a few chunks instead of every one
+    if args.bysample:
+        exists = query_obj.getRecords('show(%s_gt_bysample)' % args.array)
+        if len(exists) > 0:
+            log.info('gt_bysample array exists - will not recreate')
+        else:
+            bysample_def = """
+            create array {base}_gt_bysample <gt:gt8 null>
+            [sampleid=0:{sample_high},1,0,
+             chromid=0:{chrom_high},1,0,
+             pos=1:{pos_high},{pos_chunk},0,
+             var=1:{var_high},{var_high},0]
+            """.format(base = args.array, sample_high = sample_high, chrom_high = chrom_high,
+                pos_high = pos_high, pos_chunk = args.bysample_chunk, var_high = var_high)
+
+            query_obj.serverActionOnly(bysample_def)
+
+        source = 'project(%s_gt, gt)' % args.array
+        if args.carriers:
+            source = 'filter(%s, dosage(gt) > 0)' % source
+        log.info('redimensioning gt_bysample array')
+        tstart = datetime.datetime.now()
+        query_obj.serverActionOnly('store(redimension(%s, %s_gt_bysample), %s_gt_bysample)' %
+                                   (source, args.array, args.array))
+        tstop = datetime.datetime.now()
+        log.info("finished gt_bysample array redimension - time: %s" % (tstop - tstart))
+
     sys.exit(0) #success
 
 if __name__ == "__main__":
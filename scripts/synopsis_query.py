@@ -0,0 +1,122 @@
+#!/opt/python-2.7/bin/python
+##!/usr/bin/python
+################################################################################
+#
+#                            PUBLIC DOMAIN NOTICE
+#               National Center for Biotechnology Information
+#
+#  This software/database is a "United States Government Work" under the
+#  terms of the United States Copyright Act.  It was written as part of
+#  the author's official duties as a United States Government employee and
+#  thus cannot be copyrighted.  This software/database is freely available
+#  to the public for use. The National Library of Medicine and the U.S.
+#  Government have not placed any restriction on its use or reproduction.
+#
+#  Although all reasonable efforts have been taken to ensure the accuracy
+#  and reliability of the software and data, the NLM and the U.S.
+#  Government do not and cannot warrant the performance or results that
+#  may be obtained by using this software or data. The NLM and the U.S.
+#  Government disclaim all warranties, express or implied, including
+#  warranties of performance, merchantability or fitness for any particular
+#  purpose.
+#
+#  Please cite the author in any work or product based on this material.
+#
+# ===========================================================================
+#
+# Author:  Douglas Slotta
+#
+################################################################################
+import os
+import sys
+import argparse
+import subprocess as sp
+from ScidbQuery import ScidbQuery
+import logging as log
+
+log.basicConfig(level='INFO', format='%(asctime)s %(message)s', datefmt='%Y-%m-%d %H:%M:%S')
+
+def chunk_predicate(args):
+    """Conditions on the _synopsis of a chunk which may hold a matching row"""
+    terms = []
+    if args.min_qual is not None:
+        terms.append('max_qual >= %s' % args.min_qual)
+    if args.max_qual is not None:
+        terms.append('min_qual <= %s' % args.max_qual)
+    if args.min_af is not None:
+        terms.append('max_af >= %s' % args.min_af)
+    if args.multiallelic:
+        terms.append('multiallelic > 0')
+    if args.carriers:
+        terms.append('carriers > 0')
+    return ' and '.join(terms)
+
+def pos_ranges(chunks):
+    """Merge the pos bounds of chunks next to each other on a chromosome"""
+    ranges = []
+    for (chromid, chunk, min_pos, max_pos) in sorted(chunks):
+        if ranges and ranges[-1][0] == chromid and ranges[-1][1] == chunk - 1:
+            ranges[-1] = (chromid, chunk, ranges[-1][2], max_pos)
+        else:
+            ranges.append((chromid, chunk, min_pos, max_pos))
+    return [(r[0], r[2], r[3]) for r in ranges]
+
+def between_query(array, ndims, ranges):
+    """Union of the pos ranges of array, its extra dimensions unbounded"""
+    rest = ',null' * (ndims - 2)
+    boxes = ['between(%s,%d,%d%s,%d,%d%s)' % (array, c, lo, rest, c, hi, rest) for (c, lo, hi) in ranges]
+    query = boxes[0]
+    for box in boxes[1:]:
+        query = 'merge(%s,%s)' % (query, box)
+    return query
+
+def main():
+    parser = argparse.ArgumentParser(description='Run a filter on the _var or _gt array, reading only the chunks '
+                                     'which the _synopsis array says may match')
+    parser.add_argument('array', help='Base array name')
+    parser.add_argument('-f', '--filter', help='filter applied to the remaining chunks, e.g. "qual > 30"')
+    parser.add_argument('-g', '--gt', help='query the _gt array instead of _var', action='store_true')
+    parser.add_argument('--min-qual', help='skip chunks whose highest QUAL is below this')
+    parser.add_argument('--max-qual', help='skip chunks whose lowest QUAL is above this')
+    parser.add_argument('--min-af', help='skip chunks whose highest alternate allele frequency is below this')
+    parser.add_argument('--multiallelic', help='skip chunks without multi-allelic sites', action='store_true')
+    parser.add_argument('--carriers', help='skip chunks without carriers of an alternate allele', action='store_true')
+    parser.add_argument('--print', help='print the query instead of running it', action='store_true', dest='print_only')
+    parser.add_argument('-c', '--host', help='SciDB coordinator host (Default: localhost)', default='localhost')
+    parser.add_argument('-p', '--port', help='SciDB host port', default=1239, type=int)
+    parser.add_argument('--log_level', help='log output level', type=str, \
+        choices=['debug', 'info', 'warning', 'error', 'critical'], default='info')
+    args = parser.parse_args()
+
+    global query_obj; query_obj = ScidbQuery(server=args.host, port=args.port, log_level=args.log_level)
+
+    logger = log.getLogger()
+    logger.setLevel(args.log_level.upper())
+
+    synopsis = '%s_synopsis' % args.array
+    predicate = chunk_predicate(args)
+    if predicate:
+        synopsis = 'filter(%s, %s)' % (synopsis, predicate)
+    records = query_obj.getRecords('project(unpack(%s, row), chromid, chunk, min_pos, max_pos)' % synopsis)
+    chunks = [(int(r.chromid), int(r.chunk), int(r.min_pos), int(r.max_pos)) for r in records]
+    total = query_obj.getRecords('aggregate(%s_synopsis, count(*))' % args.array)[0].count
+    log.info('%d of %s chunks may match' % (len(chunks), total))
+    if not chunks:
+        sys.exit(0)
+
+    if args.gt:
+        query = between_query('%s_gt' % args.array, 4, pos_ranges(chunks))
+    else:
+        query = between_query('%s_var' % args.array, 3, pos_ranges(chunks))
+    if args.filter:
+        query = 'filter(%s, %s)' % (query, args.filter)
+
+    if args.print_only:
+        print query
+        sys.exit(0)
+
+    iquery = '/opt/scidb/%s/bin/iquery' % os.environ['SCIDB_VER']
+    sys.exit(sp.call([iquery, '-c', args.host, '-p', str(args.port), '-o', 'csv+', '-aq', query]))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,153 @@
+#!/bin/bash
+
+usage()
+{
+    cat << EOF
+usage: $0 options <dataset> <output.vcf.gz>
+
+Export the _var and _gt arrays of a dataset to a bgzipped VCF. Each
+chromosome is saved by a query of its own, several at a time, then
+vcfexport merges and compresses them.
+
+OPTIONS:
+   -h/-?   Show this message
+   -d      CSV file listing the sampleid and name of each sample (required)
+   -s      file listing the samples to export, one per line
+   -r      BED file of the regions to export
+   -j      chromosomes saved at once (default: 4)
+   -t      vcfexport threads (default: all cores)
+EOF
+}
+
+cleanup()
+{
+    echo "Removing temporary files."
+    rm -f $tmpdir/*.bin $tmpdir/*.txt
+    rmdir $tmpdir
+}
+
+if [ -z "$SCIDB_VER" ]; then
+    echo "SCIDB_VER must be set."
+    exit 1
+fi
+
+# Parameters
+SCRIPTDIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+IQUERY=/opt/scidb/$SCIDB_VER/bin/iquery
+VCFEXPORT=$SCRIPTDIR/vcfexport
+
+descriptions=""
+samples=""
+regions=""
+jobs=4
+threads=""
+while getopts "hd:s:r:j:t:?" flag
+do
+    case $flag in
+        d)
+            descriptions=$OPTARG
+            ;;
+        s)
+            samples=$OPTARG
+            ;;
+        r)
+            regions=$OPTARG
+            ;;
+        j)
+            jobs=$OPTARG
+            ;;
+        t)
+            threads=$OPTARG
+            ;;
+        h|?)
+            usage
+            exit 1
+            ;;
+    esac
+done
+
+if [[ ! $descriptions ]]; then
+    echo "The descriptions file is a required argument"
+    usage
+    exit 1
+fi
+
+shift $(($OPTIND - 1))
+if [ $# -ne 2 ]; then
+    echo "Arguments missing"
+    usage
+    exit 1
+fi
+array=$1
+output=$2
+
+var_types="(int64,int64,int64,string null,nuc,nuc,uint32,float null,string null,string null,string null)"
+gt_types="(int64,int64,int64,int64,gt8 null,string null)"
+var_schema=""
+
+# Wait for the saves started so far, stopping at the first which failed
+pids=""
+wait_saves()
+{
+    for pid in $pids
+    do
+        if ! wait $pid; then
+            echo "A save failed, nothing was exported"
+            exit 1
+        fi
+    done
+    pids=""
+}
+
+tmpdir=`mktemp -d /tmp/sdexport.XXXXXX` || exit 1
+trap cleanup EXIT
+chmod 777 $tmpdir
+
+$IQUERY -naq "save(project(${array}_chroms, chrom), '$tmpdir/chroms.txt', -2, 'tsv')" || exit 1
+nchroms=`wc -l < $tmpdir/chroms.txt`
+
+# A _var from 'redimension.py --dictionary' has the ids of FILTER and
+# FORMAT, named by its _filters and _formats arrays
+options=""
+if $IQUERY -ocsv -aq "filter(attributes(${array}_var), name='filterid')" | grep -q filterid; then
+    var_types="(int64,int64,int64,string null,nuc,nuc,uint32,float null,int64 null,string null,int64 null)"
+    var_schema="<id:string null,ref:nuc,alt:nuc,alleles:uint32,qual:float null,filterid:int64 null,info:string null,formatid:int64 null>[chromid=0:*,1,0,pos=1:*,200000,0,var=1:*,20,0]"
+    $IQUERY -naq "save(project(${array}_filters, filter), '$tmpdir/filters.txt', -2, 'tsv')" || exit 1
+    $IQUERY -naq "save(project(${array}_formats, format), '$tmpdir/formats.txt', -2, 'tsv')" || exit 1
+    options="--filters $tmpdir/filters.txt --formats $tmpdir/formats.txt"
+fi
+
+# unpack puts the dimensions first, as vcfexport reads them
+echo "Saving ${nchroms} chromosomes"
+for (( c=0; c<$nchroms; c++ ))
+do
+    $IQUERY -naq "save(unpack(between(${array}_var, $c, null, null, $c, null, null), row),
+                       '$tmpdir/var_$c.bin', -2, '$var_types')" > /dev/null &
+    pids="$pids $!"
+    $IQUERY -naq "save(unpack(between(${array}_gt, $c, null, null, null, $c, null, null, null), row),
+                       '$tmpdir/gt_$c.bin', -2, '$gt_types')" > /dev/null &
+    pids="$pids $!"
+    options="${options} -v $tmpdir/var_$c.bin -g $tmpdir/gt_$c.bin"
+    if (( (c + 1) % jobs == 0 )); then
+        wait_saves
+    fi
+done
+wait_saves
+
+if [[ $samples ]]; then
+    options="${options} -s ${samples}"
+fi
+if [[ $regions ]]; then
+    options="${options} -r ${regions}"
+fi
+if [[ $threads ]]; then
+    options="${options} -j ${threads}"
+fi
+
+if [[ $var_schema ]]; then
+    echo "calling: $VCFEXPORT --chroms $tmpdir/chroms.txt --var-schema \"$var_schema\" -d $descriptions -o $output $options"
+    $VCFEXPORT --chroms $tmpdir/chroms.txt --var-schema "$var_schema" -d $descriptions -o $output $options
+else
+    echo "calling: $VCFEXPORT --chroms $tmpdir/chroms.txt -d $descriptions -o $output $options"
+    $VCFEXPORT --chroms $tmpdir/chroms.txt -d $descriptions -o $output $options
+fi
@@ -42,6 +42,16 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <memory>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "load-metrics.hpp"
+#include "async-writer.hpp"
+#include "text-format.hpp"
+#include "thread-pool.hpp"
+#include "id-index.hpp"
 
 // Is 10MB a large enough buffer for a VCF line?
 // One hopes, but VCF is pathological
@@ -55,11 +65,20 @@ char* _inputFileName = NULL;
 char* _inputSamplesName = NULL;
 char* _outputVarName = NULL;
 char* _outputGtName = NULL;
+char* _metricsName = NULL;
+char* _idsName = NULL;
+unsigned _progress = 5;
+size_t _threads = 1;
+size_t _queueMB = ASYNC_WRITER_QUEUE_MB;
 
 FILE* _inputFile = NULL;
 FILE* _varFile = NULL;
 FILE* _gtFile = NULL;
 
+load_metrics _metrics("vcf2csv");
+stream_metrics& _varMetrics = _metrics.add_output("var");
+stream_metrics& _gtMetrics = _metrics.add_output("gt");
+
 typedef map<string, string> sampleMap_t;
 sampleMap_t _sampleMap;
 vector<string> _samples;
@@ -68,12 +87,29 @@ string _prevChromPos;
 int _curVar = 1;
 string _prefix;
 
+// Fewest samples worth encoding as a separate range
+#define SAMPLE_RANGE_MIN 1024
+
+thread_pool* _pool = NULL;
+vector<size_t> _sampleCols;
+vector<string> _rangeBufs;
+vector<size_t> _rangeRows;
+
+id_index _ids;
+
 void usage()
 {
     printf("Utility to split a VCF file into two CSV files.\n"
            "USAGE: vcf2csv <-s SAMPLES> [-i INPUT] file1 file2\n"
            "\t-s SAMPLES\tName of file containing sample descriptions. (REQUIRED)\n"
-           "\t-i INPUT\tInput file. (Default = stdin).\n");
+           "\t-i INPUT\tInput file. (Default = stdin).\n"
+           "\t-x IDS\t\tWrite the variant IDs with their chrom, pos and var, sorted by\n"
+           "\t\t\trsID number or hash, to IDS.\n"
+           "\t-m METRICS\tWrite a JSON summary of throughput and wait times to METRICS.\n"
+           "\t-p SECONDS\tProgress report interval on stderr, 0 disables. (Default = 5).\n"
+           "\t-t THREADS\tThreads encoding the sample columns of each row. (Default = 1).\n"
+           "\t-q MB\t\tMemory cap of the queue of each output, written by its own thread;\n"
+           "\t\t\t0 writes from the parsing thread. (Default = %d).\n", ASYNC_WRITER_QUEUE_MB);
 }
 
 void haltOnError(const char* errStr)
@@ -96,6 +132,16 @@ void parseArgs(int argc, char* argv[])
             _inputFileName = argv[++i];
         } else if (strcmp(argv[i], "-s") == 0) {
             _inputSamplesName = argv[++i];
+        } else if (strcmp(argv[i], "-x") == 0) {
+            _idsName = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            _metricsName = argv[++i];
+        } else if (strcmp(argv[i], "-p") == 0) {
+            _progress = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            _threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            _queueMB = atoi(argv[++i]);
         } else 
             break;
     }
@@ -149,25 +195,38 @@ void loadSamples()
 }
 
 
+// Open for writing as fopen(name, "w") would, with the writes timed and
+// done by a thread of their own unless the queue is disabled
+FILE* openOutput(const char* name, stream_metrics& metrics)
+{
+    int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) return NULL;
+    if (_queueMB > 0) return async_fdopen(fd, _queueMB << 20, &metrics);
+    return timed_fdopen(fd, "w", &metrics);
+}
+
 void openFiles()
 {
-    if (_inputFileName == NULL) {
-        _inputFile = stdin;
-    } else {
-        _inputFile = fopen(_inputFileName, "r");
-        if (_inputFile == NULL) {
+    int fd = STDIN_FILENO;
+    if (_inputFileName != NULL) {
+        fd = open(_inputFileName, O_RDONLY);
+        if (fd == -1) {
             haltOnError("Failed to open specified VCF input file.");
         }
     }
+    _inputFile = timed_fdopen(fd, "r", &_metrics.input());
+    if (_inputFile == NULL) {
+        haltOnError("Failed to open VCF input.");
+    }
     // Resize input buffer
     //setvbuf(_inputFile, NULL, _IOFBF, RB_SIZE*2);
 
-    _varFile = fopen(_outputVarName, "w");
+    _varFile = openOutput(_outputVarName, _varMetrics);
     if (_varFile == NULL) {
         haltOnError("Failed to open variation output file.");
     }
 
-    _gtFile = fopen(_outputGtName, "w");
+    _gtFile = openOutput(_outputGtName, _gtMetrics);
     if (_gtFile == NULL) {
         haltOnError("Failed to open genotype output file.");
     }
@@ -230,11 +289,87 @@ char* parse_format(char* fmt)
     return fmt;
 }
 
+// Append the genotype rows of samples [first, last) to buf
+size_t encodeSamples(char const* samples, size_t first, size_t last, bool has_gt, string& buf)
+{
+    size_t rows = 0;
+    for (size_t idx = first; idx < last; ++idx) {
+        if (_samples[idx].empty()) continue;
+        char const* gt = samples + _sampleCols[idx];
+        size_t len = _sampleCols[idx+1] - _sampleCols[idx] - 1;
+
+        buf.append(_prefix);
+        buf.append(_samples[idx]);
+        buf.push_back('\t');
+        if (has_gt) {
+            char const* pColon = static_cast<char const*>(memchr(gt, ':', len));
+            if (pColon) {
+                buf.append(gt, pColon - gt);
+                buf.push_back('\t');
+                buf.append(pColon + 1, gt + len - pColon - 1);
+            } else {
+                buf.append(gt, len);
+                buf.push_back('\t');
+            }
+        } else {
+            buf.push_back('\t');
+            buf.append(gt, len);
+        }
+        buf.push_back('\n');
+        ++rows;
+    }
+    return rows;
+}
+
+/*
+ * Write the genotype rows for the sample columns of a row.  A first pass
+ * finds the column boundaries, then ranges of samples are encoded on the
+ * thread pool into their own buffers, which are written in sample order.
+ */
+void parseSamples(char const* samples, size_t len, bool has_gt)
+{
+    find_columns(samples, len, _sampleCols);
+    size_t nsamples = _sampleCols.size() - 1;
+    if (nsamples > _samples.size()) {
+        size_t idx = _samples.size();
+        string gt(samples + _sampleCols[idx], _sampleCols[idx+1] - _sampleCols[idx] - 1);
+        fprintf(stderr, "gt-index exceeds _samples.size at: chrom_pos=%s, idx=%lu, gt=%s, _samples.size=%lu\n",_prefix.c_str(),idx, gt.c_str(), _samples.size());
+        exit(EXIT_FAILURE);
+    }
+
+    size_t nranges = 1;
+    if (_pool != NULL) {
+        nranges = min(_pool->size() * 4, nsamples / SAMPLE_RANGE_MIN);
+        if (nranges == 0) nranges = 1;
+    }
+    if (_rangeBufs.size() < nranges) {
+        _rangeBufs.resize(nranges);
+        _rangeRows.resize(nranges);
+    }
+
+    std::function<void(size_t)> encode = [&](size_t range) {
+        _rangeBufs[range].clear();
+        _rangeRows[range] = encodeSamples(samples, nsamples * range / nranges,
+                                          nsamples * (range + 1) / nranges, has_gt, _rangeBufs[range]);
+    };
+    if (_pool != NULL) _pool->run(nranges, encode);
+    else encode(0);
+
+    for (size_t range = 0; range < nranges; ++range) {
+        fwrite(_rangeBufs[range].data(), 1, _rangeBufs[range].size(), _gtFile);
+        _gtMetrics.add_rows(_rangeRows[range]);
+    }
+}
+
 void parseLine(char* line) {
+    char* lineEnd = line + strlen(line);
+    if ((lineEnd > line) && (lineEnd[-1] == '\n')) --lineEnd;
+
     char* chrom = strtok(line, "\t");
-    strtok(NULL, "\t"); // pos
+    char* pos = strtok(NULL, "\t");
+    size_t chromLen = strlen(chrom);
 
-    chrom[strlen(chrom)] = '\t';
+    chrom[chromLen] = '\t';
     string chromPos(chrom);
     if (chromPos == _prevChromPos) {
         ++_curVar;
@@ -250,6 +385,9 @@ void parseLine(char* line) {
     char* id = strtok(NULL, "\t");
     char* ref = strtok(NULL, "\t");
     char* alt = strtok(NULL, "\t");
+    if (_idsName != NULL) {
+        _ids.add(chrom, chromLen, parse_int64(pos, strlen(pos)), _curVar, id, strlen(id));
+    }
     size_t alleles = allele_count(alt);
     
     fprintf(_varFile, "%s\t%s\t%s\t%s\t", id, ref, alt, to_string(alleles).c_str());
@@ -266,33 +404,12 @@ void parseLine(char* line) {
     bool has_gt(new_format != format);
    
     fprintf(_varFile, "%s\t%s\t%s\t%s\n", qual, filter, info, new_format);
+    _varMetrics.add_rows(1);
 
-    size_t idx = 0;
-    char* gt = strtok(NULL, "\t");
-    while (gt != NULL) {
-		if (idx >= _samples.size())
-		{
-			fprintf(stderr, "gt-index exceeds _samples.size at: chrom_pos=%s, idx=%lu, gt=%s, _samples.size=%lu\n",_prefix.c_str(),idx, gt, _samples.size());
-			exit(EXIT_FAILURE);
-		}
-        if (! _samples[idx].empty() ) {
-
-            fprintf(_gtFile, "%s%s\t", _prefix.c_str(), _samples[idx].c_str());
-
-            if (has_gt) {
-                char* pColon = strchr(gt, ':');
-                if (pColon) {
-                    *pColon = '\t';
-                    fprintf(_gtFile, "%s\n", gt);
-                } else {
-                    fprintf(_gtFile, "%s\t\n", gt);
-                }
-            } else {
-                fprintf(_gtFile, "\t%s\n", gt);
-            }
-        }
-        gt = strtok(NULL, "\t\n");
-        ++idx;
+    // strtok has ended the FORMAT column, the samples follow it
+    char* samples = format + strlen(format) + 1;
+    if (samples < lineEnd) {
+        parseSamples(samples, lineEnd - samples, has_gt);
     }
 }
 
@@ -301,19 +418,33 @@ int main(int argc, char* argv[]) {
     loadSamples();
     openFiles();
     _prevChromPos.clear();
-    int row = 0;
-    while (fgets(_line, RB_SIZE, _inputFile) != NULL) {
-        if (strlen(_line) == 1) {
+    _metrics.start(_progress);
+    unique_ptr<thread_pool> pool;
+    if (_threads > 1) {
+        pool.reset(new thread_pool(_threads));
+        _pool = pool.get();
+    }
+    // Rows of very wide files can be much larger than RB_SIZE
+    char* line = NULL;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, _inputFile) != -1) {
+        if (strlen(line) == 1) {
             continue;
-        } else if (_line[0] == '#') {
-            if (_line[1] == '#') continue;
-            parseHeader(_line);
+        } else if (line[0] == '#') {
+            if (line[1] == '#') continue;
+            parseHeader(line);
         } else {
-            fprintf(stderr, "%d\n", ++row);
-            parseLine(_line);
+            _metrics.input().add_rows(1);
+            parseLine(line);
         }
     }
-    fprintf(stderr, "\n");
+    free(line);
     closeFiles();
+    if ((_idsName != NULL) && !_ids.write(_idsName)) {
+        fprintf(stderr, "ERROR: Failed to write ID index file %s\n", _idsName);
+    }
+    if (!_metrics.finish(_metricsName ? _metricsName : "", _progress == 0)) {
+        fprintf(stderr, "ERROR: Failed to write metrics file %s\n", _metricsName);
+    }
     exit(EXIT_SUCCESS);
 }
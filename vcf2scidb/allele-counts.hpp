@@ -0,0 +1,235 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Per-variant allele counts for each population, worked out while the
+ *   genotypes are scanned, and written as a tab separated load file for
+ *   the _counts array.  Like counts_calculate.py only founders are
+ *   counted, and the population "global" holds all of them.
+ *
+ */
+
+#ifndef ALLELE_COUNTS_HPP
+#define ALLELE_COUNTS_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "load-metrics.hpp"
+#include "text-format.hpp"
+#include "gt8.h"
+
+/*
+ * Counts for one variant, for each population and then global: the
+ * samples called and their alleles (AN), and for each allele the
+ * number of copies (AC) and of samples carrying it.
+ */
+class allele_tally {
+public:
+    allele_tally() : _groups(0), _alleles(0) {}
+
+    void reset(size_t groups, uint32_t alleles)
+    {
+        _groups = groups;
+        _alleles = alleles;
+        _counts.assign(groups * stride(), 0);
+    }
+
+    // Count a genotype of a sample in population pop
+    void add(size_t pop, gt8_t g)
+    {
+        if (gt8_is_empty(g)) return;
+        add_group(pop, g);
+        add_group(_groups - 1, g);
+    }
+
+    void merge(allele_tally const& other)
+    {
+        for (size_t i = 0; i < _counts.size(); ++i) _counts[i] += other._counts[i];
+    }
+
+    uint64_t called(size_t group) const { return _counts[group * stride()]; }
+    uint64_t an(size_t group) const { return _counts[group * stride() + 1]; }
+    uint64_t ac(size_t group, uint32_t allele) const { return _counts[group * stride() + 2 + 2 * allele]; }
+    uint64_t carriers(size_t group, uint32_t allele) const { return _counts[group * stride() + 3 + 2 * allele]; }
+
+private:
+    size_t stride() const { return 2 + 2 * _alleles; }
+
+    void add_group(size_t group, gt8_t g)
+    {
+        uint64_t* c = &_counts[group * stride()];
+        c[0] += 1;
+        c[1] += gt8_get_ploidy(g);
+        uint64_t a, b;
+        bool has_a = gt8_allele_value(g, 1, a) && (a < _alleles);
+        if (has_a) {
+            c[2 + 2 * a] += 1;
+            c[3 + 2 * a] += 1;
+        }
+        if (gt8_is_diploid(g) && gt8_allele_value(g, 2, b) && (b < _alleles)) {
+            c[2 + 2 * b] += 1;
+            // A homozygous sample carries the allele once
+            if (!has_a || (a != b)) c[3 + 2 * b] += 1;
+        }
+    }
+
+    size_t _groups;
+    uint32_t _alleles;
+    std::vector<uint64_t> _counts;
+};
+
+class population_counts {
+public:
+    // founders maps the sampleid of each founder to its population
+    population_counts(std::map<int64_t, std::string> const& founders)
+        : _file(NULL), _metrics(NULL)
+    {
+        for (std::map<int64_t, std::string>::const_iterator i = founders.begin(); i != founders.end(); ++i)
+            _populations.push_back(i->second);
+        std::sort(_populations.begin(), _populations.end());
+        _populations.erase(std::unique(_populations.begin(), _populations.end()), _populations.end());
+        for (std::map<int64_t, std::string>::const_iterator i = founders.begin(); i != founders.end(); ++i) {
+            _sample_pop[i->first] = std::lower_bound(_populations.begin(), _populations.end(), i->second)
+                - _populations.begin();
+        }
+        _populations.push_back("global");
+    }
+
+    ~population_counts() { close(); }
+
+    bool open(std::string const& filename, stream_metrics* metrics)
+    {
+        int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd == -1) return false;
+        _file = timed_fdopen(fd, "w", metrics);
+        if (_file == NULL) return false;
+        setvbuf(_file, NULL, _IOFBF, 1 << 18);
+        _metrics = metrics;
+        return true;
+    }
+
+    void close()
+    {
+        if (_file != NULL) fclose(_file);
+        _file = NULL;
+    }
+
+    // The population of each VCF sample column, from the sampleids of the header
+    void set_columns(std::vector<int64_t> const& sampleids)
+    {
+        _column_pop.assign(sampleids.size(), -1);
+        _pop_columns.assign(_populations.size(), 0);
+        for (size_t col = 0; col < sampleids.size(); ++col) {
+            std::map<int64_t, size_t>::const_iterator i = _sample_pop.find(sampleids[col]);
+            if ((sampleids[col] < 0) || (i == _sample_pop.end())) continue;
+            _column_pop[col] = i->second;
+            ++_pop_columns[i->second];
+            ++_pop_columns.back();
+        }
+    }
+
+    // Population of a sample column, -1 if it is not counted
+    int column_population(size_t col) const { return (col < _column_pop.size()) ? _column_pop[col] : -1; }
+
+    // Tallies for the sample ranges of a row, cleared for a variant with alleles
+    std::vector<allele_tally>& begin_row(size_t nranges, uint32_t alleles)
+    {
+        if (_tallies.size() < nranges) _tallies.resize(nranges);
+        for (size_t i = 0; i < nranges; ++i) _tallies[i].reset(_populations.size(), alleles);
+        return _tallies;
+    }
+
+    /*
+     * Write the rows of a variant, as chrom, pos, var, alleles, samples,
+     * population, allele and missing, where allele -1 holds AN, the
+     * samples called and the samples missing.
+     */
+    void end_row(boost::string_ref chrom, boost::string_ref pos, int64_t var, size_t nranges, uint32_t alleles)
+    {
+        allele_tally& total = _tallies[0];
+        for (size_t i = 1; i < nranges; ++i) total.merge(_tallies[i]);
+        char prefix[1024];
+        size_t plen = std::min(chrom.size(), sizeof(prefix) - 2 * FORMAT_INT64_MAX - 3);
+        memcpy(prefix, chrom.data(), plen);
+        prefix[plen++] = '\t';
+        size_t n = std::min(pos.size(), (size_t)FORMAT_INT64_MAX);
+        memcpy(prefix + plen, pos.data(), n);
+        plen += n;
+        prefix[plen++] = '\t';
+        plen += format_int64(var, prefix + plen);
+        prefix[plen++] = '\t';
+        for (size_t p = 0; p < _populations.size(); ++p) {
+            uint64_t called = total.called(p);
+            uint64_t missing = (_pop_columns[p] > called) ? _pop_columns[p] - called : 0;
+            put_row(prefix, plen, total.an(p), called, _populations[p], -1, &missing);
+            for (uint32_t a = 0; a < alleles; ++a)
+                put_row(prefix, plen, total.ac(p, a), total.carriers(p, a), _populations[p], a, NULL);
+        }
+    }
+
+private:
+    void put_row(char const* prefix, size_t plen, uint64_t count, uint64_t samples,
+                 std::string const& population, int64_t allele, uint64_t const* missing)
+    {
+        char line[1024 + 4 * FORMAT_INT64_MAX];
+        memcpy(line, prefix, plen);
+        size_t n = plen;
+        n += format_uint64(count, line + n);
+        line[n++] = '\t';
+        n += format_uint64(samples, line + n);
+        line[n++] = '\t';
+        fwrite(line, 1, n, _file);
+        fwrite(population.data(), 1, population.size(), _file);
+        n = 0;
+        line[n++] = '\t';
+        n += format_int64(allele, line + n);
+        line[n++] = '\t';
+        if (missing) n += format_uint64(*missing, line + n);
+        line[n++] = '\n';
+        fwrite(line, 1, n, _file);
+        if (_metrics) _metrics->add_rows(1);
+    }
+
+    FILE* _file;
+    stream_metrics* _metrics;
+    std::vector<std::string> _populations;
+    std::map<int64_t, size_t> _sample_pop;
+    std::vector<int> _column_pop;
+    std::vector<uint64_t> _pop_columns;
+    std::vector<allele_tally> _tallies;
+};
+
+#endif // ! ALLELE_COUNTS_HPP
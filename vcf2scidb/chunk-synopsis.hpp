@@ -0,0 +1,203 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Per-chunk synopsis of the variants, a zone map kept while the rows
+ *   are written: for each chromosome and pos chunk of the final arrays,
+ *   the row count, pos and qual bounds, highest alternate allele
+ *   frequency, multi-allelic sites and carriers.  Written as a table at
+ *   the end of the load so queries can skip chunks which cannot match.
+ *
+ */
+
+#ifndef CHUNK_SYNOPSIS_HPP
+#define CHUNK_SYNOPSIS_HPP
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "gt8.h"
+
+/* Default pos chunk interval of the _var and _gt arrays */
+#define SYNOPSIS_CHUNK 200000
+
+// Summary of the rows of one chunk
+struct chunk_summary {
+    chunk_summary()
+        : rows(0), min_pos(0), max_pos(0), min_qual(NAN), max_qual(NAN), max_af(0),
+          multiallelic(0), carriers(0) {}
+
+    uint64_t rows;
+    int64_t min_pos;
+    int64_t max_pos;
+    double min_qual;    // NAN until a row with a QUAL
+    double max_qual;
+    double max_af;
+    uint64_t multiallelic;
+    uint64_t carriers;  // samples with an alternate allele, summed over rows
+};
+
+class chunk_synopsis {
+public:
+    chunk_synopsis(int64_t interval = SYNOPSIS_CHUNK) : _interval(interval), _current(NULL), _nranges(0) {}
+
+    /*
+     * Start a variant, with qual NAN if it has none.  Its genotypes, if
+     * any, are added by range before the next row starts.
+     */
+    void begin_row(std::string const& chrom, int64_t pos, double qual, uint32_t alleles)
+    {
+        end_row();
+        int64_t chunk = (pos > 0) ? (pos - 1) / _interval : 0;
+        if ((_current == NULL) || (chrom != _chrom) || (chunk != _chunk)) {
+            _chrom = chrom;
+            _chunk = chunk;
+            _current = &_chunks[chunk_key(chrom, chunk)];
+        }
+        chunk_summary& s = *_current;
+        if ((s.rows == 0) || (pos < s.min_pos)) s.min_pos = pos;
+        if ((s.rows == 0) || (pos > s.max_pos)) s.max_pos = pos;
+        ++s.rows;
+        if (!std::isnan(qual)) {
+            if (std::isnan(s.min_qual) || (qual < s.min_qual)) s.min_qual = qual;
+            if (std::isnan(s.max_qual) || (qual > s.max_qual)) s.max_qual = qual;
+        }
+        if (alleles > 2) ++s.multiallelic;
+        _alleles = alleles;
+        _nranges = 0;
+    }
+
+    // Ready nranges sample ranges for the genotypes of the current row
+    void begin_samples(size_t nranges)
+    {
+        if (_ranges.size() < nranges) _ranges.resize(nranges);
+        for (size_t i = 0; i < nranges; ++i) _ranges[i].reset(_alleles);
+        _nranges = nranges;
+    }
+
+    // Count a genotype from sample range range
+    void add(size_t range, gt8_t g)
+    {
+        if (gt8_is_empty(g)) return;
+        range_tally& t = _ranges[range];
+        uint64_t a = 0, b = 0;
+        bool has_a = gt8_allele_value(g, 1, a) && (a < _alleles);
+        bool has_b = gt8_is_diploid(g) && gt8_allele_value(g, 2, b) && (b < _alleles);
+        if (has_a) { ++t.an; ++t.ac[a]; }
+        if (has_b) { ++t.an; ++t.ac[b]; }
+        if ((has_a && (a > 0)) || (has_b && (b > 0))) ++t.carriers;
+    }
+
+    // Fold the genotypes of the current row into its chunk
+    void end_row()
+    {
+        if ((_current == NULL) || (_nranges == 0)) return;
+        range_tally& total = _ranges[0];
+        for (size_t i = 1; i < _nranges; ++i) total.merge(_ranges[i]);
+        chunk_summary& s = *_current;
+        s.carriers += total.carriers;
+        for (uint32_t a = 1; (a < _alleles) && (total.an > 0); ++a) {
+            double af = (double)total.ac[a] / total.an;
+            if (af > s.max_af) s.max_af = af;
+        }
+        _nranges = 0;
+    }
+
+    /*
+     * One row for each chunk holding variants: chrom, chunk, rows,
+     * min_pos, max_pos, min_qual, max_qual, max_af, multiallelic and
+     * carriers.  Chunk k holds pos 1 + k * interval to (k + 1) * interval.
+     */
+    bool write(std::string const& filename)
+    {
+        end_row();
+        std::ofstream ofs(filename.c_str());
+        char qual[64];
+        for (chunk_map::const_iterator i = _chunks.begin(); i != _chunks.end(); ++i) {
+            chunk_summary const& s = i->second;
+            ofs << i->first.first << '\t' << i->first.second << '\t' << s.rows << '\t' << s.min_pos
+                << '\t' << s.max_pos << '\t' << format_qual(s.min_qual, qual);
+            ofs << '\t' << format_qual(s.max_qual, qual) << '\t' << format_af(s.max_af, qual)
+                << '\t' << s.multiallelic << '\t' << s.carriers << '\n';
+        }
+        return ofs.good();
+    }
+
+private:
+    typedef std::pair<std::string, int64_t> chunk_key;
+    typedef std::map<chunk_key, chunk_summary> chunk_map;
+
+    struct range_tally {
+        void reset(uint32_t alleles)
+        {
+            an = 0;
+            carriers = 0;
+            ac.assign(alleles, 0);
+        }
+
+        void merge(range_tally const& other)
+        {
+            an += other.an;
+            carriers += other.carriers;
+            for (size_t a = 0; a < ac.size(); ++a) ac[a] += other.ac[a];
+        }
+
+        uint64_t an;
+        uint64_t carriers;
+        std::vector<uint64_t> ac;
+    };
+
+    // Empty for a missing QUAL, so the column loads as null
+    static char const* format_qual(double q, char* buf)
+    {
+        if (std::isnan(q)) return "";
+        snprintf(buf, 64, "%g", q);
+        return buf;
+    }
+
+    static char const* format_af(double af, char* buf)
+    {
+        snprintf(buf, 64, "%.6g", af);
+        return buf;
+    }
+
+    int64_t _interval;
+    chunk_map _chunks;
+    chunk_summary* _current;
+    std::string _chrom;
+    int64_t _chunk;
+    uint32_t _alleles;
+    std::vector<range_tally> _ranges;
+    size_t _nranges;
+};
+
+#endif // ! CHUNK_SYNOPSIS_HPP
@@ -0,0 +1,171 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   PBWT of the phased genotypes, encoded while the rows are scanned and
+ *   written as a tab separated load file for the _pbwt array, see pbwt.h.
+ *   Each row holds chrom, pos, var, run, code and length.  Runs 0 and up
+ *   are the runs of allele codes of the variant in PBWT order; the calls
+ *   which are not phased diploid are rows with a negative run, the gt8 of
+ *   the call as code and its sampleid as length.
+ *
+ */
+
+#ifndef PBWT_WRITER_HPP
+#define PBWT_WRITER_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "load-metrics.hpp"
+#include "text-format.hpp"
+#include "gt8.h"
+#include "pbwt.h"
+
+class pbwt_writer {
+public:
+    pbwt_writer(int64_t interval = PBWT_CHUNK)
+        : _interval(interval), _file(NULL), _metrics(NULL), _chunk(-1)
+    {
+    }
+
+    ~pbwt_writer() { close(); }
+
+    bool open(std::string const& filename, stream_metrics* metrics)
+    {
+        int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd == -1) return false;
+        _file = timed_fdopen(fd, "w", metrics);
+        if (_file == NULL) return false;
+        setvbuf(_file, NULL, _IOFBF, 1 << 18);
+        _metrics = metrics;
+        return true;
+    }
+
+    void close()
+    {
+        if (_file != NULL) fclose(_file);
+        _file = NULL;
+    }
+
+    // Haplotypes for sampleids 0 to max_sampleid, from the header
+    void set_samples(int64_t max_sampleid)
+    {
+        _calls.assign(max_sampleid + 1, 0);
+        _called.assign(_calls.size(), 0);
+        _codes.assign(2 * _calls.size(), 0);
+        _chunk = -1;
+    }
+
+    // Start a variant, its calls are set before end_row
+    void begin_row(boost::string_ref chrom, boost::string_ref pos, int64_t var)
+    {
+        int64_t p = parse_int64(pos.data(), pos.size());
+        int64_t chunk = (p > 0) ? (p - 1) / _interval : 0;
+        if ((chunk != _chunk) || (chrom != _chrom)) {
+            _order.reset(_codes.size());
+            _chunk = chunk;
+            _chrom.assign(chrom.data(), chrom.size());
+        }
+        _pos.assign(pos.data(), pos.size());
+        _var = var;
+        std::fill(_calls.begin(), _calls.end(), 0);
+        std::fill(_called.begin(), _called.end(), 0);
+    }
+
+    // The call of a sample, from any thread as long as each sample is set by one
+    void set(int64_t sampleid, gt8_t g)
+    {
+        if ((sampleid < 0) || ((size_t)sampleid >= _calls.size())) return;
+        _calls[sampleid] = g;
+        _called[sampleid] = 1;
+    }
+
+    // Write the runs and exceptions of the variant
+    void end_row()
+    {
+        for (size_t s = 0; s < _calls.size(); ++s) {
+            _codes[2 * s] = pbwt_code(_calls[s], 0);
+            _codes[2 * s + 1] = pbwt_code(_calls[s], 1);
+        }
+        _order.encode(&_codes[0], _runs);
+
+        char prefix[1024];
+        size_t plen = std::min(_chrom.size(), sizeof(prefix) - 2 * FORMAT_INT64_MAX - 3);
+        memcpy(prefix, _chrom.data(), plen);
+        prefix[plen++] = '\t';
+        size_t n = std::min(_pos.size(), (size_t)FORMAT_INT64_MAX);
+        memcpy(prefix + plen, _pos.data(), n);
+        plen += n;
+        prefix[plen++] = '\t';
+        plen += format_int64(_var, prefix + plen);
+        prefix[plen++] = '\t';
+        for (size_t r = 0; r < _runs.size(); ++r) put_row(prefix, plen, r, _runs[r].code, _runs[r].length);
+        int64_t run = -1;
+        for (size_t s = 0; s < _calls.size(); ++s) {
+            gt8_t g = _calls[s];
+            if (_called[s] && !pbwt_is_plain(g)) put_row(prefix, plen, run--, g, s);
+        }
+    }
+
+private:
+    void put_row(char const* prefix, size_t plen, int64_t run, unsigned code, uint64_t length)
+    {
+        char line[1024 + 4 * FORMAT_INT64_MAX];
+        memcpy(line, prefix, plen);
+        size_t n = plen;
+        n += format_int64(run, line + n);
+        line[n++] = '\t';
+        n += format_uint64(code, line + n);
+        line[n++] = '\t';
+        n += format_uint64(length, line + n);
+        line[n++] = '\n';
+        fwrite(line, 1, n, _file);
+        if (_metrics) _metrics->add_rows(1);
+    }
+
+    int64_t _interval;
+    FILE* _file;
+    stream_metrics* _metrics;
+    std::string _chrom;
+    int64_t _chunk;
+    std::string _pos;
+    int64_t _var;
+    std::vector<gt8_t> _calls;      // by sampleid
+    std::vector<uint8_t> _called;
+    std::vector<uint8_t> _codes;    // by haplotype
+    std::vector<pbwt_run> _runs;
+    pbwt_order _order;
+};
+
+#endif // ! PBWT_WRITER_HPP
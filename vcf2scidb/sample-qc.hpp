@@ -0,0 +1,227 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Per-sample QC counters kept while the genotypes are scanned: call
+ *   rate, het/hom, singletons and Ti/Tv, written as a table at the end
+ *   of the load.  The ranges of a row hold distinct samples, so each
+ *   sample's counters are only updated by one thread at a time.  Only
+ *   the per-allele counts for singletons are kept per range and merged.
+ *
+ */
+
+#ifndef SAMPLE_QC_HPP
+#define SAMPLE_QC_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "gt8.h"
+
+// Counters of one sample, all sums, so the tables of several loads add up
+struct sample_stats {
+    sample_stats()
+        : called(0), hom_ref(0), het(0), hom_alt(0), singletons(0), transitions(0), transversions(0) {}
+
+    void merge(sample_stats const& other)
+    {
+        called += other.called;
+        hom_ref += other.hom_ref;
+        het += other.het;
+        hom_alt += other.hom_alt;
+        singletons += other.singletons;
+        transitions += other.transitions;
+        transversions += other.transversions;
+    }
+
+    uint64_t called;
+    uint64_t hom_ref;
+    uint64_t het;
+    uint64_t hom_alt;
+    uint64_t singletons;
+    uint64_t transitions;
+    uint64_t transversions;
+};
+
+enum ESubstitution {
+    eNotSnv,
+    eTransition,
+    eTransversion
+};
+
+inline ESubstitution substitution(char ref, char alt)
+{
+    static char const* const bases = "ACGT";
+    ref = toupper(ref);
+    alt = toupper(alt);
+    if ((ref == alt) || !strchr(bases, ref) || !strchr(bases, alt)) return eNotSnv;
+    // A<->G and C<->T are the purine and pyrimidine transitions
+    bool purine_ref = (ref == 'A') || (ref == 'G');
+    bool purine_alt = (alt == 'A') || (alt == 'G');
+    return (purine_ref == purine_alt) ? eTransition : eTransversion;
+}
+
+class sample_qc {
+public:
+    sample_qc() : _rows(0), _alleles(0) {}
+
+    // The sample of each VCF sample column, from the header, -1 if not loaded
+    void set_columns(std::vector<std::string> const& names, std::vector<int64_t> const& sampleids)
+    {
+        _names = names;
+        _sampleids = sampleids;
+        _stats.assign(names.size(), sample_stats());
+        _rows = 0;
+    }
+
+    // Start a variant with alleles, classifying its alternates against ref
+    void begin_row(size_t nranges, uint32_t alleles, boost::string_ref ref, boost::string_ref alt)
+    {
+        ++_rows;
+        _alleles = alleles;
+        _kind.assign(alleles, eNotSnv);
+        if (ref.size() == 1) {
+            size_t a = 1;
+            size_t start = 0;
+            for (size_t i = 0; (i <= alt.size()) && (a < alleles); ++i) {
+                if ((i < alt.size()) && (alt[i] != ',')) continue;
+                if (i - start == 1) _kind[a] = substitution(ref[0], alt[start]);
+                start = i + 1;
+                ++a;
+            }
+        }
+        if (_ranges.size() < nranges) _ranges.resize(nranges);
+        for (size_t i = 0; i < nranges; ++i) {
+            _ranges[i].ac.assign(alleles, 0);
+            _ranges[i].carrier.assign(alleles, 0);
+        }
+    }
+
+    // Count the genotype of the sample in column col, from sample range range
+    void add(size_t range, size_t col, gt8_t g)
+    {
+        if (gt8_is_empty(g) || (col >= _stats.size())) return;
+        sample_stats& s = _stats[col];
+        ++s.called;
+        uint64_t a = 0, b = 0;
+        bool has_a = gt8_allele_value(g, 1, a) && (a < _alleles);
+        bool has_b = gt8_is_diploid(g) && gt8_allele_value(g, 2, b) && (b < _alleles);
+        if (has_a && has_b) {
+            if (a != b) ++s.het;
+            else if (a == 0) ++s.hom_ref;
+            else ++s.hom_alt;
+        }
+        allele_counts& counts = _ranges[range];
+        if (has_a) carry(s, counts, col, a, false);
+        if (has_b) carry(s, counts, col, b, has_a && (a == b));
+    }
+
+    // Credit the singletons of the row to their carriers
+    void end_row(size_t nranges)
+    {
+        for (uint32_t a = 1; a < _alleles; ++a) {
+            uint64_t ac = 0;
+            size_t carrier = 0;
+            for (size_t i = 0; i < nranges; ++i) {
+                if (_ranges[i].ac[a] == 0) continue;
+                ac += _ranges[i].ac[a];
+                carrier = _ranges[i].carrier[a];
+            }
+            if (ac == 1) ++_stats[carrier].singletons;
+        }
+    }
+
+    // One row for each loaded sample, in sampleid order
+    bool write(std::string const& filename) const
+    {
+        std::ofstream ofs(filename.c_str());
+        ofs << "#sampleid\tsample\tcalled\tmissing\tcall_rate\thom_ref\thet\thom_alt\thet_hom_ratio"
+            << "\tsingletons\ttransitions\ttransversions\tti_tv\n";
+        std::vector<size_t> cols;
+        for (size_t col = 0; col < _sampleids.size(); ++col) {
+            if (_sampleids[col] >= 0) cols.push_back(col);
+        }
+        std::sort(cols.begin(), cols.end(), by_sampleid(_sampleids));
+        for (size_t i = 0; i < cols.size(); ++i) {
+            sample_stats const& s = _stats[cols[i]];
+            ofs << _sampleids[cols[i]] << '\t' << _names[cols[i]] << '\t' << s.called << '\t' << (_rows - s.called)
+                << '\t' << ratio(s.called, _rows) << '\t' << s.hom_ref << '\t' << s.het << '\t' << s.hom_alt
+                << '\t' << ratio(s.het, s.hom_alt) << '\t' << s.singletons << '\t' << s.transitions
+                << '\t' << s.transversions << '\t' << ratio(s.transitions, s.transversions) << '\n';
+        }
+        return ofs.good();
+    }
+
+private:
+    struct allele_counts {
+        std::vector<uint64_t> ac;
+        std::vector<size_t> carrier;
+    };
+
+    struct by_sampleid {
+        by_sampleid(std::vector<int64_t> const& ids) : _ids(ids) {}
+        bool operator()(size_t lhs, size_t rhs) const { return _ids[lhs] < _ids[rhs]; }
+        std::vector<int64_t> const& _ids;
+    };
+
+    // An allele copy of a sample, repeat is the second copy of a homozygote
+    void carry(sample_stats& s, allele_counts& counts, size_t col, uint64_t allele, bool repeat)
+    {
+        if (allele == 0) return;
+        ++counts.ac[allele];
+        counts.carrier[allele] = col;
+        if (repeat) return;
+        if (_kind[allele] == eTransition) ++s.transitions;
+        else if (_kind[allele] == eTransversion) ++s.transversions;
+    }
+
+    static std::string ratio(uint64_t num, uint64_t den)
+    {
+        if (den == 0) return "";
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.4f", (double)num / den);
+        return buf;
+    }
+
+    std::vector<std::string> _names;
+    std::vector<int64_t> _sampleids;
+    std::vector<sample_stats> _stats;
+    uint64_t _rows;
+    uint32_t _alleles;
+    std::vector<ESubstitution> _kind;
+    std::vector<allele_counts> _ranges;
+};
+
+#endif // ! SAMPLE_QC_HPP
@@ -37,15 +37,16 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <iostream>
-#include <sstream>
+#include <fstream>
+#include <ctype.h>
 
-#include <stdlib.h>
-#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
 
 using namespace std;
 using namespace boost;
 
-scidb_writer::scidb_writer(string const& filename)
+scidb_writer_base::scidb_writer_base(string const& filename)
+    : _metrics(NULL), _async(NULL), _buf(new char[SCIDB_WRITER_BUFSIZE]), _used(0), _failed(false)
 {
     /* Assumes the file exists and is probably a pipe, pipes required
      * to be read by other processes do not like to have the mode set
@@ -57,232 +58,301 @@ scidb_writer::scidb_writer(string const& filename)
          * previous failure was not catastrophic */
         _out = open(filename.c_str(), O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
     }
+    if (_out == -1) _failed = true;
 }
 
-scidb_writer::~scidb_writer()
+scidb_writer_base::~scidb_writer_base()
 {
-    close(_out);
+    close();
 }
 
-scidb_text_writer::scidb_text_writer(string const& filename, size_t chunksize)
-    : scidb_writer(filename), _chunksize(chunksize), _rowcount(0), _newchunk(false)
+void scidb_writer_base::close()
 {
-    write(_out, "[\n", 2);
-}
-
-scidb_text_writer::~scidb_text_writer()
-{
-    if (! _newchunk)
-        write(_out, "]\n", 2);
-    else
-        write(_out, "\n", 1);
-
+    if (_buf == NULL) return;
+    flush();
+    if (_async) {
+        // Give back the empty buffer and wait for the queue to drain
+        _async->put_block(_buf, 0);
+        _async->close();
+        if (_async->failed()) _failed = true;
+        delete _async;
+        _async = NULL;
+    } else {
+        delete[] _buf;
+    }
+    _buf = NULL;
+    if ((_out != -1) && (::close(_out) != 0)) _failed = true;
+    _out = -1;
 }
 
-void scidb_text_writer::set_var(int64_t var)
+void scidb_writer_base::set_queue(size_t max_bytes)
 {
-    _prefix =  "(\"" + _chrom + "\"," + _pos + ",";
-    _prefix.append(lexical_cast<string>(var));
-    _prefix.push_back(',');
+    if ((max_bytes == 0) || _async) return;
+    flush();
+    delete[] _buf;
+    _async = new async_writer(_out, SCIDB_WRITER_BUFSIZE, max_bytes, _metrics);
+    _buf = _async->get_block();
 }
 
-void scidb_text_writer::put_prefix()
+void scidb_writer_base::flush()
 {
-    if (_newchunk) {
-        write(_out, ";\n[\n", 4);
-        _newchunk=false;
+    if (_used > 0) {
+        if (_async) {
+            _async->put_block(_buf, _used);
+            _buf = _async->get_block();
+        } else if (timed_write(_out, _buf, _used, _metrics) < 0) {
+            _failed = true;
+        }
+        _used = 0;
     }
-    write(_out, _prefix.c_str(), _prefix.size());
 }
 
-void scidb_text_writer::put_separator()
+void scidb_writer_base::out_large(void const* data, size_t size)
 {
-    write(_out, ",", 1);
-}
-
-void scidb_text_writer::put_endrow()
-{
-    ++_rowcount;
-    write(_out, ")\n", 2);
-    if ((_rowcount % _chunksize) == 0) {
-        write(_out,"]",1);
-        _newchunk = true;
+    if (_async) {
+        _async->write(data, size);
+        _async->flush();
+    } else if (timed_write(_out, data, size, _metrics) < 0) {
+        _failed = true;
     }
 }
 
-void scidb_text_writer::put_data(std::string const& data, ENullData nullstatus, EDataType type)
+scidb_text_writer::scidb_writer(string const& filename, size_t chunksize)
+    : scidb_writer_base(filename), _chunksize(chunksize), _rowcount(0), _newchunk(false)
 {
-
-    if (data.empty() && (nullstatus == eNullable)) {
-        write(_out, "?", 1);
-    } else {
-        bool isString = ((type == eString) || (type == eGt8));
-        if (isString) write(_out, "\"", 1);
-        write(_out, data.c_str(), data.size());
-        if (isString) write(_out, "\"", 1);
-    }
+    out("[\n", 2);
 }
 
-void scidb_text_writer::put_uint32(uint32_t data)
+scidb_text_writer::~scidb_writer()
 {
-    string strData = lexical_cast<string>(data);
-    write(_out, strData.c_str(), strData.size());
+    close();
 }
 
-void scidb_text_writer::put_int64(int64_t data)
+void scidb_text_writer::close()
 {
-    string strData = lexical_cast<string>(data);
-    write(_out, strData.c_str(), strData.size());
+    if (_buf == NULL) return;
+    if (! _newchunk)
+        out("]\n", 2);
+    else
+        out('\n');
+    scidb_writer_base::close();
 }
 
-scidb_binary_writer::scidb_binary_writer(string const& filename)
-    : scidb_writer(filename)
+scidb_binary_writer::scidb_writer(string const& filename)
+    : scidb_writer_base(filename), _pos(0)
 {}
 
-scidb_binary_writer::~scidb_binary_writer()
+scidb_binary_writer::~scidb_writer()
 {
 }
 
-void scidb_binary_writer::set_var(int64_t var)
+scidb_schema_writer::scidb_writer(string const& filename, load_schema const& schema, chrom_dictionary& chroms)
+    : scidb_writer_base(filename), _attrs(schema.attributes()), _chroms(chroms), _filters(NULL), _formats(NULL),
+      _chromid(0), _pos(0), _var(0), _next(eFieldId), _gl_key(NO_GL_KEY), _gl_log10(false), _alleles(0)
 {
-    ostringstream oss;
-
-    uint32_t sz = _chrom.size()+1;
-    oss.write(reinterpret_cast<char *>(&sz), sizeof(sz));
-    oss.write(_chrom.c_str(), sz);
-    int64_t pos = atol(_pos.c_str());
-    oss.write(reinterpret_cast<char *>(&pos), sizeof(pos));
-    oss.write(reinterpret_cast<char *>(&var), sizeof(var));
-    _prefix = oss.str();
+    fill(_bound, _bound + eFieldCount, (load_attribute const*)NULL);
+    for (size_t i = 0; i < _attrs.size(); ++i) {
+        if (_attrs[i].field >= eFieldId) _bound[_attrs[i].field] = &_attrs[i];
+    }
 }
 
-void scidb_binary_writer::put_prefix()
+scidb_schema_writer::~scidb_writer()
 {
-    write(_out, _prefix.c_str(), _prefix.size());
 }
 
-void scidb_binary_writer::put_separator()
+str_ref scidb_schema_writer::set_format(str_ref format, uint32_t alleles)
 {
+    _alleles = alleles;
+    _gl_key = NO_GL_KEY;
+    if (_bound[eFieldGl] == NULL) return format;
+    // PL is taken in preference to GL
+    size_t begin = 0;
+    for (size_t i = 0; begin <= format.size(); ++i) {
+        size_t end = format_colon(format, begin);
+        if (end == str_ref::npos) end = format.size();
+        str_ref key = format.substr(begin, end - begin);
+        if (key == "PL") {
+            _gl_key = i;
+            _gl_log10 = false;
+            break;
+        }
+        if ((key == "GL") && (_gl_key == NO_GL_KEY)) {
+            _gl_key = i;
+            _gl_log10 = true;
+        }
+        begin = end + 1;
+    }
+    if (_gl_key == NO_GL_KEY) return format;
+    str_ref head, tail;
+    format_item(format, _gl_key, head, tail);
+    _format.assign(head.data(), head.size());
+    _format.append(tail.data(), tail.size());
+    return _format;
 }
 
-void scidb_binary_writer::put_endrow()
+struct load_field_name {
+    char const* name;
+    ELoadField field;
+    // Streams which supply the value, a bit for each ELoadStream
+    int streams;
+};
+
+#define BOTH_STREAMS ((1 << eVarStream) | (1 << eGtStream))
+
+static load_field_name const load_field_names[] = {
+    {"chrom", eFieldChrom, BOTH_STREAMS},
+    {"chromid", eFieldChromId, BOTH_STREAMS},
+    {"pos", eFieldPos, BOTH_STREAMS},
+    {"var", eFieldVar, BOTH_STREAMS},
+    {"sampleid", eFieldSampleId, 1 << eGtStream},
+    {"id", eFieldId, 1 << eVarStream},
+    {"ref", eFieldRef, 1 << eVarStream},
+    {"alt", eFieldAlt, 1 << eVarStream},
+    {"alleles", eFieldAlleles, 1 << eVarStream},
+    {"qual", eFieldQual, 1 << eVarStream},
+    {"filter", eFieldFilter, 1 << eVarStream},
+    {"info", eFieldInfo, 1 << eVarStream},
+    {"format", eFieldFormat, 1 << eVarStream},
+    {"gt", eFieldGt, 1 << eGtStream},
+    {"unparsed", eFieldUnparsed, 1 << eGtStream},
+    {"gl", eFieldGl, 1 << eGtStream},
+    {"filterid", eFieldFilterId, 1 << eVarStream},
+    {"formatid", eFieldFormatId, 1 << eVarStream}
+};
+
+struct load_type_name {
+    char const* name;
+    EDataType type;
+};
+
+static load_type_name const load_type_names[] = {
+    {"string", eString}, {"float", eFloat}, {"double", eDouble},
+    {"int8", eInt8}, {"int16", eInt16}, {"int32", eInt32}, {"int64", eInt64},
+    {"uint8", eUint8}, {"uint16", eUint16}, {"uint32", eUint32}, {"uint64", eUint64},
+    {"gt8", eGt8}, {"nuc", eNuc}, {"gl", eGl}
+};
+
+bool load_schema::add(string const& name, string const& type, ENullData null, ELoadStream stream, string& error)
 {
+    load_attribute attr;
+    attr.name = name;
+    attr.type = type;
+    attr.null = null;
+    size_t i = 0;
+    size_t nfields = sizeof(load_field_names) / sizeof(load_field_names[0]);
+    while ((i < nfields) && (name != load_field_names[i].name)) ++i;
+    if ((i == nfields) || !(load_field_names[i].streams & (1 << stream))) {
+        error = "no value for " + name + " in this array";
+        return false;
+    }
+    attr.field = load_field_names[i].field;
+    for (size_t j = 0; j < _attrs.size(); ++j) {
+        if (_attrs[j].field == attr.field) {
+            error = name + " appears twice";
+            return false;
+        }
+    }
+    size_t ntypes = sizeof(load_type_names) / sizeof(load_type_names[0]);
+    for (i = 0; (i < ntypes) && (type != load_type_names[i].name); ++i);
+    if (i == ntypes) {
+        error = "unsupported type " + type + " for " + name;
+        return false;
+    }
+    attr.data_type = load_type_names[i].type;
+    _attrs.push_back(attr);
+    return true;
 }
 
-uint8_t str2gt8(string const& gstr)
+bool load_schema::parse(string const& schema, ELoadStream stream, string& error)
 {
-    size_t phase_loc = gstr.find_first_of("/|");
-    bool isDiploid;
-    unsigned short int a, b;
-    char phase('/');
-    if (phase_loc != string::npos) {
-        isDiploid = true;
-        phase = gstr[phase_loc];
-        string strA = gstr.substr(0, phase_loc);
-        string strB = gstr.substr(phase_loc+1);
-        if (strA[0] == '.') {
-            a=0;
-        } else {
-            if (sscanf(strA.c_str(), "%hu", &a) < 1)
-                cerr << "Can't convert " << gstr << " to gt8\n";
-            a++;
+    _attrs.clear();
+    size_t lt = schema.find('<');
+    size_t gt = schema.find('>', lt);
+    if ((lt == string::npos) || (gt == string::npos)) {
+        error = "expected <attributes>[dimensions]";
+        return false;
+    }
+    size_t lb = schema.find('[', gt);
+    size_t rb = schema.find(']', lb);
+    if ((lb != string::npos) && (rb != string::npos)) {
+        // A dimension starts with its name, then come its range and chunking
+        vector<string> tokens;
+        string dims = schema.substr(lb+1, rb-lb-1);
+        split(tokens, dims, is_any_of(",;"));
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            string tok = trim_copy(tokens[i]);
+            if (tok.empty() || !(isalpha(tok[0]) || (tok[0] == '_'))) continue;
+            if (!add(trim_copy(tok.substr(0, tok.find('='))), "int64", eNotNullable, stream, error)) return false;
         }
-        if (strB[0] == '.') {
-            b=0;
-        } else {
-            if (sscanf(strB.c_str(), "%hu", &b) < 1)
-                cerr << "Can't convert " << gstr << " to gt8\n";
-            b++;
+    }
+    vector<string> tokens;
+    string attrs = schema.substr(lt+1, gt-lt-1);
+    split(tokens, attrs, is_any_of(","));
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        size_t colon = tokens[i].find(':');
+        if (colon == string::npos) {
+            error = "expected name:type in " + tokens[i];
+            return false;
         }
-    } else {
-        isDiploid = false;
-        if (gstr[0] == '.') {
-            a=0;
-        } else {
-            if (sscanf(gstr.c_str(), "%hu", &a) < 1)
-                cerr << "Can't convert " << gstr << " to gt8\n";
-            a++;
+        vector<string> words;
+        string decl = trim_copy(tokens[i].substr(colon+1));
+        split(words, decl, is_space(), token_compress_on);
+        ENullData null = eNotNullable;
+        for (size_t w = 1; w < words.size(); ++w) {
+            if (iequals(words[w], "null") && !iequals(words[w-1], "not")) null = eNullable;
         }
+        if (!add(trim_copy(tokens[i].substr(0, colon)), to_lower_copy(words[0]), null, stream, error)) return false;
     }
-    
-    uint8_t g = a;    
-    if (isDiploid) {
-        g <<= 3;
-        g |= b;
-        if (phase == '|') {
-            g |= 0xC0;  // 0x80 & 0x40
-        } else {
-            g |= 0x80;
-        }
+    return true;
+}
+
+string load_schema::array_schema() const
+{
+    string schema("<");
+    for (size_t i = 0; i < _attrs.size(); ++i) {
+        if (i > 0) schema += ",";
+        schema += _attrs[i].name + ":" + _attrs[i].type;
+        if (_attrs[i].null == eNullable) schema += " null";
     }
-    return g;
+    return schema + ">[row=0:*,1000000,0]";
 }
 
-void scidb_binary_writer::put_data(std::string const& data, ENullData nullstatus, EDataType type)
+string load_schema::format() const
 {
-    if (nullstatus == eNullable) {
-        int8_t nullval = data.empty() ? 0 : -1;
-        write(_out, &nullval, sizeof(nullval));
+    string format("(");
+    for (size_t i = 0; i < _attrs.size(); ++i) {
+        if (i > 0) format += ",";
+        format += _attrs[i].type;
+        if (_attrs[i].null == eNullable) format += " null";
     }
-    switch (type) {
-    case (eGt8): {
-        uint8_t gt = str2gt8(data);
-        write(_out, &gt, sizeof(gt));
-    } break;
-    case (eString): {
-        uint32_t sz = data.size()+1;
-        write(_out, &sz, sizeof(sz));
-        if (sz > 0) write(_out, data.c_str(), sz);
-    } break;
-    case (eFloat): {
-        float d = atof(data.c_str());
-        write(_out, &d, sizeof(d));
-    } break;
-    case (eDouble): {
-        double d = atof(data.c_str());
-        write(_out, &d, sizeof(d));
-    } break;
-    case (eInt8): {
-        int8_t d =atoi(data.c_str());
-        write(_out, &d, sizeof(d));
-    } break;
-    case (eInt16): {
-        int16_t d = atoi(data.c_str());
-        write(_out, &d, sizeof(d));
-    } break;
-    case (eInt32): {
-        int32_t d = atoi(data.c_str());
-        write(_out, &d, sizeof(d));
-    } break;
-    case (eInt64): {
-        int64_t d = atol(data.c_str());
-        write(_out, &d, sizeof(d));
-    } break;
-    case (eUint8): {
-        uint8_t d = atoi(data.c_str());
-        write(_out, &d, sizeof(d));
-    } break;
-    case (eUint16): {
-        uint16_t d = atoi(data.c_str());
-        write(_out, &d, sizeof(d));
-    } break;
-    case (eUint32): {
-        uint32_t d = atoi(data.c_str());
-        write(_out, &d, sizeof(d));
-    } break;
-    case (eUint64): {
-        uint64_t d = atol(data.c_str());
-        write(_out, &d, sizeof(d));
-    } break;
+    return format + ")";
+}
+
+bool chrom_dictionary::load(string const& filename)
+{
+    ifstream ifs(filename.c_str(), ifstream::in);
+    if (!ifs) return true;
+    // An id is a line number, so a blank or repeated line would shift the
+    // ids of the names after it away from those already in the arrays
+    string line;
+    while (getline(ifs, line)) {
+        if (line.empty() || (_ids.count(line) > 0)) {
+            cerr << filename << ":" << _names.size() + 1 << ": blank or repeated name" << endl;
+            return false;
+        }
+        id(line);
     }
+    return !ifs.bad();
 }
 
-void scidb_binary_writer::put_uint32(uint32_t data)
+bool chrom_dictionary::save(string const& filename) const
 {
-    write(_out, &data, sizeof(data));
+    ofstream ofs(filename.c_str());
+    for (size_t i = 0; i < _names.size(); ++i) ofs << _names[i] << '\n';
+    return ofs.good();
 }
 
-void scidb_binary_writer::put_int64(int64_t data)
+void gt8_parse_error(str_ref gstr)
 {
-    write(_out, &data, sizeof(data));
+    cerr << "Can't convert " << gstr << " to gt8\n";
 }
@@ -28,13 +28,44 @@
  * File Description:
  *   Various writer classes for SciDB
  *
+ *   The writer is a template on the output format, chosen once at startup,
+ *   so the scanner calls straight into the inlined put_* functions.  Fields
+ *   are passed as string_refs into the scanner buffer, and output is
+ *   gathered in a preallocated buffer, so writing a genotype does not
+ *   allocate.
+ *
+ *   The genotype rows of a wide VCF row may also be encoded into separate
+ *   row_buffers, one per range of samples and possibly on other threads,
+ *   and then appended in sample order with put_rows.
+ *
+ *   The schema writer writes the records of a 1-D load array whose
+ *   attributes are the dimensions and attributes of a target array, as
+ *   given by a load_schema, with chromosomes replaced by their ids, so
+ *   the server only has to redimension them.
+ *
+ *   With set_queue, full buffers are handed to a thread which writes
+ *   them out, and the scanner only waits when the queue is full.
+ *
  */
 
 #ifndef SCIDB_WRITERS_HPP
 #define SCIDB_WRITERS_HPP
+#include <algorithm>
 #include <string>
 #include <map>
+#include <vector>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "load-metrics.hpp"
+#include "async-writer.hpp"
+#include "text-format.hpp"
+#include "gt8.h"
+#include "nuc.h"
+#include "gl.h"
 
 enum ENullData {
     eNullable,
@@ -53,73 +84,730 @@ enum EDataType {
     eUint16,
     eUint32,
     eUint64,
-    eGt8
+    eGt8,
+    eNuc,
+    eGl
+};
+
+enum EWriterFormat {
+    eTextFormat,
+    eBinaryFormat,
+    eSchemaFormat
 };
 
-class scidb_writer {
+// Values the scanner can supply for an attribute of a load schema
+enum ELoadField {
+    eFieldChrom,
+    eFieldChromId,
+    eFieldPos,
+    eFieldVar,
+    eFieldSampleId,
+    eFieldId,
+    eFieldRef,
+    eFieldAlt,
+    eFieldAlleles,
+    eFieldQual,
+    eFieldFilter,
+    eFieldInfo,
+    eFieldFormat,
+    eFieldGt,
+    eFieldUnparsed,
+    eFieldGl,
+    eFieldFilterId,
+    eFieldFormatId,
+    eFieldCount
+};
+
+enum ELoadStream {
+    eVarStream,
+    eGtStream
+};
+
+typedef boost::string_ref str_ref;
+
+// Size of the output buffer of each writer
+#define SCIDB_WRITER_BUFSIZE (1 << 18)
+
+// Rows encoded away from the writer, to be appended with put_rows
+class row_buffer {
 public:
-    scidb_writer(std::string const& filename);
-    virtual ~scidb_writer();
+    row_buffer() : _data(NULL), _size(0), _capacity(0) {}
+    row_buffer(row_buffer&& other)
+        : _data(other._data), _size(other._size), _capacity(other._capacity), _rows(std::move(other._rows))
+    {
+        other._data = NULL;
+        other._size = other._capacity = 0;
+    }
+    ~row_buffer() { free(_data); }
+
+    void clear()
+    {
+        _size = 0;
+        _rows.clear();
+    }
+
+    char const* data() const { return _data; }
+    size_t size() const { return _size; }
+    // End offset of each row in data
+    std::vector<size_t> const& rows() const { return _rows; }
+
+    void out(void const* data, size_t size)
+    {
+        memcpy(reserve(size), data, size);
+        _size += size;
+    }
+    void out(char c)
+    {
+        *reserve(1) = c;
+        ++_size;
+    }
+    void out(str_ref s) { out(s.data(), s.size()); }
+
+    char* reserve(size_t size)
+    {
+        if (_size + size > _capacity) {
+            _capacity = std::max(std::max(_capacity * 2, _size + size), (size_t)4096);
+            _data = static_cast<char*>(realloc(_data, _capacity));
+        }
+        return _data + _size;
+    }
+    void commit(size_t size) { _size += size; }
+
+    void end_row() { _rows.push_back(_size); }
+
+private:
+    row_buffer(row_buffer const&);
+    row_buffer& operator=(row_buffer const&);
+
+    char* _data;
+    size_t _size;
+    size_t _capacity;
+    std::vector<size_t> _rows;
+};
+
+// Buffered output to a file or pipe, shared by the writer formats
+class scidb_writer_base {
+public:
+    scidb_writer_base(std::string const& filename);
+    ~scidb_writer_base();
+
+    // Count the bytes, rows and time blocked in write() against metrics
+    void set_metrics(stream_metrics* metrics) { _metrics = metrics; }
+
+    // Write through a queue of up to max_bytes on a thread of its own,
+    // after set_metrics; 0 keeps writing from the calling thread
+    void set_queue(size_t max_bytes);
+
+    void flush();
 
-    void set_chrom(std::string const& chrom)  { _chrom = chrom; }
-    void set_pos(std::string const& pos) { _pos = pos; }
-    virtual void set_var(int64_t var)=0;
-    
-    virtual void put_prefix()=0;
-    virtual void put_separator()=0;
-    virtual void put_endrow()=0;
+    // Write out everything buffered or queued and close the output,
+    // the destructor does the same for a writer not closed
+    void close();
 
-    virtual void put_data(std::string const& data, ENullData nullval, EDataType type)=0;
-    virtual void put_uint32(uint32_t data)=0;
-    virtual void put_int64(int64_t data)=0;
+    // True once the output could not be opened or a write or the close
+    // failed, whether from this thread or the queue's
+    bool failed() const { return _failed || (_async && _async->failed()); }
+
+    // The FORMAT of the var array for a row, given its FORMAT without GT
+    // and its number of alleles; a writer which takes a field of the
+    // genotypes out of unparsed takes it out here too
+    str_ref set_format(str_ref format, uint32_t alleles) { return format; }
 
 protected:
+    // The binary formatting shared by the binary writers
+    template <class Sink, typename T> friend void put_binary(Sink& sink, T data);
+    template <class Sink> friend void format_binary(Sink& sink, str_ref data, ENullData nullstatus, EDataType type);
+    template <class Sink> friend void format_binary(Sink& sink, int64_t data, ENullData nullstatus, EDataType type);
+    template <class Sink> friend void format_nuc(Sink& sink, str_ref data);
+    template <class Sink> friend void put_gl(Sink& sink, uint8_t const* gl, uint32_t size);
+
+    void out(void const* data, size_t size)
+    {
+        if (_used + size > SCIDB_WRITER_BUFSIZE) {
+            flush();
+            if (size > SCIDB_WRITER_BUFSIZE) {
+                out_large(data, size);
+                return;
+            }
+        }
+        memcpy(_buf + _used, data, size);
+        _used += size;
+    }
+
+    void out(char c)
+    {
+        if (_used == SCIDB_WRITER_BUFSIZE) flush();
+        _buf[_used++] = c;
+    }
+
+    void out(str_ref s) { out(s.data(), s.size()); }
+
+    // Write data bigger than the buffer, which has just been flushed
+    void out_large(void const* data, size_t size);
+
+    // Room for at least size bytes, to be followed by commit(size)
+    char* reserve(size_t size)
+    {
+        if (_used + size > SCIDB_WRITER_BUFSIZE) flush();
+        return _buf + _used;
+    }
+    void commit(size_t size) { _used += size; }
+
+    void end_rows(size_t rows) { if (_metrics) _metrics->add_rows(rows); }
+
     int _out;
+    stream_metrics* _metrics;
+    async_writer* _async;
+    char* _buf;
+    size_t _used;
+    bool _failed;
     std::string _chrom;
-    std::string _pos;
     std::string _prefix;
 };
 
-typedef std::map<std::string, int64_t> subjectMap_t;
-# define YY_DECL int yylex(scidb_writer& var_writer, scidb_writer& gt_writer, subjectMap_t& subjMap, size_t max_ref_size)
-YY_DECL;
+template <EWriterFormat Format> class scidb_writer;
 
-class scidb_text_writer: public scidb_writer {
+template <>
+class scidb_writer<eTextFormat> : public scidb_writer_base {
 public:
-    scidb_text_writer(std::string const& filename, size_t chunksize);
-    virtual ~scidb_text_writer();
-    virtual void set_var(int64_t var);
-    
-    virtual void put_prefix();
-    virtual void put_separator();
-    virtual void put_endrow();
-
-    virtual void put_data(std::string const& data, ENullData nullval, EDataType type);
-    virtual void put_uint32(uint32_t data);
-    virtual void put_int64(int64_t data);
+    scidb_writer(std::string const& filename, size_t chunksize);
+    ~scidb_writer();
+
+    // Close the array with its last bracket first
+    void close();
+
+    void set_chrom(str_ref chrom) { _chrom.assign(chrom.data(), chrom.size()); }
+    void set_pos(str_ref pos) { _pos.assign(pos.data(), pos.size()); }
+    void set_var(int64_t var)
+    {
+        char num[FORMAT_INT64_MAX];
+        _prefix.assign("(\"", 2);
+        _prefix.append(_chrom);
+        _prefix.append("\",", 2);
+        _prefix.append(_pos);
+        _prefix.push_back(',');
+        _prefix.append(num, format_int64(var, num));
+        _prefix.push_back(',');
+    }
+
+    void put_prefix()
+    {
+        if (_newchunk) {
+            out(";\n[\n", 4);
+            _newchunk = false;
+        }
+        out(_prefix.data(), _prefix.size());
+    }
+    void put_separator() { out(','); }
+    void put_endrow()
+    {
+        ++_rowcount;
+        end_rows(1);
+        out(")\n", 2);
+        if ((_rowcount % _chunksize) == 0) {
+            out(']');
+            _newchunk = true;
+        }
+    }
+
+    void put_data(str_ref data, ENullData nullstatus, EDataType type) { format_data(*this, data, nullstatus, type); }
+    void put_uint32(uint32_t data) { commit(format_uint64(data, reserve(FORMAT_INT64_MAX))); }
+    void put_int64(int64_t data) { commit(format_int64(data, reserve(FORMAT_INT64_MAX))); }
+
+    // A genotype row for the current variant, as put_* would write it
+    void encode_gt(row_buffer& buf, int64_t sampleid, str_ref gt, str_ref rest) const
+    {
+        buf.out(_prefix.data(), _prefix.size());
+        buf.commit(format_int64(sampleid, buf.reserve(FORMAT_INT64_MAX)));
+        buf.out(',');
+        format_data(buf, gt, eNotNullable, eGt8);
+        buf.out(',');
+        format_data(buf, rest, eNullable, eString);
+        buf.out(")\n", 2);
+        buf.end_row();
+    }
+
+    // Append encoded rows, closing and opening chunks where they fall
+    void put_rows(row_buffer const& buf)
+    {
+        std::vector<size_t> const& rows = buf.rows();
+        size_t start = 0;
+        for (size_t i = 0; i < rows.size(); ) {
+            if (_newchunk) {
+                out(";\n[\n", 4);
+                _newchunk = false;
+            }
+            size_t count = std::min(_chunksize - (_rowcount % _chunksize), rows.size() - i);
+            i += count;
+            out(buf.data() + start, rows[i - 1] - start);
+            start = rows[i - 1];
+            _rowcount += count;
+            end_rows(count);
+            if ((_rowcount % _chunksize) == 0) {
+                out(']');
+                _newchunk = true;
+            }
+        }
+    }
 
 private:
+    template <class Sink>
+    static void format_data(Sink& sink, str_ref data, ENullData nullstatus, EDataType type)
+    {
+        if (data.empty() && (nullstatus == eNullable)) {
+            sink.out('?');
+        } else {
+            bool isString = ((type == eString) || (type == eGt8) || (type == eNuc) || (type == eGl));
+            if (isString) sink.out('"');
+            sink.out(data);
+            if (isString) sink.out('"');
+        }
+    }
+
+    std::string _pos;
     size_t _chunksize;
     size_t _rowcount;
     bool _newchunk;
 };
 
-class scidb_binary_writer: public scidb_writer {
+// Report a genotype which could not be parsed
+void gt8_parse_error(str_ref gstr);
+
+inline uint8_t str2gt8(str_ref gstr)
+{
+    gt8_t g = 0;
+    if (!gt8_parse(gstr.data(), gstr.size(), g)) gt8_parse_error(gstr);
+    return g;
+}
+
+// A copy of data with a terminating NUL, for the C conversion functions
+inline char const* c_str(str_ref data, char* buf, size_t size)
+{
+    size_t n = (data.size() < size) ? data.size() : size - 1;
+    memcpy(buf, data.data(), n);
+    buf[n] = '\0';
+    return buf;
+}
+
+template <class Sink, typename T> void put_binary(Sink& sink, T data) { sink.out(&data, sizeof(data)); }
+
+// Alleles as a size and a nuc value, encoded in place unless very long
+template <class Sink>
+void format_nuc(Sink& sink, str_ref data)
+{
+    uint32_t sz = nuc_encoded_size(data.data(), data.size());
+    put_binary(sink, sz);
+    if (sz <= 4096) {
+        nuc_encode(data.data(), data.size(), reinterpret_cast<uint8_t*>(sink.reserve(sz)));
+        sink.commit(sz);
+    } else {
+        std::vector<uint8_t> buf(sz);
+        nuc_encode(data.data(), data.size(), &buf[0]);
+        sink.out(&buf[0], sz);
+    }
+}
+
+// Likelihoods as a size and a gl value, size 0 for none
+template <class Sink>
+void put_gl(Sink& sink, uint8_t const* gl, uint32_t size)
+{
+    put_binary(sink, size);
+    if (size) sink.out(gl, size);
+}
+
+// Room to encode the likelihoods of a call, on the stack unless there are many
+class gl_buffer {
 public:
-    scidb_binary_writer(std::string const& filename);
-    virtual ~scidb_binary_writer();
-    virtual void set_var(int64_t var);
-    
-    virtual void put_prefix();
-    virtual void put_separator();
-    virtual void put_endrow();
-
-    virtual void put_data(std::string const& data, ENullData nullval, EDataType type);
-    virtual void put_uint32(uint32_t data);
-    virtual void put_int64(int64_t data);
+    gl_buffer(str_ref data) : _data(_local)
+    {
+        size_t size = gl_encoded_size(data.data(), data.size());
+        if (size > sizeof(_local)) {
+            _heap.resize(size);
+            _data = &_heap[0];
+        }
+    }
+    uint8_t* data() { return _data; }
 
 private:
-    std::string _prefix;
+    uint8_t _local[256];
+    std::vector<uint8_t> _heap;
+    uint8_t* _data;
 };
 
+// A gl from its text form, see gl_parse, empty if it does not parse
+template <class Sink>
+void format_gl(Sink& sink, str_ref data)
+{
+    gl_buffer buf(data);
+    put_gl(sink, buf.data(), gl_parse(data.data(), data.size(), buf.data()));
+}
+
+// Offset of the first ':' at or after from, or npos
+inline size_t format_colon(str_ref fields, size_t from)
+{
+    void const* colon = memchr(fields.data() + from, ':', fields.size() - from);
+    return colon ? static_cast<char const*>(colon) - fields.data() : str_ref::npos;
+}
+
+// Item i of the colon separated fields, and the fields before and after
+// it, with the separator between them, as if it were not there
+inline str_ref format_item(str_ref fields, size_t i, str_ref& head, str_ref& tail)
+{
+    size_t begin = 0;
+    for (size_t k = 0; k < i; ++k) {
+        size_t colon = format_colon(fields, begin);
+        if (colon == str_ref::npos) {
+            head = fields;
+            tail.clear();
+            return str_ref();
+        }
+        begin = colon + 1;
+    }
+    size_t end = format_colon(fields, begin);
+    if (end == str_ref::npos) {
+        head = fields.substr(0, begin ? begin - 1 : 0);
+        tail.clear();
+        return fields.substr(begin);
+    }
+    head = fields.substr(0, begin);
+    tail = fields.substr(end + 1);
+    return fields.substr(begin, end - begin);
+}
+
+// A field in SciDB's binary load format, converted to type
+template <class Sink>
+void format_binary(Sink& sink, str_ref data, ENullData nullstatus, EDataType type)
+{
+    if (nullstatus == eNullable) sink.out(data.empty() ? (char)0 : (char)-1);
+    char buf[64];
+    switch (type) {
+    case (eGt8): sink.out((char)str2gt8(data)); break;
+    case (eString): {
+        uint32_t sz = data.size()+1;
+        put_binary(sink, sz);
+        sink.out(data);
+        sink.out('\0');
+    } break;
+    case (eNuc): format_nuc(sink, data); break;
+    case (eGl): format_gl(sink, data); break;
+    case (eFloat): put_binary(sink, (float)atof(c_str(data, buf, sizeof(buf)))); break;
+    case (eDouble): put_binary(sink, atof(c_str(data, buf, sizeof(buf)))); break;
+    case (eInt8): put_binary(sink, (int8_t)parse_int64(data.data(), data.size())); break;
+    case (eInt16): put_binary(sink, (int16_t)parse_int64(data.data(), data.size())); break;
+    case (eInt32): put_binary(sink, (int32_t)parse_int64(data.data(), data.size())); break;
+    case (eInt64): put_binary(sink, (int64_t)parse_int64(data.data(), data.size())); break;
+    case (eUint8): put_binary(sink, (uint8_t)parse_int64(data.data(), data.size())); break;
+    case (eUint16): put_binary(sink, (uint16_t)parse_int64(data.data(), data.size())); break;
+    case (eUint32): put_binary(sink, (uint32_t)parse_int64(data.data(), data.size())); break;
+    case (eUint64): put_binary(sink, (uint64_t)parse_int64(data.data(), data.size())); break;
+    }
+}
+
+// A number in SciDB's binary load format, converted to type
+template <class Sink>
+void format_binary(Sink& sink, int64_t data, ENullData nullstatus, EDataType type)
+{
+    if (nullstatus == eNullable) sink.out((char)-1);
+    switch (type) {
+    case (eGt8): sink.out((char)data); break;
+    case (eString): {
+        char num[FORMAT_INT64_MAX];
+        size_t n = format_int64(data, num);
+        uint32_t sz = n+1;
+        put_binary(sink, sz);
+        sink.out(num, n);
+        sink.out('\0');
+    } break;
+    case (eNuc): {
+        char num[FORMAT_INT64_MAX];
+        format_nuc(sink, str_ref(num, format_int64(data, num)));
+    } break;
+    case (eGl): put_gl(sink, NULL, 0); break;
+    case (eFloat): put_binary(sink, (float)data); break;
+    case (eDouble): put_binary(sink, (double)data); break;
+    case (eInt8): put_binary(sink, (int8_t)data); break;
+    case (eInt16): put_binary(sink, (int16_t)data); break;
+    case (eInt32): put_binary(sink, (int32_t)data); break;
+    case (eInt64): put_binary(sink, (int64_t)data); break;
+    case (eUint8): put_binary(sink, (uint8_t)data); break;
+    case (eUint16): put_binary(sink, (uint16_t)data); break;
+    case (eUint32): put_binary(sink, (uint32_t)data); break;
+    case (eUint64): put_binary(sink, (uint64_t)data); break;
+    }
+}
+
+template <>
+class scidb_writer<eBinaryFormat> : public scidb_writer_base {
+public:
+    scidb_writer(std::string const& filename);
+    ~scidb_writer();
+
+    void set_chrom(str_ref chrom) { _chrom.assign(chrom.data(), chrom.size()); }
+    void set_pos(str_ref pos) { _pos = parse_int64(pos.data(), pos.size()); }
+    void set_var(int64_t var)
+    {
+        uint32_t sz = _chrom.size()+1;
+        _prefix.assign(reinterpret_cast<char*>(&sz), sizeof(sz));
+        _prefix.append(_chrom.c_str(), sz);
+        _prefix.append(reinterpret_cast<char*>(&_pos), sizeof(_pos));
+        _prefix.append(reinterpret_cast<char*>(&var), sizeof(var));
+    }
+
+    void put_prefix() { out(_prefix.data(), _prefix.size()); }
+    void put_separator() {}
+    void put_endrow() { end_rows(1); }
+
+    void put_data(str_ref data, ENullData nullstatus, EDataType type) { format_binary(*this, data, nullstatus, type); }
+    void put_uint32(uint32_t data) { put_binary(*this, data); }
+    void put_int64(int64_t data) { put_binary(*this, data); }
+
+    // A genotype row for the current variant, as put_* would write it
+    void encode_gt(row_buffer& buf, int64_t sampleid, str_ref gt, str_ref rest) const
+    {
+        buf.out(_prefix.data(), _prefix.size());
+        put_binary(buf, sampleid);
+        format_binary(buf, gt, eNotNullable, eGt8);
+        format_binary(buf, rest, eNullable, eString);
+        buf.end_row();
+    }
+
+    void put_rows(row_buffer const& buf)
+    {
+        out(buf.data(), buf.size());
+        end_rows(buf.rows().size());
+    }
+
+private:
+    int64_t _pos;
+};
+
+
+// An attribute of a load array and the value written to it
+struct load_attribute {
+    std::string name;
+    std::string type;
+    EDataType data_type;
+    ENullData null;
+    ELoadField field;
+};
+
+/*
+ * The record layout for a target array, from a schema such as
+ * "<gt:gt8 null,unparsed:string null>[chromid=0:*,1,0,pos=1:*,200000,0]".
+ * Each dimension becomes an int64 attribute, in order, followed by the
+ * attributes; every name must be one of the values of the stream.
+ */
+// The final var and gt arrays, loaded as they are by --native
+#define DEFAULT_VAR_SCHEMA "<id:string null,ref:nuc,alt:nuc,alleles:uint32,qual:float null," \
+    "filter:string null,info:string null,format:string null>[chromid=0:*,1,0,pos=1:*,200000,0,var=1:*,20,0]"
+#define DEFAULT_GT_SCHEMA "<gt:gt8 null,unparsed:string null>" \
+    "[chromid=0:*,1,0,pos=1:*,200000,0,var=1:*,20,0,sampleid=0:*,1000,0]"
+
+class load_schema {
+public:
+    bool parse(std::string const& schema, ELoadStream stream, std::string& error);
+
+    std::vector<load_attribute> const& attributes() const { return _attrs; }
+
+    // Schema of the 1-D array to load the records into
+    std::string array_schema() const;
+    // Format string of the records for input() and load()
+    std::string format() const;
+
+    bool has(ELoadField field) const
+    {
+        for (size_t i = 0; i < _attrs.size(); ++i) {
+            if (_attrs[i].field == field) return true;
+        }
+        return false;
+    }
+
+private:
+    bool add(std::string const& name, std::string const& type, ENullData null, ELoadStream stream, std::string& error);
+
+    std::vector<load_attribute> _attrs;
+};
+
+// Chromosome ids, the line number in a file of chromosome names; also
+// used for the FILTER and FORMAT strings of the var array
+class chrom_dictionary {
+public:
+    // A missing file starts an empty dictionary, a blank or repeated line fails
+    bool load(std::string const& filename);
+    bool save(std::string const& filename) const;
+
+    // The id of chrom, adding it if new
+    int64_t id(str_ref chrom)
+    {
+        std::map<std::string, int64_t>::const_iterator i = _ids.find(std::string(chrom.data(), chrom.size()));
+        if (i != _ids.end()) return i->second;
+        _names.push_back(std::string(chrom.data(), chrom.size()));
+        return _ids[_names.back()] = _names.size() - 1;
+    }
+
+    size_t size() const { return _names.size(); }
+    std::string const& name(int64_t id) const { return _names[id]; }
+
+private:
+    std::map<std::string, int64_t> _ids;
+    std::vector<std::string> _names;
+};
+
+template <>
+class scidb_writer<eSchemaFormat> : public scidb_writer_base {
+public:
+    scidb_writer(std::string const& filename, load_schema const& schema, chrom_dictionary& chroms);
+    ~scidb_writer();
+
+    void set_chrom(str_ref chrom)
+    {
+        if (chrom != _chrom) {
+            _chrom.assign(chrom.data(), chrom.size());
+            _chromid = _chroms.id(chrom);
+        }
+    }
+    void set_pos(str_ref pos) { _pos = parse_int64(pos.data(), pos.size()); }
+    void set_var(int64_t var) { _var = var; }
+
+    // A gl attribute takes the PL, or else GL, out of the FORMAT and unparsed
+    str_ref set_format(str_ref format, uint32_t alleles);
+
+    // Dictionaries of the filterid and formatid attributes, if any
+    void set_dictionaries(chrom_dictionary* filters, chrom_dictionary* formats)
+    {
+        _filters = filters;
+        _formats = formats;
+    }
+
+    // The var fields arrive in ELoadField order, from id to format
+    void put_prefix() { _next = eFieldId; }
+    void put_separator() {}
+    void put_endrow()
+    {
+        for (std::vector<load_attribute>::const_iterator a = _attrs.begin(); a != _attrs.end(); ++a) {
+            if (a->field < eFieldId) put_value(*this, *a, 0);
+            else out(_fields[a->field].data(), _fields[a->field].size());
+        }
+        end_rows(1);
+    }
+
+    void put_data(str_ref data, ENullData, EDataType)
+    {
+        if (_next == eFieldFilter) code_buffer(eFieldFilterId, _filters, data);
+        else if (_next == eFieldFormat) code_buffer(eFieldFormatId, _formats, data);
+        field_buffer(_next++, data);
+    }
+    void put_uint32(uint32_t data) { field_buffer(_next++, data); }
+    void put_int64(int64_t data) { field_buffer(_next++, data); }
+
+    // A genotype row for the current variant, as put_* would write it
+    void encode_gt(row_buffer& buf, int64_t sampleid, str_ref gt, str_ref rest) const
+    {
+        for (std::vector<load_attribute>::const_iterator a = _attrs.begin(); a != _attrs.end(); ++a) {
+            switch (a->field) {
+            case eFieldGt: format_binary(buf, gt, a->null, a->data_type); break;
+            case eFieldUnparsed: put_unparsed(buf, *a, rest); break;
+            case eFieldGl: put_likelihoods(buf, *a, gt, rest); break;
+            default: put_value(buf, *a, sampleid); break;
+            }
+        }
+        buf.end_row();
+    }
+
+    void put_rows(row_buffer const& buf)
+    {
+        out(buf.data(), buf.size());
+        end_rows(buf.rows().size());
+    }
+
+private:
+    // Encode a var field for the attribute it is bound to, if any
+    template <typename T>
+    void field_buffer(size_t field, T data)
+    {
+        row_buffer& buf = _fields[field];
+        buf.clear();
+        if (_bound[field] != NULL) format_binary(buf, data, _bound[field]->null, _bound[field]->data_type);
+    }
+
+    // Encode the id of a string in its dictionary, -1 for none unless nullable
+    void code_buffer(size_t field, chrom_dictionary* dictionary, str_ref data)
+    {
+        row_buffer& buf = _fields[field];
+        buf.clear();
+        load_attribute const* a = _bound[field];
+        if ((a == NULL) || (dictionary == NULL)) return;
+        if (data.empty() && (a->null == eNullable)) format_binary(buf, data, a->null, a->data_type);
+        else format_binary(buf, data.empty() ? (int64_t)-1 : dictionary->id(data), a->null, a->data_type);
+    }
+
+    void put_unparsed(row_buffer& buf, load_attribute const& a, str_ref rest) const
+    {
+        if ((_gl_key == NO_GL_KEY) || (a.data_type != eString)) {
+            format_binary(buf, rest, a.null, a.data_type);
+            return;
+        }
+        str_ref head, tail;
+        format_item(rest, _gl_key, head, tail);
+        if (a.null == eNullable) buf.out((head.empty() && tail.empty()) ? (char)0 : (char)-1);
+        uint32_t sz = head.size() + tail.size() + 1;
+        put_binary(buf, sz);
+        buf.out(head);
+        buf.out(tail);
+        buf.out('\0');
+    }
+
+    // The likelihoods of a call, null if it has none which fit the variant
+    void put_likelihoods(row_buffer& buf, load_attribute const& a, str_ref gt, str_ref rest) const
+    {
+        str_ref head, tail, field;
+        if (_gl_key != NO_GL_KEY) field = format_item(rest, _gl_key, head, tail);
+        gl_buffer gl(field);
+        gt8_t g = 0;
+        gt8_parse(gt.data(), gt.size(), g);
+        uint32_t size = gl_encode(field.data(), field.size(), _gl_log10, _alleles,
+                                  (g == 0) ? 0 : gt8_get_ploidy(g), gl.data());
+        if (a.null == eNullable) buf.out(size ? (char)-1 : (char)0);
+        put_gl(buf, gl.data(), size);
+    }
+
+    template <class Sink>
+    void put_value(Sink& sink, load_attribute const& a, int64_t sampleid) const
+    {
+        switch (a.field) {
+        case eFieldChrom: format_binary(sink, str_ref(_chrom), a.null, a.data_type); break;
+        case eFieldChromId: format_binary(sink, _chromid, a.null, a.data_type); break;
+        case eFieldPos: format_binary(sink, _pos, a.null, a.data_type); break;
+        case eFieldVar: format_binary(sink, _var, a.null, a.data_type); break;
+        case eFieldSampleId: format_binary(sink, sampleid, a.null, a.data_type); break;
+        default: break;
+        }
+    }
+
+    std::vector<load_attribute> _attrs;
+    load_attribute const* _bound[eFieldCount];
+    row_buffer _fields[eFieldCount];
+    chrom_dictionary& _chroms;
+    chrom_dictionary* _filters;
+    chrom_dictionary* _formats;
+    int64_t _chromid;
+    int64_t _pos;
+    int64_t _var;
+    size_t _next;
+    // Position of the likelihoods in the FORMAT, and whether they are GL
+    static const size_t NO_GL_KEY = (size_t)-1;
+    size_t _gl_key;
+    bool _gl_log10;
+    uint32_t _alleles;
+    std::string _format;
+};
+
+typedef scidb_writer<eTextFormat> scidb_text_writer;
+typedef scidb_writer<eBinaryFormat> scidb_binary_writer;
+typedef scidb_writer<eSchemaFormat> scidb_schema_writer;
+
+typedef std::map<std::string, int64_t> subjectMap_t;
+# define YY_DECL template <class Writer> int yylex(Writer& var_writer, Writer& gt_writer, subjectMap_t& subjMap, size_t max_ref_size)
+YY_DECL;
+
 #endif // ! SCIDB_WRITERS_HPP
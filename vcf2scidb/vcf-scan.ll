@@ -35,11 +35,19 @@
 #include <iostream>
 #include <vector>
 #include <set>
+#include <functional>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp> 
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include "scidb-writers.hpp"
+#include "thread-pool.hpp"
+#include "bed-regions.hpp"
+#include "allele-counts.hpp"
+#include "sample-qc.hpp"
+#include "id-index.hpp"
+#include "chunk-synopsis.hpp"
+#include "pbwt-writer.hpp"
 using namespace std;
 using namespace boost;
 size_t colnum = 0;
@@ -50,16 +58,143 @@ string prev_pos;
 string cur_pos;
 string cur_id;
 size_t loc;
-int64_t cur_sample;
 vector<int64_t> sampleids;
 bool skip_row;
 set<string> chrom_set;
 int64_t max_pos;
 int64_t max_var;
 int64_t max_sampleid;
+stream_metrics* input_metrics = NULL;
+thread_pool* sample_pool = NULL;
+bed_regions* row_regions = NULL;
+set<string>* sample_allow = NULL;
+population_counts* variant_counts = NULL;
+sample_qc* sample_metrics = NULL;
+id_index* variant_ids = NULL;
+chunk_synopsis* chunk_zones = NULL;
+pbwt_writer* haplotype_pbwt = NULL;
+uint32_t cur_alleles;
+string cur_ref;
+string cur_alt;
+double cur_qual;
+// Replaces reading yyin, e.g. to decompress or read indexed regions
+std::function<ssize_t(char*, size_t)> input_source;
+
+ssize_t scan_read(int fd, char* buf, size_t max_size)
+{
+    if (!input_source) return timed_read(fd, buf, max_size, input_metrics);
+    uint64_t start = input_metrics ? metrics_now_ns() : 0;
+    ssize_t nread = input_source(buf, max_size);
+    if (input_metrics) input_metrics->add_io(nread > 0 ? nread : 0, metrics_now_ns() - start);
+    return nread;
+}
+
+/* Fewest samples worth encoding as a separate range */
+#define SAMPLE_RANGE_MIN 1024
+
+vector<size_t> sample_cols;
+// VCF columns of the samples being loaded, in order
+vector<size_t> sample_keep;
+vector<row_buffer> sample_bufs;
+
+/*
+ * End the var row with its FORMAT, less GT, and tell the gt writer the
+ * fields of the sample columns which follow.
+ */
+template <class Writer>
+void put_format(Writer& var_writer, Writer& gt_writer, str_ref format)
+{
+    if (format == ".") format.clear();
+    var_writer.put_separator();
+    if (format.starts_with("GT")) {
+        format.remove_prefix(2);
+    }
+    if (format.starts_with(':')) {
+        format.remove_prefix(1);
+    }
+    format = gt_writer.set_format(format, cur_alleles);
+    var_writer.put_data(format, eNullable, eString);
+    var_writer.put_endrow();
+    if (chunk_zones) {
+        chunk_zones->begin_row(cur_chrom, parse_int64(cur_pos.data(), cur_pos.size()), cur_qual, cur_alleles);
+    }
+}
+
+/*
+ * Write the genotype rows for the sample columns of one VCF row.  A first
+ * pass finds the column boundaries, up to the last column being loaded,
+ * then ranges of the loaded samples are encoded on the pool into their
+ * own buffers, which are appended in sample order.  Other columns are
+ * only passed over by the tab scan.  The allele counts, sample QC and
+ * chunk synopsis of each range are tallied along the way, and the calls
+ * are gathered for the PBWT.
+ */
+template <class Writer>
+void encode_samples(Writer& gt_writer, str_ref line)
+{
+    if (sample_keep.empty()) return;
+    find_columns(line.data(), line.size(), sample_cols, sample_keep.back() + 1);
+    // Loaded samples which have a column in this row
+    size_t nsamples = lower_bound(sample_keep.begin(), sample_keep.end(), sample_cols.size() - 1)
+        - sample_keep.begin();
+
+    size_t nranges = 1;
+    if (sample_pool != NULL) {
+        nranges = min(sample_pool->size() * 4, nsamples / SAMPLE_RANGE_MIN);
+        if (nranges == 0) nranges = 1;
+    }
+    while (sample_bufs.size() < nranges) sample_bufs.push_back(row_buffer());
+    vector<allele_tally>* tallies = variant_counts ? &variant_counts->begin_row(nranges, cur_alleles) : NULL;
+    if (sample_metrics) sample_metrics->begin_row(nranges, cur_alleles, cur_ref, cur_alt);
+    if (chunk_zones) chunk_zones->begin_samples(nranges);
+    if (haplotype_pbwt) haplotype_pbwt->begin_row(cur_chrom, cur_pos, cur_var);
+
+    std::function<void(size_t)> encode = [&](size_t range) {
+        row_buffer& buf = sample_bufs[range];
+        buf.clear();
+        size_t last = nsamples * (range + 1) / nranges;
+        for (size_t i = nsamples * range / nranges; i < last; ++i) {
+            size_t col = sample_keep[i];
+            str_ref field(line.data() + sample_cols[col], sample_cols[col+1] - sample_cols[col] - 1);
+            str_ref gt = field;
+            str_ref rest;
+            size_t div = field.find(':');
+            if (div != str_ref::npos) {
+                gt = field.substr(0,div);
+                rest = field.substr(div+1);
+            }
+            if ((gt != "./.") && (gt != ".|.")) {
+                gt_writer.encode_gt(buf, sampleids[col], gt, rest);
+                gt8_t g;
+                if ((tallies || sample_metrics || chunk_zones || haplotype_pbwt) && gt8_parse(gt.data(), gt.size(), g)) {
+                    int pop = tallies ? variant_counts->column_population(col) : -1;
+                    if (pop >= 0) (*tallies)[range].add(pop, g);
+                    if (sample_metrics) sample_metrics->add(range, col, g);
+                    if (chunk_zones) chunk_zones->add(range, g);
+                    if (haplotype_pbwt) haplotype_pbwt->set(sampleids[col], g);
+                }
+            }
+        }
+    };
+    if (sample_pool != NULL) sample_pool->run(nranges, encode);
+    else encode(0);
+    for (size_t range = 0; range < nranges; ++range) {
+        gt_writer.put_rows(sample_bufs[range]);
+    }
+    if (variant_counts) variant_counts->end_row(cur_chrom, cur_pos, cur_var, nranges, cur_alleles);
+    if (sample_metrics) sample_metrics->end_row(nranges);
+    if (haplotype_pbwt) haplotype_pbwt->end_row();
+}
+
+/* Count the bytes read and the time blocked waiting for input */
+#define YY_INPUT(buf,result,max_size) { \
+    ssize_t nread = scan_read(fileno(yyin), buf, max_size); \
+    if (nread < 0) YY_FATAL_ERROR("input in flex scanner failed"); \
+    result = nread; }
 %}
 
 %option noyywrap nounput batch
+%x SAMPLES SKIPLINE
 
 mdline    ^##.*
 header    ^#[cC][hH][rR][oO][mM]\t.*
@@ -76,10 +211,13 @@ eol       \n
     string yystr(yytext);
     split(samples, yystr, is_any_of("\t"));
     samples.erase(samples.begin(), samples.begin()+9);
-    sampleids.assign(samples.size(), 0);
+    sampleids.assign(samples.size(), -1);
+    sample_keep.clear();
     subjectMap_t::iterator smi;
     size_t idx=0;
     for (vector<string>::iterator i=samples.begin(); i != samples.end(); ++i, ++idx) {
+        if (sample_allow && (sample_allow->count(*i) == 0)) continue;
+        sample_keep.push_back(idx);
         smi = subjMap.find(*i);
         if (smi == subjMap.end()) {
             subjMap[*i] = subjMap.size()+1;
@@ -90,26 +228,45 @@ eol       \n
         if (sampleids[idx] > max_sampleid) max_sampleid = sampleids[idx];
         //cout << idx << "<-" << sampleids[idx] << endl;
     }
+    if (variant_counts) variant_counts->set_columns(sampleids);
+    if (sample_metrics) sample_metrics->set_columns(samples, sampleids);
+    if (haplotype_pbwt) haplotype_pbwt->set_samples(max_sampleid);
 }
 {chrom} {
     colnum = 1;
-    cur_chrom = yytext;
+    cur_chrom.assign(yytext, yyleng);
     var_writer.set_chrom(cur_chrom);
     gt_writer.set_chrom(cur_chrom);
-    chrom_set.insert(cur_chrom);
     skip_row = false;
+    if (input_metrics) input_metrics->add_rows(1);
+}
+{tab} {
+    if (colnum == 9) {
+        // An empty FORMAT, this tab starts the samples
+        if (!skip_row) put_format(var_writer, gt_writer, str_ref());
+        yyless(0);
+        BEGIN(SAMPLES);
+    } else {
+        ++colnum;
+    }
 }
-{tab} { ++colnum; }
 {datum} {
-    string yystr(yytext);
+    str_ref yystr(yytext, yyleng);
     if (!skip_row) {
         switch (colnum) {
         case 2:  // POS and VAR
         {
-            cur_pos = yystr;
-            var_writer.set_pos(cur_pos);
-            gt_writer.set_pos(cur_pos);
-            int64_t pos = atol(cur_pos.c_str());
+            int64_t pos = parse_int64(yystr.data(), yystr.size());
+            if (row_regions && !row_regions->contains(cur_chrom.data(), cur_chrom.size(), pos)) {
+                // Pass over the rest of the line without tokenizing it
+                skip_row = true;
+                BEGIN(SKIPLINE);
+                break;
+            }
+            if (cur_chrom != prev_chrom) chrom_set.insert(cur_chrom);
+            cur_pos.assign(yystr.data(), yystr.size());
+            var_writer.set_pos(yystr);
+            gt_writer.set_pos(yystr);
             if (pos > max_pos) max_pos = pos;
             if ((cur_pos == prev_pos) && (cur_chrom == prev_chrom)) {
                 ++cur_var;
@@ -125,7 +282,7 @@ eol       \n
         }
         case 3: // ID
             if (yystr == ".") yystr.clear();
-            cur_id = yystr;
+            cur_id.assign(yystr.data(), yystr.size());
             break;
         case 4: // REF
             if (yystr.size() > max_ref_size) {
@@ -134,20 +291,28 @@ eol       \n
                 var_writer.put_prefix(); 
                 var_writer.put_data(cur_id, eNullable, eString);
                 var_writer.put_separator();
-                var_writer.put_data(yystr, eNotNullable, eString);            
+                var_writer.put_data(yystr, eNotNullable, eNuc);
+                cur_ref.assign(yystr.data(), yystr.size());
+                if (variant_ids) {
+                    variant_ids->add(cur_chrom.data(), cur_chrom.size(), parse_int64(cur_pos.data(), cur_pos.size()),
+                                     cur_var, cur_id.data(), cur_id.size());
+                }
             }
             break;
         case 5: // ALT and Alleles
         {
             var_writer.put_separator();
-            var_writer.put_data(yystr, eNotNullable, eString);
+            var_writer.put_data(yystr, eNotNullable, eNuc);
+            cur_alt.assign(yystr.data(), yystr.size());
             var_writer.put_separator();
             uint32_t alleles = 2 + (uint32_t)count(yystr.begin(),yystr.end(),',');
             var_writer.put_uint32(alleles);
+            cur_alleles = alleles;
         }
         break;
         case 6: // QUAL
             if (yystr == ".") yystr.clear();
+            cur_qual = yystr.empty() ? NAN : strtod(yytext, NULL);
             var_writer.put_separator();
             var_writer.put_data(yystr, eNullable, eFloat);
             break;
@@ -162,46 +327,29 @@ eol       \n
             var_writer.put_data(yystr, eNullable, eString);
             break;
         case 9: // FORMAT
-            if (yystr == ".") yystr.clear();
-            var_writer.put_separator();
-            if (yystr.substr(0,2) == "GT") {
-                yystr.erase(0,2);
-            }
-            if (yystr[0] == ':') {
-                yystr.erase(0,1);                
-            }
-            var_writer.put_data(yystr, eNullable, eString);
-            var_writer.put_endrow();
+            put_format(var_writer, gt_writer, yystr);
             break;
-        default: // SAMPLES
-        {
-            cur_sample=colnum-10;
-            string gt;
-            string rest;
-            size_t div = yystr.find(':');
-            if (div == string::npos) {
-                gt = yystr;
-                rest.clear();
-            } else {
-                gt = yystr.substr(0,div);
-                rest = yystr.substr(div+1, string::npos);
-            }
-            if ((gt != "./.") && (gt != ".|.")) {
-                gt_writer.put_prefix();
-                gt_writer.put_int64(sampleids[cur_sample]);
-                gt_writer.put_separator();
-                gt_writer.put_data(gt, eNotNullable, eGt8);
-                gt_writer.put_separator();
-                gt_writer.put_data(rest, eNullable, eString);
-                gt_writer.put_endrow();
-            }
-            break;
-        }
         }
     }
+    if (colnum == 9) BEGIN(SAMPLES);
+}
+<SAMPLES>\t[^\n]* {
+    if (!skip_row) encode_samples(gt_writer, str_ref(yytext + 1, yyleng - 1));
+    BEGIN(INITIAL);
 }
+<SAMPLES>{eol} { BEGIN(INITIAL); }
+<SKIPLINE>[^\n]+ ;
+<SKIPLINE>{eol} { BEGIN(INITIAL); }
 {eol} {
     // mylineno++;
     // cout << endl;
 }
 
+%%
+
+template int yylex(scidb_text_writer& var_writer, scidb_text_writer& gt_writer,
+                   subjectMap_t& subjMap, size_t max_ref_size);
+template int yylex(scidb_binary_writer& var_writer, scidb_binary_writer& gt_writer,
+                   subjectMap_t& subjMap, size_t max_ref_size);
+template int yylex(scidb_schema_writer& var_writer, scidb_schema_writer& gt_writer,
+                   subjectMap_t& subjMap, size_t max_ref_size);
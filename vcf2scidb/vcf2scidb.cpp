@@ -45,6 +45,18 @@
 #include <boost/lexical_cast.hpp>
 
 #include "scidb-writers.hpp"
+#include "thread-pool.hpp"
+#include "bed-regions.hpp"
+#include "bgzf.hpp"
+#include "allele-counts.hpp"
+#include "sample-qc.hpp"
+#include "id-index.hpp"
+#include "chunk-synopsis.hpp"
+#include "pbwt-writer.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
 
 using namespace std;
 using namespace boost;
@@ -55,8 +67,20 @@ extern set<string> chrom_set;
 extern int64_t max_pos;
 extern int64_t max_var;
 extern int64_t max_sampleid;
+extern stream_metrics* input_metrics;
+extern thread_pool* sample_pool;
+extern bed_regions* row_regions;
+extern set<string>* sample_allow;
+extern population_counts* variant_counts;
+extern sample_qc* sample_metrics;
+extern id_index* variant_ids;
+extern chunk_synopsis* chunk_zones;
+extern pbwt_writer* haplotype_pbwt;
+extern std::function<ssize_t(char*, size_t)> input_source;
 
-void read_descriptions(string const& filename, subjectMap_t& subjectMap)
+// The population of each founder, from the third and fourth columns, is
+// kept in founders; without a fourth column every sample is a founder
+void read_descriptions(string const& filename, subjectMap_t& subjectMap, map<int64_t, string>& founders)
 {
     ifstream ifs(filename.c_str(), ifstream::in);
     string line;
@@ -67,7 +91,56 @@ void read_descriptions(string const& filename, subjectMap_t& subjectMap)
         int64_t index = lexical_cast<int64_t>(cells[0]);
         string subject = cells[1];
         subjectMap.insert(make_pair(subject, index));
+        if (cells.size() > 2) {
+            string founder = (cells.size() > 3) ? trim_copy(cells[3]) : string("true");
+            if (iequals(founder, "true") || (founder == "1")) founders[index] = trim_copy(cells[2]);
+        }
+    }
+}
+
+// One sample name per line, anything after a tab or comma is ignored
+bool read_sample_list(string const& filename, set<string>& samples)
+{
+    ifstream ifs(filename.c_str(), ifstream::in);
+    if (!ifs) return false;
+    string line;
+    while (getline(ifs,line)) {
+        if (line.empty() || (line[0] == '#')) continue;
+        samples.insert(line.substr(0, line.find_first_of("\t,")));
+    }
+    return true;
+}
+
+bool file_exists(string const& filename)
+{
+    return access(filename.c_str(), R_OK) == 0;
+}
+
+bool parse_schema(string const& name, string const& schema, ELoadStream stream, load_schema& load)
+{
+    string error;
+    if (!load.parse(schema, stream, error)) {
+        cerr << "Bad " << name << " schema: " << error << endl;
+        return false;
     }
+    return true;
+}
+
+// False if either output could not be written in full
+template <class Writer>
+bool scan(Writer& var_writer, Writer& gt_writer, stream_metrics& var_metrics, stream_metrics& gt_metrics,
+          subjectMap_t& subjMap, size_t maxref, size_t queue_bytes)
+{
+    var_writer.set_metrics(&var_metrics);
+    gt_writer.set_metrics(&gt_metrics);
+    var_writer.set_queue(queue_bytes);
+    gt_writer.set_queue(queue_bytes);
+    yylex(var_writer, gt_writer, subjMap, maxref);
+    var_writer.close();
+    gt_writer.close();
+    if (var_writer.failed()) cerr << "Failed to write the var output" << endl;
+    if (gt_writer.failed()) cerr << "Failed to write the gt output" << endl;
+    return !var_writer.failed() && !gt_writer.failed();
 }
 
 int main( int argc, char** argv)
@@ -77,11 +150,36 @@ int main( int argc, char** argv)
         ("help,h", "view help message, then exit")
         ("text,t", "use SciDB text format")
         ("binary,b", "use SciDB binary format")
+        ("native,n", "use SciDB binary format for the final arrays, as given by --var-schema and --gt-schema")
+        ("var-schema", value<string>()->default_value(DEFAULT_VAR_SCHEMA), "schema of the variation array, with --native")
+        ("gt-schema", value<string>()->default_value(DEFAULT_GT_SCHEMA), "schema of the genotype array, with --native")
+        ("chroms", value<string>()->default_value("array_chroms.txt"),
+         "chromosome names, one per line, numbered from 0 as chromid, new ones are appended, with --native")
+        ("filters", value<string>()->default_value("array_filters.txt"),
+         "FILTER values, numbered as --chroms, for a filterid attribute of --var-schema, PASS is 0 in a new file")
+        ("formats", value<string>()->default_value("array_formats.txt"),
+         "FORMAT values, numbered as --chroms, for a formatid attribute of --var-schema")
         ("descriptions,d", value<string>(), "Input a CSV file listing info about the samples")
+        ("input,i", value<string>(), "VCF input file, plain or compressed with gzip or bgzip (default: stdin)")
+        ("samples,s", value<string>(), "load only the samples listed in this file, one per line")
+        ("regions,r", value<string>(), "load only the rows within the regions of this BED file")
+        ("index", value<string>(), "tabix index of a bgzipped input, used with --regions (default: INPUT.tbi)")
         ("chunk,c", value<size_t>()->default_value(100000), "loading array chunk size")
         ("var,v", value<string>()->default_value("array_var.scidb"), "variation array output file")
         ("gt,g", value<string>()->default_value("array_gt.scidb"), "genotype array output file")
         ("maxref,m", value<size_t>()->default_value(50), "maximum length ")
+        ("counts", value<string>(), "write the allele counts of each variant for each population of --descriptions to this file")
+        ("sample-qc", value<string>(), "write the call rate, het/hom, singletons and Ti/Tv of each sample to this file")
+        ("ids", value<string>(), "write the variant IDs with their chrom, pos and var, sorted by rsID number or hash, to this file")
+        ("synopsis", value<string>(), "write the row count, pos and qual bounds, max AF, multi-allelic sites and carriers of each pos chunk to this file")
+        ("synopsis-chunk", value<int64_t>()->default_value(SYNOPSIS_CHUNK), "pos chunk interval of the --synopsis")
+        ("pbwt", value<string>(), "write the PBWT of the phased genotypes, as runs restarting at each pos chunk, to this file")
+        ("pbwt-chunk", value<int64_t>()->default_value(PBWT_CHUNK), "pos chunk interval of the --pbwt")
+        ("metrics", value<string>(), "write a JSON summary of throughput and wait times to this file")
+        ("threads,j", value<size_t>()->default_value(1), "threads encoding the sample columns of each row")
+        ("queue,q", value<size_t>()->default_value(ASYNC_WRITER_QUEUE_MB),
+         "memory cap in MB of the queue of each output, written by its own thread, 0 writes from the scanner")
+        ("progress,p", value<unsigned>()->default_value(5), "progress report interval on stderr in seconds, 0 disables")
     ;
     
     variables_map vm;
@@ -94,33 +192,198 @@ int main( int argc, char** argv)
     }
 
     subjectMap_t subjMap;
+    map<int64_t, string> founders;
     if (vm.count("descriptions")) {
-        read_descriptions(vm["descriptions"].as<string>(), subjMap);
+        read_descriptions(vm["descriptions"].as<string>(), subjMap, founders);
+    }
+    if (vm.count("counts") && founders.empty()) {
+        cerr << "--counts needs a --descriptions file with population and founder columns" << endl;
+        return 1;
+    }
+
+    set<string> allow;
+    if (vm.count("samples")) {
+        if (!read_sample_list(vm["samples"].as<string>(), allow)) {
+            cerr << "Failed to read the samples file " << vm["samples"].as<string>() << endl;
+            return 1;
+        }
+        sample_allow = &allow;
+    }
+
+    bed_regions regions;
+    if (vm.count("regions")) {
+        if (!regions.load(vm["regions"].as<string>())) {
+            cerr << "Failed to read the regions file " << vm["regions"].as<string>() << endl;
+            return 1;
+        }
+        row_regions = &regions;
+    }
+
+    // With an index, only the blocks overlapping the regions are read
+    bgzf_region_reader region_reader;
+    gzFile gz = NULL;
+    int fd = -1;
+    if (vm.count("input")) {
+        string input = vm["input"].as<string>();
+        string index = vm.count("index") ? vm["index"].as<string>() : input + ".tbi";
+        if (vm.count("regions") && file_exists(index)) {
+            if (!region_reader.open(input, index, regions)) {
+                cerr << "Failed to read " << input << " through the index " << index << endl;
+                return 1;
+            }
+            input_source = [&region_reader](char* buf, size_t size) { return region_reader.read(buf, size); };
+        } else if (ends_with(input, ".gz") || ends_with(input, ".bgz")) {
+            if ((gz = gzopen(input.c_str(), "rb")) == NULL) {
+                cerr << "Failed to open " << input << endl;
+                return 1;
+            }
+            gzbuffer(gz, 1 << 18);
+            input_source = [gz](char* buf, size_t size) { return (ssize_t)gzread(gz, buf, size); };
+        } else {
+            if ((fd = open(input.c_str(), O_RDONLY)) == -1) {
+                cerr << "Failed to open " << input << endl;
+                return 1;
+            }
+            input_source = [fd](char* buf, size_t size) { return read(fd, buf, size); };
+        }
     }
 
     size_t chunksize = vm["chunk"].as<size_t>();
     size_t maxref = vm["maxref"].as<size_t>();
     string varfile = vm["var"].as<string>();
     string gtfile = vm["gt"].as<string>();
+    size_t queue_bytes = vm["queue"].as<size_t>() << 20;
 
-    unique_ptr<scidb_writer> var_writer;
-    unique_ptr<scidb_writer> gt_writer;
+    load_metrics metrics("vcf2scidb");
+    stream_metrics& var_metrics = metrics.add_output("var");
+    stream_metrics& gt_metrics = metrics.add_output("gt");
+    input_metrics = &metrics.input();
+    unique_ptr<population_counts> counts;
+    if (vm.count("counts")) {
+        counts.reset(new population_counts(founders));
+        if (!counts->open(vm["counts"].as<string>(), &metrics.add_output("counts"))) {
+            cerr << "Failed to open the counts file " << vm["counts"].as<string>() << endl;
+            return 1;
+        }
+        variant_counts = counts.get();
+    }
+    unsigned progress = vm["progress"].as<unsigned>();
+    metrics.start(progress);
 
-    if (vm.count("binary")) {
-        var_writer = unique_ptr<scidb_writer>(new scidb_binary_writer(varfile));
-        gt_writer = unique_ptr<scidb_writer>(new scidb_binary_writer(gtfile));
-    } else {
-        var_writer = unique_ptr<scidb_writer>(new scidb_text_writer(varfile, chunksize));
-        gt_writer = unique_ptr<scidb_writer>(new scidb_text_writer(gtfile, chunksize));        
+    unique_ptr<thread_pool> pool;
+    if (vm["threads"].as<size_t>() > 1) {
+        pool.reset(new thread_pool(vm["threads"].as<size_t>()));
+        sample_pool = pool.get();
+    }
+
+    sample_qc qc;
+    if (vm.count("sample-qc")) sample_metrics = &qc;
+    id_index ids;
+    if (vm.count("ids")) variant_ids = &ids;
+    if (vm["synopsis-chunk"].as<int64_t>() <= 0) {
+        cerr << "--synopsis-chunk must be positive" << endl;
+        return 1;
+    }
+    chunk_synopsis zones(vm["synopsis-chunk"].as<int64_t>());
+    if (vm.count("synopsis")) chunk_zones = &zones;
+    if (vm["pbwt-chunk"].as<int64_t>() <= 0) {
+        cerr << "--pbwt-chunk must be positive" << endl;
+        return 1;
+    }
+    unique_ptr<pbwt_writer> pbwt;
+    if (vm.count("pbwt")) {
+        pbwt.reset(new pbwt_writer(vm["pbwt-chunk"].as<int64_t>()));
+        if (!pbwt->open(vm["pbwt"].as<string>(), &metrics.add_output("pbwt"))) {
+            cerr << "Failed to open the PBWT file " << vm["pbwt"].as<string>() << endl;
+            return 1;
+        }
+        haplotype_pbwt = pbwt.get();
     }
 
     max_var = 0;
     max_pos = 0;
     max_sampleid = 0;
-    yylex(*var_writer, *gt_writer, subjMap, maxref);
+    // Any output which could not be written fails the run, later loads
+    // depend on the ids of the dictionaries
+    bool ok = true;
+    if (vm.count("native")) {
+        load_schema var_schema;
+        load_schema gt_schema;
+        if (!parse_schema("var", vm["var-schema"].as<string>(), eVarStream, var_schema) ||
+            !parse_schema("gt", vm["gt-schema"].as<string>(), eGtStream, gt_schema)) {
+            return 1;
+        }
+        string chromfile = vm["chroms"].as<string>();
+        chrom_dictionary chroms;
+        if (!chroms.load(chromfile)) {
+            cerr << "Failed to read the chromosomes file " << chromfile << endl;
+            return 1;
+        }
+        // FILTER and FORMAT dictionaries, for the var schemas which use them
+        string filterfile = vm["filters"].as<string>();
+        string formatfile = vm["formats"].as<string>();
+        chrom_dictionary filters, formats;
+        bool use_filters = var_schema.has(eFieldFilterId);
+        bool use_formats = var_schema.has(eFieldFormatId);
+        if ((use_filters && !filters.load(filterfile)) || (use_formats && !formats.load(formatfile))) {
+            cerr << "Failed to read the FILTER or FORMAT dictionary" << endl;
+            return 1;
+        }
+        if (use_filters && (filters.size() == 0)) filters.id("PASS");
+        cerr << "var: input(" << var_schema.array_schema() << ", '" << varfile << "', -2, '"
+             << var_schema.format() << "')" << endl;
+        cerr << "gt: input(" << gt_schema.array_schema() << ", '" << gtfile << "', -2, '"
+             << gt_schema.format() << "')" << endl;
+        {
+            scidb_schema_writer var_writer(varfile, var_schema, chroms);
+            scidb_schema_writer gt_writer(gtfile, gt_schema, chroms);
+            var_writer.set_dictionaries(use_filters ? &filters : NULL, use_formats ? &formats : NULL);
+            ok = scan(var_writer, gt_writer, var_metrics, gt_metrics, subjMap, maxref, queue_bytes);
+        }
+        if (!chroms.save(chromfile)) {
+            cerr << "Failed to write the chromosomes file " << chromfile << endl;
+            ok = false;
+        }
+        if (use_filters && !filters.save(filterfile)) {
+            cerr << "Failed to write the FILTER dictionary " << filterfile << endl;
+            ok = false;
+        }
+        if (use_formats && !formats.save(formatfile)) {
+            cerr << "Failed to write the FORMAT dictionary " << formatfile << endl;
+            ok = false;
+        }
+    } else if (vm.count("binary")) {
+        scidb_binary_writer var_writer(varfile);
+        scidb_binary_writer gt_writer(gtfile);
+        ok = scan(var_writer, gt_writer, var_metrics, gt_metrics, subjMap, maxref, queue_bytes);
+    } else {
+        scidb_text_writer var_writer(varfile, chunksize);
+        scidb_text_writer gt_writer(gtfile, chunksize);
+        ok = scan(var_writer, gt_writer, var_metrics, gt_metrics, subjMap, maxref, queue_bytes);
+    }
+    if (counts) counts->close();
+    if (pbwt) pbwt->close();
+    if (vm.count("sample-qc") && !qc.write(vm["sample-qc"].as<string>())) {
+        cerr << "Failed to write the sample QC file " << vm["sample-qc"].as<string>() << endl;
+        ok = false;
+    }
+    if (vm.count("ids") && !ids.write(vm["ids"].as<string>())) {
+        cerr << "Failed to write the ID index file " << vm["ids"].as<string>() << endl;
+        ok = false;
+    }
+    if (vm.count("synopsis") && !zones.write(vm["synopsis"].as<string>())) {
+        cerr << "Failed to write the synopsis file " << vm["synopsis"].as<string>() << endl;
+        ok = false;
+    }
+    if (gz != NULL) gzclose(gz);
+    if (fd != -1) close(fd);
+    if (!metrics.finish(vm.count("metrics") ? vm["metrics"].as<string>() : string(), progress == 0)) {
+        cerr << "Failed to write metrics file " << vm["metrics"].as<string>() << endl;
+        ok = false;
+    }
     cout << chrom_set.size() << " ";
     cout << max_pos << " ";
     cout << max_var << " ";
     cout << max_sampleid << endl;
-    return 0;
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,196 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Blocked alt allele dosage matrix, written by vcfexport --dosage so the
+ *   genotypes can be memory mapped by NumPy or handed to BLAS without any
+ *   parsing.  The matrix is cut into blocks of variant_block variants by
+ *   sample_block samples, written variant block by variant block, and the
+ *   blocks at the edges are padded with missing values so every block has
+ *   the same size.  Within a block the cells are row major, one row per
+ *   variant.  A cell is an int8 (0, 1, 2, or -1 if missing) or, packed,
+ *   2 bits (3 if missing), the first sample in the low bits of a byte.
+ *
+ */
+
+#ifndef DOSAGE_MATRIX_HPP
+#define DOSAGE_MATRIX_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "gt8.h"
+#include "thread-pool.hpp"
+
+enum EDosageEncoding {
+    eDosageInt8,
+    eDosagePacked
+};
+
+// Cell value of a missing dosage in the int8 encoding
+#define DOSAGE_INT8_MISSING -1
+
+class dosage_matrix {
+public:
+    dosage_matrix(EDosageEncoding encoding, size_t samples, size_t variant_block, size_t sample_block)
+        : _encoding(encoding), _samples(samples), _variant_block(variant_block), _sample_block(sample_block),
+          _sample_blocks((samples + sample_block - 1) / sample_block), _variants(0), _blocks(0), _rows(0), _file(NULL)
+    {
+        for (int g = 0; g < 256; ++g) {
+            uint8_t d = gt8_dosage(g);
+            _int8[g] = (d == GT8_DOSAGE_MISSING) ? DOSAGE_INT8_MISSING : d;
+        }
+        if (_sample_blocks == 0) _sample_blocks = 1;
+        _row_bytes = (encoding == eDosageInt8) ? sample_block : sample_block / 4;
+        _block_bytes = _row_bytes * variant_block;
+        _dosage.resize(_variant_block * _sample_blocks * _sample_block);
+        _out.resize(_sample_blocks);
+    }
+
+    bool open(std::string const& filename)
+    {
+        _filename = filename;
+        _file = fopen(filename.c_str(), "wb");
+        return _file != NULL;
+    }
+
+    ~dosage_matrix()
+    {
+        if (_file) fclose(_file);
+    }
+
+    size_t row_bytes() const { return _row_bytes; }
+    size_t block_bytes() const { return _block_bytes; }
+
+    // Add nrows variants, the gt8 of each sample in order, writing the full variant blocks
+    bool add(uint8_t const* gts, size_t nrows, thread_pool& pool)
+    {
+        while (nrows > 0) {
+            size_t n = std::min(nrows, _variant_block - _rows);
+            std::function<void(size_t)> convert = [&](size_t row) {
+                uint8_t const* in = gts + row * _samples;
+                int8_t* out = &_dosage[(_rows + row) * _sample_blocks * _sample_block];
+                for (size_t s = 0; s < _samples; ++s) out[s] = _int8[in[s]];
+            };
+            pool.run(n, convert);
+            _rows += n;
+            _variants += n;
+            gts += n * _samples;
+            nrows -= n;
+            if ((_rows == _variant_block) && !flush(pool)) return false;
+        }
+        return true;
+    }
+
+    // Write the last, padded, variant block and the index
+    bool finish(std::string const& index, thread_pool& pool)
+    {
+        if ((_rows > 0) && !flush(pool)) return false;
+        if (fclose(_file) != 0) {
+            _file = NULL;
+            return false;
+        }
+        _file = NULL;
+        std::ofstream ofs(index.c_str());
+        ofs << "{\n";
+        ofs << "  \"data\": \"" << _filename.substr(_filename.rfind('/') + 1) << "\",\n";
+        ofs << "  \"encoding\": \"" << ((_encoding == eDosageInt8) ? "int8" : "2bit") << "\",\n";
+        ofs << "  \"missing\": " << ((_encoding == eDosageInt8) ? DOSAGE_INT8_MISSING : GT8_DOSAGE_MISSING) << ",\n";
+        ofs << "  \"variants\": " << _variants << ",\n";
+        ofs << "  \"samples\": " << _samples << ",\n";
+        ofs << "  \"variant_block\": " << _variant_block << ",\n";
+        ofs << "  \"sample_block\": " << _sample_block << ",\n";
+        ofs << "  \"variant_blocks\": " << _blocks << ",\n";
+        ofs << "  \"sample_blocks\": " << _sample_blocks << ",\n";
+        ofs << "  \"row_bytes\": " << _row_bytes << ",\n";
+        ofs << "  \"block_bytes\": " << _block_bytes << ",\n";
+        ofs << "  \"shape\": [" << _blocks << ", " << _sample_blocks << ", " << _variant_block << ", "
+            << _row_bytes << "]\n";
+        ofs << "}\n";
+        return ofs.good();
+    }
+
+private:
+    // Encode the sample blocks of the buffered variants in parallel, then write them
+    bool flush(thread_pool& pool)
+    {
+        size_t width = _sample_blocks * _sample_block;
+        // Padding, past the last sample, and the rows past the last variant
+        for (size_t row = 0; row < _variant_block; ++row) {
+            int8_t* r = &_dosage[row * width];
+            size_t first = (row < _rows) ? _samples : 0;
+            std::fill(r + first, r + width, (int8_t)DOSAGE_INT8_MISSING);
+        }
+        std::function<void(size_t)> encode = [&](size_t block) {
+            std::vector<uint8_t>& out = _out[block];
+            out.resize(_block_bytes);
+            for (size_t row = 0; row < _variant_block; ++row) {
+                int8_t const* in = &_dosage[row * width + block * _sample_block];
+                uint8_t* o = &out[row * _row_bytes];
+                if (_encoding == eDosageInt8) {
+                    memcpy(o, in, _sample_block);
+                    continue;
+                }
+                for (size_t s = 0; s < _sample_block; s += 4) {
+                    uint8_t byte = 0;
+                    for (size_t k = 0; k < 4; ++k) byte |= (in[s + k] & 3) << (2 * k);
+                    o[s / 4] = byte;
+                }
+            }
+        };
+        pool.run(_sample_blocks, encode);
+        for (size_t block = 0; block < _sample_blocks; ++block) {
+            if (fwrite(&_out[block][0], 1, _block_bytes, _file) != _block_bytes) return false;
+        }
+        ++_blocks;
+        _rows = 0;
+        return true;
+    }
+
+    EDosageEncoding _encoding;
+    size_t _samples;
+    size_t _variant_block;
+    size_t _sample_block;
+    size_t _sample_blocks;
+    size_t _row_bytes;
+    size_t _block_bytes;
+    uint64_t _variants;
+    uint64_t _blocks;
+    size_t _rows;           // buffered in the current variant block
+    int8_t _int8[256];
+    std::vector<int8_t> _dosage;
+    std::vector<std::vector<uint8_t> > _out;
+    std::string _filename;
+    FILE* _file;
+};
+
+#endif // ! DOSAGE_MATRIX_HPP
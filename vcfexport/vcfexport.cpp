@@ -0,0 +1,984 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ * Authors:  Douglas Slotta
+ *
+ * File Description:
+ *   Utility to write a bgzipped VCF from the _var and _gt arrays, as saved
+ *   by SciDB in its binary format, or as written by vcf2scidb --native.
+ *   The records are gathered one pos chunk at a time, the inputs of the
+ *   chunk decoded in parallel, and its lines formatted and compressed into
+ *   BGZF blocks in parallel while the next chunk is read.  With --dosage
+ *   the genotypes are written as a blocked alt allele dosage matrix
+ *   instead, see dosage-matrix.hpp.
+ *
+ */
+
+// Standard includes
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "scidb-writers.hpp"
+#include "thread-pool.hpp"
+#include "bed-regions.hpp"
+#include "bgzf.hpp"
+#include "dosage-matrix.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace boost;
+using namespace boost::program_options;
+
+// Initial size of the read buffer of each input, grown for larger records
+#define RECORD_BUFSIZE (1 << 22)
+
+// Genotype cells without a gt row, or with a null gt
+#define GT_MISSING "./."
+
+// An attribute of the current record, strings point into the read buffer
+struct field_value {
+    bool null;
+    int64_t i;
+    double d;
+    str_ref s;
+};
+
+/*
+ * Reader of records in SciDB's binary format, laid out as a load_schema:
+ * the dimensions as int64, then the attributes, each nullable one after
+ * a byte which is -1 unless it is null.  The values of the current record
+ * stay valid until the next call of next().
+ */
+class record_reader {
+public:
+    record_reader(load_schema const& schema)
+        : _attrs(schema.attributes()), _fd(-1), _buf(RECORD_BUFSIZE), _cur(0), _end(0),
+          _has(false), _error(false), _values(_attrs.size())
+    {
+        fill(_index, _index + eFieldCount, -1);
+        for (size_t i = 0; i < _attrs.size(); ++i) _index[_attrs[i].field] = i;
+    }
+
+    ~record_reader()
+    {
+        if (_fd != -1) close(_fd);
+    }
+
+    bool open(string const& filename)
+    {
+        _fd = ::open(filename.c_str(), O_RDONLY);
+        return _fd != -1;
+    }
+
+    bool has(ELoadField field) const { return _index[field] >= 0; }
+    field_value const& get(ELoadField field) const { return _values[_index[field]]; }
+    EDataType type(ELoadField field) const { return _attrs[_index[field]].data_type; }
+
+    // True while there is a current record
+    bool valid() const { return _has; }
+    bool failed() const { return _error; }
+
+    // Decode the next record, false at the end or on a short record
+    bool next()
+    {
+        _has = false;
+        while (true) {
+            size_t used = decode(_cur);
+            if (used > 0) {
+                _cur += used;
+                return _has = true;
+            }
+            ssize_t nread = refill();
+            if (nread < 0) _error = true;
+            if (nread <= 0) {
+                if (_cur != _end) _error = true;
+                return false;
+            }
+        }
+    }
+
+private:
+    static size_t fixed_size(EDataType type)
+    {
+        switch (type) {
+        case eInt8: case eUint8: case eGt8: return 1;
+        case eInt16: case eUint16: return 2;
+        case eInt32: case eUint32: case eFloat: return 4;
+        case eInt64: case eUint64: case eDouble: return 8;
+        default: return 0;
+        }
+    }
+
+    template <typename T>
+    static T load(char const* p)
+    {
+        T v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static void number(char const* p, EDataType type, field_value& v)
+    {
+        switch (type) {
+        case eInt8: v.i = load<int8_t>(p); break;
+        case eUint8: case eGt8: v.i = load<uint8_t>(p); break;
+        case eInt16: v.i = load<int16_t>(p); break;
+        case eUint16: v.i = load<uint16_t>(p); break;
+        case eInt32: v.i = load<int32_t>(p); break;
+        case eUint32: v.i = load<uint32_t>(p); break;
+        case eInt64: v.i = load<int64_t>(p); break;
+        case eUint64: v.i = load<uint64_t>(p); break;
+        case eFloat: v.d = load<float>(p); v.i = v.d; return;
+        case eDouble: v.d = load<double>(p); v.i = v.d; return;
+        default: break;
+        }
+        v.d = v.i;
+    }
+
+    // Bytes taken by the record at pos, 0 unless all of it is buffered
+    size_t decode(size_t pos)
+    {
+        char const* b = &_buf[0];
+        size_t p = pos;
+        for (size_t a = 0; a < _attrs.size(); ++a) {
+            field_value& v = _values[a];
+            v.null = false;
+            if (_attrs[a].null == eNullable) {
+                if (p + 1 > _end) return 0;
+                v.null = (b[p++] != (char)-1);
+            }
+            size_t size = fixed_size(_attrs[a].data_type);
+            if (size == 0) {
+                if (p + 4 > _end) return 0;
+                uint32_t len = load<uint32_t>(b + p);
+                p += 4;
+                if (p + len > _end) return 0;
+                // Strings are saved with their terminating NUL
+                size_t n = len;
+                if ((_attrs[a].data_type == eString) && (n > 0) && (b[p + n - 1] == '\0')) --n;
+                v.s = str_ref(b + p, n);
+                p += len;
+            } else {
+                if (p + size > _end) return 0;
+                number(b + p, _attrs[a].data_type, v);
+                p += size;
+            }
+        }
+        return p - pos;
+    }
+
+    // Keep the partial record at _cur, growing the buffer if it fills it
+    ssize_t refill()
+    {
+        if (_fd == -1) return 0;
+        if (_cur > 0) {
+            memmove(&_buf[0], &_buf[_cur], _end - _cur);
+            _end -= _cur;
+            _cur = 0;
+        }
+        if (_end == _buf.size()) _buf.resize(_buf.size() * 2);
+        ssize_t nread;
+        do {
+            nread = read(_fd, &_buf[_end], _buf.size() - _end);
+        } while ((nread < 0) && (errno == EINTR));
+        if (nread > 0) _end += nread;
+        return nread;
+    }
+
+    vector<load_attribute> const& _attrs;
+    int _fd;
+    vector<char> _buf;
+    size_t _cur;
+    size_t _end;
+    bool _has;
+    bool _error;
+    vector<field_value> _values;
+    int _index[eFieldCount];
+};
+
+// Chromosome and pos chunk, the order of the chunks in a saved array
+typedef pair<int64_t, int64_t> group_key;
+
+// A VCF row, its fixed columns at text in the group's text
+struct var_row {
+    int64_t pos;
+    int64_t var;
+    size_t text;
+    size_t len;
+
+    bool operator<(var_row const& rhs) const
+    {
+        return (pos < rhs.pos) || ((pos == rhs.pos) && (var < rhs.var));
+    }
+};
+
+// The rows of one pos chunk, and the genotypes of their output columns
+struct export_group {
+    vector<var_row> rows;
+    string text;
+    vector<uint8_t> gts;
+    // Per cell, the offset + 1 of its unparsed FORMAT fields in the arena
+    // of the input it came from, and that input in the top byte
+    vector<uint64_t> extra;
+    vector<string> arenas;
+    vector<string> outs;
+};
+
+#define EXTRA_INPUT_SHIFT 56
+
+class vcf_exporter {
+public:
+    vcf_exporter(load_schema const& var_schema, load_schema const& gt_schema, chrom_dictionary& chroms,
+                 int64_t interval, size_t threads, int level)
+        : _var_schema(var_schema), _gt_schema(gt_schema), _chroms(chroms), _interval(interval),
+          _level(level), _regions(NULL), _fd(-1), _dosage(NULL), _filters(NULL), _formats(NULL),
+          _read_pool(threads), _pool(threads), _write_failed(false), _unsorted(false)
+    {
+        char buf[16];
+        for (int g = 0; g < 256; ++g) _gt_text[g].assign(buf, gt8_format(g, buf));
+        gt8_t missing = 0;
+        gt8_parse(GT_MISSING, missing);
+        _missing = missing;
+    }
+
+    bool add_var_input(string const& filename)
+    {
+        _var_files.push_back(filename);
+        return add_input(filename, _var_schema, _vars);
+    }
+    bool add_gt_input(string const& filename) { return add_input(filename, _gt_schema, _gts); }
+
+    void set_regions(bed_regions* regions) { _regions = regions; }
+
+    // Write the dosage of the genotypes to matrix, and to fd only the variants
+    void set_dosage(dosage_matrix* matrix, string const& index)
+    {
+        _dosage = matrix;
+        _dosage_index = index;
+    }
+
+    // Names of the filterid and formatid of the var records
+    void set_dictionaries(chrom_dictionary* filters, chrom_dictionary* formats)
+    {
+        _filters = filters;
+        _formats = formats;
+    }
+
+    // Meta-information lines to write first, their IDs are not declared again
+    void set_header(vector<string> const& lines) { _header = lines; }
+
+    // Output columns in order, and the column of each sampleid
+    void set_samples(vector<string> const& names, vector<int64_t> const& sampleids)
+    {
+        _names = names;
+        for (size_t i = 0; i < sampleids.size(); ++i) {
+            if (sampleids[i] < 0) continue;
+            if ((size_t)sampleids[i] >= _column.size()) _column.resize(sampleids[i] + 1, -1);
+            _column[sampleids[i]] = i;
+        }
+    }
+
+    bool run(int fd)
+    {
+        _fd = fd;
+        if (!_vars.empty() && (!_vars[0]->has(eFieldPos) || !(_vars[0]->has(eFieldChromId) || _vars[0]->has(eFieldChrom)))) {
+            cerr << "The var schema needs pos and chrom or chromid" << endl;
+            return false;
+        }
+        if (!_gts.empty() && (!_gts[0]->has(eFieldPos) || !_gts[0]->has(eFieldSampleId) ||
+                              !(_gts[0]->has(eFieldChromId) || _gts[0]->has(eFieldChrom)))) {
+            cerr << "The gt schema needs pos, sampleid and chrom or chromid" << endl;
+            return false;
+        }
+        for (size_t i = 0; i < _vars.size(); ++i) _vars[i]->next();
+        for (size_t i = 0; i < _gts.size(); ++i) _gts[i]->next();
+
+        export_group groups[2];
+        for (int i = 0; i < 2; ++i) groups[i].arenas.resize(_gts.size());
+        // The variants of a dosage matrix are written as plain text
+        if (_dosage) _level = -1;
+        string header;
+        if (!_dosage && !scan_keys()) return false;
+        format_header(header);
+        write_block(header);
+
+        // While one chunk is formatted and written, the next one is read
+        thread emitter;
+        size_t current = 0;
+        group_key key;
+        while (next_key(key)) {
+            export_group& g = groups[current];
+            read_group(key, g);
+            if (emitter.joinable()) emitter.join();
+            if (_write_failed || _unsorted) break;
+            emitter = thread(&vcf_exporter::emit, this, std::ref(g));
+            current = 1 - current;
+        }
+        if (emitter.joinable()) emitter.join();
+
+        string eof;
+        if (_level >= 0) bgzf_eof(eof);
+        write_all(eof.data(), eof.size());
+        if (_dosage && !_write_failed && !_dosage->finish(_dosage_index, _pool)) _write_failed = true;
+
+        bool ok = !_write_failed && !_unsorted;
+        for (size_t i = 0; i < _vars.size(); ++i) ok = ok && !_vars[i]->failed();
+        for (size_t i = 0; i < _gts.size(); ++i) ok = ok && !_gts[i]->failed();
+        return ok;
+    }
+
+private:
+    bool add_input(string const& filename, load_schema const& schema, vector<unique_ptr<record_reader> >& inputs)
+    {
+        inputs.push_back(unique_ptr<record_reader>(new record_reader(schema)));
+        return inputs.back()->open(filename);
+    }
+
+    group_key key_of(record_reader const& r)
+    {
+        int64_t chrom;
+        if (r.has(eFieldChromId)) {
+            chrom = r.get(eFieldChromId).i;
+        } else {
+            lock_guard<mutex> lock(_chroms_mutex);
+            chrom = _chroms.id(r.get(eFieldChrom).s);
+        }
+        int64_t pos = r.get(eFieldPos).i;
+        return group_key(chrom, (pos > 0) ? (pos - 1) / _interval : 0);
+    }
+
+    // Each input must come sorted by chunk, or the rows of a chunk already
+    // passed would be dropped, so a key before the last one fails the export
+    bool in_order(vector<group_key>& last, size_t i, group_key const& k, char const* what)
+    {
+        if (i >= last.size()) last.resize(i + 1, group_key(INT64_MIN, INT64_MIN));
+        if (k < last[i]) {
+            cerr << what << " input " << i + 1 << " is not sorted by chromid and pos chunk" << endl;
+            _unsorted = true;
+            return false;
+        }
+        last[i] = k;
+        return true;
+    }
+
+    // The next chunk with variants, the smallest among the var inputs
+    bool next_key(group_key& key)
+    {
+        bool found = false;
+        for (size_t i = 0; i < _vars.size(); ++i) {
+            if (!_vars[i]->valid()) continue;
+            group_key k = key_of(*_vars[i]);
+            if (!in_order(_var_last, i, k, "var")) return false;
+            if (!found || (k < key)) key = k;
+            found = true;
+        }
+        return found;
+    }
+
+    string const& chrom_name(int64_t chrom)
+    {
+        lock_guard<mutex> lock(_chroms_mutex);
+        if ((chrom < 0) || ((size_t)chrom >= _chroms.size())) {
+            _unknown = lexical_cast<string>(chrom);
+            return _unknown;
+        }
+        return _chroms.name(chrom);
+    }
+
+    static void append_int(string& out, int64_t v)
+    {
+        char buf[FORMAT_INT64_MAX];
+        out.append(buf, format_int64(v, buf));
+    }
+
+    // A VCF column from a value of the type type, "." if null or empty
+    static void append_value(string& out, field_value const& v, EDataType type)
+    {
+        if (v.null) {
+            out.push_back('.');
+            return;
+        }
+        char buf[64];
+        switch (type) {
+        case eString:
+            if (v.s.empty()) out.push_back('.');
+            else out.append(v.s.data(), v.s.size());
+            break;
+        case eNuc: {
+            string alleles;
+            nuc_format(reinterpret_cast<uint8_t const*>(v.s.data()), v.s.size(), alleles);
+            out.append(alleles.empty() ? string(".") : alleles);
+        } break;
+        case eFloat:
+        case eDouble:
+            out.append(buf, snprintf(buf, sizeof(buf), "%g", v.d));
+            break;
+        case eGt8:
+            out.append(buf, gt8_format(v.i, buf));
+            break;
+        default:
+            append_int(out, v.i);
+            break;
+        }
+    }
+
+    static void append_field(string& out, record_reader const& r, ELoadField field)
+    {
+        if (r.has(field)) append_value(out, r.get(field), r.type(field));
+        else out.push_back('.');
+    }
+
+    // The name of the id in code, or str if the schema has str instead
+    static str_ref coded_field(record_reader const& r, ELoadField str, ELoadField code, chrom_dictionary const* names)
+    {
+        if (r.has(code)) {
+            field_value const& v = r.get(code);
+            if (v.null || !names || (v.i < 0) || ((size_t)v.i >= names->size())) return str_ref();
+            return names->name(v.i);
+        }
+        if (!r.has(str) || r.get(str).null) return str_ref();
+        return r.get(str).s;
+    }
+
+    static void add_keys(str_ref text, char sep, map<string, bool>& keys)
+    {
+        while (!text.empty()) {
+            size_t end = text.find(sep);
+            str_ref item = text.substr(0, end);
+            size_t eq = item.find('=');
+            string key(item.data(), min(eq, item.size()));
+            if (!key.empty() && (key != ".")) {
+                bool flag = (eq == str_ref::npos);
+                map<string, bool>::iterator k = keys.find(key);
+                if (k == keys.end()) keys[key] = flag;
+                else k->second = k->second && flag;
+            }
+            if (end == str_ref::npos) break;
+            text = text.substr(end + 1);
+        }
+    }
+
+    // The FILTER names, INFO keys and FORMAT keys of every var record, for the
+    // header.  The var inputs are read once more, they are small next to gt.
+    bool scan_keys()
+    {
+        for (size_t i = 0; i < _var_files.size(); ++i) {
+            record_reader r(_var_schema);
+            if (!r.open(_var_files[i])) return false;
+            while (r.next()) {
+                if (!r.has(eFieldChromId) && r.has(eFieldChrom)) _chroms.id(r.get(eFieldChrom).s);
+                add_keys(coded_field(r, eFieldFilter, eFieldFilterId, _filters), ';', _filter_keys);
+                if (r.has(eFieldInfo) && !r.get(eFieldInfo).null) add_keys(r.get(eFieldInfo).s, ';', _info_keys);
+                add_keys(coded_field(r, eFieldFormat, eFieldFormatId, _formats), ':', _format_keys);
+            }
+            if (r.failed()) return false;
+        }
+        _filter_keys.erase("PASS");
+        _format_keys.erase("GT");
+        return true;
+    }
+
+    void add_row(record_reader const& r, string const& chrom, export_group& g)
+    {
+        var_row row;
+        row.pos = r.get(eFieldPos).i;
+        row.var = r.has(eFieldVar) ? r.get(eFieldVar).i : 1;
+        if (_regions && !_regions->contains(chrom.data(), chrom.size(), row.pos)) return;
+        row.text = g.text.size();
+        string& t = g.text;
+        t.append(chrom);
+        t.push_back('\t');
+        append_int(t, row.pos);
+        ELoadField const fields[] = { eFieldId, eFieldRef, eFieldAlt, eFieldQual };
+        for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); ++f) {
+            t.push_back('\t');
+            append_field(t, r, fields[f]);
+        }
+        str_ref filter = coded_field(r, eFieldFilter, eFieldFilterId, _filters);
+        t.push_back('\t');
+        if (filter.empty()) t.push_back('.');
+        else t.append(filter.data(), filter.size());
+        t.push_back('\t');
+        append_field(t, r, eFieldInfo);
+        // vcf2scidb keeps the FORMAT keys after GT
+        t.append("\tGT");
+        str_ref format = coded_field(r, eFieldFormat, eFieldFormatId, _formats);
+        if (!format.empty()) {
+            t.push_back(':');
+            t.append(format.data(), format.size());
+        }
+        row.len = t.size() - row.text;
+        g.rows.push_back(row);
+    }
+
+    // Place the genotypes of input i which belong to the chunk key
+    void read_genotypes(size_t i, group_key const& key, export_group& g)
+    {
+        record_reader& r = *_gts[i];
+        string& arena = g.arenas[i];
+        arena.clear();
+        size_t ncols = _names.size();
+        size_t last = 0;
+        for (; r.valid(); r.next()) {
+            group_key k = key_of(r);
+            if (!in_order(_gt_last, i, k, "gt")) break;
+            if (key < k) break;
+            if (k < key) continue;      // a chunk without variants
+            int64_t sampleid = r.get(eFieldSampleId).i;
+            if ((sampleid < 0) || ((size_t)sampleid >= _column.size()) || (_column[sampleid] < 0)) continue;
+            var_row probe;
+            probe.pos = r.get(eFieldPos).i;
+            probe.var = r.has(eFieldVar) ? r.get(eFieldVar).i : 1;
+            // Genotypes come in runs of the same row
+            if ((last >= g.rows.size()) || (g.rows[last] < probe) || (probe < g.rows[last])) {
+                last = lower_bound(g.rows.begin(), g.rows.end(), probe) - g.rows.begin();
+                if ((last == g.rows.size()) || (probe < g.rows[last])) continue;
+            }
+            size_t cell = last * ncols + _column[sampleid];
+            if (r.has(eFieldGt) && !r.get(eFieldGt).null) g.gts[cell] = r.get(eFieldGt).i;
+            if (_dosage) continue;
+            if (r.has(eFieldUnparsed) && !r.get(eFieldUnparsed).null && !r.get(eFieldUnparsed).s.empty()) {
+                str_ref extra = r.get(eFieldUnparsed).s;
+                g.extra[cell] = ((uint64_t)i << EXTRA_INPUT_SHIFT) | (arena.size() + 1);
+                uint32_t len = extra.size();
+                arena.append(reinterpret_cast<char const*>(&len), sizeof(len));
+                arena.append(extra.data(), extra.size());
+            }
+        }
+    }
+
+    void read_group(group_key const& key, export_group& g)
+    {
+        g.rows.clear();
+        g.text.clear();
+        string const chrom = chrom_name(key.first);
+        for (size_t i = 0; i < _vars.size(); ++i) {
+            record_reader& r = *_vars[i];
+            for (; r.valid() && (key_of(r) == key); r.next()) add_row(r, chrom, g);
+        }
+        sort(g.rows.begin(), g.rows.end());
+
+        size_t cells = g.rows.size() * _names.size();
+        g.gts.assign(cells, _missing);
+        g.extra.assign(cells, 0);
+        // Sized here, as the pool threads each update their own
+        _gt_last.resize(_gts.size(), group_key(INT64_MIN, INT64_MIN));
+        std::function<void(size_t)> decode = [&](size_t i) { read_genotypes(i, key, g); };
+        _read_pool.run(_gts.size(), decode);
+    }
+
+    // Lines of rows [first, last) of g
+    void format_rows(export_group const& g, size_t first, size_t last, string& out) const
+    {
+        size_t ncols = _names.size();
+        for (size_t row = first; row < last; ++row) {
+            out.append(g.text, g.rows[row].text, g.rows[row].len);
+            for (size_t col = 0; col < ncols; ++col) {
+                size_t cell = row * ncols + col;
+                out.push_back('\t');
+                out.append(_gt_text[g.gts[cell]]);
+                if (g.extra[cell] != 0) {
+                    string const& arena = g.arenas[g.extra[cell] >> EXTRA_INPUT_SHIFT];
+                    size_t off = (g.extra[cell] & ((1ULL << EXTRA_INPUT_SHIFT) - 1)) - 1;
+                    uint32_t len;
+                    memcpy(&len, &arena[off], sizeof(len));
+                    out.push_back(':');
+                    out.append(arena, off + sizeof(len), len);
+                }
+            }
+            out.push_back('\n');
+        }
+    }
+
+    // Format and compress ranges of the rows in parallel, then write them in order
+    void emit(export_group& g)
+    {
+        size_t nrows = g.rows.size();
+        if (_dosage) {
+            emit_dosage(g);
+            return;
+        }
+        size_t nranges = min(nrows, _pool.size() * 4);
+        if (nranges == 0) return;
+        if (g.outs.size() < nranges) g.outs.resize(nranges);
+        std::function<void(size_t)> encode = [&](size_t range) {
+            string& out = g.outs[range];
+            out.clear();
+            size_t first = nrows * range / nranges;
+            size_t last = nrows * (range + 1) / nranges;
+            if (_level < 0) {
+                format_rows(g, first, last, out);
+                return;
+            }
+            string text;
+            format_rows(g, first, last, text);
+            if (!bgzf_compress(text.data(), text.size(), _level, out)) out.clear();
+        };
+        _pool.run(nranges, encode);
+        for (size_t range = 0; range < nranges; ++range) write_all(g.outs[range].data(), g.outs[range].size());
+    }
+
+    // The CHROM to ALT columns of each row, then the dosage of its genotypes
+    void emit_dosage(export_group& g)
+    {
+        if (g.outs.empty()) g.outs.resize(1);
+        string& out = g.outs[0];
+        out.clear();
+        for (size_t row = 0; row < g.rows.size(); ++row) {
+            size_t len = 0;
+            for (int tabs = 0; len < g.rows[row].len; ++len) {
+                if ((g.text[g.rows[row].text + len] == '\t') && (++tabs == 5)) break;
+            }
+            out.append(g.text, g.rows[row].text, len);
+            out.push_back('\n');
+        }
+        write_all(out.data(), out.size());
+        if (!_write_failed && !_dosage->add(g.gts.data(), g.rows.size(), _pool)) _write_failed = true;
+    }
+
+    void format_header(string& out) const
+    {
+        if (_dosage) {
+            out = "#CHROM\tPOS\tID\tREF\tALT\n";
+            return;
+        }
+        out = "##fileformat=VCFv4.2\n##source=vcfexport\n";
+        // The lines of --header come first, and define their IDs
+        set<string> defined;
+        for (size_t i = 0; i < _header.size(); ++i) {
+            string const& line = _header[i];
+            if (!starts_with(line, "##") || starts_with(line, "##fileformat=")) continue;
+            out += line + "\n";
+            size_t id = line.find("=<ID=");
+            if (id != string::npos) defined.insert(line.substr(2, line.find_first_of(",>", id + 5) - 2));
+        }
+        for (size_t i = 0; i < _chroms.size(); ++i) {
+            if (!defined.count("contig=<ID=" + _chroms.name(i))) out += "##contig=<ID=" + _chroms.name(i) + ">\n";
+        }
+        if (!defined.count("FILTER=<ID=PASS")) out += "##FILTER=<ID=PASS,Description=\"All filters passed\">\n";
+        for (map<string, bool>::const_iterator k = _filter_keys.begin(); k != _filter_keys.end(); ++k) {
+            if (!defined.count("FILTER=<ID=" + k->first)) out += "##FILTER=<ID=" + k->first + ",Description=\"\">\n";
+        }
+        // Without --header the types are not known, so values are strings
+        for (map<string, bool>::const_iterator k = _info_keys.begin(); k != _info_keys.end(); ++k) {
+            if (defined.count("INFO=<ID=" + k->first)) continue;
+            out += "##INFO=<ID=" + k->first + (k->second ? ",Number=0,Type=Flag" : ",Number=.,Type=String")
+                + ",Description=\"\">\n";
+        }
+        if (!defined.count("FORMAT=<ID=GT")) out += "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">\n";
+        for (map<string, bool>::const_iterator k = _format_keys.begin(); k != _format_keys.end(); ++k) {
+            if (!defined.count("FORMAT=<ID=" + k->first))
+                out += "##FORMAT=<ID=" + k->first + ",Number=.,Type=String,Description=\"\">\n";
+        }
+        out += "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+        for (size_t i = 0; i < _names.size(); ++i) out += "\t" + _names[i];
+        out += "\n";
+    }
+
+    void write_block(string const& text)
+    {
+        if (_level < 0) {
+            write_all(text.data(), text.size());
+            return;
+        }
+        string out;
+        bgzf_compress(text.data(), text.size(), _level, out);
+        write_all(out.data(), out.size());
+    }
+
+    void write_all(char const* data, size_t size)
+    {
+        while ((size > 0) && !_write_failed) {
+            ssize_t n = write(_fd, data, size);
+            if ((n < 0) && (errno == EINTR)) continue;
+            if (n <= 0) {
+                _write_failed = true;
+                break;
+            }
+            data += n;
+            size -= n;
+        }
+    }
+
+    load_schema const& _var_schema;
+    load_schema const& _gt_schema;
+    chrom_dictionary& _chroms;
+    mutex _chroms_mutex;
+    string _unknown;
+    int64_t _interval;
+    int _level;
+    bed_regions* _regions;
+    int _fd;
+    dosage_matrix* _dosage;
+    string _dosage_index;
+    chrom_dictionary* _filters;
+    chrom_dictionary* _formats;
+    vector<string> _header;
+    vector<string> _var_files;
+    // Keys of the header, true for those never given a value
+    map<string, bool> _filter_keys;
+    map<string, bool> _info_keys;
+    map<string, bool> _format_keys;
+    // The next chunk is read while the emitter formats the last one
+    thread_pool _read_pool;
+    thread_pool _pool;
+    // Set by the emitter and the pools, read by the main loop
+    atomic<bool> _write_failed;
+    atomic<bool> _unsorted;
+    // The last chunk of each input
+    vector<group_key> _var_last;
+    vector<group_key> _gt_last;
+    vector<unique_ptr<record_reader> > _vars;
+    vector<unique_ptr<record_reader> > _gts;
+    vector<string> _names;
+    vector<int> _column;
+    string _gt_text[256];
+    uint8_t _missing;
+};
+
+// sampleid and name of each sample of a descriptions file, in file order,
+// only those of the populations in pops if it is given
+bool read_descriptions(string const& filename, set<string> const* allow, set<string> const* pops,
+                       vector<string>& names, vector<int64_t>& sampleids)
+{
+    ifstream ifs(filename.c_str(), ifstream::in);
+    if (!ifs) return false;
+    string line;
+    while (getline(ifs, line)) {
+        if (line.empty() || (line[0] == '#')) continue;
+        vector<string> cells;
+        split(cells, line, is_any_of(","));
+        if (cells.size() < 2) continue;
+        if (allow && (allow->count(cells[1]) == 0)) continue;
+        if (pops && ((cells.size() < 3) || (pops->count(cells[2]) == 0))) continue;
+        sampleids.push_back(lexical_cast<int64_t>(trim_copy(cells[0])));
+        names.push_back(cells[1]);
+    }
+    return true;
+}
+
+// One sample name per line, anything after a tab or comma is ignored
+bool read_sample_list(string const& filename, set<string>& samples)
+{
+    ifstream ifs(filename.c_str(), ifstream::in);
+    if (!ifs) return false;
+    string line;
+    while (getline(ifs, line)) {
+        if (line.empty() || (line[0] == '#')) continue;
+        samples.insert(line.substr(0, line.find_first_of("\t,")));
+    }
+    return true;
+}
+
+bool parse_schema(string const& name, string const& schema, ELoadStream stream, load_schema& load)
+{
+    string error;
+    if (!load.parse(schema, stream, error)) {
+        cerr << "Bad " << name << " schema: " << error << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "view help message, then exit")
+        ("var,v", value<vector<string> >(), "saved variation array, may be given once for each instance")
+        ("gt,g", value<vector<string> >(), "saved genotype array, may be given once for each instance")
+        ("var-schema", value<string>()->default_value(DEFAULT_VAR_SCHEMA), "schema of the --var records")
+        ("gt-schema", value<string>()->default_value(DEFAULT_GT_SCHEMA), "schema of the --gt records")
+        ("chroms", value<string>()->default_value("array_chroms.txt"),
+         "chromosome names, one per line, numbered from 0 as chromid")
+        ("filters", value<string>()->default_value("array_filters.txt"),
+         "FILTER values, one per line, numbered from 0 as a filterid of --var-schema")
+        ("formats", value<string>()->default_value("array_formats.txt"),
+         "FORMAT values, one per line, numbered from 0 as a formatid of --var-schema")
+        ("header", value<string>(), "VCF header whose ## lines are written first, for the types of INFO and FORMAT")
+        ("descriptions,d", value<string>(), "CSV file listing the sampleid and name of each sample, in output order")
+        ("samples,s", value<string>(), "write only the samples listed in this file, one per line")
+        ("populations,P", value<string>(), "write only the samples of these comma separated populations")
+        ("regions,r", value<string>(), "write only the rows within the regions of this BED file")
+        ("chunk,c", value<int64_t>()->default_value(200000), "pos chunk interval of the arrays")
+        ("output,o", value<string>(), "bgzipped VCF output file (default: stdout)")
+        ("level,l", value<int>()->default_value(6), "compression level, -1 writes plain text")
+        ("dosage", value<string>(),
+         "write the alt allele dosage as a blocked matrix, PREFIX.bin, with its index PREFIX.json, "
+         "and the variants and samples in PREFIX.variants.tsv and PREFIX.samples.txt, instead of a VCF")
+        ("packed", "store 4 dosages to a byte in the --dosage matrix, instead of one int8")
+        ("variant-block", value<size_t>()->default_value(1024), "variants in a block of the --dosage matrix")
+        ("sample-block", value<size_t>()->default_value(4096),
+         "samples in a block of the --dosage matrix, a multiple of 4 when --packed")
+        ("threads,j", value<size_t>()->default_value(thread::hardware_concurrency()),
+         "threads decoding the inputs and compressing the output")
+    ;
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+    notify(vm);
+
+    if (vm.count("help") || !vm.count("var") || !vm.count("descriptions")) {
+        cout << "Write a bgzipped VCF, or a dosage matrix, from the binary save()s of the _var and _gt arrays\n";
+        cout << desc << "\n";
+        return 1;
+    }
+
+    load_schema var_schema;
+    load_schema gt_schema;
+    if (!parse_schema("var", vm["var-schema"].as<string>(), eVarStream, var_schema) ||
+        !parse_schema("gt", vm["gt-schema"].as<string>(), eGtStream, gt_schema)) {
+        return 1;
+    }
+    chrom_dictionary chroms;
+    if (!chroms.load(vm["chroms"].as<string>())) {
+        cerr << "Failed to read the chromosomes file " << vm["chroms"].as<string>() << endl;
+        return 1;
+    }
+
+    chrom_dictionary filters, formats;
+    if ((var_schema.has(eFieldFilterId) && !filters.load(vm["filters"].as<string>())) ||
+        (var_schema.has(eFieldFormatId) && !formats.load(vm["formats"].as<string>()))) {
+        cerr << "Failed to read the FILTER or FORMAT dictionary" << endl;
+        return 1;
+    }
+    vector<string> header;
+    if (vm.count("header")) {
+        ifstream ifs(vm["header"].as<string>().c_str());
+        string line;
+        while (getline(ifs, line) && starts_with(line, "##")) header.push_back(line);
+        if (ifs.bad() || header.empty()) {
+            cerr << "Failed to read the header file " << vm["header"].as<string>() << endl;
+            return 1;
+        }
+    }
+
+    set<string> allow;
+    if (vm.count("samples") && !read_sample_list(vm["samples"].as<string>(), allow)) {
+        cerr << "Failed to read the samples file " << vm["samples"].as<string>() << endl;
+        return 1;
+    }
+    vector<string> names;
+    vector<int64_t> sampleids;
+    set<string> pops;
+    if (vm.count("populations")) split(pops, vm["populations"].as<string>(), is_any_of(","));
+    if (!read_descriptions(vm["descriptions"].as<string>(), vm.count("samples") ? &allow : NULL,
+                           vm.count("populations") ? &pops : NULL, names, sampleids)) {
+        cerr << "Failed to read the descriptions file " << vm["descriptions"].as<string>() << endl;
+        return 1;
+    }
+
+    bed_regions regions;
+    if (vm.count("regions") && !regions.load(vm["regions"].as<string>())) {
+        cerr << "Failed to read the regions file " << vm["regions"].as<string>() << endl;
+        return 1;
+    }
+
+    if (vm["chunk"].as<int64_t>() <= 0) {
+        cerr << "--chunk must be positive" << endl;
+        return 1;
+    }
+    size_t threads = max(vm["threads"].as<size_t>(), (size_t)1);
+    vcf_exporter exporter(var_schema, gt_schema, chroms, vm["chunk"].as<int64_t>(), threads, vm["level"].as<int>());
+    exporter.set_samples(names, sampleids);
+    exporter.set_dictionaries(&filters, &formats);
+    exporter.set_header(header);
+    if (vm.count("regions")) exporter.set_regions(&regions);
+
+    vector<string> inputs = vm["var"].as<vector<string> >();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (!exporter.add_var_input(inputs[i])) {
+            cerr << "Failed to open " << inputs[i] << endl;
+            return 1;
+        }
+    }
+    if (vm.count("gt")) {
+        inputs = vm["gt"].as<vector<string> >();
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (!exporter.add_gt_input(inputs[i])) {
+                cerr << "Failed to open " << inputs[i] << endl;
+                return 1;
+            }
+        }
+    }
+
+    string output = vm.count("output") ? vm["output"].as<string>() : string();
+    unique_ptr<dosage_matrix> matrix;
+    if (vm.count("dosage")) {
+        string prefix = vm["dosage"].as<string>();
+        size_t variant_block = vm["variant-block"].as<size_t>();
+        size_t sample_block = vm["sample-block"].as<size_t>();
+        if ((variant_block == 0) || (sample_block == 0) || (vm.count("packed") && (sample_block % 4 != 0))) {
+            cerr << "The dosage blocks must not be empty, and hold a multiple of 4 samples when packed" << endl;
+            return 1;
+        }
+        matrix.reset(new dosage_matrix(vm.count("packed") ? eDosagePacked : eDosageInt8, names.size(),
+                                       variant_block, sample_block));
+        if (!matrix->open(prefix + ".bin")) {
+            cerr << "Failed to open " << prefix << ".bin" << endl;
+            return 1;
+        }
+        ofstream ofs((prefix + ".samples.txt").c_str());
+        for (size_t i = 0; i < names.size(); ++i) ofs << names[i] << '\n';
+        if (!ofs) {
+            cerr << "Failed to write " << prefix << ".samples.txt" << endl;
+            return 1;
+        }
+        exporter.set_dosage(matrix.get(), prefix + ".json");
+        output = prefix + ".variants.tsv";
+    }
+
+    int fd = STDOUT_FILENO;
+    if (!output.empty()) {
+        fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd == -1) {
+            cerr << "Failed to open " << output << endl;
+            return 1;
+        }
+    }
+    bool ok = exporter.run(fd);
+    if (fd != STDOUT_FILENO) close(fd);
+    if (!ok) {
+        cerr << "Export failed, an input was cut short or out of order, or the output could not be written" << endl;
+        return 1;
+    }
+    return 0;
+}